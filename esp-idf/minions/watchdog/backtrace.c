@@ -0,0 +1,368 @@
+#ifndef ESP_PLATFORM
+#define _GNU_SOURCE                     // dladdr()
+#endif
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+#include "backtrace.h"
+
+static const char *TAG = "Backtrace";
+
+static backtrace_slot_t s_slots[SUPERVISOR_MAX_USERS];
+static hal_spinlock_t s_lock = HAL_SPINLOCK_INIT;
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/task_snapshot.h"
+#include "esp_debug_helpers.h"
+#include "esp_cpu_utils.h"
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+#include "freertos/xtensa_context.h"
+#else
+#include "riscv/rvruntime-frames.h"
+#endif
+
+//---------------------------------------------------------------------
+// Append one frame to a slot
+//---------------------------------------------------------------------
+static bool push_frame(backtrace_slot_t *slot, uintptr_t pc, uintptr_t sp)
+{
+    if (slot->depth >= BACKTRACE_DEPTH) {
+        slot->flags |= BACKTRACE_TRUNCATED;
+        return false;
+    }
+    slot->pc[slot->depth] = pc;
+    slot->sp[slot->depth] = sp;
+    slot->depth++;
+    return true;
+}
+
+//---------------------------------------------------------------------
+// Walk a switched-out task's stack from its saved context
+//---------------------------------------------------------------------
+static void capture_task(TaskHandle_t task, backtrace_slot_t *slot)
+{
+    // The caller is running on this core, so a running target is on the
+    // other one and its saved context is stale
+    if (eTaskGetState(task) == eRunning) {
+        slot->flags |= BACKTRACE_RUNNING;
+        return;
+    }
+
+    // Keep the task from being scheduled here while its stack is read
+    vTaskSuspendAll();
+
+    TaskSnapshot_t snapshot;
+    vTaskGetSnapshot(task, &snapshot);
+    uintptr_t stack_low = (uintptr_t)snapshot.pxTopOfStack;
+    uintptr_t stack_high = (uintptr_t)snapshot.pxEndOfStack;
+
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+    const XtExcFrame *exc = (const XtExcFrame *)snapshot.pxTopOfStack;
+    esp_backtrace_frame_t frame;
+    if (exc->exit != 0) {
+        // Preempted: full exception frame
+        frame.pc = exc->pc;
+        frame.sp = exc->a1;
+        frame.next_pc = exc->a0;
+    } else {
+        // Blocked: solicited frame from a voluntary yield
+        const XtSolFrame *sol = (const XtSolFrame *)snapshot.pxTopOfStack;
+        frame.pc = sol->pc;
+        frame.sp = sol->a1;
+        frame.next_pc = sol->a0;
+    }
+
+    push_frame(slot, esp_cpu_process_stack_pc(frame.pc), frame.sp);
+    while (frame.next_pc != 0) {
+        // The base save area below sp must lie on the task's own stack
+        if (frame.sp < stack_low + 16 || frame.sp >= stack_high) {
+            slot->flags |= BACKTRACE_CORRUPTED;
+            break;
+        }
+        if (!esp_backtrace_get_next_frame(&frame)) {
+            slot->flags |= BACKTRACE_CORRUPTED;
+            break;
+        }
+        if (!push_frame(slot, esp_cpu_process_stack_pc(frame.pc), frame.sp)) {
+            break;
+        }
+    }
+#else
+    // Without frame pointers only the saved pc and return address are known
+    const RvExcFrame *exc = (const RvExcFrame *)snapshot.pxTopOfStack;
+    push_frame(slot, exc->mepc, exc->sp);
+    if (exc->ra != 0) {
+        push_frame(slot, exc->ra, 0);
+    }
+    (void)stack_low;
+    (void)stack_high;
+#endif
+
+    xTaskResumeAll();
+    slot->flags |= BACKTRACE_VALID;
+}
+
+esp_err_t backtrace_init(void)
+{
+    memset(s_slots, 0, sizeof(s_slots));
+    return ESP_OK;
+}
+
+esp_err_t backtrace_capture_user(supervisor_user_id_t id)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    TaskHandle_t task = supervisor_get_task(id);
+    if (task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    backtrace_slot_t slot = { .timestamp_us = hal_time_us() };
+    capture_task(task, &slot);
+
+    hal_enter_critical(&s_lock);
+    s_slots[id] = slot;
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+// Device addresses are already link-time addresses
+static uintptr_t printable_pc(uintptr_t pc)
+{
+    return pc;
+}
+
+#else // Host build
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <time.h>
+#if __has_include(<libunwind.h>)
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#define HAVE_LIBUNWIND                  1
+#else
+#include <execinfo.h>
+#define HAVE_LIBUNWIND                  0
+#endif
+
+#define BACKTRACE_SIGNAL                (SIGRTMIN + 1)
+#define CAPTURE_TIMEOUT_MS              100
+
+// One capture at a time. A request is claimed by exactly one handler run,
+// which fills s_scratch and posts s_done; a request the capturer takes
+// back on timeout can no longer be claimed, so no handler outlives it.
+static pthread_mutex_t s_capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static backtrace_slot_t s_scratch;
+static pthread_t s_target_thread;
+static uint32_t s_request;              // Generation of the pending capture, 0 if none
+static uint32_t s_generation;
+static sem_t s_done;
+
+//---------------------------------------------------------------------
+// Runs on the stuck thread: unwind past the signal frame into the code
+// that was interrupted. Only async-signal-safe calls are made here.
+//---------------------------------------------------------------------
+static void capture_handler(int sig)
+{
+    (void)sig;
+    // A signal left over from a capture that timed out finds no request,
+    // or one for another thread
+    uint32_t gen = __atomic_load_n(&s_request, __ATOMIC_ACQUIRE);
+    if (gen == 0 || !pthread_equal(pthread_self(), s_target_thread) ||
+        !__atomic_compare_exchange_n(&s_request, &gen, 0, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    backtrace_slot_t *slot = &s_scratch;
+
+#if HAVE_LIBUNWIND
+    unw_context_t context;
+    unw_cursor_t cursor;
+    bool past_signal_frame = false;
+
+    unw_getcontext(&context);
+    unw_init_local(&cursor, &context);
+    while (unw_step(&cursor) > 0) {
+        if (!past_signal_frame) {
+            past_signal_frame = unw_is_signal_frame(&cursor) > 0;
+            continue;
+        }
+        if (slot->depth >= BACKTRACE_DEPTH) {
+            slot->flags |= BACKTRACE_TRUNCATED;
+            break;
+        }
+        unw_word_t pc, sp;
+        unw_get_reg(&cursor, UNW_REG_IP, &pc);
+        unw_get_reg(&cursor, UNW_REG_SP, &sp);
+        slot->pc[slot->depth] = (uintptr_t)pc;
+        slot->sp[slot->depth] = (uintptr_t)sp;
+        slot->depth++;
+    }
+#else
+    // Frame 0 is this handler and frame 1 the signal trampoline
+    void *frames[BACKTRACE_DEPTH + 2];
+    int count = backtrace(frames, BACKTRACE_DEPTH + 2);
+    for (int i = 2; i < count; i++) {
+        slot->pc[slot->depth++] = (uintptr_t)frames[i];
+    }
+    if (count == BACKTRACE_DEPTH + 2) {
+        slot->flags |= BACKTRACE_TRUNCATED;
+    }
+#endif
+
+    slot->flags |= BACKTRACE_VALID;
+    sem_post(&s_done);
+}
+
+esp_err_t backtrace_init(void)
+{
+    memset(s_slots, 0, sizeof(s_slots));
+    sem_init(&s_done, 0, 0);
+
+#if !HAVE_LIBUNWIND
+    // backtrace() loads libgcc on first use, which is not signal safe
+    void *warmup[1];
+    backtrace(warmup, 1);
+#endif
+
+    struct sigaction action = { 0 };
+    action.sa_handler = capture_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    return sigaction(BACKTRACE_SIGNAL, &action, NULL) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+//---------------------------------------------------------------------
+// Interrupt a thread and collect its backtrace into a user's slot
+//---------------------------------------------------------------------
+esp_err_t backtrace_capture_thread(supervisor_user_id_t id, pthread_t thread)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&s_capture_lock);
+    while (sem_trywait(&s_done) == 0) {
+    }
+    memset(&s_scratch, 0, sizeof(s_scratch));
+    s_scratch.timestamp_us = hal_time_us();
+    s_target_thread = thread;
+    if (++s_generation == 0) {
+        s_generation = 1;
+    }
+    uint32_t gen = s_generation;
+    __atomic_store_n(&s_request, gen, __ATOMIC_RELEASE);
+
+    esp_err_t err = ESP_OK;
+    if (pthread_kill(thread, BACKTRACE_SIGNAL) != 0) {
+        __atomic_store_n(&s_request, 0, __ATOMIC_RELAXED);
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += CAPTURE_TIMEOUT_MS * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        while (sem_timedwait(&s_done, &deadline) != 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Take the request back; if a handler claimed it first it is
+            // already unwinding, and its post is waited for
+            if (__atomic_compare_exchange_n(&s_request, &gen, 0, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                err = ESP_ERR_TIMEOUT;
+            } else {
+                while (sem_wait(&s_done) != 0) {
+                }
+            }
+            break;
+        }
+    }
+
+    if (err == ESP_OK) {
+        hal_enter_critical(&s_lock);
+        s_slots[id] = s_scratch;
+        hal_exit_critical(&s_lock);
+    }
+    pthread_mutex_unlock(&s_capture_lock);
+    return err;
+}
+
+esp_err_t backtrace_capture_user(supervisor_user_id_t id)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_t thread;
+    if (!hal_linux_task_thread(supervisor_get_task(id), &thread)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return backtrace_capture_thread(id, thread);
+}
+
+// Make addresses relative to their module so addr2line works on PIE
+static uintptr_t printable_pc(uintptr_t pc)
+{
+    Dl_info info;
+    if (dladdr((void *)pc, &info) != 0 && info.dli_fbase != NULL) {
+        return pc - (uintptr_t)info.dli_fbase;
+    }
+    return pc;
+}
+
+#endif // ESP_PLATFORM
+
+esp_err_t backtrace_get(supervisor_user_id_t id, backtrace_slot_t *out)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    hal_enter_critical(&s_lock);
+    *out = s_slots[id];
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+void backtrace_capture_mask(uint32_t mask)
+{
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        if (mask & (1u << i)) {
+            backtrace_capture_user(i);
+        }
+    }
+}
+
+void backtrace_print(supervisor_user_id_t id)
+{
+    backtrace_slot_t slot;
+    if (backtrace_get(id, &slot) != ESP_OK) {
+        return;
+    }
+    if (slot.flags & BACKTRACE_RUNNING) {
+        HAL_LOGW(TAG, "User %d was running on the other core, no saved context", id);
+        return;
+    }
+    if (!(slot.flags & BACKTRACE_VALID)) {
+        return;
+    }
+
+    // " 0x%08lx:0x%08lx" per frame, up to 16 digits each on a 64-bit host
+    char line[BACKTRACE_DEPTH * 40 + 1];
+    size_t len = 0;
+    line[0] = '\0';
+    for (uint32_t i = 0; i < slot.depth && len < sizeof(line); i++) {
+        len += snprintf(line + len, sizeof(line) - len, " 0x%08lx:0x%08lx",
+                        (unsigned long)printable_pc(slot.pc[i]), (unsigned long)slot.sp[i]);
+    }
+
+    HAL_LOGW(TAG, "User %d at %lld ms%s%s", id, (long long)(slot.timestamp_us / 1000),
+             (slot.flags & BACKTRACE_TRUNCATED) ? " (truncated)" : "",
+             (slot.flags & BACKTRACE_CORRUPTED) ? " (corrupted)" : "");
+    HAL_LOGW(TAG, "Backtrace:%s", line);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include "hal.h"
+#include "supervisor.h"
+
+// Frames kept per user
+#define BACKTRACE_DEPTH                 16
+
+// Slot flags
+#define BACKTRACE_VALID                 (1u << 0)
+#define BACKTRACE_RUNNING               (1u << 1)   // Task was running on the other core
+#define BACKTRACE_TRUNCATED             (1u << 2)   // Stack went deeper than BACKTRACE_DEPTH
+#define BACKTRACE_CORRUPTED             (1u << 3)   // Walk left the task's stack
+
+//---------------------------------------------------------------------
+// Backtrace of a stalled user
+//
+// On the device the frames are walked from the context the task saved
+// when it was switched out, so no symbol lookup happens here; addresses
+// are printed in the "Backtrace: PC:SP ..." format and decoded offline
+// by tools/symbolize.c or idf.py monitor. A task running on the other
+// core has no saved context; only BACKTRACE_RUNNING is recorded then.
+//
+// The host build finds the thread of the user's task through hal_linux.c,
+// interrupts it with a signal and unwinds it with libunwind (glibc
+// backtrace() if libunwind is not available), and prints addresses
+// relative to the executable so addr2line can resolve them on a PIE
+// binary.
+//---------------------------------------------------------------------
+typedef struct {
+    int64_t timestamp_us;
+    uint32_t flags;
+    uint32_t depth;
+    uintptr_t pc[BACKTRACE_DEPTH];
+    uintptr_t sp[BACKTRACE_DEPTH];
+} backtrace_slot_t;
+
+esp_err_t backtrace_init(void);
+
+// Capture the backtrace of a user's task into its slot
+esp_err_t backtrace_capture_user(supervisor_user_id_t id);
+
+// Capture every user in a mask
+void backtrace_capture_mask(uint32_t mask);
+
+esp_err_t backtrace_get(supervisor_user_id_t id, backtrace_slot_t *out);
+
+// Log a user's slot as a single Backtrace line
+void backtrace_print(supervisor_user_id_t id);
+
+#ifndef ESP_PLATFORM
+#include <pthread.h>
+
+// Host build: interrupt a thread and store its backtrace as a user's slot
+esp_err_t backtrace_capture_thread(supervisor_user_id_t id, pthread_t thread);
+#endif
@@ -0,0 +1,121 @@
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include "hal.h"
+#include "beacon.h"
+#include "supstats.h"
+#include "loglimit.h"
+
+static const char *TAG = "Beacon";
+
+_Static_assert(sizeof(beacon_header_t) == 36, "beacon_header_t is a wire format");
+_Static_assert(sizeof(beacon_user_t) == 8, "beacon_user_t is a wire format");
+
+static beacon_config_t s_config;
+static bool s_initialized;
+static uint32_t s_seq;
+static beacon_stats_t s_stats;
+static int s_sock = -1;
+static struct sockaddr_in s_dest;
+
+size_t beacon_build(uint8_t *buf)
+{
+    static supstats_user_t users[SUPERVISOR_MAX_USERS];
+    uint32_t mask = supstats_snapshot(users);
+    int64_t now = hal_time_us();
+
+    // Users up to the highest registered id, so ids stay positions
+    int count = mask ? 32 - __builtin_clz(mask) : 0;
+    beacon_header_t header = {
+        .magic = BEACON_MAGIC,
+        .version = BEACON_VERSION,
+        .user_count = (uint8_t)count,
+        .device_id = s_config.device_id,
+        .seq = s_seq++,
+        .uptime_s = (uint32_t)(now / 1000000),
+        .period_ms = s_config.period_ms,
+        .unhealthy_mask = supervisor_get_unhealthy_mask(),
+    };
+
+    size_t len = sizeof(header);
+    for (int i = 0; i < count; i++) {
+        const supstats_user_t *u = &users[i];
+        beacon_user_t entry = { .last_feed_age_ms = UINT32_MAX };
+        if (mask & (1u << i)) {
+            entry.misses = u->misses > UINT16_MAX ? UINT16_MAX : (uint16_t)u->misses;
+            entry.recoveries = u->recoveries > UINT16_MAX ? UINT16_MAX : (uint16_t)u->recoveries;
+            if (u->last_feed_us != 0) {
+                entry.last_feed_age_ms = (uint32_t)((now - u->last_feed_us) / 1000);
+            }
+            header.misses += u->misses;
+            header.recoveries += u->recoveries;
+        }
+        memcpy(buf + len, &entry, sizeof(entry));
+        len += sizeof(entry);
+    }
+    memcpy(buf, &header, sizeof(header));
+
+    uint32_t crc = hal_crc32_le(0, buf, len);
+    memcpy(buf + len, &crc, sizeof(crc));
+    return len + sizeof(crc);
+}
+
+static void beacon_task(void *arg)
+{
+    (void)arg;
+    static uint8_t buf[BEACON_MAX_SIZE];
+    hal_tick_t last_wake = hal_ticks();
+
+    while (1) {
+        size_t len = beacon_build(buf);
+        if (sendto(s_sock, buf, len, 0, (struct sockaddr *)&s_dest, sizeof(s_dest)) == (ssize_t)len) {
+            s_stats.sent++;
+        } else {
+            s_stats.send_errors++;
+            LOGLIMIT_W(TAG, "Beacon to %s:%u not sent", s_config.collector_ip, (unsigned)s_config.port);
+        }
+        hal_delay_until(&last_wake, s_config.period_ms);
+    }
+}
+
+esp_err_t beacon_init(const beacon_config_t *config)
+{
+    if (config == NULL || config->collector_ip == NULL || config->period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_config = *config;
+    memset(&s_dest, 0, sizeof(s_dest));
+    s_dest.sin_family = AF_INET;
+    s_dest.sin_port = htons(s_config.port);
+    if (inet_pton(AF_INET, s_config.collector_ip, &s_dest.sin_addr) != 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s_sock < 0) {
+        return ESP_FAIL;
+    }
+    esp_err_t err = hal_task_create(beacon_task, "beacon", BEACON_STACK_SIZE, NULL, s_config.task_priority,
+                                    HAL_NO_AFFINITY, NULL);
+    if (err != ESP_OK) {
+        close(s_sock);
+        s_sock = -1;
+        return err;
+    }
+    s_initialized = true;
+
+    HAL_LOGI(TAG, "Beacon %08lx to %s:%u every %lu ms", (unsigned long)s_config.device_id,
+             s_config.collector_ip, (unsigned)s_config.port, (unsigned long)s_config.period_ms);
+    return ESP_OK;
+}
+
+void beacon_get_stats(beacon_stats_t *out)
+{
+    *out = s_stats;
+}
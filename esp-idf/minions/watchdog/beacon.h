@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include "hal.h"
+#include "supervisor.h"
+
+#define BEACON_MAGIC                    0x43424457u     // "WDBC"
+#define BEACON_VERSION                  1
+#define BEACON_DEFAULT_PORT             47800
+#define BEACON_STACK_SIZE               3072
+
+//---------------------------------------------------------------------
+// Fleet heartbeat beacon
+//
+// A task sends one UDP datagram every period_ms to a fleet collector
+// (tools/fleetcollector.c): the device id, a sequence number, uptime,
+// the mask of unhealthy users, and per-user miss and recovery counts
+// from the supervisor stats. The collector declares a device lost
+// after a few periods without a beacon; the sequence and uptime show
+// lost datagrams and reboots.
+//
+// Wire layout, little-endian as both ends are: beacon_header_t, then
+// user_count beacon_user_t, then the CRC-32 of everything before it.
+// A beacon with every user is under 110 bytes.
+//---------------------------------------------------------------------
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t user_count;
+    uint16_t reserved;
+    uint32_t device_id;
+    uint32_t seq;                   // From 0 at every boot
+    uint32_t uptime_s;
+    uint32_t period_ms;             // Beacon period, for the collector's timeout
+    uint32_t unhealthy_mask;        // supervisor_get_unhealthy_mask()
+    uint32_t misses;                // Totals over all users
+    uint32_t recoveries;
+} beacon_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t misses;                // Saturating
+    uint16_t recoveries;
+    uint32_t last_feed_age_ms;      // UINT32_MAX if never fed
+} beacon_user_t;
+
+#define BEACON_MAX_SIZE                 (sizeof(beacon_header_t) + \
+                                         SUPERVISOR_MAX_USERS * sizeof(beacon_user_t) + sizeof(uint32_t))
+
+typedef struct {
+    const char *collector_ip;       // IPv4, dotted quad
+    uint16_t port;
+    uint32_t device_id;
+    uint32_t period_ms;
+    uint32_t task_priority;
+} beacon_config_t;
+
+#define BEACON_CONFIG_DEFAULT() {       \
+    .collector_ip = "192.168.1.10",     \
+    .port = BEACON_DEFAULT_PORT,        \
+    .device_id = 0,                     \
+    .period_ms = 1000,                  \
+    .task_priority = 2,                 \
+}
+
+// Start sending; the network must be up
+esp_err_t beacon_init(const beacon_config_t *config);
+
+// Build the next beacon into buf (BEACON_MAX_SIZE bytes), returns its
+// length
+size_t beacon_build(uint8_t *buf);
+
+typedef struct {
+    uint32_t sent;
+    uint32_t send_errors;
+} beacon_stats_t;
+
+void beacon_get_stats(beacon_stats_t *out);
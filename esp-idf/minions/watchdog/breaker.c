@@ -0,0 +1,300 @@
+#include <string.h>
+#include "hal.h"
+#include "breaker.h"
+
+static const char *TAG = "Breaker";
+
+typedef struct {
+    bool configured;
+    breaker_config_t config;
+    breaker_gate_t gate;
+    breaker_stats_t stats;
+} breaker_user_t;
+
+static breaker_budget_t s_budget;
+static breaker_user_t s_users[SUPERVISOR_MAX_USERS];
+static int64_t s_window_start_us;
+static int64_t s_window_used_us;
+static uint32_t s_suppressed_total;
+static hal_spinlock_t s_lock = HAL_SPINLOCK_INIT;
+
+static const char *s_state_names[] = { "closed", "open", "half-open" };
+
+//---------------------------------------------------------------------
+// Get a user's breaker, applying the default configuration on first use
+// (call under s_lock)
+//---------------------------------------------------------------------
+static breaker_user_t *get_user(supervisor_user_id_t id, int64_t now)
+{
+    breaker_user_t *user = &s_users[id];
+    if (!user->configured) {
+        breaker_config_t config = BREAKER_CONFIG_DEFAULT();
+        memset(user, 0, sizeof(*user));
+        user->configured = true;
+        user->config = config;
+        breaker_gate_init(&user->gate, &config, now);
+    }
+    return user;
+}
+
+//---------------------------------------------------------------------
+// True if the global budget has room left in the current window
+// (call under s_lock)
+//---------------------------------------------------------------------
+static bool budget_available(int64_t now)
+{
+    int64_t window_us = (int64_t)s_budget.budget_window_ms * 1000;
+    if (window_us <= 0) {
+        return true;
+    }
+    if (now - s_window_start_us >= window_us) {
+        s_window_start_us = now;
+        s_window_used_us = 0;
+    }
+    return s_window_used_us < window_us * s_budget.budget_percent / 100;
+}
+
+//---------------------------------------------------------------------
+// Per-user breaker and bucket, free of any global state
+//---------------------------------------------------------------------
+void breaker_gate_init(breaker_gate_t *gate, const breaker_config_t *config, int64_t now_us)
+{
+    memset(gate, 0, sizeof(*gate));
+    gate->tokens = config->bucket_capacity;
+    gate->last_refill_us = now_us;
+}
+
+void breaker_gate_refill(breaker_gate_t *gate, const breaker_config_t *config, int64_t now_us)
+{
+    int64_t period_us = (int64_t)config->refill_period_ms * 1000;
+    if (period_us <= 0) {
+        gate->tokens = config->bucket_capacity;
+        return;
+    }
+
+    int64_t earned = (now_us - gate->last_refill_us) / period_us;
+    if (earned <= 0) {
+        return;
+    }
+    gate->last_refill_us += earned * period_us;
+    uint64_t tokens = gate->tokens + (uint64_t)earned;
+    if (tokens >= config->bucket_capacity) {
+        tokens = config->bucket_capacity;
+        gate->last_refill_us = now_us;
+    }
+    gate->tokens = (uint32_t)tokens;
+}
+
+breaker_verdict_t breaker_gate_check(breaker_gate_t *gate, const breaker_config_t *config, int64_t now_us,
+                                     bool budget_ok, bool *out_tripped)
+{
+    *out_tripped = false;
+
+    // Another timeout before a feed means the previous attempt failed
+    if (gate->awaiting) {
+        gate->awaiting = false;
+        gate->failures++;
+        if (gate->state == BREAKER_HALF_OPEN ||
+            (gate->state == BREAKER_CLOSED && gate->failures >= config->open_failures)) {
+            gate->state = BREAKER_OPEN;
+            gate->opened_us = now_us;
+            *out_tripped = true;
+        }
+    }
+
+    if (gate->state == BREAKER_OPEN &&
+        now_us - gate->opened_us >= (int64_t)config->open_duration_ms * 1000) {
+        gate->state = BREAKER_HALF_OPEN;
+    }
+
+    breaker_gate_refill(gate, config, now_us);
+
+    if (gate->state == BREAKER_OPEN) {
+        return BREAKER_REJECT_OPEN;
+    }
+    if (gate->tokens == 0) {
+        return BREAKER_REJECT_RATE;
+    }
+    if (!budget_ok) {
+        return BREAKER_REJECT_BUDGET;
+    }
+    gate->tokens--;
+    gate->awaiting = true;
+    return BREAKER_ALLOWED;
+}
+
+bool breaker_gate_refund(breaker_gate_t *gate, const breaker_config_t *config)
+{
+    if (!gate->awaiting) {
+        return false;
+    }
+    gate->awaiting = false;
+    if (gate->tokens < config->bucket_capacity) {
+        gate->tokens++;
+    }
+    return true;
+}
+
+void breaker_gate_recovered(breaker_gate_t *gate)
+{
+    gate->awaiting = false;
+    gate->failures = 0;
+    if (gate->state == BREAKER_HALF_OPEN) {
+        gate->state = BREAKER_CLOSED;
+    }
+}
+
+//---------------------------------------------------------------------
+// Public API
+//---------------------------------------------------------------------
+esp_err_t breaker_init(const breaker_budget_t *budget)
+{
+    if (budget == NULL || budget->budget_percent > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    hal_enter_critical(&s_lock);
+    s_budget = *budget;
+    memset(s_users, 0, sizeof(s_users));
+    s_window_start_us = hal_time_us();
+    s_window_used_us = 0;
+    s_suppressed_total = 0;
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t breaker_configure(supervisor_user_id_t id, const breaker_config_t *config)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || config == NULL || config->bucket_capacity == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int64_t now = hal_time_us();
+    hal_enter_critical(&s_lock);
+    breaker_user_t *user = get_user(id, now);
+    user->config = *config;
+    user->gate.tokens = config->bucket_capacity;
+    user->gate.last_refill_us = now;
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+bool breaker_allow(supervisor_user_id_t id)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS) {
+        return false;
+    }
+
+    int64_t now = hal_time_us();
+    bool tripped;
+    uint32_t failures = 0;
+
+    hal_enter_critical(&s_lock);
+    breaker_user_t *user = get_user(id, now);
+    breaker_verdict_t verdict = breaker_gate_check(&user->gate, &user->config, now, budget_available(now),
+                                                   &tripped);
+    if (tripped) {
+        user->stats.opened++;
+        // Logged after the lock is dropped, when user may change
+        failures = user->gate.failures;
+    }
+
+    switch (verdict) {
+    case BREAKER_ALLOWED:
+        user->stats.allowed++;
+        break;
+    case BREAKER_REJECT_OPEN:
+        user->stats.suppressed_open++;
+        break;
+    case BREAKER_REJECT_RATE:
+        user->stats.suppressed_rate++;
+        break;
+    case BREAKER_REJECT_BUDGET:
+        user->stats.suppressed_budget++;
+        break;
+    }
+    bool allowed = verdict == BREAKER_ALLOWED;
+    if (!allowed) {
+        s_suppressed_total++;
+    }
+    hal_exit_critical(&s_lock);
+
+    if (tripped) {
+        HAL_LOGW(TAG, "Breaker of user %d opened after %lu failed recoveries",
+                 id, (unsigned long)failures);
+    }
+    return allowed;
+}
+
+void breaker_refund(supervisor_user_id_t id)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS) {
+        return;
+    }
+    int64_t now = hal_time_us();
+    hal_enter_critical(&s_lock);
+    breaker_user_t *user = get_user(id, now);
+    if (breaker_gate_refund(&user->gate, &user->config)) {
+        user->stats.allowed--;
+        user->stats.deferred++;
+    }
+    hal_exit_critical(&s_lock);
+}
+
+void breaker_record(supervisor_user_id_t id, int64_t cost_us)
+{
+    (void)id;
+    if (cost_us <= 0) {
+        return;
+    }
+    int64_t now = hal_time_us();
+    hal_enter_critical(&s_lock);
+    budget_available(now);
+    s_window_used_us += cost_us;
+    hal_exit_critical(&s_lock);
+}
+
+void breaker_on_recovered(supervisor_user_id_t id)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS) {
+        return;
+    }
+    int64_t now = hal_time_us();
+    hal_enter_critical(&s_lock);
+    breaker_gate_recovered(&get_user(id, now)->gate);
+    hal_exit_critical(&s_lock);
+}
+
+esp_err_t breaker_get_stats(supervisor_user_id_t id, breaker_stats_t *out)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int64_t now = hal_time_us();
+    hal_enter_critical(&s_lock);
+    breaker_user_t *user = get_user(id, now);
+    breaker_gate_refill(&user->gate, &user->config, now);
+    *out = user->stats;
+    out->state = user->gate.state;
+    out->tokens = user->gate.tokens;
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+void breaker_print_report(void)
+{
+    HAL_LOGI(TAG, "Breaker report (budget %lu%% of %lu ms, %lu recoveries suppressed)",
+             (unsigned long)s_budget.budget_percent, (unsigned long)s_budget.budget_window_ms,
+             (unsigned long)s_suppressed_total);
+
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        supervisor_user_info_t info;
+        breaker_stats_t stats;
+        if (supervisor_get_info(i, &info) != ESP_OK || breaker_get_stats(i, &stats) != ESP_OK) {
+            continue;
+        }
+        HAL_LOGI(TAG, "  %-16s %-9s tokens %lu, allowed %lu, deferred %lu, suppressed open/rate/budget %lu/%lu/%lu, "
+                 "opened %lu", info.name, s_state_names[stats.state], (unsigned long)stats.tokens,
+                 (unsigned long)stats.allowed, (unsigned long)stats.deferred, (unsigned long)stats.suppressed_open,
+                 (unsigned long)stats.suppressed_rate, (unsigned long)stats.suppressed_budget,
+                 (unsigned long)stats.opened);
+    }
+}
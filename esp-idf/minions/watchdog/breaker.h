@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+#include "supervisor.h"
+
+//---------------------------------------------------------------------
+// Recovery circuit breaker and rate limiter
+//
+// Every recovery attempt must pass three gates:
+//   - the user's breaker: after open_failures attempts in a row that were
+//     not followed by a feed it opens and rejects attempts for
+//     open_duration_ms, then lets a single trial through (half-open);
+//     a feed after that trial closes it again,
+//   - the user's token bucket: bucket_capacity attempts in a burst,
+//     refilled by one token every refill_period_ms,
+//   - a global budget: time spent in recovery actions may not exceed
+//     budget_percent of each budget_window_ms.
+// Rejected attempts are counted per reason.
+//---------------------------------------------------------------------
+typedef enum {
+    BREAKER_CLOSED = 0,
+    BREAKER_OPEN,
+    BREAKER_HALF_OPEN,
+} breaker_state_t;
+
+typedef struct {
+    uint32_t bucket_capacity;
+    uint32_t refill_period_ms;
+    uint32_t open_failures;
+    uint32_t open_duration_ms;
+} breaker_config_t;
+
+#define BREAKER_CONFIG_DEFAULT() {  \
+    .bucket_capacity = 3,           \
+    .refill_period_ms = 10000,      \
+    .open_failures = 5,             \
+    .open_duration_ms = 60000,      \
+}
+
+typedef struct {
+    uint32_t budget_window_ms;
+    uint32_t budget_percent;
+} breaker_budget_t;
+
+#define BREAKER_BUDGET_DEFAULT() {  \
+    .budget_window_ms = 1000,       \
+    .budget_percent = 10,           \
+}
+
+typedef struct {
+    breaker_state_t state;
+    uint32_t tokens;
+    uint32_t allowed;
+    uint32_t deferred;              // Allowed, then refunded because the ladder was backing off
+    uint32_t suppressed_open;       // Rejected by an open breaker
+    uint32_t suppressed_rate;       // Rejected for lack of tokens
+    uint32_t suppressed_budget;     // Rejected by the global budget
+    uint32_t opened;                // Times the breaker tripped
+} breaker_stats_t;
+
+// Breaker and token bucket of one user. breaker.c keeps one per
+// supervisor user; tools/fleetsim.c keeps one per virtual task and runs
+// the same breaker_gate_*() steps.
+typedef struct {
+    breaker_state_t state;
+    uint32_t tokens;
+    int64_t last_refill_us;
+    int64_t opened_us;
+    uint32_t failures;              // Attempts in a row without a feed
+    bool awaiting;                  // Last allowed attempt not yet followed by a feed
+} breaker_gate_t;
+
+typedef enum {
+    BREAKER_ALLOWED = 0,
+    BREAKER_REJECT_OPEN,
+    BREAKER_REJECT_RATE,
+    BREAKER_REJECT_BUDGET,
+} breaker_verdict_t;
+
+// Closed with a full bucket as of now_us
+void breaker_gate_init(breaker_gate_t *gate, const breaker_config_t *config, int64_t now_us);
+
+// Add the tokens earned up to now_us
+void breaker_gate_refill(breaker_gate_t *gate, const breaker_config_t *config, int64_t now_us);
+
+// Decide an attempt at now_us: counts a previous attempt still awaiting
+// a feed as failed, which may trip the breaker (*out_tripped), then
+// checks the breaker, the bucket and budget_ok, the caller's global
+// budget, in that order. An allowed attempt takes a token.
+breaker_verdict_t breaker_gate_check(breaker_gate_t *gate, const breaker_config_t *config, int64_t now_us,
+                                     bool budget_ok, bool *out_tripped);
+
+// Give back the token of an allowed attempt that did not run; returns
+// false if there was none awaiting a feed
+bool breaker_gate_refund(breaker_gate_t *gate, const breaker_config_t *config);
+
+// The user fed after an attempt
+void breaker_gate_recovered(breaker_gate_t *gate);
+
+// Set the global recovery budget and reset every breaker
+esp_err_t breaker_init(const breaker_budget_t *budget);
+
+// Users without an explicit configuration use BREAKER_CONFIG_DEFAULT()
+esp_err_t breaker_configure(supervisor_user_id_t id, const breaker_config_t *config);
+
+// Ask whether a recovery attempt for the user may run now
+bool breaker_allow(supervisor_user_id_t id);
+
+// An allowed attempt did not run because the escalation ladder was
+// backing off: give its token back and do not count it as a failure
+void breaker_refund(supervisor_user_id_t id);
+
+// Charge the time an allowed attempt spent in recovery actions
+void breaker_record(supervisor_user_id_t id, int64_t cost_us);
+
+// The user fed after a recovery attempt; closes a half-open breaker
+void breaker_on_recovered(supervisor_user_id_t id);
+
+esp_err_t breaker_get_stats(supervisor_user_id_t id, breaker_stats_t *out);
+
+// Log breaker states and suppression counters
+void breaker_print_report(void);
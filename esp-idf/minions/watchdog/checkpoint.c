@@ -0,0 +1,114 @@
+#include <string.h>
+#include "hal.h"
+#include "checkpoint.h"
+
+typedef struct {
+    volatile uint32_t seq;          // 0 = never written, published last
+    uint32_t len;
+    uint32_t crc;
+    uint8_t data[CHECKPOINT_MAX_SIZE];
+} checkpoint_buf_t;
+
+typedef struct {
+    checkpoint_buf_t buf[2];
+} checkpoint_slot_t;
+
+// Not cleared by a software or watchdog reset, so tasks resume after a
+// warm boot; checkpoint_clear_all() wipes it on a cold one
+HAL_NOINIT_ATTR static checkpoint_slot_t s_slots[SUPERVISOR_MAX_USERS];
+
+//---------------------------------------------------------------------
+// CRC over sequence, length and payload of a buffer
+//---------------------------------------------------------------------
+static uint32_t buf_crc(uint32_t seq, uint32_t len, const uint8_t *data)
+{
+    uint32_t crc = hal_crc32_le(0, (const uint8_t *)&seq, sizeof(seq));
+    crc = hal_crc32_le(crc, (const uint8_t *)&len, sizeof(len));
+    return hal_crc32_le(crc, data, len);
+}
+
+static bool buf_valid(const checkpoint_buf_t *buf)
+{
+    uint32_t seq = buf->seq;
+    return seq != 0 && buf->len <= CHECKPOINT_MAX_SIZE && buf->crc == buf_crc(seq, buf->len, buf->data);
+}
+
+//---------------------------------------------------------------------
+// Index of the newest valid buffer in a slot, -1 if none
+//---------------------------------------------------------------------
+static int newest_buf(const checkpoint_slot_t *slot)
+{
+    bool valid0 = buf_valid(&slot->buf[0]);
+    bool valid1 = buf_valid(&slot->buf[1]);
+
+    if (valid0 && valid1) {
+        return (int32_t)(slot->buf[1].seq - slot->buf[0].seq) > 0 ? 1 : 0;
+    }
+    return valid0 ? 0 : (valid1 ? 1 : -1);
+}
+
+esp_err_t checkpoint_save(supervisor_user_id_t id, const void *data, size_t len)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || data == NULL || len > CHECKPOINT_MAX_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    checkpoint_slot_t *slot = &s_slots[id];
+    int newest = newest_buf(slot);
+    uint32_t seq = newest < 0 ? 1 : slot->buf[newest].seq + 1;
+    if (seq == 0) {
+        seq = 1;
+    }
+    checkpoint_buf_t *target = &slot->buf[newest == 0 ? 1 : 0];
+
+    // Invalidate first so a half-written buffer is never taken as newest
+    target->seq = 0;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    memcpy(target->data, data, len);
+    target->len = len;
+    target->crc = buf_crc(seq, len, target->data);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    target->seq = seq;
+    return ESP_OK;
+}
+
+esp_err_t checkpoint_restore(supervisor_user_id_t id, void *data, size_t size, size_t *out_len)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const checkpoint_slot_t *slot = &s_slots[id];
+    int newest = newest_buf(slot);
+    if (newest < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const checkpoint_buf_t *buf = &slot->buf[newest];
+    if (buf->len > size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(data, buf->data, buf->len);
+    if (out_len != NULL) {
+        *out_len = buf->len;
+    }
+    return ESP_OK;
+}
+
+void checkpoint_clear(supervisor_user_id_t id)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS) {
+        return;
+    }
+    s_slots[id].buf[0].seq = 0;
+    s_slots[id].buf[1].seq = 0;
+}
+
+void checkpoint_clear_all(void)
+{
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        checkpoint_clear(i);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include "hal.h"
+#include "supervisor.h"
+
+// Largest state blob a user can checkpoint
+#define CHECKPOINT_MAX_SIZE             64
+
+//---------------------------------------------------------------------
+// Per-user checkpoints
+//
+// Each user owns a double-buffered slot. checkpoint_save() writes the
+// buffer not holding the latest checkpoint and commits it by publishing a
+// new sequence number last, so a task deleted mid-save leaves the
+// previous checkpoint intact. A task recreated by the supervisor calls
+// checkpoint_restore() on entry to resume from the last commit.
+//
+// Saves are meant to come from the user's own task; one writer per slot.
+//
+// Slots live in RTC memory that a software or watchdog reset leaves
+// alone, and the CRC tells a surviving checkpoint from power-on garbage.
+//---------------------------------------------------------------------
+
+esp_err_t checkpoint_save(supervisor_user_id_t id, const void *data, size_t len);
+
+// Copy the last committed checkpoint into data. Returns ESP_ERR_NOT_FOUND
+// if the user never committed one.
+esp_err_t checkpoint_restore(supervisor_user_id_t id, void *data, size_t size, size_t *out_len);
+
+// Drop the user's checkpoint so the next start is a fresh one
+void checkpoint_clear(supervisor_user_id_t id);
+
+// Drop every checkpoint, e.g. on a cold boot
+void checkpoint_clear_all(void);
@@ -0,0 +1,315 @@
+#include <stddef.h>
+#include <string.h>
+#include "hal.h"
+#include "partition_io.h"
+#include "lz.h"
+#include "escalation.h"
+#include "backtrace.h"
+#include "crashdump.h"
+
+static const char *TAG = "Crashdump";
+
+typedef struct {
+    char name[CRASHDUMP_NAME_LEN];
+    const void *addr;
+    size_t size;
+} user_region_t;
+
+// Writer state for one dump
+typedef struct {
+    size_t offset;                  // Next byte to write
+    size_t erased_end;              // Sectors below this are erased
+    uint32_t raw_size;
+    int64_t erase_us;
+    esp_err_t err;
+} writer_t;
+
+static partition_io_t s_part;
+static bool s_ready = false;
+static user_region_t s_regions[CRASHDUMP_MAX_REGIONS];
+static int s_region_count;
+
+// Everything the crash path needs is allocated up front
+static uint16_t s_hash_table[LZ_HASH_SIZE];
+static uint8_t s_block[sizeof(crashdump_block_t) + CRASHDUMP_BLOCK_SIZE];
+static supervisor_user_info_t s_supervisor_table[SUPERVISOR_MAX_USERS];
+static escalation_level_stats_t s_escalation_table[SUPERVISOR_MAX_USERS][ESCALATION_LEVEL_COUNT];
+static backtrace_slot_t s_backtrace_table[SUPERVISOR_MAX_USERS];
+
+//---------------------------------------------------------------------
+// Append bytes to the partition, erasing sectors just ahead of the data
+//---------------------------------------------------------------------
+static void put(writer_t *w, size_t offset, const void *data, size_t len)
+{
+    if (w->err != ESP_OK) {
+        return;
+    }
+    size_t end = offset + len;
+    if (end > s_part.size) {
+        w->err = ESP_ERR_NO_MEM;
+        return;
+    }
+    while (w->erased_end < end) {
+        int64_t start = hal_time_us();
+        w->err = partition_io_erase(&s_part, w->erased_end, PARTITION_IO_SECTOR_SIZE);
+        w->erase_us += hal_time_us() - start;
+        if (w->err != ESP_OK) {
+            return;
+        }
+        w->erased_end += PARTITION_IO_SECTOR_SIZE;
+    }
+    w->err = partition_io_write(&s_part, offset, data, len);
+}
+
+//---------------------------------------------------------------------
+// CRC of a stored range, read back from the partition so that it also
+// catches failed writes
+//---------------------------------------------------------------------
+static esp_err_t crc_range(size_t offset, size_t len, uint32_t *out_crc)
+{
+    uint8_t buf[256];
+    uint32_t crc = 0;
+    for (size_t pos = 0; pos < len; pos += sizeof(buf)) {
+        size_t chunk = len - pos < sizeof(buf) ? len - pos : sizeof(buf);
+        esp_err_t err = partition_io_read(&s_part, offset + pos, buf, chunk);
+        if (err != ESP_OK) {
+            return err;
+        }
+        crc = hal_crc32_le(crc, buf, chunk);
+    }
+    *out_crc = crc;
+    return ESP_OK;
+}
+
+//---------------------------------------------------------------------
+// Compress one region block by block behind its header
+//---------------------------------------------------------------------
+static void put_region(writer_t *w, const char *name, crashdump_region_type_t type,
+                       const void *addr, size_t size)
+{
+    crashdump_region_t region = {
+        .type = type,
+        .addr = (uint32_t)(uintptr_t)addr,
+        .raw_size = (uint32_t)size,
+    };
+    strncpy(region.name, name, CRASHDUMP_NAME_LEN - 1);
+
+    // The header is written into the space left in front of the blocks
+    // once their size is known; that area is still erased
+    size_t header_offset = w->offset;
+    w->offset += sizeof(region);
+
+    const uint8_t *src = (const uint8_t *)addr;
+    for (size_t done = 0; done < size && w->err == ESP_OK; done += CRASHDUMP_BLOCK_SIZE) {
+        size_t raw_len = size - done < CRASHDUMP_BLOCK_SIZE ? size - done : CRASHDUMP_BLOCK_SIZE;
+        crashdump_block_t *block = (crashdump_block_t *)s_block;
+        uint8_t *payload = s_block + sizeof(*block);
+
+        size_t stored = lz_compress(src + done, raw_len, payload, raw_len - 1, s_hash_table);
+        block->raw_len = (uint16_t)raw_len;
+        if (stored == 0) {
+            // Incompressible: store it as is
+            memcpy(payload, src + done, raw_len);
+            stored = raw_len;
+            block->stored_len = (uint16_t)(stored | CRASHDUMP_BLOCK_RAW);
+        } else {
+            block->stored_len = (uint16_t)stored;
+        }
+        put(w, w->offset, s_block, sizeof(*block) + stored);
+        w->offset += sizeof(*block) + stored;
+    }
+
+    region.stored_size = (uint32_t)(w->offset - header_offset - sizeof(region));
+    put(w, header_offset, &region, sizeof(region));
+    w->raw_size += (uint32_t)size;
+}
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/task_snapshot.h"
+
+// Tasks whose stacks are dumped
+#define MAX_STACKS                      32
+
+static TaskStatus_t s_tasks[MAX_STACKS];
+
+//---------------------------------------------------------------------
+// Only the used part of each stack, from the saved stack pointer up.
+// Returns the number of regions written.
+//---------------------------------------------------------------------
+static int put_stacks(writer_t *w)
+{
+    int count = 0;
+    UBaseType_t task_count = uxTaskGetSystemState(s_tasks, MAX_STACKS, NULL);
+    for (UBaseType_t i = 0; i < task_count && w->err == ESP_OK; i++) {
+        TaskSnapshot_t snapshot;
+        vTaskGetSnapshot(s_tasks[i].xHandle, &snapshot);
+        uintptr_t top = (uintptr_t)snapshot.pxTopOfStack;
+        uintptr_t end = (uintptr_t)snapshot.pxEndOfStack;
+        if (top == 0 || end <= top) {
+            continue;
+        }
+        put_region(w, s_tasks[i].pcTaskName, CRASHDUMP_REGION_STACK, (const void *)top, end - top);
+        count++;
+    }
+    return count;
+}
+
+#else // Host build
+
+// Threads have no saved context to walk; the dump carries the tables
+// and the application's regions only
+static int put_stacks(writer_t *w)
+{
+    (void)w;
+    return 0;
+}
+
+#endif // ESP_PLATFORM
+
+//---------------------------------------------------------------------
+// Public API
+//---------------------------------------------------------------------
+esp_err_t crashdump_init(void)
+{
+    esp_err_t err = partition_io_open(&s_part, CRASHDUMP_PARTITION_LABEL, CRASHDUMP_HOST_SIZE);
+    if (err != ESP_OK) {
+        HAL_LOGW(TAG, "No '%s' partition: %s", CRASHDUMP_PARTITION_LABEL, esp_err_to_name(err));
+        return err;
+    }
+    s_ready = true;
+    return ESP_OK;
+}
+
+esp_err_t crashdump_add_region(const char *name, const void *addr, size_t size)
+{
+    if (name == NULL || addr == NULL || size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_region_count >= CRASHDUMP_MAX_REGIONS) {
+        return ESP_ERR_NO_MEM;
+    }
+    user_region_t *region = &s_regions[s_region_count++];
+    strncpy(region->name, name, CRASHDUMP_NAME_LEN - 1);
+    region->addr = addr;
+    region->size = size;
+    return ESP_OK;
+}
+
+esp_err_t crashdump_write(supervisor_user_id_t user)
+{
+    if (!s_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int64_t start = hal_time_us();
+    writer_t w = { .offset = sizeof(crashdump_header_t) };
+    int region_count = 0;
+
+    // Tables are copied out through their getters, under their own locks
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        if (supervisor_get_info(i, &s_supervisor_table[i]) != ESP_OK) {
+            memset(&s_supervisor_table[i], 0, sizeof(s_supervisor_table[i]));
+        }
+        for (int level = 0; level < ESCALATION_LEVEL_COUNT; level++) {
+            escalation_get_stats(i, (escalation_level_t)level, &s_escalation_table[i][level]);
+        }
+        backtrace_get(i, &s_backtrace_table[i]);
+    }
+    put_region(&w, "supervisor", CRASHDUMP_REGION_TABLE, s_supervisor_table, sizeof(s_supervisor_table));
+    put_region(&w, "escalation", CRASHDUMP_REGION_TABLE, s_escalation_table, sizeof(s_escalation_table));
+    put_region(&w, "backtrace", CRASHDUMP_REGION_TABLE, s_backtrace_table, sizeof(s_backtrace_table));
+    region_count += 3;
+
+    for (int i = 0; i < s_region_count; i++) {
+        put_region(&w, s_regions[i].name, CRASHDUMP_REGION_USER, s_regions[i].addr, s_regions[i].size);
+        region_count++;
+    }
+
+    region_count += put_stacks(&w);
+
+    uint32_t crc = 0;
+    if (w.err == ESP_OK) {
+        w.err = crc_range(sizeof(crashdump_header_t), w.offset - sizeof(crashdump_header_t), &crc);
+    }
+    int64_t write_us = hal_time_us() - start - w.erase_us;
+
+    crashdump_header_t header = {
+        .magic = CRASHDUMP_MAGIC,
+        .version = CRASHDUMP_VERSION,
+        .region_count = (uint16_t)region_count,
+        .user = user,
+        .uptime_ms = (uint32_t)(start / 1000),
+        .raw_size = w.raw_size,
+        .stored_size = (uint32_t)(w.offset - sizeof(crashdump_header_t)),
+        .erase_us = (uint32_t)w.erase_us,
+        .write_us = (uint32_t)write_us,
+        .crc = crc,
+        .unreported = UINT32_MAX,
+    };
+    put(&w, 0, &header, sizeof(header));
+    if (w.err == ESP_OK) {
+        w.err = partition_io_sync(&s_part);
+    }
+
+    if (w.err != ESP_OK) {
+        HAL_LOGE(TAG, "Dump failed after %u bytes: %s", (unsigned)w.offset, esp_err_to_name(w.err));
+        return w.err;
+    }
+    HAL_LOGW(TAG, "Dumped %d regions: %lu -> %lu bytes (%lu%%), erase %lu ms, compress+write %lu ms",
+             region_count, (unsigned long)header.raw_size, (unsigned long)header.stored_size,
+             (unsigned long)(header.raw_size ? (uint64_t)header.stored_size * 100 / header.raw_size : 0),
+             (unsigned long)(header.erase_us / 1000), (unsigned long)(header.write_us / 1000));
+    return ESP_OK;
+}
+
+esp_err_t crashdump_check(void)
+{
+    if (!s_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    crashdump_header_t header;
+    esp_err_t err = partition_io_read(&s_part, 0, &header, sizeof(header));
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (header.magic != CRASHDUMP_MAGIC || header.version != CRASHDUMP_VERSION ||
+        header.stored_size > s_part.size - sizeof(header) || header.unreported != UINT32_MAX) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint32_t crc;
+    err = crc_range(sizeof(header), header.stored_size, &crc);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (crc != header.crc) {
+        HAL_LOGW(TAG, "Crash dump present but corrupted");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    HAL_LOGW(TAG, "Crash dump from user %ld at %lu ms uptime: %u regions, %lu -> %lu bytes, took %lu ms",
+             (long)header.user, (unsigned long)header.uptime_ms, header.region_count,
+             (unsigned long)header.raw_size, (unsigned long)header.stored_size,
+             (unsigned long)((header.erase_us + header.write_us) / 1000));
+
+    // Programming the erased word to zero needs no erase and leaves the
+    // rest of the dump intact
+    uint32_t reported = 0;
+    err = partition_io_write(&s_part, offsetof(crashdump_header_t, unreported), &reported, sizeof(reported));
+    if (err == ESP_OK) {
+        err = partition_io_sync(&s_part);
+    }
+    return err;
+}
+
+esp_err_t crashdump_erase(void)
+{
+    if (!s_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Erasing the header sector is enough to invalidate the dump
+    return partition_io_erase(&s_part, 0, PARTITION_IO_SECTOR_SIZE);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+#include "hal.h"
+#include "supervisor.h"
+
+// Partition label; the host build writes crashdump.bin instead
+#define CRASHDUMP_PARTITION_LABEL       "crashdump"
+#define CRASHDUMP_HOST_SIZE             (64 * 1024)
+// Extra RAM regions the application can add
+#define CRASHDUMP_MAX_REGIONS           8
+// Bytes compressed at a time; each block decodes on its own
+#define CRASHDUMP_BLOCK_SIZE            4096
+#define CRASHDUMP_NAME_LEN              16
+
+#define CRASHDUMP_MAGIC                 0x44434457u     // "WDCD"
+#define CRASHDUMP_VERSION               2
+
+typedef enum {
+    CRASHDUMP_REGION_TABLE = 0,     // Supervisor, escalation or backtrace table
+    CRASHDUMP_REGION_STACK,         // Used part of a task stack
+    CRASHDUMP_REGION_USER,          // Added with crashdump_add_region()
+} crashdump_region_type_t;
+
+//---------------------------------------------------------------------
+// Compressed crash dump
+//
+// Written from the escalation path right before a watchdog-triggered
+// system reset: the supervisor, escalation and backtrace tables, the
+// used part of every task stack and any regions the application added,
+// each streamed through the lz block compressor into the crash dump
+// partition. Decode with tools/crashdump_decode.c.
+//
+// Partition layout, little endian:
+//   crashdump_header_t, written last so an interrupted dump stays invalid
+//   per region: crashdump_region_t, then its blocks
+//   per block:  crashdump_block_t, then stored_len bytes
+//
+// The scheduler keeps running while the dump is written, so stacks of
+// tasks that are not stuck may be caught mid-change.
+//---------------------------------------------------------------------
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t region_count;
+    int32_t user;                   // User whose escalation reset the system
+    uint32_t uptime_ms;
+    uint32_t raw_size;              // Region bytes before compression
+    uint32_t stored_size;           // Bytes after the header
+    uint32_t erase_us;
+    uint32_t write_us;              // Compression and flash writes
+    uint32_t crc;                   // CRC-32 of the stored_size bytes after the header
+    uint32_t unreported;            // Left erased by the writer, cleared by crashdump_check()
+} crashdump_header_t;
+
+typedef struct {
+    char name[CRASHDUMP_NAME_LEN];
+    uint32_t type;                  // crashdump_region_type_t
+    uint32_t addr;
+    uint32_t raw_size;
+    uint32_t stored_size;           // Block headers and data
+} crashdump_region_t;
+
+// Block is stored uncompressed when set in stored_len
+#define CRASHDUMP_BLOCK_RAW             0x8000u
+
+typedef struct {
+    uint16_t raw_len;
+    uint16_t stored_len;
+} crashdump_block_t;
+
+esp_err_t crashdump_init(void);
+
+// Include a RAM region in every dump; addr must stay valid
+esp_err_t crashdump_add_region(const char *name, const void *addr, size_t size);
+
+// Write a dump now. Blocks for the erase and the flash writes.
+esp_err_t crashdump_write(supervisor_user_id_t user);
+
+// Log a summary of the dump left by the previous reset, if any, and
+// mark it reported so later boots stay quiet. The dump itself stays in
+// the partition for readout until the next dump or crashdump_erase().
+// Returns ESP_ERR_NOT_FOUND if the partition holds no valid dump that
+// has not been reported yet.
+esp_err_t crashdump_check(void);
+
+// Erase the dump once it has been read out
+esp_err_t crashdump_erase(void);
@@ -0,0 +1,94 @@
+#include <string.h>
+#include "hal.h"
+#include "depgraph.h"
+
+static const char *TAG = "DepGraph";
+
+// Transitive dependencies of each user
+static uint32_t s_reach[SUPERVISOR_MAX_USERS];
+static depgraph_stats_t s_stats;
+static hal_spinlock_t s_lock = HAL_SPINLOCK_INIT;
+
+esp_err_t depgraph_add(supervisor_user_id_t user, supervisor_user_id_t dependency)
+{
+    if (user < 0 || user >= SUPERVISOR_MAX_USERS ||
+        dependency < 0 || dependency >= SUPERVISOR_MAX_USERS || user == dependency) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    hal_enter_critical(&s_lock);
+    if (s_reach[dependency] & (1u << user)) {
+        hal_exit_critical(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Everything that reaches 'user' now also reaches 'dependency' and
+    // everything behind it
+    uint32_t added = (1u << dependency) | s_reach[dependency];
+    s_reach[user] |= added;
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        if (s_reach[i] & (1u << user)) {
+            s_reach[i] |= added;
+        }
+    }
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+void depgraph_analyze(uint32_t failed_mask, uint32_t timed_out_mask, depgraph_result_t *out)
+{
+    memset(out, 0, sizeof(*out));
+
+    hal_enter_critical(&s_lock);
+    uint32_t down = failed_mask | timed_out_mask;
+
+    // Kahn's algorithm on the reachability relation: emit a user once none
+    // of its remaining dependencies is left in the batch
+    uint32_t remaining = failed_mask;
+    while (remaining != 0) {
+        uint32_t ready = 0;
+        for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+            if ((remaining & (1u << i)) && (s_reach[i] & remaining) == 0) {
+                ready |= (1u << i);
+            }
+        }
+        for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+            if (ready & (1u << i)) {
+                out->order[out->count++] = i;
+                if (s_reach[i] & down) {
+                    out->suppressed_mask |= (1u << i);
+                } else {
+                    out->root_mask |= (1u << i);
+                }
+            }
+        }
+        remaining &= ~ready;
+    }
+
+    if (failed_mask != 0) {
+        s_stats.analyses++;
+        s_stats.recovered += __builtin_popcount(out->root_mask);
+        s_stats.suppressed += __builtin_popcount(out->suppressed_mask);
+        if (out->suppressed_mask != 0) {
+            s_stats.cascades++;
+        }
+    }
+    hal_exit_critical(&s_lock);
+}
+
+void depgraph_get_stats(depgraph_stats_t *out)
+{
+    hal_enter_critical(&s_lock);
+    *out = s_stats;
+    hal_exit_critical(&s_lock);
+}
+
+void depgraph_print_report(void)
+{
+    depgraph_stats_t stats;
+    depgraph_get_stats(&stats);
+
+    HAL_LOGI(TAG, "Root-cause report: %lu batches, %lu cascades, %lu recovered, %lu suppressed",
+             (unsigned long)stats.analyses, (unsigned long)stats.cascades,
+             (unsigned long)stats.recovered, (unsigned long)stats.suppressed);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include "hal.h"
+#include "supervisor.h"
+
+//---------------------------------------------------------------------
+// User dependency graph for root-cause analysis
+//
+// A user depends on another when it blocks on something the other one
+// holds or produces, so a stall of the dependency shows up as a timeout
+// of both. The graph must stay acyclic; depgraph_add() rejects edges that
+// would close a cycle.
+//---------------------------------------------------------------------
+
+typedef struct {
+    uint32_t root_mask;             // Timed out users to recover
+    uint32_t suppressed_mask;       // Timed out only because a dependency is down
+    int count;                      // Entries in order
+    supervisor_user_id_t order[SUPERVISOR_MAX_USERS];   // Timed out users, dependencies first
+} depgraph_result_t;
+
+typedef struct {
+    uint32_t analyses;              // Timeout batches analyzed
+    uint32_t cascades;              // Batches where at least one user was suppressed
+    uint32_t recovered;             // Root-cause users passed on for recovery
+    uint32_t suppressed;            // Recoveries avoided
+} depgraph_stats_t;
+
+// Declare that 'user' depends on 'dependency'
+esp_err_t depgraph_add(supervisor_user_id_t user, supervisor_user_id_t dependency);
+
+// Order the timed out users topologically and keep only root causes. A
+// user is suppressed if any of its transitive dependencies timed out in
+// this batch or is still timed out from an earlier one (timed_out_mask,
+// see supervisor_get_timed_out_mask()).
+void depgraph_analyze(uint32_t failed_mask, uint32_t timed_out_mask, depgraph_result_t *out);
+
+void depgraph_get_stats(depgraph_stats_t *out);
+
+// Log how many recoveries root-cause analysis avoided
+void depgraph_print_report(void);
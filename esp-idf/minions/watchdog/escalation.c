@@ -0,0 +1,295 @@
+#include <string.h>
+#include "hal.h"
+#include "escalation.h"
+#include "loglimit.h"
+#include "trace.h"
+
+static const char *TAG = "Escalation";
+
+// Backoff doubles per attempt up to this many times
+#define MAX_BACKOFF_SHIFT           4
+
+typedef struct {
+    escalation_policy_t policy;
+    escalation_state_t ladder;
+    int active_level;               // Level whose action awaits a feed, -1 if none
+    escalation_level_stats_t stats[ESCALATION_LEVEL_COUNT];
+} escalation_user_t;
+
+static escalation_user_t s_users[SUPERVISOR_MAX_USERS];
+static bool s_users_ready[SUPERVISOR_MAX_USERS];
+static hal_spinlock_t s_lock = HAL_SPINLOCK_INIT;
+static escalation_reset_hook_t s_reset_hook;
+static void *s_reset_hook_arg;
+
+static const char *s_level_names[ESCALATION_LEVEL_COUNT] = {
+    "log", "task-restart", "periph-restart", "system-reset",
+};
+
+//---------------------------------------------------------------------
+// Get a user's state, giving it the log-only policy on first use
+// (call under s_lock)
+//---------------------------------------------------------------------
+static escalation_user_t *get_user(supervisor_user_id_t id)
+{
+    escalation_user_t *user = &s_users[id];
+    if (!s_users_ready[id]) {
+        memset(user, 0, sizeof(*user));
+        user->policy.max_attempts[ESCALATION_LOG] = 1;
+        user->active_level = -1;
+        s_users_ready[id] = true;
+    }
+    return user;
+}
+
+//---------------------------------------------------------------------
+// First enabled level above 'from', or -1 if there is none
+//---------------------------------------------------------------------
+static int next_level(const escalation_policy_t *policy, int from)
+{
+    for (int level = from + 1; level < ESCALATION_LEVEL_COUNT; level++) {
+        if (policy->max_attempts[level] > 0) {
+            return level;
+        }
+    }
+    return -1;
+}
+
+//---------------------------------------------------------------------
+// First enabled level of a policy, or -1 if there is none
+//---------------------------------------------------------------------
+static int first_level(const escalation_policy_t *policy)
+{
+    return policy->max_attempts[ESCALATION_LOG] > 0 ? ESCALATION_LOG : next_level(policy, ESCALATION_LOG);
+}
+
+//---------------------------------------------------------------------
+// Ladder state machine, free of any global state
+//---------------------------------------------------------------------
+void escalation_state_reset(escalation_state_t *state, const escalation_policy_t *policy)
+{
+    int first = first_level(policy);
+    state->level = (escalation_level_t)(first >= 0 ? first : ESCALATION_LOG);
+    state->attempts = 0;
+    state->next_allowed_us = 0;
+}
+
+int escalation_step(escalation_state_t *state, const escalation_policy_t *policy, int64_t now_us,
+                    bool *out_overflow)
+{
+    *out_overflow = false;
+
+    // A long healthy run since the last recovery closes the previous
+    // incident; either way the recovery is accounted for
+    if (state->last_recovered_us != 0) {
+        if (now_us - state->last_recovered_us > (int64_t)policy->healthy_reset_ms * 1000) {
+            escalation_state_reset(state, policy);
+        }
+        state->last_recovered_us = 0;
+    }
+
+    if (now_us < state->next_allowed_us) {
+        return -1;
+    }
+
+    if (state->attempts >= policy->max_attempts[state->level]) {
+        int next = next_level(policy, state->level);
+        if (next >= 0) {
+            state->level = (escalation_level_t)next;
+            state->attempts = 0;
+        } else {
+            // Nowhere left to go: retry the last level, still backing off
+            *out_overflow = true;
+        }
+    }
+
+    state->attempts++;
+    uint32_t shift = state->attempts - 1;
+    if (shift > MAX_BACKOFF_SHIFT) {
+        shift = MAX_BACKOFF_SHIFT;
+    }
+    state->next_allowed_us = now_us + ((int64_t)policy->backoff_ms[state->level] << shift) * 1000;
+    return state->level;
+}
+
+//---------------------------------------------------------------------
+// Perform the recovery action of a level
+//---------------------------------------------------------------------
+static void apply_level(supervisor_user_id_t id, escalation_level_t level,
+                        const escalation_policy_t *policy)
+{
+    esp_err_t err = ESP_OK;
+
+    switch (level) {
+    case ESCALATION_LOG:
+        break;
+    case ESCALATION_TASK_RESTART:
+        err = supervisor_restart_task(id);
+        break;
+    case ESCALATION_PERIPH_RESTART:
+        if (policy->periph_restart == NULL) {
+            err = ESP_ERR_NOT_SUPPORTED;
+        } else {
+            err = policy->periph_restart(id, policy->periph_arg);
+        }
+        break;
+    case ESCALATION_SYSTEM_RESET:
+        if (s_reset_hook != NULL) {
+            s_reset_hook(id, s_reset_hook_arg);
+        }
+        HAL_LOGE(TAG, "Restarting system");
+        // Give the log a moment to drain before resetting
+        hal_delay_ms(100);
+        hal_restart();
+        break;
+    default:
+        break;
+    }
+
+    if (err != ESP_OK) {
+        HAL_LOGW(TAG, "%s action failed: %s", s_level_names[level], esp_err_to_name(err));
+    }
+}
+
+//---------------------------------------------------------------------
+// Public API
+//---------------------------------------------------------------------
+esp_err_t escalation_set_policy(supervisor_user_id_t id, const escalation_policy_t *policy)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || policy == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (first_level(policy) < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    hal_enter_critical(&s_lock);
+    escalation_user_t *user = get_user(id);
+    user->policy = *policy;
+    escalation_state_reset(&user->ladder, policy);
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+int escalation_handle(supervisor_user_id_t id)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS) {
+        return -1;
+    }
+
+    int64_t now = hal_time_us();
+
+    hal_enter_critical(&s_lock);
+    escalation_user_t *user = get_user(id);
+    const escalation_policy_t *policy = &user->policy;
+
+    bool overflow;
+    int step = escalation_step(&user->ladder, policy, now, &overflow);
+    if (step < 0) {
+        hal_exit_critical(&s_lock);
+        supervisor_rearm(id);
+        return -1;
+    }
+
+    escalation_level_t level = (escalation_level_t)step;
+    user->stats[level].attempts++;
+    if (overflow) {
+        user->stats[level].overflows++;
+    }
+    user->active_level = level;
+
+    uint32_t attempt = user->ladder.attempts;
+    uint32_t max_attempts = policy->max_attempts[level];
+    escalation_policy_t policy_copy = *policy;
+    hal_exit_critical(&s_lock);
+
+    supervisor_user_info_t info;
+    const char *name = supervisor_get_info(id, &info) == ESP_OK ? info.name : "?";
+    if (overflow) {
+        LOGLIMIT_W(TAG, "%s: escalation level %s again (all %lu attempts used, no higher level)", name,
+                   s_level_names[level], (unsigned long)max_attempts);
+    } else {
+        LOGLIMIT_W(TAG, "%s: escalation level %s (attempt %lu/%lu)", name, s_level_names[level],
+                   (unsigned long)attempt, (unsigned long)max_attempts);
+    }
+
+    trace_record(TRACE_EVT_RECOVERY_BEGIN, (uint32_t)id, (uint16_t)level);
+    apply_level(id, level, &policy_copy);
+    trace_record(TRACE_EVT_RECOVERY_END, (uint32_t)id, (uint16_t)level);
+    supervisor_rearm(id);
+    return level;
+}
+
+void escalation_set_reset_hook(escalation_reset_hook_t hook, void *arg)
+{
+    s_reset_hook = hook;
+    s_reset_hook_arg = arg;
+}
+
+void escalation_on_recovered(supervisor_user_id_t id, int64_t detect_us, void *arg)
+{
+    (void)arg;
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS) {
+        return;
+    }
+
+    int64_t now = hal_time_us();
+
+    hal_enter_critical(&s_lock);
+    escalation_user_t *user = get_user(id);
+    if (user->active_level >= 0) {
+        escalation_level_stats_t *stats = &user->stats[user->active_level];
+        uint32_t mttr_us = (uint32_t)(now - detect_us);
+        stats->recoveries++;
+        stats->mttr_sum_us += mttr_us;
+        if (mttr_us > stats->mttr_max_us) {
+            stats->mttr_max_us = mttr_us;
+        }
+        user->active_level = -1;
+    }
+    escalation_state_recovered(&user->ladder, now);
+    hal_exit_critical(&s_lock);
+}
+
+esp_err_t escalation_get_stats(supervisor_user_id_t id, escalation_level_t level, escalation_level_stats_t *out)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || level >= ESCALATION_LEVEL_COUNT || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    hal_enter_critical(&s_lock);
+    *out = get_user(id)->stats[level];
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+const char *escalation_level_name(escalation_level_t level)
+{
+    return level < ESCALATION_LEVEL_COUNT ? s_level_names[level] : "?";
+}
+
+void escalation_print_report(void)
+{
+    HAL_LOGI(TAG, "Escalation report");
+
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        supervisor_user_info_t info;
+        if (supervisor_get_info(i, &info) != ESP_OK) {
+            continue;
+        }
+        for (int level = 0; level < ESCALATION_LEVEL_COUNT; level++) {
+            escalation_level_stats_t stats;
+            escalation_get_stats(i, (escalation_level_t)level, &stats);
+            if (stats.attempts == 0) {
+                continue;
+            }
+            uint32_t mttr_ms = stats.recoveries ? (uint32_t)(stats.mttr_sum_us / stats.recoveries / 1000) : 0;
+            // Attempts add up over incidents; overflows are the ones a
+            // single incident made past max_attempts of the last level
+            HAL_LOGI(TAG, "  %-16s %-14s attempts %lu (%lu past the limit), recovered %lu, "
+                     "MTTR avg %lu ms max %lu ms", info.name, s_level_names[level],
+                     (unsigned long)stats.attempts, (unsigned long)stats.overflows,
+                     (unsigned long)stats.recoveries, (unsigned long)mttr_ms,
+                     (unsigned long)(stats.mttr_max_us / 1000));
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+#include "supervisor.h"
+
+//---------------------------------------------------------------------
+// Graded escalation ladder
+//
+// Each timeout of a user is handled at its current level. A level is
+// retried up to max_attempts times, waiting backoff_ms (doubled per
+// attempt) between tries, before moving to the next enabled level. The
+// last enabled level keeps being retried past max_attempts; those tries
+// are counted as overflows. A user that runs cleanly for healthy_reset_ms
+// after recovering drops back to the first level. Levels with
+// max_attempts == 0 are skipped.
+//---------------------------------------------------------------------
+typedef enum {
+    ESCALATION_LOG = 0,             // Log and let the application indicate it
+    ESCALATION_TASK_RESTART,        // Delete and recreate the task
+    ESCALATION_PERIPH_RESTART,      // Restart the peripheral the task drives
+    ESCALATION_SYSTEM_RESET,        // Controlled esp_restart()
+    ESCALATION_LEVEL_COUNT,
+} escalation_level_t;
+
+typedef esp_err_t (*escalation_periph_restart_t)(supervisor_user_id_t id, void *arg);
+
+// Runs right before ESCALATION_SYSTEM_RESET restarts the system
+typedef void (*escalation_reset_hook_t)(supervisor_user_id_t id, void *arg);
+
+typedef struct {
+    uint8_t max_attempts[ESCALATION_LEVEL_COUNT];
+    uint32_t backoff_ms[ESCALATION_LEVEL_COUNT];
+    uint32_t healthy_reset_ms;
+    escalation_periph_restart_t periph_restart;
+    void *periph_arg;
+} escalation_policy_t;
+
+#define ESCALATION_POLICY_DEFAULT() {                   \
+    .max_attempts = { 1, 2, 1, 1 },                     \
+    .backoff_ms = { 0, 1000, 2000, 0 },                 \
+    .healthy_reset_ms = 30000,                          \
+    .periph_restart = NULL,                             \
+    .periph_arg = NULL,                                 \
+}
+
+// Per-level counters of one user
+typedef struct {
+    uint32_t attempts;              // Actions taken at this level
+    uint32_t overflows;             // Of those, past max_attempts with no higher level enabled
+    uint32_t recoveries;            // Actions followed by a feed
+    uint64_t mttr_sum_us;           // Detection to first feed, summed
+    uint32_t mttr_max_us;
+} escalation_level_stats_t;
+
+// Where one user stands on the ladder. escalation_handle() keeps one per
+// supervisor user; tools/fleetsim.c keeps one per virtual task and runs
+// the same escalation_step().
+typedef struct {
+    escalation_level_t level;       // Level the next attempt starts from
+    uint32_t attempts;              // Attempts made at the current level
+    int64_t next_allowed_us;        // End of the current backoff
+    int64_t last_recovered_us;      // Last recovery not yet seen by a step, 0 if none
+} escalation_state_t;
+
+// Start over at the first enabled level of the policy
+void escalation_state_reset(escalation_state_t *state, const escalation_policy_t *policy);
+
+// The user recovered at now_us; a long enough healthy run from here
+// resets the ladder at its next step
+static inline void escalation_state_recovered(escalation_state_t *state, int64_t now_us)
+{
+    state->last_recovered_us = now_us;
+}
+
+// Decide the next attempt at now_us without acting on it: applies the
+// healthy reset, defers while backing off, moves on to the next enabled
+// level once the current one used max_attempts and starts the backoff
+// of the attempt. Returns the level to apply, or -1 when deferred.
+// *out_overflow is set for a retry of the last enabled level past its
+// max_attempts.
+int escalation_step(escalation_state_t *state, const escalation_policy_t *policy, int64_t now_us,
+                    bool *out_overflow);
+
+// Set the policy of a user; users without a policy only get ESCALATION_LOG
+esp_err_t escalation_set_policy(supervisor_user_id_t id, const escalation_policy_t *policy);
+
+// Handle a timeout of a user. Applies the action of its current level, or
+// only re-arms the deadline while the level is backing off. Returns the
+// level that was applied, or -1 when the attempt was deferred.
+int escalation_handle(supervisor_user_id_t id);
+
+// Set the hook run before a system reset, e.g. to write a crash dump
+void escalation_set_reset_hook(escalation_reset_hook_t hook, void *arg);
+
+// Hook for supervisor_config_t.on_recovered
+void escalation_on_recovered(supervisor_user_id_t id, int64_t detect_us, void *arg);
+
+esp_err_t escalation_get_stats(supervisor_user_id_t id, escalation_level_t level, escalation_level_stats_t *out);
+
+const char *escalation_level_name(escalation_level_t level);
+
+// Log attempts and MTTR per user and level
+void escalation_print_report(void);
@@ -0,0 +1,192 @@
+#include <string.h>
+#include "hal.h"
+#include "fastdet.h"
+#include "loglimit.h"
+
+static const char *TAG = "FastDet";
+
+shard_table_t fastdet_table;
+
+static fastdet_config_t s_config;
+static bool s_initialized;
+static bool s_running;
+static hal_task_t s_handler_task;
+static fastdet_stats_t s_stats;
+
+// Written by the interrupt only
+static int s_cursor;
+static int64_t s_last_isr_us;
+// Misses not yet taken by the handler, and how late each was caught
+static volatile uint32_t s_pending;
+static uint32_t s_late_us[FASTDET_MAX_USERS];
+
+//---------------------------------------------------------------------
+// Timer interrupt: check the next scan_budget users
+//---------------------------------------------------------------------
+static bool HAL_IRAM_ATTR fastdet_isr(void *arg)
+{
+    (void)arg;
+    uint32_t start = hal_cycles();
+    int64_t now = hal_time_us();
+
+    if (s_last_isr_us != 0 && (uint32_t)(now - s_last_isr_us) > s_stats.max_gap_us) {
+        s_stats.max_gap_us = (uint32_t)(now - s_last_isr_us);
+    }
+    s_last_isr_us = now;
+
+    if (s_cursor >= fastdet_table.count) {
+        s_cursor = 0;
+    }
+    uint32_t missed = shard_table_scan_part(&fastdet_table, now, s_cursor, s_config.scan_budget);
+    s_cursor += s_config.scan_budget;
+
+    bool woken = false;
+    if (missed != 0) {
+        for (int i = 0; i < FASTDET_MAX_USERS; i++) {
+            if (missed & (1u << i)) {
+                const shard_user_t *user = &fastdet_table.users[i];
+                uint32_t elapsed = (uint32_t)now - user->last_feed;
+                // A feed since the scan leaves elapsed below the timeout
+                s_late_us[i] = elapsed > user->timeout_us ? elapsed - user->timeout_us : 0;
+            }
+        }
+        __atomic_or_fetch(&s_pending, missed, __ATOMIC_RELEASE);
+        hal_notify_give_from_isr(s_handler_task, &woken);
+    }
+
+    uint32_t cycles = hal_cycles() - start;
+    s_stats.interrupts++;
+    s_stats.isr_cycles_sum += cycles;
+    if (cycles > s_stats.isr_max_cycles) {
+        s_stats.isr_max_cycles = cycles;
+    }
+    return woken;
+}
+
+//---------------------------------------------------------------------
+// Handler task: reports misses outside the interrupt
+//---------------------------------------------------------------------
+static void handler_task(void *arg)
+{
+    (void)arg;
+    while (1) {
+        hal_notify_take(1000 * 1000);
+        uint32_t pending = __atomic_exchange_n(&s_pending, 0, __ATOMIC_ACQUIRE);
+        for (int i = 0; pending != 0; i++, pending >>= 1) {
+            if (!(pending & 1)) {
+                continue;
+            }
+            uint32_t late_us = s_late_us[i];
+            s_stats.misses++;
+            s_stats.late_sum_us += late_us;
+            if (late_us > s_stats.late_max_us) {
+                s_stats.late_max_us = late_us;
+            }
+            LOGLIMIT_W(TAG, "%s missed its %lu us timeout (caught %lu us late)", fastdet_table.users[i].name,
+                       (unsigned long)fastdet_table.users[i].timeout_us, (unsigned long)late_us);
+            if (s_config.on_miss != NULL) {
+                s_config.on_miss(i, fastdet_table.users[i].name, late_us, s_config.cb_arg);
+            }
+        }
+    }
+}
+
+esp_err_t fastdet_init(const fastdet_config_t *config)
+{
+    if (config == NULL || config->period_us == 0 || config->scan_budget <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_config = *config;
+    if (!s_initialized) {
+        shard_table_init(&fastdet_table, -1);
+        esp_err_t err = hal_task_create(handler_task, "fastdet", FASTDET_STACK_SIZE, NULL,
+                                        s_config.task_priority, HAL_NO_AFFINITY, &s_handler_task);
+        if (err != ESP_OK) {
+            return err;
+        }
+        s_initialized = true;
+    }
+
+    s_cursor = 0;
+    s_last_isr_us = 0;
+    esp_err_t err = hal_fast_timer_start(s_config.period_us, fastdet_isr, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_running = true;
+
+    HAL_LOGI(TAG, "Fast detection started (every %lu us, %d users per interrupt)",
+             (unsigned long)s_config.period_us, s_config.scan_budget);
+    return ESP_OK;
+}
+
+esp_err_t fastdet_stop(void)
+{
+    if (!s_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = hal_fast_timer_stop();
+    if (err == ESP_OK) {
+        s_running = false;
+    }
+    return err;
+}
+
+esp_err_t fastdet_add_user(const char *name, uint32_t timeout_us, fastdet_user_t *out_user)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return shard_table_add(&fastdet_table, name, timeout_us, hal_time_us(), out_user);
+}
+
+esp_err_t fastdet_remove_user(fastdet_user_t user)
+{
+    if (!s_initialized || user < 0 || user >= FASTDET_MAX_USERS || !fastdet_table.users[user].used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    shard_table_remove(&fastdet_table, user);
+    return ESP_OK;
+}
+
+// Copied without stopping the interrupt, so figures may be one
+// interrupt apart
+void fastdet_get_stats(fastdet_stats_t *out)
+{
+    memcpy(out, &s_stats, sizeof(*out));
+}
+
+void fastdet_print_report(void)
+{
+    fastdet_stats_t stats;
+    fastdet_get_stats(&stats);
+
+    uint32_t per_us = hal_cycles_per_us();
+    uint32_t avg = stats.interrupts ? (uint32_t)(stats.isr_cycles_sum / stats.interrupts) : 0;
+    int passes = (fastdet_table.count + s_config.scan_budget - 1) / s_config.scan_budget;
+    uint32_t pass_us = (uint32_t)(passes ? passes : 1) * s_config.period_us;
+
+    HAL_LOGI(TAG, "Fast detection report (every %lu us, %d users per interrupt, table covered every %lu us)",
+             (unsigned long)s_config.period_us, s_config.scan_budget, (unsigned long)pass_us);
+    HAL_LOGI(TAG, "  %lu interrupts, avg %lu cycles (%.2f us), max %lu (%.2f us), longest gap %lu us",
+             (unsigned long)stats.interrupts, (unsigned long)avg, per_us ? (double)avg / per_us : 0.0,
+             (unsigned long)stats.isr_max_cycles, per_us ? (double)stats.isr_max_cycles / per_us : 0.0,
+             (unsigned long)stats.max_gap_us);
+    HAL_LOGI(TAG, "  %lu misses, caught avg %lu us, max %lu us after the timeout",
+             (unsigned long)stats.misses,
+             (unsigned long)(stats.misses ? stats.late_sum_us / stats.misses : 0),
+             (unsigned long)stats.late_max_us);
+
+    for (int i = 0; i < fastdet_table.count; i++) {
+        const shard_user_t *user = &fastdet_table.users[i];
+        if (user->used) {
+            HAL_LOGI(TAG, "    %-16s timeout %lu us, caught within %lu us, %lu feeds, %lu misses", user->name,
+                     (unsigned long)user->timeout_us, (unsigned long)(user->timeout_us + pass_us),
+                     (unsigned long)user->feeds, (unsigned long)user->misses);
+        }
+    }
+}
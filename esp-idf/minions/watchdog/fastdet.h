@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+#include "shardsup.h"
+
+#define FASTDET_MAX_USERS               SHARDSUP_MAX_USERS
+#define FASTDET_STACK_SIZE              3072
+
+//---------------------------------------------------------------------
+// Fast detection
+//
+// Catches a stalled control loop within a millisecond or two, which the
+// TWDT, counting in seconds, cannot. A general-purpose timer interrupts
+// every period_us and the interrupt scans a heartbeat table (a
+// shard_table_t), at most scan_budget users at a time, so its time is
+// bounded however many users there are: n users are all checked every
+// ceil(n / scan_budget) periods. A user is caught at most that long
+// after its timeout. Misses wake a handler task, which reports them
+// through on_miss outside the interrupt.
+//
+// This never touches the TWDT; the supervisor and its TWDT users stay
+// in place behind it as the slow safety net.
+//---------------------------------------------------------------------
+
+// Index in the table
+typedef int fastdet_user_t;
+
+// Called from the handler task; late_us is how long after its timeout
+// the miss was caught
+typedef void (*fastdet_miss_cb_t)(fastdet_user_t user, const char *name, uint32_t late_us, void *arg);
+
+typedef struct {
+    uint32_t period_us;             // Timer interrupt period
+    int scan_budget;                // Users checked per interrupt
+    uint32_t task_priority;         // Handler task
+    fastdet_miss_cb_t on_miss;
+    void *cb_arg;
+} fastdet_config_t;
+
+#define FASTDET_CONFIG_DEFAULT() {      \
+    .period_us = 250,                   \
+    .scan_budget = 8,                   \
+    .task_priority = 15,                \
+    .on_miss = NULL,                    \
+    .cb_arg = NULL,                     \
+}
+
+typedef struct {
+    uint32_t interrupts;
+    uint32_t isr_max_cycles;
+    uint64_t isr_cycles_sum;
+    uint32_t max_gap_us;            // Longest time between two interrupts
+    uint32_t misses;
+    uint32_t late_max_us;           // Of the misses, after their timeouts
+    uint64_t late_sum_us;
+} fastdet_stats_t;
+
+// Start the timer and the handler task
+esp_err_t fastdet_init(const fastdet_config_t *config);
+
+// Stop the timer; users and stats are kept
+esp_err_t fastdet_stop(void);
+
+esp_err_t fastdet_add_user(const char *name, uint32_t timeout_us, fastdet_user_t *out_user);
+
+esp_err_t fastdet_remove_user(fastdet_user_t user);
+
+// Table scanned by the interrupt, for the inline fastdet_feed()
+extern shard_table_t fastdet_table;
+
+static inline void fastdet_feed(fastdet_user_t user)
+{
+    shard_table_feed(&fastdet_table, user, hal_time_us());
+}
+
+void fastdet_get_stats(fastdet_stats_t *out);
+
+// Log interrupt cost, worst-case detection time and misses per user
+void fastdet_print_report(void);
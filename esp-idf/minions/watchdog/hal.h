@@ -0,0 +1,389 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------
+// Hardware abstraction layer
+//
+// The few OS and chip services the supervision modules need: time,
+// cycle counts, critical sections and mutexes, tasks and notifications,
+// the task watchdog, GPIO and logging. hal_esp.c maps them onto ESP-IDF and
+// FreeRTOS, mostly as inlines below. hal_linux.c implements them with
+// pthreads, timerfd and signals, so the recovery engine and its
+// benchmarks build as a native library (see Makefile) that perf and
+// the sanitizers can look at.
+//
+// esp_err_t stays the error type on both; the Linux backend defines
+// the subset of codes the modules return.
+//---------------------------------------------------------------------
+
+#ifdef ESP_PLATFORM
+#include "esp_err.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_task_wdt.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+typedef TaskHandle_t hal_task_t;
+typedef TickType_t hal_tick_t;
+typedef portMUX_TYPE hal_spinlock_t;
+typedef esp_task_wdt_user_handle_t hal_twdt_user_t;
+typedef UBaseType_t hal_irq_state_t;
+typedef struct {
+    SemaphoreHandle_t handle;
+    StaticSemaphore_t storage;
+} hal_mutex_t;
+
+#define HAL_NO_AFFINITY                 tskNO_AFFINITY
+#define HAL_TICK_US                     (portTICK_PERIOD_MS * 1000)
+#define HAL_SPINLOCK_INIT               portMUX_INITIALIZER_UNLOCKED
+#define HAL_IRAM_ATTR                   IRAM_ATTR
+// Kept across software and watchdog resets
+#define HAL_NOINIT_ATTR                 RTC_NOINIT_ATTR
+
+#define HAL_LOGE(tag, fmt, ...)         ESP_LOGE(tag, fmt, ##__VA_ARGS__)
+#define HAL_LOGW(tag, fmt, ...)         ESP_LOGW(tag, fmt, ##__VA_ARGS__)
+#define HAL_LOGI(tag, fmt, ...)         ESP_LOGI(tag, fmt, ##__VA_ARGS__)
+#define HAL_LOGD(tag, fmt, ...)         ESP_LOGD(tag, fmt, ##__VA_ARGS__)
+
+#else // Linux
+
+#include <pthread.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                          0
+#define ESP_FAIL                        -1
+#define ESP_ERR_NO_MEM                  0x101
+#define ESP_ERR_INVALID_ARG             0x102
+#define ESP_ERR_INVALID_STATE           0x103
+#define ESP_ERR_INVALID_SIZE            0x104
+#define ESP_ERR_NOT_FOUND               0x105
+#define ESP_ERR_NOT_SUPPORTED           0x106
+#define ESP_ERR_TIMEOUT                 0x107
+#define ESP_ERR_INVALID_CRC             0x109
+
+const char *esp_err_to_name(esp_err_t err);
+void hal_error_check_failed(esp_err_t err, const char *file, int line, const char *expr);
+
+#define ESP_ERROR_CHECK(x)                                              \
+    do {                                                                \
+        esp_err_t err_rc_ = (x);                                        \
+        if (err_rc_ != ESP_OK) {                                        \
+            hal_error_check_failed(err_rc_, __FILE__, __LINE__, #x);    \
+        }                                                               \
+    } while (0)
+
+typedef struct hal_task *hal_task_t;
+typedef uint64_t hal_tick_t;
+// Recursive like portMUX_TYPE; waiters spin, then yield
+typedef struct {
+    volatile uintptr_t owner;       // pthread_self() of the holder, 0 if free
+    uint32_t count;
+} hal_spinlock_t;
+typedef struct hal_twdt_user *hal_twdt_user_t;
+typedef int hal_irq_state_t;
+typedef pthread_mutex_t hal_mutex_t;
+
+#define HAL_NO_AFFINITY                 -1
+#define HAL_TICK_US                     1000
+#define HAL_SPINLOCK_INIT               { 0, 0 }
+#define HAL_IRAM_ATTR
+#define HAL_NOINIT_ATTR
+
+void hal_log(char level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#define HAL_LOGE(tag, fmt, ...)         hal_log('E', tag, fmt, ##__VA_ARGS__)
+#define HAL_LOGW(tag, fmt, ...)         hal_log('W', tag, fmt, ##__VA_ARGS__)
+#define HAL_LOGI(tag, fmt, ...)         hal_log('I', tag, fmt, ##__VA_ARGS__)
+#define HAL_LOGD(tag, fmt, ...)         hal_log('D', tag, fmt, ##__VA_ARGS__)
+
+#endif // ESP_PLATFORM
+
+typedef void (*hal_task_fn_t)(void *arg);
+
+// Name and handle of a live task, for trace dumps
+typedef struct {
+    hal_task_t handle;
+    const char *name;
+} hal_task_info_t;
+
+//---------------------------------------------------------------------
+// Time
+//---------------------------------------------------------------------
+
+// Microseconds since boot (process start on Linux)
+static inline int64_t hal_time_us(void);
+
+// Free-running 32-bit cycle counter of the calling CPU, for short
+// intervals; wraps within seconds
+static inline uint32_t hal_cycles(void);
+
+// hal_cycles() per microsecond
+uint32_t hal_cycles_per_us(void);
+
+hal_tick_t hal_ticks(void);
+
+// Sleep for at least ms; 0 yields
+void hal_delay_ms(uint32_t ms);
+
+// Sleep until *last_wake + period_ms and advance *last_wake, for
+// periodic loops without drift
+void hal_delay_until(hal_tick_t *last_wake, uint32_t period_ms);
+
+// Busy-wait
+void hal_delay_us(uint32_t us);
+
+//---------------------------------------------------------------------
+// Critical sections and cores
+//---------------------------------------------------------------------
+static inline void hal_spinlock_init(hal_spinlock_t *lock);
+static inline void hal_enter_critical(hal_spinlock_t *lock);
+static inline void hal_exit_critical(hal_spinlock_t *lock);
+
+// Keep the calling core to itself, from tasks and ISRs: masks interrupts
+// on ESP, takes one process-wide lock on Linux where threads migrate
+static inline hal_irq_state_t hal_core_lock(void);
+static inline void hal_core_unlock(hal_irq_state_t state);
+
+static inline int hal_core_id(void);
+int hal_num_cores(void);
+
+// Sleeping mutex for sections that block, such as flash I/O; never
+// from an ISR or inside a critical section
+static inline void hal_mutex_init(hal_mutex_t *mutex);
+static inline void hal_mutex_lock(hal_mutex_t *mutex);
+static inline void hal_mutex_unlock(hal_mutex_t *mutex);
+
+//---------------------------------------------------------------------
+// Tasks
+//---------------------------------------------------------------------
+
+// Create a task pinned to core_id, or HAL_NO_AFFINITY. Linux ignores the
+// stack size and priority and pins only to CPUs that exist.
+esp_err_t hal_task_create(hal_task_fn_t fn, const char *name, uint32_t stack_size, void *arg,
+                          uint32_t priority, int core_id, hal_task_t *out_task);
+
+// Delete a task, NULL for the caller; like vTaskDelete() nothing it holds
+// is released. On Linux another task stops at its next delay, busy-wait
+// or notification wait; one that reaches none within a second is left
+// running with a warning.
+void hal_task_delete(hal_task_t task);
+
+hal_task_t hal_task_current(void);
+
+const char *hal_task_name(hal_task_t task);
+
+// Fill out with up to max live tasks, returns the number filled
+int hal_task_list(hal_task_info_t *out, int max);
+
+// Direct-to-task counting notification
+void hal_notify_give(hal_task_t task);
+
+// Wait up to timeout_us for notifications; returns and clears the count,
+// 0 on timeout
+uint32_t hal_notify_take(uint32_t timeout_us);
+
+//---------------------------------------------------------------------
+// Task watchdog and system
+//---------------------------------------------------------------------
+
+// Start the task watchdog; panic aborts on a timeout instead of logging
+esp_err_t hal_twdt_init(uint32_t timeout_ms, bool panic);
+esp_err_t hal_twdt_add_user(const char *name, hal_twdt_user_t *out_user);
+esp_err_t hal_twdt_reset_user(hal_twdt_user_t user);
+esp_err_t hal_twdt_delete_user(hal_twdt_user_t user);
+
+void hal_restart(void) __attribute__((noreturn));
+
+// esp_rom_crc32_le() semantics: crc of the previous chunk in, 0 to start
+uint32_t hal_crc32_le(uint32_t crc, const uint8_t *data, size_t len);
+
+//---------------------------------------------------------------------
+// High-rate timer: one general-purpose timer interrupt on ESP, a
+// timerfd thread on Linux
+//---------------------------------------------------------------------
+
+// Runs in the interrupt; returns true if it woke a task that should run
+// as the interrupt returns
+typedef bool (*hal_timer_isr_t)(void *arg);
+
+// Call isr every period_us until stopped. One timer; ESP_ERR_INVALID_STATE
+// while it runs.
+esp_err_t hal_fast_timer_start(uint32_t period_us, hal_timer_isr_t isr, void *arg);
+esp_err_t hal_fast_timer_stop(void);
+
+// hal_notify_give() from the timer interrupt; sets *woken if the task
+// should run before the interrupted one
+void hal_notify_give_from_isr(hal_task_t task, bool *woken);
+
+//---------------------------------------------------------------------
+// GPIO; virtual pins on Linux
+//---------------------------------------------------------------------
+esp_err_t hal_gpio_set_level(int pin, uint32_t level);
+int hal_gpio_get_level(int pin);
+
+//---------------------------------------------------------------------
+// Inlines for the hot paths
+//---------------------------------------------------------------------
+#ifdef ESP_PLATFORM
+
+static inline int64_t hal_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+static inline uint32_t hal_cycles(void)
+{
+    return esp_cpu_get_cycle_count();
+}
+
+static inline void hal_spinlock_init(hal_spinlock_t *lock)
+{
+    portMUX_INITIALIZE(lock);
+}
+
+static inline void hal_enter_critical(hal_spinlock_t *lock)
+{
+    portENTER_CRITICAL(lock);
+}
+
+static inline void hal_exit_critical(hal_spinlock_t *lock)
+{
+    portEXIT_CRITICAL(lock);
+}
+
+static inline hal_irq_state_t hal_core_lock(void)
+{
+    return portSET_INTERRUPT_MASK_FROM_ISR();
+}
+
+static inline void hal_core_unlock(hal_irq_state_t state)
+{
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+static inline int hal_core_id(void)
+{
+    return xPortGetCoreID();
+}
+
+static inline void hal_mutex_init(hal_mutex_t *mutex)
+{
+    mutex->handle = xSemaphoreCreateMutexStatic(&mutex->storage);
+}
+
+static inline void hal_mutex_lock(hal_mutex_t *mutex)
+{
+    xSemaphoreTake(mutex->handle, portMAX_DELAY);
+}
+
+static inline void hal_mutex_unlock(hal_mutex_t *mutex)
+{
+    xSemaphoreGive(mutex->handle);
+}
+
+#else // Linux
+
+#include <time.h>
+
+extern int64_t hal_boot_ns;
+extern hal_spinlock_t hal_core_spinlock;
+
+int hal_linux_core_id(void);
+
+// Thread of a live task, for signalling it; false once the task exited
+bool hal_linux_task_thread(hal_task_t task, pthread_t *out);
+
+static inline int64_t hal_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec - hal_boot_ns) / 1000;
+}
+
+static inline uint32_t hal_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return (uint32_t)ticks;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+#endif
+}
+
+void hal_spin_wait(hal_spinlock_t *lock, uintptr_t self);
+
+static inline void hal_spinlock_init(hal_spinlock_t *lock)
+{
+    lock->owner = 0;
+    lock->count = 0;
+}
+
+static inline void hal_enter_critical(hal_spinlock_t *lock)
+{
+    uintptr_t self = (uintptr_t)pthread_self();
+    if (__atomic_load_n(&lock->owner, __ATOMIC_RELAXED) == self) {
+        lock->count++;
+        return;
+    }
+    uintptr_t expected = 0;
+    if (!__atomic_compare_exchange_n(&lock->owner, &expected, self, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        hal_spin_wait(lock, self);
+    }
+    lock->count = 1;
+}
+
+static inline void hal_exit_critical(hal_spinlock_t *lock)
+{
+    if (--lock->count == 0) {
+        __atomic_store_n(&lock->owner, 0, __ATOMIC_RELEASE);
+    }
+}
+
+static inline hal_irq_state_t hal_core_lock(void)
+{
+    hal_enter_critical(&hal_core_spinlock);
+    return 0;
+}
+
+static inline void hal_core_unlock(hal_irq_state_t state)
+{
+    (void)state;
+    hal_exit_critical(&hal_core_spinlock);
+}
+
+static inline int hal_core_id(void)
+{
+    return hal_linux_core_id();
+}
+
+static inline void hal_mutex_init(hal_mutex_t *mutex)
+{
+    pthread_mutex_init(mutex, NULL);
+}
+
+static inline void hal_mutex_lock(hal_mutex_t *mutex)
+{
+    pthread_mutex_lock(mutex);
+}
+
+static inline void hal_mutex_unlock(hal_mutex_t *mutex)
+{
+    pthread_mutex_unlock(mutex);
+}
+
+#endif // ESP_PLATFORM
@@ -0,0 +1,255 @@
+#ifdef ESP_PLATFORM
+#include <string.h>
+#include "driver/gpio.h"
+#include "driver/gptimer.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "hal.h"
+
+// GPIO levels last written, for hal_gpio_get_level() on output pins
+static uint64_t s_gpio_levels;
+
+static gptimer_handle_t s_fast_timer;
+static hal_timer_isr_t s_fast_isr;
+
+//---------------------------------------------------------------------
+// Time
+//---------------------------------------------------------------------
+uint32_t hal_cycles_per_us(void)
+{
+    return esp_rom_get_cpu_ticks_per_us();
+}
+
+hal_tick_t hal_ticks(void)
+{
+    return xTaskGetTickCount();
+}
+
+void hal_delay_ms(uint32_t ms)
+{
+    // Round up so a short delay still sleeps rather than only yielding
+    vTaskDelay((TickType_t)(((uint64_t)ms * configTICK_RATE_HZ + 999) / 1000));
+}
+
+void hal_delay_until(hal_tick_t *last_wake, uint32_t period_ms)
+{
+    vTaskDelayUntil(last_wake, pdMS_TO_TICKS(period_ms));
+}
+
+void hal_delay_us(uint32_t us)
+{
+    esp_rom_delay_us(us);
+}
+
+int hal_num_cores(void)
+{
+    return portNUM_PROCESSORS;
+}
+
+//---------------------------------------------------------------------
+// Tasks
+//---------------------------------------------------------------------
+esp_err_t hal_task_create(hal_task_fn_t fn, const char *name, uint32_t stack_size, void *arg,
+                          uint32_t priority, int core_id, hal_task_t *out_task)
+{
+    TaskHandle_t task = NULL;
+    if (xTaskCreatePinnedToCore(fn, name, stack_size, arg, priority, &task, core_id) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (out_task != NULL) {
+        *out_task = task;
+    }
+    return ESP_OK;
+}
+
+void hal_task_delete(hal_task_t task)
+{
+    vTaskDelete(task);
+}
+
+hal_task_t hal_task_current(void)
+{
+    return xTaskGetCurrentTaskHandle();
+}
+
+const char *hal_task_name(hal_task_t task)
+{
+    return pcTaskGetName(task);
+}
+
+int hal_task_list(hal_task_info_t *out, int max)
+{
+    // Snapshot the scheduler's own list; names stay valid while the
+    // tasks live
+    static TaskStatus_t status[32];
+    int count = (int)uxTaskGetSystemState(status, sizeof(status) / sizeof(status[0]), NULL);
+    if (count > max) {
+        count = max;
+    }
+    for (int i = 0; i < count; i++) {
+        out[i].handle = status[i].xHandle;
+        out[i].name = status[i].pcTaskName;
+    }
+    return count;
+}
+
+void hal_notify_give(hal_task_t task)
+{
+    xTaskNotifyGive(task);
+}
+
+uint32_t hal_notify_take(uint32_t timeout_us)
+{
+    TickType_t ticks = (TickType_t)((timeout_us + HAL_TICK_US - 1) / HAL_TICK_US);
+    return ulTaskNotifyTake(pdTRUE, ticks);
+}
+
+//---------------------------------------------------------------------
+// Task watchdog and system
+//---------------------------------------------------------------------
+esp_err_t hal_twdt_init(uint32_t timeout_ms, bool panic)
+{
+    esp_task_wdt_config_t config = {
+        .timeout_ms = timeout_ms,
+        .idle_core_mask = 0,
+        .trigger_panic = panic,
+    };
+    // The system may have started it already from sdkconfig
+    esp_err_t err = esp_task_wdt_init(&config);
+    if (err == ESP_ERR_INVALID_STATE) {
+        err = esp_task_wdt_reconfigure(&config);
+    }
+    return err;
+}
+
+esp_err_t hal_twdt_add_user(const char *name, hal_twdt_user_t *out_user)
+{
+    return esp_task_wdt_add_user(name, out_user);
+}
+
+esp_err_t hal_twdt_reset_user(hal_twdt_user_t user)
+{
+    return esp_task_wdt_reset_user(user);
+}
+
+esp_err_t hal_twdt_delete_user(hal_twdt_user_t user)
+{
+    return esp_task_wdt_delete_user(user);
+}
+
+void hal_restart(void)
+{
+    esp_restart();
+}
+
+uint32_t hal_crc32_le(uint32_t crc, const uint8_t *data, size_t len)
+{
+    return esp_rom_crc32_le(crc, data, len);
+}
+
+//---------------------------------------------------------------------
+// High-rate timer: a 1 MHz GPTimer reloading at each alarm
+//---------------------------------------------------------------------
+static bool IRAM_ATTR fast_timer_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata,
+                                       void *arg)
+{
+    (void)timer;
+    (void)edata;
+    return s_fast_isr(arg);
+}
+
+esp_err_t hal_fast_timer_start(uint32_t period_us, hal_timer_isr_t isr, void *arg)
+{
+    if (period_us == 0 || isr == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_fast_timer != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    gptimer_config_t config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = 1000000,
+    };
+    esp_err_t err = gptimer_new_timer(&config, &s_fast_timer);
+    if (err != ESP_OK) {
+        s_fast_timer = NULL;
+        return err;
+    }
+    s_fast_isr = isr;
+
+    gptimer_event_callbacks_t callbacks = { .on_alarm = fast_timer_alarm };
+    gptimer_alarm_config_t alarm = {
+        .alarm_count = period_us,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    err = gptimer_register_event_callbacks(s_fast_timer, &callbacks, arg);
+    if (err == ESP_OK) {
+        err = gptimer_set_alarm_action(s_fast_timer, &alarm);
+    }
+    if (err == ESP_OK) {
+        err = gptimer_enable(s_fast_timer);
+    }
+    if (err == ESP_OK) {
+        err = gptimer_start(s_fast_timer);
+        if (err != ESP_OK) {
+            gptimer_disable(s_fast_timer);
+        }
+    }
+    if (err != ESP_OK) {
+        gptimer_del_timer(s_fast_timer);
+        s_fast_timer = NULL;
+    }
+    return err;
+}
+
+esp_err_t hal_fast_timer_stop(void)
+{
+    if (s_fast_timer == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    gptimer_stop(s_fast_timer);
+    gptimer_disable(s_fast_timer);
+    gptimer_del_timer(s_fast_timer);
+    s_fast_timer = NULL;
+    return ESP_OK;
+}
+
+void IRAM_ATTR hal_notify_give_from_isr(hal_task_t task, bool *woken)
+{
+    BaseType_t higher = pdFALSE;
+    vTaskNotifyGiveFromISR(task, &higher);
+    if (higher == pdTRUE) {
+        *woken = true;
+    }
+}
+
+//---------------------------------------------------------------------
+// GPIO
+//---------------------------------------------------------------------
+esp_err_t hal_gpio_set_level(int pin, uint32_t level)
+{
+    if (pin < 0 || pin >= 64) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = gpio_set_level((gpio_num_t)pin, level);
+    if (err == ESP_OK) {
+        if (level) {
+            __atomic_or_fetch(&s_gpio_levels, 1ull << pin, __ATOMIC_RELAXED);
+        } else {
+            __atomic_and_fetch(&s_gpio_levels, ~(1ull << pin), __ATOMIC_RELAXED);
+        }
+    }
+    return err;
+}
+
+int hal_gpio_get_level(int pin)
+{
+    if (pin < 0 || pin >= 64) {
+        return -1;
+    }
+    return (int)((__atomic_load_n(&s_gpio_levels, __ATOMIC_RELAXED) >> pin) & 1);
+}
+#endif // ESP_PLATFORM
@@ -0,0 +1,751 @@
+#ifndef ESP_PLATFORM
+#define _GNU_SOURCE                     // sched_getcpu(), pthread affinity and names
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include "hal.h"
+
+static const char *TAG = "HAL";
+
+// Live tasks, including threads adopted by hal_task_current()
+#define MAX_TASKS                       64
+#define TASK_NAME_LEN                   16
+#define MAX_TWDT_USERS                  32
+#define GPIO_COUNT                      64
+// How long hal_task_delete() waits for another task to reach a stop point
+#define DELETE_TIMEOUT_MS               1000
+// Spins on a held lock before yielding the CPU
+#define SPIN_LIMIT                      100
+
+struct hal_task {
+    pthread_t thread;
+    hal_task_fn_t fn;
+    void *arg;
+    char name[TASK_NAME_LEN];
+    bool joining;                   // Being deleted by another task, which frees it
+    bool stop;                      // Deleted; exits at its next stop point
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+struct hal_twdt_user {
+    bool used;
+    char name[TASK_NAME_LEN];
+    int64_t last_reset_us;
+};
+
+int64_t hal_boot_ns;
+hal_spinlock_t hal_core_spinlock = HAL_SPINLOCK_INIT;
+
+static char **s_argv;
+static pthread_mutex_t s_log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct hal_task *s_tasks[MAX_TASKS];
+static pthread_mutex_t s_tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct hal_task *s_current;
+
+static struct hal_twdt_user s_twdt_users[MAX_TWDT_USERS];
+static pthread_mutex_t s_twdt_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t s_twdt_timeout_ms;
+static bool s_twdt_panic;
+static bool s_twdt_running;
+
+static uint64_t s_gpio_levels;
+
+static pthread_t s_fast_thread;
+static bool s_fast_running;
+static volatile bool s_fast_stop;
+static hal_timer_isr_t s_fast_isr;
+static void *s_fast_arg;
+static uint32_t s_fast_period_us;
+
+//---------------------------------------------------------------------
+// Start-up: the process start stands in for boot. glibc passes main's
+// arguments to constructors; hal_restart() execs them again.
+//---------------------------------------------------------------------
+__attribute__((constructor)) static void hal_linux_init(int argc, char **argv, char **envp)
+{
+    (void)argc;
+    (void)envp;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    hal_boot_ns = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    s_argv = argv;
+}
+
+static int64_t mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//---------------------------------------------------------------------
+// Errors and logging
+//---------------------------------------------------------------------
+const char *esp_err_to_name(esp_err_t err)
+{
+    switch (err) {
+    case ESP_OK:                return "ESP_OK";
+    case ESP_FAIL:              return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_CRC:   return "ESP_ERR_INVALID_CRC";
+    default:                    return "UNKNOWN ERROR";
+    }
+}
+
+void hal_error_check_failed(esp_err_t err, const char *file, int line, const char *expr)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: esp_err_t 0x%x (%s) at %s:%d\nexpression: %s\n",
+            err, esp_err_to_name(err), file, line, expr);
+    abort();
+}
+
+// Same layout as the ESP-IDF log, so the host tools parse both
+void hal_log(char level, const char *tag, const char *fmt, ...)
+{
+    if (level == 'D' && getenv("HAL_LOG_DEBUG") == NULL) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    pthread_mutex_lock(&s_log_lock);
+    fprintf(stdout, "%c (%lld) %s: ", level, (long long)(hal_time_us() / 1000), tag);
+    vfprintf(stdout, fmt, args);
+    fputc('\n', stdout);
+    fflush(stdout);
+    pthread_mutex_unlock(&s_log_lock);
+    va_end(args);
+}
+
+//---------------------------------------------------------------------
+// Time
+//---------------------------------------------------------------------
+uint32_t hal_cycles_per_us(void)
+{
+    static uint32_t s_per_us;
+    uint32_t per_us = __atomic_load_n(&s_per_us, __ATOMIC_RELAXED);
+    if (per_us != 0) {
+        return per_us;
+    }
+
+    // Count cycles across 10 ms of wall time
+    int64_t start_ns = mono_ns();
+    uint32_t start = hal_cycles();
+    while (mono_ns() - start_ns < 10000000) {
+    }
+    uint32_t cycles = hal_cycles() - start;
+    int64_t elapsed_ns = mono_ns() - start_ns;
+    per_us = (uint32_t)((uint64_t)cycles * 1000 / (uint64_t)elapsed_ns);
+    if (per_us == 0) {
+        per_us = 1;
+    }
+    __atomic_store_n(&s_per_us, per_us, __ATOMIC_RELAXED);
+    return per_us;
+}
+
+hal_tick_t hal_ticks(void)
+{
+    return (hal_tick_t)mono_ns();
+}
+
+//---------------------------------------------------------------------
+// Stop point: a task deleted by another one exits here. Called from
+// every delay and notification wait, never with a HAL lock held.
+//---------------------------------------------------------------------
+static void check_stop(void)
+{
+    struct hal_task *task = s_current;
+    if (task != NULL && __atomic_load_n(&task->stop, __ATOMIC_ACQUIRE)) {
+        pthread_exit(NULL);
+    }
+}
+
+// A task sleeps on its condition variable so hal_task_delete() can wake it
+static void sleep_until_ns(int64_t deadline_ns)
+{
+    struct timespec ts = {
+        .tv_sec = deadline_ns / 1000000000,
+        .tv_nsec = deadline_ns % 1000000000,
+    };
+    struct hal_task *task = s_current;
+    if (task == NULL) {
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&task->lock);
+    while (!task->stop) {
+        if (pthread_cond_timedwait(&task->cond, &task->lock, &ts) == ETIMEDOUT) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&task->lock);
+    check_stop();
+}
+
+void hal_delay_ms(uint32_t ms)
+{
+    if (ms == 0) {
+        sched_yield();
+        check_stop();
+        return;
+    }
+    sleep_until_ns(mono_ns() + (int64_t)ms * 1000000);
+}
+
+void hal_delay_until(hal_tick_t *last_wake, uint32_t period_ms)
+{
+    *last_wake += (hal_tick_t)period_ms * 1000000;
+    sleep_until_ns((int64_t)*last_wake);
+}
+
+void hal_delay_us(uint32_t us)
+{
+    int64_t end_ns = mono_ns() + (int64_t)us * 1000;
+    while (mono_ns() < end_ns) {
+        check_stop();
+    }
+}
+
+//---------------------------------------------------------------------
+// Critical sections and cores
+//---------------------------------------------------------------------
+void hal_spin_wait(hal_spinlock_t *lock, uintptr_t self)
+{
+    // The holder may be preempted on an oversubscribed host; yield rather
+    // than burn its time slice
+    for (int spins = 0;; spins++) {
+        uintptr_t expected = 0;
+        if (__atomic_load_n(&lock->owner, __ATOMIC_RELAXED) == 0 &&
+            __atomic_compare_exchange_n(&lock->owner, &expected, self, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        if (spins >= SPIN_LIMIT) {
+            sched_yield();
+        }
+    }
+}
+
+int hal_linux_core_id(void)
+{
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : cpu;
+}
+
+int hal_num_cores(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+//---------------------------------------------------------------------
+// Tasks: one thread each. A task deleted by another is flagged and woken,
+// and exits at its next stop point (see check_stop()).
+//---------------------------------------------------------------------
+
+static bool register_task(struct hal_task *task)
+{
+    pthread_mutex_lock(&s_tasks_lock);
+    for (int i = 0; i < MAX_TASKS; i++) {
+        if (s_tasks[i] == NULL) {
+            s_tasks[i] = task;
+            pthread_mutex_unlock(&s_tasks_lock);
+            return true;
+        }
+    }
+    pthread_mutex_unlock(&s_tasks_lock);
+    return false;
+}
+
+// Index of a live task, -1 once it exited (call under s_tasks_lock)
+static int find_task(const struct hal_task *task)
+{
+    for (int i = 0; i < MAX_TASKS; i++) {
+        if (s_tasks[i] == task) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static struct hal_task *new_task(const char *name)
+{
+    struct hal_task *task = calloc(1, sizeof(*task));
+    if (task == NULL) {
+        return NULL;
+    }
+    strncpy(task->name, name, TASK_NAME_LEN - 1);
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&task->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    return task;
+}
+
+static void free_task(struct hal_task *task)
+{
+    pthread_cond_destroy(&task->cond);
+    pthread_mutex_destroy(&task->lock);
+    free(task);
+}
+
+// Runs however the task ends: return, self-delete or a stop point
+static void task_exit(void *arg)
+{
+    struct hal_task *task = (struct hal_task *)arg;
+    pthread_mutex_lock(&s_tasks_lock);
+    int index = find_task(task);
+    if (index >= 0) {
+        s_tasks[index] = NULL;
+    }
+    bool joining = task->joining;
+    pthread_mutex_unlock(&s_tasks_lock);
+
+    if (!joining) {
+        pthread_detach(pthread_self());
+        free_task(task);
+    }
+}
+
+static void *task_main(void *arg)
+{
+    struct hal_task *task = (struct hal_task *)arg;
+    s_current = task;
+    pthread_setname_np(pthread_self(), task->name);
+    pthread_cleanup_push(task_exit, task);
+    task->fn(task->arg);
+    pthread_cleanup_pop(1);
+    return NULL;
+}
+
+esp_err_t hal_task_create(hal_task_fn_t fn, const char *name, uint32_t stack_size, void *arg,
+                          uint32_t priority, int core_id, hal_task_t *out_task)
+{
+    (void)stack_size;
+    (void)priority;
+
+    struct hal_task *task = new_task(name);
+    if (task == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (!register_task(task)) {
+        free_task(task);
+        return ESP_ERR_NO_MEM;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (core_id >= 0 && core_id < hal_num_cores()) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(core_id, &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+    // Hold the registry so the task cannot exit before its handle is set
+    pthread_mutex_lock(&s_tasks_lock);
+    int err = pthread_create(&task->thread, &attr, task_main, task);
+    pthread_mutex_unlock(&s_tasks_lock);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        pthread_mutex_lock(&s_tasks_lock);
+        s_tasks[find_task(task)] = NULL;
+        pthread_mutex_unlock(&s_tasks_lock);
+        free_task(task);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (out_task != NULL) {
+        *out_task = task;
+    }
+    return ESP_OK;
+}
+
+void hal_task_delete(hal_task_t task)
+{
+    if (task == NULL || task == s_current) {
+        pthread_exit(NULL);
+    }
+
+    pthread_mutex_lock(&s_tasks_lock);
+    if (find_task(task) < 0 || task->fn == NULL) {
+        // Already gone, or an adopted thread the HAL did not start
+        pthread_mutex_unlock(&s_tasks_lock);
+        return;
+    }
+    task->joining = true;
+    pthread_mutex_lock(&task->lock);
+    __atomic_store_n(&task->stop, true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    pthread_mutex_unlock(&s_tasks_lock);
+
+    // Like vTaskDelete(), the task never runs again once this returns,
+    // provided it reaches a stop point
+    int64_t deadline_ns = mono_ns() + (int64_t)DELETE_TIMEOUT_MS * 1000000;
+    struct timespec ts = {
+        .tv_sec = deadline_ns / 1000000000,
+        .tv_nsec = deadline_ns % 1000000000,
+    };
+    if (pthread_clockjoin_np(task->thread, NULL, CLOCK_MONOTONIC, &ts) == 0) {
+        free_task(task);
+        return;
+    }
+
+    // Spinning without a delay or wait: leave it to exit and free itself
+    // at its next stop point
+    HAL_LOGW(TAG, "Task %s did not stop within %d ms, leaving it running", task->name, DELETE_TIMEOUT_MS);
+    pthread_mutex_lock(&s_tasks_lock);
+    bool live = find_task(task) >= 0;
+    if (live) {
+        task->joining = false;
+        pthread_detach(task->thread);
+    }
+    pthread_mutex_unlock(&s_tasks_lock);
+    if (!live) {
+        // It exited after all, before seeing joining cleared
+        pthread_join(task->thread, NULL);
+        free_task(task);
+    }
+}
+
+bool hal_linux_task_thread(hal_task_t task, pthread_t *out)
+{
+    pthread_mutex_lock(&s_tasks_lock);
+    bool live = task != NULL && find_task(task) >= 0;
+    if (live) {
+        *out = task->thread;
+    }
+    pthread_mutex_unlock(&s_tasks_lock);
+    return live;
+}
+
+hal_task_t hal_task_current(void)
+{
+    if (s_current == NULL) {
+        // A thread the HAL did not start, e.g. main: adopt it so it can
+        // take notifications
+        char name[TASK_NAME_LEN] = "main";
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        struct hal_task *task = new_task(name);
+        if (task == NULL) {
+            return NULL;
+        }
+        task->thread = pthread_self();
+        register_task(task);
+        s_current = task;
+    }
+    return s_current;
+}
+
+const char *hal_task_name(hal_task_t task)
+{
+    if (task == NULL) {
+        task = hal_task_current();
+    }
+    return task != NULL ? task->name : "?";
+}
+
+int hal_task_list(hal_task_info_t *out, int max)
+{
+    int count = 0;
+    pthread_mutex_lock(&s_tasks_lock);
+    for (int i = 0; i < MAX_TASKS && count < max; i++) {
+        if (s_tasks[i] != NULL) {
+            out[count].handle = s_tasks[i];
+            out[count].name = s_tasks[i]->name;
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&s_tasks_lock);
+    return count;
+}
+
+void hal_notify_give(hal_task_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+}
+
+uint32_t hal_notify_take(uint32_t timeout_us)
+{
+    struct hal_task *task = hal_task_current();
+    int64_t deadline_ns = mono_ns() + (int64_t)timeout_us * 1000;
+    struct timespec ts = {
+        .tv_sec = deadline_ns / 1000000000,
+        .tv_nsec = deadline_ns % 1000000000,
+    };
+
+    pthread_mutex_lock(&task->lock);
+    while (task->notify == 0 && !task->stop) {
+        if (pthread_cond_timedwait(&task->cond, &task->lock, &ts) == ETIMEDOUT) {
+            break;
+        }
+    }
+    uint32_t count = task->notify;
+    task->notify = 0;
+    pthread_mutex_unlock(&task->lock);
+    check_stop();
+    return count;
+}
+
+//---------------------------------------------------------------------
+// Task watchdog: a timerfd thread checks every user a few times per
+// timeout and reports the ones that did not reset in time, like the
+// TWDT interrupt. With panic set it aborts with SIGABRT.
+//---------------------------------------------------------------------
+static void *twdt_thread(void *arg)
+{
+    (void)arg;
+    uint32_t period_ms = s_twdt_timeout_ms / 4 ? s_twdt_timeout_ms / 4 : 1;
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    struct itimerspec spec = {
+        .it_interval = { .tv_sec = period_ms / 1000, .tv_nsec = (period_ms % 1000) * 1000000L },
+        .it_value = { .tv_sec = period_ms / 1000, .tv_nsec = (period_ms % 1000) * 1000000L },
+    };
+    timerfd_settime(fd, 0, &spec, NULL);
+    pthread_setname_np(pthread_self(), "twdt");
+
+    while (1) {
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            continue;
+        }
+
+        int64_t now = hal_time_us();
+        bool triggered = false;
+        pthread_mutex_lock(&s_twdt_lock);
+        for (int i = 0; i < MAX_TWDT_USERS; i++) {
+            struct hal_twdt_user *user = &s_twdt_users[i];
+            if (!user->used || now - user->last_reset_us <= (int64_t)s_twdt_timeout_ms * 1000) {
+                continue;
+            }
+            if (!triggered) {
+                HAL_LOGE(TAG, "Task watchdog got triggered. The following users did not reset the watchdog in time:");
+                triggered = true;
+            }
+            HAL_LOGE(TAG, " - %s", user->name);
+            // Fire again after another full timeout, as the TWDT does
+            user->last_reset_us = now;
+        }
+        pthread_mutex_unlock(&s_twdt_lock);
+
+        if (triggered && s_twdt_panic) {
+            HAL_LOGE(TAG, "Aborting.");
+            raise(SIGABRT);
+        }
+    }
+    return NULL;
+}
+
+esp_err_t hal_twdt_init(uint32_t timeout_ms, bool panic)
+{
+    if (timeout_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_twdt_lock);
+    bool running = s_twdt_running;
+    s_twdt_timeout_ms = timeout_ms;
+    s_twdt_panic = panic;
+    s_twdt_running = true;
+    pthread_mutex_unlock(&s_twdt_lock);
+    if (running) {
+        // Reconfigured; the checking period stays as first set
+        return ESP_OK;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, twdt_thread, NULL) != 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(thread);
+    return ESP_OK;
+}
+
+esp_err_t hal_twdt_add_user(const char *name, hal_twdt_user_t *out_user)
+{
+    if (name == NULL || out_user == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_ERR_NO_MEM;
+    pthread_mutex_lock(&s_twdt_lock);
+    if (!s_twdt_running) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        for (int i = 0; i < MAX_TWDT_USERS; i++) {
+            struct hal_twdt_user *user = &s_twdt_users[i];
+            if (!user->used) {
+                user->used = true;
+                strncpy(user->name, name, TASK_NAME_LEN - 1);
+                user->name[TASK_NAME_LEN - 1] = '\0';
+                user->last_reset_us = hal_time_us();
+                *out_user = user;
+                err = ESP_OK;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&s_twdt_lock);
+    return err;
+}
+
+esp_err_t hal_twdt_reset_user(hal_twdt_user_t user)
+{
+    if (user == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_twdt_lock);
+    user->last_reset_us = hal_time_us();
+    pthread_mutex_unlock(&s_twdt_lock);
+    return ESP_OK;
+}
+
+esp_err_t hal_twdt_delete_user(hal_twdt_user_t user)
+{
+    if (user == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_twdt_lock);
+    user->used = false;
+    pthread_mutex_unlock(&s_twdt_lock);
+    return ESP_OK;
+}
+
+//---------------------------------------------------------------------
+// High-rate timer: a timerfd thread, real-time if the process may, calls
+// the handler once per expiry. Expiries missed while it was descheduled
+// are collapsed into one call, as a late interrupt would be.
+//---------------------------------------------------------------------
+static void *fast_timer_thread(void *arg)
+{
+    (void)arg;
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    struct itimerspec spec = {
+        .it_interval = { .tv_sec = s_fast_period_us / 1000000, .tv_nsec = (s_fast_period_us % 1000000) * 1000L },
+        .it_value = { .tv_sec = s_fast_period_us / 1000000, .tv_nsec = (s_fast_period_us % 1000000) * 1000L },
+    };
+    timerfd_settime(fd, 0, &spec, NULL);
+    pthread_setname_np(pthread_self(), "fast_timer");
+    struct sched_param param = { .sched_priority = sched_get_priority_max(SCHED_FIFO) };
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+    while (!s_fast_stop) {
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+            s_fast_isr(s_fast_arg);
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+esp_err_t hal_fast_timer_start(uint32_t period_us, hal_timer_isr_t isr, void *arg)
+{
+    if (period_us == 0 || isr == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_fast_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_fast_isr = isr;
+    s_fast_arg = arg;
+    s_fast_period_us = period_us;
+    s_fast_stop = false;
+    if (pthread_create(&s_fast_thread, NULL, fast_timer_thread, NULL) != 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_fast_running = true;
+    return ESP_OK;
+}
+
+esp_err_t hal_fast_timer_stop(void)
+{
+    if (!s_fast_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_fast_stop = true;
+    pthread_join(s_fast_thread, NULL);
+    s_fast_running = false;
+    return ESP_OK;
+}
+
+void hal_notify_give_from_isr(hal_task_t task, bool *woken)
+{
+    hal_notify_give(task);
+    *woken = true;
+}
+
+//---------------------------------------------------------------------
+// System
+//---------------------------------------------------------------------
+
+// A fresh process stands in for the reset: every static starts over,
+// including HAL_NOINIT_ATTR ones
+void hal_restart(void)
+{
+    HAL_LOGW(TAG, "Restarting");
+    fflush(NULL);
+    if (s_argv != NULL) {
+        execv("/proc/self/exe", s_argv);
+    }
+    _exit(EXIT_FAILURE);
+}
+
+uint32_t hal_crc32_le(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+//---------------------------------------------------------------------
+// GPIO
+//---------------------------------------------------------------------
+esp_err_t hal_gpio_set_level(int pin, uint32_t level)
+{
+    if (pin < 0 || pin >= GPIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (level) {
+        __atomic_or_fetch(&s_gpio_levels, 1ull << pin, __ATOMIC_RELAXED);
+    } else {
+        __atomic_and_fetch(&s_gpio_levels, ~(1ull << pin), __ATOMIC_RELAXED);
+    }
+    HAL_LOGD(TAG, "GPIO%d = %lu", pin, (unsigned long)level);
+    return ESP_OK;
+}
+
+int hal_gpio_get_level(int pin)
+{
+    if (pin < 0 || pin >= GPIO_COUNT) {
+        return -1;
+    }
+    return (int)((__atomic_load_n(&s_gpio_levels, __ATOMIC_RELAXED) >> pin) & 1);
+}
+#endif // !ESP_PLATFORM
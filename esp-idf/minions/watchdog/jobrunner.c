@@ -0,0 +1,456 @@
+#include <string.h>
+#include "hal.h"
+#include "jobrunner.h"
+#include "loglimit.h"
+
+static const char *TAG = "Jobrunner";
+
+// Passes over all jobs timed by the benchmark
+#define BENCHMARK_PASSES                20
+
+typedef struct {
+    bool used;
+    supervisor_user_id_t user;
+    job_timeout_cb_t on_timeout;
+    void *cb_arg;
+
+    // Jobs by wake time; heap[0] runs next
+    job_t *heap[JOBRUNNER_MAX_JOBS];
+    int heap_len;
+
+    job_t *volatile current;        // Job whose step is running
+    volatile int64_t step_start_us;
+
+    uint32_t jobs;
+    uint32_t dispatches;
+    uint32_t misses;
+    uint32_t abandoned;
+    uint64_t dispatch_cycles_sum;
+    uint32_t dispatch_max_cycles;
+    hal_spinlock_t lock;
+} runner_t;
+
+static job_t s_jobs[JOBRUNNER_MAX_JOBS];
+static runner_t s_runners[JOBRUNNER_MAX_RUNNERS];
+static hal_spinlock_t s_pool_lock = HAL_SPINLOCK_INIT;
+
+// Only driven by jobrunner_benchmark(), never by a task
+static runner_t s_bench_runner;
+
+//---------------------------------------------------------------------
+// Placeholder step marking a pool slot taken while it is set up
+//---------------------------------------------------------------------
+static job_status_t reserved_job(job_t *job, void *arg)
+{
+    (void)job;
+    (void)arg;
+    return JOB_DONE;
+}
+
+//---------------------------------------------------------------------
+// Min-heap on wake_us (call under the runner's lock)
+//---------------------------------------------------------------------
+static void heap_push(runner_t *r, job_t *job)
+{
+    int i = r->heap_len++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (r->heap[parent]->wake_us <= job->wake_us) {
+            break;
+        }
+        r->heap[i] = r->heap[parent];
+        i = parent;
+    }
+    r->heap[i] = job;
+}
+
+static job_t *heap_pop(runner_t *r)
+{
+    job_t *top = r->heap[0];
+    job_t *last = r->heap[--r->heap_len];
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= r->heap_len) {
+            break;
+        }
+        if (child + 1 < r->heap_len && r->heap[child + 1]->wake_us < r->heap[child]->wake_us) {
+            child++;
+        }
+        if (last->wake_us <= r->heap[child]->wake_us) {
+            break;
+        }
+        r->heap[i] = r->heap[child];
+        i = child;
+    }
+    if (r->heap_len > 0) {
+        r->heap[i] = last;
+    }
+    return top;
+}
+
+//---------------------------------------------------------------------
+// Job pool
+//---------------------------------------------------------------------
+static job_t *alloc_job(void)
+{
+    job_t *job = NULL;
+    hal_enter_critical(&s_pool_lock);
+    for (int i = 0; i < JOBRUNNER_MAX_JOBS; i++) {
+        if (s_jobs[i].fn == NULL) {
+            job = &s_jobs[i];
+            // Claim the slot before leaving the lock; no runner scans it
+            // until init_job() assigns one
+            memset(job, 0, sizeof(*job));
+            job->runner = UINT8_MAX;
+            job->fn = reserved_job;
+            break;
+        }
+    }
+    hal_exit_critical(&s_pool_lock);
+    return job;
+}
+
+static void free_job(job_t *job)
+{
+    hal_enter_critical(&s_pool_lock);
+    job->fn = NULL;
+    hal_exit_critical(&s_pool_lock);
+}
+
+static void init_job(job_t *job, int runner, const char *name, job_fn_t fn, void *arg,
+                     uint32_t deadline_ms, int64_t now)
+{
+    job->name = name;
+    job->arg = arg;
+    job->deadline_ms = deadline_ms;
+    job->wake_us = now;
+    job->last_feed_us = now;
+    job->fn = fn;
+    job->runner = (uint8_t)runner;
+}
+
+//---------------------------------------------------------------------
+// Run every job due at now, one step each
+//---------------------------------------------------------------------
+static void run_ready(runner_t *r, int64_t now)
+{
+    while (1) {
+        uint32_t start = hal_cycles();
+        hal_enter_critical(&r->lock);
+        if (r->heap_len == 0 || r->heap[0]->wake_us > now) {
+            hal_exit_critical(&r->lock);
+            break;
+        }
+        job_t *job = heap_pop(r);
+        r->step_start_us = now;
+        r->current = job;
+        hal_exit_critical(&r->lock);
+
+        job->now_us = now;
+        uint32_t step_start = hal_cycles();
+        job_status_t status = job->fn(job, job->arg);
+        uint32_t step_end = hal_cycles();
+
+        job->steps++;
+        uint32_t step_cycles = step_end - step_start;
+        if (step_cycles > job->max_step_us * hal_cycles_per_us()) {
+            job->max_step_us = step_cycles / hal_cycles_per_us();
+        }
+
+        hal_enter_critical(&r->lock);
+        r->current = NULL;
+        if (status == JOB_WAITING) {
+            heap_push(r, job);
+        } else {
+            r->jobs--;
+        }
+        uint32_t cycles = (hal_cycles() - start) - step_cycles;
+        r->dispatches++;
+        r->dispatch_cycles_sum += cycles;
+        if (cycles > r->dispatch_max_cycles) {
+            r->dispatch_max_cycles = cycles;
+        }
+        hal_exit_critical(&r->lock);
+
+        if (status == JOB_DONE) {
+            free_job(job);
+        }
+    }
+}
+
+//---------------------------------------------------------------------
+// Report jobs that have not fed within their deadline (runner task only)
+//---------------------------------------------------------------------
+static void scan_deadlines(runner_t *r, int index, int64_t now)
+{
+    for (int i = 0; i < JOBRUNNER_MAX_JOBS; i++) {
+        job_t *job = &s_jobs[i];
+        if (job->fn == NULL || job->runner != index || job->deadline_ms == 0 || job->timed_out) {
+            continue;
+        }
+        int64_t elapsed_ms = (now - job->last_feed_us) / 1000;
+        if (elapsed_ms <= job->deadline_ms) {
+            continue;
+        }
+        job->timed_out = true;
+        job->misses++;
+        r->misses++;
+        LOGLIMIT_W(TAG, "Job %s missed its %lu ms deadline (%lld ms since its last feed)",
+                   job->name, (unsigned long)job->deadline_ms, (long long)elapsed_ms);
+        if (r->on_timeout != NULL) {
+            r->on_timeout(job, r->cb_arg);
+        }
+    }
+}
+
+//---------------------------------------------------------------------
+// Runner Task - steps due jobs, checks their deadlines and feeds the
+// supervisor on behalf of all of them
+//---------------------------------------------------------------------
+static void runner_task(void *pvParameters)
+{
+    runner_t *r = (runner_t *)pvParameters;
+    int index = r - s_runners;
+
+    // A restarted runner drops the job its predecessor was deleted in;
+    // resuming it would stall the new runner the same way
+    hal_enter_critical(&r->lock);
+    job_t *stuck = r->current;
+    if (stuck != NULL) {
+        r->current = NULL;
+        r->jobs--;
+        r->abandoned++;
+    }
+    hal_exit_critical(&r->lock);
+    if (stuck != NULL) {
+        LOGLIMIT_W(TAG, "Runner %d dropped job %s after a restart", index, stuck->name);
+        free_job(stuck);
+    }
+
+    int64_t next_scan_us = 0;
+    while (1) {
+        int64_t now = hal_time_us();
+        run_ready(r, now);
+
+        // One feed per scan keeps the supervisor's cost independent of
+        // how often jobs step
+        if (now >= next_scan_us) {
+            scan_deadlines(r, index, now);
+            supervisor_feed(r->user);
+            next_scan_us = now + JOBRUNNER_SCAN_MS * 1000;
+        }
+
+        // Sleep until the next job or scan is due; jobrunner_add_job()
+        // wakes the runner early
+        int64_t wake_us = next_scan_us;
+        hal_enter_critical(&r->lock);
+        if (r->heap_len > 0 && r->heap[0]->wake_us < wake_us) {
+            wake_us = r->heap[0]->wake_us;
+        }
+        hal_exit_critical(&r->lock);
+        int64_t wait_us = wake_us - hal_time_us();
+        if (wait_us > 0) {
+            hal_notify_take(wait_us < UINT32_MAX ? (uint32_t)wait_us : UINT32_MAX);
+        }
+    }
+}
+
+//---------------------------------------------------------------------
+// Public API
+//---------------------------------------------------------------------
+esp_err_t jobrunner_start(int runner, const char *name, int core_id, uint32_t priority,
+                          job_timeout_cb_t on_timeout, void *cb_arg)
+{
+    if (runner < 0 || runner >= JOBRUNNER_MAX_RUNNERS || name == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    runner_t *r = &s_runners[runner];
+    if (r->used) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = supervisor_add_user(name, &r->user);
+    if (err != ESP_OK) {
+        return err;
+    }
+    hal_spinlock_init(&r->lock);
+    r->on_timeout = on_timeout;
+    r->cb_arg = cb_arg;
+    r->used = true;
+
+    supervisor_task_desc_t desc = {
+        .entry = runner_task,
+        .task_name = name,
+        .stack_size = JOBRUNNER_STACK_SIZE,
+        .priority = priority,
+        .arg = r,
+        .core_id = core_id,
+    };
+    return supervisor_start_task(r->user, &desc);
+}
+
+esp_err_t jobrunner_add_job(int runner, const char *name, job_fn_t fn, void *arg,
+                            uint32_t deadline_ms, job_t **out_job)
+{
+    if (runner < 0 || runner >= JOBRUNNER_MAX_RUNNERS || name == NULL || fn == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    runner_t *r = &s_runners[runner];
+    if (!r->used) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    job_t *job = alloc_job();
+    if (job == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    init_job(job, runner, name, fn, arg, deadline_ms, hal_time_us());
+
+    hal_enter_critical(&r->lock);
+    heap_push(r, job);
+    r->jobs++;
+    hal_exit_critical(&r->lock);
+
+    hal_task_t task = supervisor_get_task(r->user);
+    if (task != NULL) {
+        hal_notify_give(task);
+    }
+    if (out_job != NULL) {
+        *out_job = job;
+    }
+    return ESP_OK;
+}
+
+void jobrunner_restart_job(job_t *job)
+{
+    if (job == NULL || job->fn == NULL) {
+        return;
+    }
+    // Leaves wake_us alone, which orders the heap; the job starts over
+    // at JOB_BEGIN() on its next step
+    job->pc = 0;
+    job->last_feed_us = hal_time_us();
+    job->timed_out = false;
+}
+
+bool jobrunner_explain_timeout(supervisor_user_id_t id)
+{
+    for (int i = 0; i < JOBRUNNER_MAX_RUNNERS; i++) {
+        runner_t *r = &s_runners[i];
+        if (!r->used || r->user != id) {
+            continue;
+        }
+        hal_enter_critical(&r->lock);
+        job_t *job = r->current;
+        int64_t start_us = r->step_start_us;
+        hal_exit_critical(&r->lock);
+        if (job == NULL) {
+            return false;
+        }
+        LOGLIMIT_W(TAG, "Runner %d is stuck in job %s for %lld ms (resume point line %u)",
+                   i, job->name, (long long)((hal_time_us() - start_us) / 1000), (unsigned)job->pc);
+        return true;
+    }
+    return false;
+}
+
+void jobrunner_get_stats(int runner, jobrunner_stats_t *out)
+{
+    if (runner < 0 || runner >= JOBRUNNER_MAX_RUNNERS || out == NULL) {
+        return;
+    }
+    runner_t *r = &s_runners[runner];
+    hal_enter_critical(&r->lock);
+    out->jobs = r->jobs;
+    out->dispatches = r->dispatches;
+    out->misses = r->misses;
+    out->abandoned = r->abandoned;
+    out->dispatch_max_cycles = r->dispatch_max_cycles;
+    out->dispatch_avg_cycles = r->dispatches ? (uint32_t)(r->dispatch_cycles_sum / r->dispatches) : 0;
+    hal_exit_critical(&r->lock);
+}
+
+void jobrunner_print_report(void)
+{
+    for (int i = 0; i < JOBRUNNER_MAX_RUNNERS; i++) {
+        if (!s_runners[i].used) {
+            continue;
+        }
+        jobrunner_stats_t stats;
+        jobrunner_get_stats(i, &stats);
+        HAL_LOGI(TAG, "Runner %d: %lu jobs, %lu steps, %lu misses, %lu abandoned, dispatch avg %lu max %lu cycles",
+                 i, (unsigned long)stats.jobs, (unsigned long)stats.dispatches, (unsigned long)stats.misses,
+                 (unsigned long)stats.abandoned, (unsigned long)stats.dispatch_avg_cycles, (unsigned long)stats.dispatch_max_cycles);
+    }
+    for (int i = 0; i < JOBRUNNER_MAX_JOBS; i++) {
+        const job_t *job = &s_jobs[i];
+        if (job->fn == NULL || job->misses == 0) {
+            continue;
+        }
+        HAL_LOGI(TAG, "  %-16s runner %u, %lu steps, %lu misses, longest step %lu us",
+                 job->name, (unsigned)job->runner, (unsigned long)job->steps,
+                 (unsigned long)job->misses, (unsigned long)job->max_step_us);
+    }
+}
+
+//---------------------------------------------------------------------
+// Benchmark
+//---------------------------------------------------------------------
+static job_status_t bench_job(job_t *job, void *arg)
+{
+    (void)arg;
+    JOB_BEGIN(job);
+    while (1) {
+        JOB_FEED(job);
+        JOB_EVERY(job, 1);
+    }
+    JOB_END(job);
+}
+
+void jobrunner_benchmark(void)
+{
+    static const int counts[] = { 10, 100, JOBRUNNER_MAX_JOBS };
+    static job_t *bench_jobs[JOBRUNNER_MAX_JOBS];
+    runner_t *r = &s_bench_runner;
+    uint32_t mhz = hal_cycles_per_us();
+
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        memset(r, 0, sizeof(*r));
+        hal_spinlock_init(&r->lock);
+
+        // Jobs come from the shared pool; fewer are timed if it is in use
+        int count = 0;
+        while (count < counts[c]) {
+            job_t *job = alloc_job();
+            if (job == NULL) {
+                break;
+            }
+            init_job(job, JOBRUNNER_MAX_RUNNERS, "bench", bench_job, NULL, 0, 0);
+            heap_push(r, job);
+            bench_jobs[count++] = job;
+        }
+        r->jobs = count;
+
+        int64_t now = 0;
+        uint32_t start = hal_cycles();
+        for (int pass = 0; pass < BENCHMARK_PASSES; pass++) {
+            run_ready(r, now);
+            now += 1000;
+        }
+        uint32_t cycles = hal_cycles() - start;
+
+        for (int i = 0; i < count; i++) {
+            free_job(bench_jobs[i]);
+        }
+
+        uint32_t steps = r->dispatches ? r->dispatches : 1;
+        uint32_t per_step = cycles / steps;
+        uint32_t dispatch = (uint32_t)(r->dispatch_cycles_sum / steps);
+        HAL_LOGI(TAG, "%3d jobs: %lu cycles/step (%lu ns at %lu MHz), %lu of them dispatch, max %lu",
+                 count, (unsigned long)per_step, (unsigned long)(mhz ? per_step * 1000 / mhz : 0),
+                 (unsigned long)mhz, (unsigned long)dispatch, (unsigned long)r->dispatch_max_cycles);
+        HAL_LOGI(TAG, "          %u bytes of RAM vs %u bytes of 2048-byte task stacks",
+                 (unsigned)(count * (sizeof(job_t) + sizeof(job_t *))), (unsigned)(count * 2048));
+    }
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+#include "supervisor.h"
+
+// Jobs across all runners; each costs sizeof(job_t) plus a heap slot
+#define JOBRUNNER_MAX_JOBS              256
+// Runner tasks, e.g. one per core
+#define JOBRUNNER_MAX_RUNNERS           2
+#define JOBRUNNER_STACK_SIZE            3072
+// How often each runner checks the job deadlines
+#define JOBRUNNER_SCAN_MS               10
+// Re-check interval of JOB_WAIT_UNTIL()
+#define JOBRUNNER_POLL_US               1000
+
+typedef enum {
+    JOB_WAITING = 0,                // Run again at wake_us
+    JOB_DONE,                       // Finished, the slot is freed
+} job_status_t;
+
+typedef struct job job_t;
+
+// One step of a job: runs until the next JOB_* wait and returns
+typedef job_status_t (*job_fn_t)(job_t *job, void *arg);
+
+// Called from the runner task when a job misses its deadline
+typedef void (*job_timeout_cb_t)(job_t *job, void *arg);
+
+struct job {
+    job_fn_t fn;
+    void *arg;
+    const char *name;
+    uint16_t pc;                    // Resume point, 0 = start
+    uint8_t runner;
+    bool timed_out;                 // Latched until the next feed
+    int64_t now_us;                 // Time of the current step
+    int64_t wake_us;                // Next step, also the heap key
+    int64_t last_feed_us;
+    uint32_t deadline_ms;           // 0 = unsupervised
+    uint32_t steps;
+    uint32_t misses;
+    uint32_t max_step_us;
+};
+
+//---------------------------------------------------------------------
+// Cooperative job runner
+//
+// Stackless jobs multiplexed on one task per runner, for many small
+// periodic activities that would otherwise each need a FreeRTOS task
+// and its stack. A job is a function resumed where it last waited, in
+// the style of protothreads: JOB_BEGIN() switches on the saved line, and
+// each JOB_* wait records its line and returns to the runner. Locals do
+// not survive a wait; keep state in the object passed as arg.
+//
+//     static job_status_t blink(job_t *job, void *arg)
+//     {
+//         blink_state_t *s = arg;
+//         JOB_BEGIN(job);
+//         while (1) {
+//             s->level = !s->level;
+//             JOB_FEED(job);
+//             JOB_EVERY(job, 500);
+//         }
+//         JOB_END(job);
+//     }
+//
+// Each runner keeps its jobs in a min-heap on wake time, so dispatching
+// a job costs O(log n) whatever the number of jobs. A job with a
+// deadline must call JOB_FEED() at least every deadline_ms; a miss is
+// reported through the timeout callback, which can restart the job from
+// the top with jobrunner_restart_job(). A job that never returns stalls
+// its runner; the runner is a supervisor user, and
+// jobrunner_explain_timeout() names the job it is stuck in. A restarted
+// runner drops that job and counts it as abandoned.
+//---------------------------------------------------------------------
+#define JOB_BEGIN(job)                  switch ((job)->pc) { case 0:
+
+#define JOB_END(job)                    } (job)->pc = 0; return JOB_DONE
+
+// Let the runner's other jobs run, then continue
+#define JOB_YIELD(job)                                                  \
+    do {                                                                \
+        (job)->pc = __LINE__;                                           \
+        (job)->wake_us = (job)->now_us + 1;                             \
+        return JOB_WAITING;                                             \
+        case __LINE__:;                                                 \
+    } while (0)
+
+// Continue ms after this step
+#define JOB_SLEEP(job, ms)                                              \
+    do {                                                                \
+        (job)->pc = __LINE__;                                           \
+        (job)->wake_us = (job)->now_us + (int64_t)(ms) * 1000;          \
+        return JOB_WAITING;                                             \
+        case __LINE__:;                                                 \
+    } while (0)
+
+// Continue ms after the previous release, without drift; a job running
+// late is released right away rather than catching up
+#define JOB_EVERY(job, ms)                                              \
+    do {                                                                \
+        (job)->pc = __LINE__;                                           \
+        (job)->wake_us += (int64_t)(ms) * 1000;                         \
+        if ((job)->wake_us < (job)->now_us) {                           \
+            (job)->wake_us = (job)->now_us;                             \
+        }                                                               \
+        return JOB_WAITING;                                             \
+        case __LINE__:;                                                 \
+    } while (0)
+
+// Poll cond every JOBRUNNER_POLL_US until it holds
+#define JOB_WAIT_UNTIL(job, cond)                                       \
+    do {                                                                \
+        (job)->pc = __LINE__;                                           \
+        case __LINE__:                                                  \
+        if (!(cond)) {                                                  \
+            (job)->wake_us = (job)->now_us + JOBRUNNER_POLL_US;         \
+            return JOB_WAITING;                                         \
+        }                                                               \
+    } while (0)
+
+// Heartbeat of the job itself
+#define JOB_FEED(job)                                                   \
+    do {                                                                \
+        (job)->last_feed_us = (job)->now_us;                            \
+        (job)->timed_out = false;                                       \
+    } while (0)
+
+typedef struct {
+    uint32_t jobs;
+    uint32_t dispatches;
+    uint32_t misses;
+    uint32_t abandoned;             // Dropped after their runner restarted in them
+    uint32_t dispatch_max_cycles;   // Heap pop and push around one step
+    uint32_t dispatch_avg_cycles;
+} jobrunner_stats_t;
+
+// Create a runner task pinned to core_id and register it with the
+// supervisor as user name
+esp_err_t jobrunner_start(int runner, const char *name, int core_id, uint32_t priority,
+                          job_timeout_cb_t on_timeout, void *cb_arg);
+
+// Add a job to a runner; it takes its first step right away
+esp_err_t jobrunner_add_job(int runner, const char *name, job_fn_t fn, void *arg,
+                            uint32_t deadline_ms, job_t **out_job);
+
+// Run the job from JOB_BEGIN() again on its next step and re-arm its
+// deadline. Call from the timeout callback, i.e. on the job's runner.
+void jobrunner_restart_job(job_t *job);
+
+// If the user is a runner stuck inside a job step, log the job. Returns
+// true if so.
+bool jobrunner_explain_timeout(supervisor_user_id_t id);
+
+void jobrunner_get_stats(int runner, jobrunner_stats_t *out);
+
+void jobrunner_print_report(void);
+
+// Time the dispatch of 10, 100 and JOBRUNNER_MAX_JOBS trivial jobs on a
+// private runner and log the cost per step and the RAM used per job
+void jobrunner_benchmark(void);
@@ -0,0 +1,378 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lockmon.h"
+
+static const char *TAG = "LockMon";
+
+// Waiter table: open addressing on the task handle, twice the capacity
+#define WAITER_SLOTS                    (2 * LOCKMON_MAX_WAITERS)
+
+typedef struct {
+    TaskHandle_t task;              // NULL = free slot
+    lockmon_mutex_t *waiting_on;
+} waiter_t;
+
+// Last priority inversion suffered by each supervised user
+typedef struct {
+    const lockmon_mutex_t *mutex;
+    TaskHandle_t owner;
+    UBaseType_t owner_priority;
+    int64_t start_us;
+    int64_t end_us;                 // 0 while the user is still blocked
+} inversion_t;
+
+static waiter_t s_waiters[WAITER_SLOTS];
+static inversion_t s_inversions[SUPERVISOR_MAX_USERS];
+static int s_waiter_count;
+static lockmon_mutex_t *s_mutexes[LOCKMON_MAX_MUTEXES];
+static lockmon_deadlock_cb_t s_on_deadlock;
+static void *s_cb_arg;
+static lockmon_deadlock_t s_last_deadlock;
+static uint32_t s_deadlocks;
+static uint32_t s_abandoned;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//---------------------------------------------------------------------
+// Waiter table helpers (call under s_lock)
+//---------------------------------------------------------------------
+static uint32_t waiter_hash(TaskHandle_t task)
+{
+    uint32_t key = (uint32_t)(uintptr_t)task >> 2;
+    return (key * 2654435761u) % WAITER_SLOTS;
+}
+
+static waiter_t *waiter_find(TaskHandle_t task)
+{
+    uint32_t i = waiter_hash(task);
+    for (int n = 0; n < WAITER_SLOTS; n++) {
+        waiter_t *w = &s_waiters[i];
+        if (w->task == task) {
+            return w;
+        }
+        if (w->task == NULL) {
+            return NULL;
+        }
+        i = (i + 1) % WAITER_SLOTS;
+    }
+    return NULL;
+}
+
+static bool waiter_insert(TaskHandle_t task, lockmon_mutex_t *mutex)
+{
+    if (s_waiter_count >= LOCKMON_MAX_WAITERS) {
+        return false;
+    }
+    uint32_t i = waiter_hash(task);
+    while (s_waiters[i].task != NULL && s_waiters[i].task != task) {
+        i = (i + 1) % WAITER_SLOTS;
+    }
+    if (s_waiters[i].task == NULL) {
+        s_waiter_count++;
+    }
+    s_waiters[i].task = task;
+    s_waiters[i].waiting_on = mutex;
+    return true;
+}
+
+static void waiter_remove(TaskHandle_t task)
+{
+    waiter_t *w = waiter_find(task);
+    if (w == NULL) {
+        return;
+    }
+
+    // Backward-shift deletion keeps probe sequences intact
+    uint32_t hole = w - s_waiters;
+    uint32_t i = (hole + 1) % WAITER_SLOTS;
+    while (s_waiters[i].task != NULL) {
+        uint32_t home = waiter_hash(s_waiters[i].task);
+        bool movable = (hole <= i) ? (home <= hole || home > i) : (home <= hole && home > i);
+        if (movable) {
+            s_waiters[hole] = s_waiters[i];
+            hole = i;
+        }
+        i = (i + 1) % WAITER_SLOTS;
+    }
+    s_waiters[hole].task = NULL;
+    s_waiters[hole].waiting_on = NULL;
+    s_waiter_count--;
+}
+
+//---------------------------------------------------------------------
+// Follow owner and wait edges from 'mutex'. Returns true and fills the
+// report if the path leads back to 'self' (call under s_lock).
+//---------------------------------------------------------------------
+static bool find_cycle(TaskHandle_t self, lockmon_mutex_t *mutex, lockmon_deadlock_t *report)
+{
+    int length = 0;
+    TaskHandle_t task = self;
+
+    // A cycle has at most one edge per blocked task plus the new one
+    for (int step = 0; step <= LOCKMON_MAX_WAITERS && mutex != NULL; step++) {
+        if (length < LOCKMON_MAX_CYCLE) {
+            report->tasks[length] = task;
+            report->mutexes[length] = mutex;
+            length++;
+        }
+
+        TaskHandle_t owner = mutex->owner;
+        if (owner == NULL) {
+            return false;
+        }
+        if (owner == self) {
+            report->length = length;
+            return true;
+        }
+
+        waiter_t *w = waiter_find(owner);
+        if (w == NULL) {
+            return false;
+        }
+        task = owner;
+        mutex = w->waiting_on;
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------
+// Account a finished inversion in the mutex histogram (call under s_lock)
+//---------------------------------------------------------------------
+static void record_inversion(lockmon_mutex_t *mutex, uint32_t duration_us)
+{
+    int bucket = duration_us ? 31 - __builtin_clz(duration_us) : 0;
+    if (bucket >= LOCKMON_HIST_BUCKETS) {
+        bucket = LOCKMON_HIST_BUCKETS - 1;
+    }
+    mutex->inversions++;
+    mutex->inversion_hist[bucket]++;
+    if (duration_us > mutex->inversion_max_us) {
+        mutex->inversion_max_us = duration_us;
+    }
+}
+
+//---------------------------------------------------------------------
+// Supervisor restart hook: a deleted task can no longer wait or unlock
+//---------------------------------------------------------------------
+static void on_task_restart(supervisor_user_id_t id, TaskHandle_t old_task, void *arg)
+{
+    (void)arg;
+    int abandoned = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    waiter_remove(old_task);
+    s_inversions[id].mutex = NULL;
+    for (int i = 0; i < LOCKMON_MAX_MUTEXES && s_mutexes[i] != NULL; i++) {
+        if (s_mutexes[i]->owner == old_task) {
+            abandoned++;
+        }
+    }
+    s_abandoned += abandoned;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (abandoned > 0) {
+        ESP_LOGE(TAG, "User %d was restarted while holding %d mutex(es); they stay locked", id, abandoned);
+    }
+}
+
+//---------------------------------------------------------------------
+// Public API
+//---------------------------------------------------------------------
+esp_err_t lockmon_init(lockmon_deadlock_cb_t on_deadlock, void *arg)
+{
+    s_on_deadlock = on_deadlock;
+    s_cb_arg = arg;
+    return supervisor_add_restart_hook(on_task_restart, NULL);
+}
+
+esp_err_t lockmon_mutex_init(lockmon_mutex_t *mutex, const char *name)
+{
+    if (mutex == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(mutex, 0, sizeof(*mutex));
+    mutex->name = name ? name : "?";
+    mutex->handle = xSemaphoreCreateMutexStatic(&mutex->storage);
+    if (mutex->handle == NULL) {
+        return ESP_FAIL;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < LOCKMON_MAX_MUTEXES; i++) {
+        if (s_mutexes[i] == NULL) {
+            s_mutexes[i] = mutex;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t lockmon_lock(lockmon_mutex_t *mutex, TickType_t timeout)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    if (xSemaphoreTake(mutex->handle, 0) == pdTRUE) {
+        mutex->owner = self;
+        return ESP_OK;
+    }
+    if (timeout == 0) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    // About to block. Note whether we wait on a lower-priority owner,
+    // before priority inheritance raises it.
+    TaskHandle_t owner = mutex->owner;
+    UBaseType_t self_priority = uxTaskPriorityGet(NULL);
+    UBaseType_t owner_priority = owner ? uxTaskPriorityGet(owner) : self_priority;
+    bool inverted = owner_priority < self_priority;
+    supervisor_user_id_t user = inverted ? supervisor_find_user_by_task(self) : -1;
+    int64_t start_us = inverted ? esp_timer_get_time() : 0;
+
+    if (user >= 0) {
+        portENTER_CRITICAL(&s_lock);
+        inversion_t *inv = &s_inversions[user];
+        inv->mutex = mutex;
+        inv->owner = owner;
+        inv->owner_priority = owner_priority;
+        inv->start_us = start_us;
+        inv->end_us = 0;
+        portEXIT_CRITICAL(&s_lock);
+    }
+
+    // Add the wait edge and check it against the graph
+    lockmon_deadlock_t report;
+    bool deadlock = false;
+
+    portENTER_CRITICAL(&s_lock);
+    if (waiter_insert(self, mutex)) {
+        deadlock = find_cycle(self, mutex, &report);
+        if (deadlock) {
+            s_deadlocks++;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (deadlock) {
+        report.detect_us = esp_timer_get_time();
+        for (int i = 0; i < report.length; i++) {
+            report.users[i] = supervisor_find_user_by_task(report.tasks[i]);
+        }
+
+        portENTER_CRITICAL(&s_lock);
+        s_last_deadlock = report;
+        portEXIT_CRITICAL(&s_lock);
+
+        for (int i = 0; i < report.length; i++) {
+            const lockmon_mutex_t *held = report.mutexes[(i + report.length - 1) % report.length];
+            ESP_LOGE(TAG, "Deadlock: %s (user %d) holds %s, waits for %s",
+                     pcTaskGetName(report.tasks[i]), report.users[i], held->name, report.mutexes[i]->name);
+        }
+        if (s_on_deadlock != NULL) {
+            s_on_deadlock(&report, s_cb_arg);
+        }
+    }
+
+    BaseType_t taken = xSemaphoreTake(mutex->handle, timeout);
+    int64_t end_us = inverted ? esp_timer_get_time() : 0;
+
+    portENTER_CRITICAL(&s_lock);
+    waiter_remove(self);
+    if (inverted) {
+        record_inversion(mutex, (uint32_t)(end_us - start_us));
+        if (user >= 0 && s_inversions[user].mutex == mutex) {
+            s_inversions[user].end_us = end_us;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (taken != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    mutex->owner = self;
+    return ESP_OK;
+}
+
+void lockmon_unlock(lockmon_mutex_t *mutex)
+{
+    mutex->owner = NULL;
+    xSemaphoreGive(mutex->handle);
+}
+
+bool lockmon_explain_timeout(supervisor_user_id_t id, int64_t window_us)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS) {
+        return false;
+    }
+
+    int64_t now = esp_timer_get_time();
+    inversion_t inv;
+    bool linked = false;
+
+    portENTER_CRITICAL(&s_lock);
+    inv = s_inversions[id];
+    if (inv.mutex != NULL && (inv.end_us == 0 || now - inv.end_us < window_us)) {
+        ((lockmon_mutex_t *)inv.mutex)->linked_timeouts++;
+        linked = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!linked) {
+        return false;
+    }
+    if (inv.end_us == 0) {
+        ESP_LOGW(TAG, "User %d is blocked on %s held by lower-priority %s (prio %u) for %lld ms",
+                 id, inv.mutex->name, pcTaskGetName(inv.owner), (unsigned)inv.owner_priority,
+                 (long long)((now - inv.start_us) / 1000));
+    } else {
+        ESP_LOGW(TAG, "User %d waited %lld ms on %s held by lower-priority %s (prio %u), %lld ms before the timeout",
+                 id, (long long)((inv.end_us - inv.start_us) / 1000), inv.mutex->name,
+                 pcTaskGetName(inv.owner), (unsigned)inv.owner_priority,
+                 (long long)((now - inv.end_us) / 1000));
+    }
+    return true;
+}
+
+esp_err_t lockmon_get_last_deadlock(lockmon_deadlock_t *out)
+{
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&s_lock);
+    if (s_deadlocks > 0) {
+        *out = s_last_deadlock;
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+void lockmon_print_report(void)
+{
+    ESP_LOGI(TAG, "Lock report: %lu deadlocks, %lu mutexes abandoned by restarts",
+             (unsigned long)s_deadlocks, (unsigned long)s_abandoned);
+
+    lockmon_deadlock_t report;
+    if (lockmon_get_last_deadlock(&report) == ESP_OK) {
+        for (int i = 0; i < report.length; i++) {
+            ESP_LOGI(TAG, "  user %d waits for %s", report.users[i], report.mutexes[i]->name);
+        }
+    }
+
+    for (int i = 0; i < LOCKMON_MAX_MUTEXES && s_mutexes[i] != NULL; i++) {
+        const lockmon_mutex_t *mutex = s_mutexes[i];
+        if (mutex->inversions == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "  %s: %lu inversions, max %lu us, %lu linked to timeouts",
+                 mutex->name, (unsigned long)mutex->inversions,
+                 (unsigned long)mutex->inversion_max_us, (unsigned long)mutex->linked_timeouts);
+        for (int b = 0; b < LOCKMON_HIST_BUCKETS; b++) {
+            if (mutex->inversion_hist[b] != 0) {
+                ESP_LOGI(TAG, "    >= %8lu us: %lu", (unsigned long)(b ? 1ul << b : 0),
+                         (unsigned long)mutex->inversion_hist[b]);
+            }
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "supervisor.h"
+
+// Tasks that can be blocked in lockmon_lock() at the same time
+#define LOCKMON_MAX_WAITERS             16
+// Mutexes tracked for reporting
+#define LOCKMON_MAX_MUTEXES             16
+// Longest wait-for cycle recorded in a report
+#define LOCKMON_MAX_CYCLE               8
+// Inversion histogram buckets; bucket i counts waits of [2^i, 2^(i+1)) us,
+// the last one everything longer
+#define LOCKMON_HIST_BUCKETS            20
+
+//---------------------------------------------------------------------
+// Instrumented mutex
+//
+// A FreeRTOS mutex that records its owner, so the lock monitor can keep
+// a wait-for graph: an edge task -> mutex while a task is blocked on it
+// and mutex -> owner while it is held. Create with lockmon_mutex_init()
+// and use lockmon_lock()/lockmon_unlock() instead of xSemaphoreTake/Give.
+//---------------------------------------------------------------------
+typedef struct {
+    SemaphoreHandle_t handle;
+    StaticSemaphore_t storage;
+    const char *name;
+    volatile TaskHandle_t owner;
+
+    // Priority inversions: a task waited on a lower-priority owner
+    uint32_t inversions;
+    uint32_t inversion_max_us;
+    uint32_t inversion_hist[LOCKMON_HIST_BUCKETS];
+    uint32_t linked_timeouts;       // Watchdog timeouts explained by an inversion
+} lockmon_mutex_t;
+
+//---------------------------------------------------------------------
+// Deadlock report. Entry i reads: tasks[i] waits for mutexes[i], which
+// is held by tasks[i + 1] (wrapping around). tasks[0] is the task whose
+// acquire closed the cycle.
+//---------------------------------------------------------------------
+typedef struct {
+    int length;
+    TaskHandle_t tasks[LOCKMON_MAX_CYCLE];
+    const lockmon_mutex_t *mutexes[LOCKMON_MAX_CYCLE];
+    supervisor_user_id_t users[LOCKMON_MAX_CYCLE];     // -1 if unsupervised
+    int64_t detect_us;
+} lockmon_deadlock_t;
+
+// Called from the task whose acquire closed a cycle, right before it blocks
+typedef void (*lockmon_deadlock_cb_t)(const lockmon_deadlock_t *report, void *arg);
+
+// Set the deadlock callback and hook into supervisor task restarts
+esp_err_t lockmon_init(lockmon_deadlock_cb_t on_deadlock, void *arg);
+
+esp_err_t lockmon_mutex_init(lockmon_mutex_t *mutex, const char *name);
+
+// Take the mutex. If the caller has to block, the wait-for graph is
+// checked for a cycle through the new edge first; the cost is one step
+// per edge on the path and nothing on the uncontended path. Returns
+// ESP_ERR_TIMEOUT if the mutex was not taken within timeout.
+esp_err_t lockmon_lock(lockmon_mutex_t *mutex, TickType_t timeout);
+
+void lockmon_unlock(lockmon_mutex_t *mutex);
+
+// Check whether a timeout of a user is tied to a priority inversion: the
+// user is blocked right now on a lower-priority owner, or such a wait
+// ended less than window_us ago. Logs the inversion and returns true if so.
+bool lockmon_explain_timeout(supervisor_user_id_t id, int64_t window_us);
+
+// Copy the most recent deadlock report, ESP_ERR_NOT_FOUND if none
+esp_err_t lockmon_get_last_deadlock(lockmon_deadlock_t *out);
+
+// Log deadlock counters, the last cycle and inversion histograms per mutex
+void lockmon_print_report(void);
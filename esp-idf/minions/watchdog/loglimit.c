@@ -0,0 +1,143 @@
+#include <string.h>
+#include "hal.h"
+#include "loglimit.h"
+
+static const char *TAG = "LogLimit";
+
+_Static_assert((LOGLIMIT_SLOTS & (LOGLIMIT_SLOTS - 1)) == 0, "LOGLIMIT_SLOTS must be a power of two");
+
+typedef struct {
+    const char *fmt;                // Key, NULL when free
+    const char *tag;
+    char level;
+    uint32_t passed;                // Lines logged this window
+    uint32_t suppressed;            // Lines dropped this window
+    int64_t window_start_us;
+} site_t;
+
+static site_t s_sites[LOGLIMIT_SLOTS];
+static loglimit_stats_t s_stats;
+static hal_spinlock_t s_lock = HAL_SPINLOCK_INIT;
+
+static uint32_t hash_site(const char *fmt)
+{
+    uint32_t x = (uint32_t)(uintptr_t)fmt;
+    x ^= x >> 16;
+    x *= 0x45d9f3bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static void log_summary(char level, const char *tag, const char *fmt, uint32_t count)
+{
+    switch (level) {
+    case 'E':
+        HAL_LOGE(tag, "Last message repeated %lu times: \"%s\"", (unsigned long)count, fmt);
+        break;
+    case 'W':
+        HAL_LOGW(tag, "Last message repeated %lu times: \"%s\"", (unsigned long)count, fmt);
+        break;
+    default:
+        HAL_LOGI(tag, "Last message repeated %lu times: \"%s\"", (unsigned long)count, fmt);
+        break;
+    }
+}
+
+bool loglimit_check(char level, const char *tag, const char *fmt)
+{
+    int64_t now = hal_time_us();
+    uint32_t hash = hash_site(fmt);
+    uint32_t repeated = 0;
+    bool allow = true;
+
+    hal_enter_critical(&s_lock);
+    site_t *site = NULL;
+    for (int i = 0; i < LOGLIMIT_PROBES; i++) {
+        site_t *slot = &s_sites[(hash + i) & (LOGLIMIT_SLOTS - 1)];
+        if (slot->fmt == fmt) {
+            site = slot;
+            break;
+        }
+        if (slot->fmt == NULL) {
+            site = slot;
+            site->fmt = fmt;
+            site->tag = tag;
+            site->level = level;
+            site->passed = 0;
+            site->suppressed = 0;
+            site->window_start_us = now;
+            s_stats.sites++;
+            break;
+        }
+    }
+
+    if (site == NULL) {
+        s_stats.untracked++;
+    } else {
+        if (now - site->window_start_us >= (int64_t)LOGLIMIT_WINDOW_MS * 1000) {
+            repeated = site->suppressed;
+            site->passed = 0;
+            site->suppressed = 0;
+            site->window_start_us = now;
+        }
+        if (site->passed < LOGLIMIT_BURST) {
+            site->passed++;
+            s_stats.passed++;
+        } else {
+            site->suppressed++;
+            s_stats.suppressed++;
+            allow = false;
+        }
+        if (repeated != 0) {
+            s_stats.summaries++;
+        }
+    }
+    hal_exit_critical(&s_lock);
+
+    if (repeated != 0) {
+        log_summary(level, tag, fmt, repeated);
+    }
+    return allow;
+}
+
+void loglimit_flush(void)
+{
+    int64_t now = hal_time_us();
+    for (int i = 0; i < LOGLIMIT_SLOTS; i++) {
+        site_t *site = &s_sites[i];
+
+        hal_enter_critical(&s_lock);
+        uint32_t repeated = 0;
+        char level = site->level;
+        const char *tag = site->tag;
+        const char *fmt = site->fmt;
+        if (fmt != NULL && site->suppressed != 0 &&
+            now - site->window_start_us >= (int64_t)LOGLIMIT_WINDOW_MS * 1000) {
+            // The window is over; the next line starts a fresh one
+            repeated = site->suppressed;
+            site->suppressed = 0;
+            s_stats.summaries++;
+        }
+        hal_exit_critical(&s_lock);
+
+        if (repeated != 0) {
+            log_summary(level, tag, fmt, repeated);
+        }
+    }
+}
+
+void loglimit_get_stats(loglimit_stats_t *out)
+{
+    hal_enter_critical(&s_lock);
+    *out = s_stats;
+    hal_exit_critical(&s_lock);
+}
+
+void loglimit_print_report(void)
+{
+    loglimit_stats_t stats;
+    loglimit_get_stats(&stats);
+    HAL_LOGI(TAG, "Log limiter: %lu of %d sites, %lu lines passed, %lu suppressed in %lu summaries, %lu untracked",
+             (unsigned long)stats.sites, LOGLIMIT_SLOTS, (unsigned long)stats.passed,
+             (unsigned long)stats.suppressed, (unsigned long)stats.summaries, (unsigned long)stats.untracked);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+// Call sites tracked at once; a power of two
+#define LOGLIMIT_SLOTS                  64
+// Slots probed from a site's hash before it goes untracked
+#define LOGLIMIT_PROBES                 4
+// Lines a site may log per window; later ones are counted instead
+#define LOGLIMIT_BURST                  2
+#define LOGLIMIT_WINDOW_MS              1000
+
+//---------------------------------------------------------------------
+// Log rate limiting
+//
+// Drop-in wrappers for HAL_LOGE/W/I on lines that repeat during a fault
+// storm. Each call site is keyed by the address of its format string,
+// hashed into a fixed open-addressed table: a lookup is a hash and at
+// most LOGLIMIT_PROBES compares under a spinlock, with nothing
+// allocated. A site logs LOGLIMIT_BURST lines per window; the rest are
+// counted, and "repeated N times" is logged when the site next logs
+// after its window or when loglimit_flush() finds the window over.
+// Arguments of suppressed lines are not evaluated.
+//
+// If the table is full a new site is let through unlimited, counted as
+// untracked in the report.
+//---------------------------------------------------------------------
+
+#define LOGLIMIT_LOG(level, tag, fmt, ...)                              \
+    do {                                                                \
+        if (loglimit_check(#level[0], tag, fmt)) {                      \
+            LOGLIMIT_EMIT_##level(tag, fmt, ##__VA_ARGS__);             \
+        }                                                               \
+    } while (0)
+
+#define LOGLIMIT_E(tag, fmt, ...)       LOGLIMIT_LOG(E, tag, fmt, ##__VA_ARGS__)
+#define LOGLIMIT_W(tag, fmt, ...)       LOGLIMIT_LOG(W, tag, fmt, ##__VA_ARGS__)
+#define LOGLIMIT_I(tag, fmt, ...)       LOGLIMIT_LOG(I, tag, fmt, ##__VA_ARGS__)
+
+#define LOGLIMIT_EMIT_E                 HAL_LOGE
+#define LOGLIMIT_EMIT_W                 HAL_LOGW
+#define LOGLIMIT_EMIT_I                 HAL_LOGI
+
+typedef struct {
+    uint32_t sites;                 // Slots in use
+    uint32_t passed;
+    uint32_t suppressed;
+    uint32_t summaries;             // "repeated N times" lines logged
+    uint32_t untracked;             // Lines let through with the table full
+} loglimit_stats_t;
+
+// True if the line at this call site should be logged now. Logs the
+// summary of the site's last window first if it had suppressed lines.
+bool loglimit_check(char level, const char *tag, const char *fmt);
+
+// Log the summaries of windows that ended without another line from
+// their site; call now and then, e.g. from a recovery loop
+void loglimit_flush(void);
+
+void loglimit_get_stats(loglimit_stats_t *out);
+
+void loglimit_print_report(void);
@@ -0,0 +1,187 @@
+#include <string.h>
+#include "lz.h"
+
+#define MIN_MATCH                       4
+// The format ends every block with at least this many literals...
+#define LAST_LITERALS                   5
+// ...and no match may start closer than this to the end
+#define MATCH_FIND_LIMIT                12
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+//---------------------------------------------------------------------
+// Write a length that did not fit in its 4-bit token field
+//---------------------------------------------------------------------
+static uint8_t *put_length(uint8_t *op, const uint8_t *end, size_t len)
+{
+    while (len >= 255) {
+        if (op >= end) {
+            return NULL;
+        }
+        *op++ = 255;
+        len -= 255;
+    }
+    if (op >= end) {
+        return NULL;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+//---------------------------------------------------------------------
+// Emit one sequence: literals, then a match unless match_len is 0
+//---------------------------------------------------------------------
+static uint8_t *put_sequence(uint8_t *op, const uint8_t *end, const uint8_t *literals, size_t lit_len,
+                             size_t offset, size_t match_len)
+{
+    if (op >= end) {
+        return NULL;
+    }
+    uint8_t *token = op++;
+    size_t match_code = match_len ? match_len - MIN_MATCH : 0;
+    *token = (uint8_t)(((lit_len < 15 ? lit_len : 15) << 4) | (match_code < 15 ? match_code : 15));
+
+    if (lit_len >= 15 && (op = put_length(op, end, lit_len - 15)) == NULL) {
+        return NULL;
+    }
+    if ((size_t)(end - op) < lit_len) {
+        return NULL;
+    }
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+
+    if (match_len == 0) {
+        return op;
+    }
+    if (end - op < 2) {
+        return NULL;
+    }
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    if (match_code >= 15 && (op = put_length(op, end, match_code - 15)) == NULL) {
+        return NULL;
+    }
+    return op;
+}
+
+size_t lz_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_cap,
+                   uint16_t table[LZ_HASH_SIZE])
+{
+    if (len > LZ_MAX_BLOCK) {
+        return 0;
+    }
+
+    const uint8_t *end = dst + dst_cap;
+    uint8_t *op = dst;
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    memset(table, 0, LZ_HASH_SIZE * sizeof(table[0]));
+
+    if (len >= MATCH_FIND_LIMIT) {
+        size_t limit = len - MATCH_FIND_LIMIT;
+        size_t match_end_limit = len - LAST_LITERALS;
+        while (ip < limit) {
+            uint32_t v = read32(src + ip);
+            uint32_t h = hash(v);
+            size_t ref = table[h];
+            table[h] = (uint16_t)ip;
+
+            if (ref >= ip || read32(src + ref) != v) {
+                ip++;
+                continue;
+            }
+
+            size_t match_len = MIN_MATCH;
+            while (ip + match_len < match_end_limit && src[ref + match_len] == src[ip + match_len]) {
+                match_len++;
+            }
+            op = put_sequence(op, end, src + anchor, ip - anchor, ip - ref, match_len);
+            if (op == NULL) {
+                return 0;
+            }
+            ip += match_len;
+            anchor = ip;
+        }
+    }
+
+    op = put_sequence(op, end, src + anchor, len - anchor, 0, 0);
+    return op ? (size_t)(op - dst) : 0;
+}
+
+size_t lz_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_cap)
+{
+    const uint8_t *ip = src;
+    const uint8_t *in_end = src + len;
+    uint8_t *op = dst;
+    uint8_t *out_end = dst + dst_cap;
+
+    while (ip < in_end) {
+        uint8_t token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= in_end) {
+                    return 0;
+                }
+                b = *ip++;
+                lit_len += b;
+            } while (b == 255);
+        }
+        if ((size_t)(in_end - ip) < lit_len || (size_t)(out_end - op) < lit_len) {
+            return 0;
+        }
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        // The last sequence has no match
+        if (ip == in_end) {
+            break;
+        }
+
+        if (in_end - ip < 2) {
+            return 0;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) {
+            return 0;
+        }
+
+        size_t match_len = token & 15;
+        if (match_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= in_end) {
+                    return 0;
+                }
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += MIN_MATCH;
+        if ((size_t)(out_end - op) < match_len) {
+            return 0;
+        }
+        // Byte by byte: the match may overlap its own output
+        const uint8_t *ref = op - offset;
+        for (size_t i = 0; i < match_len; i++) {
+            op[i] = ref[i];
+        }
+        op += match_len;
+    }
+    return (size_t)(op - dst);
+}
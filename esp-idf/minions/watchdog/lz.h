@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Hash table entries used by the compressor
+#define LZ_HASH_BITS                    12
+#define LZ_HASH_SIZE                    (1u << LZ_HASH_BITS)
+// Largest block; offsets and table entries are 16 bits
+#define LZ_MAX_BLOCK                    65535u
+// Worst-case compressed size of an n-byte block
+#define LZ_BOUND(n)                     ((n) + (n) / 255 + 16)
+
+//---------------------------------------------------------------------
+// Block compressor
+//
+// Greedy single-probe compressor that writes the LZ4 block format, so
+// any LZ4 block decoder reads its output. It has no dynamic state beyond
+// the caller's hash table and no dependencies, which keeps it usable in
+// the crash path and in the host tools.
+//---------------------------------------------------------------------
+
+// Compress src into dst. Returns the compressed size, or 0 if it would
+// not fit in dst_cap (store the block uncompressed then).
+size_t lz_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_cap,
+                   uint16_t table[LZ_HASH_SIZE]);
+
+// Decompress a block into dst. Returns the decompressed size, or 0 if
+// the input is malformed or does not fit in dst_cap.
+size_t lz_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_cap);
@@ -0,0 +1,146 @@
+#include <stdbool.h>
+#include <string.h>
+#include "partition_io.h"
+
+static bool in_range(const partition_io_t *part, size_t offset, size_t size)
+{
+    return offset <= part->size && size <= part->size - offset;
+}
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+
+esp_err_t partition_io_open(partition_io_t *part, const char *label, size_t host_size)
+{
+    (void)host_size;
+    if (part == NULL || label == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    part->label = label;
+    part->size = partition->size;
+    part->handle = partition;
+    part->map = NULL;
+    return ESP_OK;
+}
+
+esp_err_t partition_io_erase(partition_io_t *part, size_t offset, size_t size)
+{
+    if (!in_range(part, offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return esp_partition_erase_range((const esp_partition_t *)part->handle, offset, size);
+}
+
+esp_err_t partition_io_write(partition_io_t *part, size_t offset, const void *data, size_t size)
+{
+    if (!in_range(part, offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return esp_partition_write((const esp_partition_t *)part->handle, offset, data, size);
+}
+
+esp_err_t partition_io_read(partition_io_t *part, size_t offset, void *data, size_t size)
+{
+    if (!in_range(part, offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return esp_partition_read((const esp_partition_t *)part->handle, offset, data, size);
+}
+
+esp_err_t partition_io_sync(partition_io_t *part)
+{
+    (void)part;
+    return ESP_OK;
+}
+
+#else // Host build
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+esp_err_t partition_io_open(partition_io_t *part, const char *label, size_t host_size)
+{
+    if (part == NULL || label == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "%s.bin", label);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    struct stat st;
+    bool fresh = fstat(fd, &st) == 0 && st.st_size == 0;
+    size_t size = fresh ? host_size : (size_t)st.st_size;
+    if (size == 0 || (fresh && ftruncate(fd, (off_t)size) != 0)) {
+        close(fd);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (fresh) {
+        // A new file reads as erased flash
+        memset(map, 0xFF, size);
+    }
+
+    part->label = label;
+    part->size = size;
+    part->handle = NULL;
+    part->map = map;
+    return ESP_OK;
+}
+
+esp_err_t partition_io_erase(partition_io_t *part, size_t offset, size_t size)
+{
+    if (!in_range(part, offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (offset % PARTITION_IO_SECTOR_SIZE != 0 || size % PARTITION_IO_SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(part->map + offset, 0xFF, size);
+    return ESP_OK;
+}
+
+esp_err_t partition_io_write(partition_io_t *part, size_t offset, const void *data, size_t size)
+{
+    if (!in_range(part, offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // Programming can only clear bits
+    const uint8_t *src = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        part->map[offset + i] &= src[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t partition_io_read(partition_io_t *part, size_t offset, void *data, size_t size)
+{
+    if (!in_range(part, offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(data, part->map + offset, size);
+    return ESP_OK;
+}
+
+esp_err_t partition_io_sync(partition_io_t *part)
+{
+    return msync(part->map, part->size, MS_SYNC) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+#endif // ESP_PLATFORM
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hal.h"
+
+// Erase granularity; erase offsets and sizes must be multiples of this
+#define PARTITION_IO_SECTOR_SIZE        4096
+
+//---------------------------------------------------------------------
+// Raw flash partition access
+//
+// On the device this wraps a data partition found by label, so the
+// partition table needs an entry such as:
+//
+//   crashdump, data, 0x40, , 64K
+//
+// The host build backs the same calls with a file of the partition's
+// size named <label>.bin, mapped into memory; erase fills it with 0xFF
+// and writes can only clear bits, as on flash.
+//---------------------------------------------------------------------
+typedef struct {
+    const char *label;
+    size_t size;
+    const void *handle;             // esp_partition_t on the device
+    uint8_t *map;                   // Mapped file on the host
+} partition_io_t;
+
+// Open a partition. host_size is the file size used by the host build
+// when the file does not exist yet; the device ignores it.
+esp_err_t partition_io_open(partition_io_t *part, const char *label, size_t host_size);
+
+esp_err_t partition_io_erase(partition_io_t *part, size_t offset, size_t size);
+esp_err_t partition_io_write(partition_io_t *part, size_t offset, const void *data, size_t size);
+esp_err_t partition_io_read(partition_io_t *part, size_t offset, void *data, size_t size);
+
+// Make host writes durable; no-op on the device
+esp_err_t partition_io_sync(partition_io_t *part);
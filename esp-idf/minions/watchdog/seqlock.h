@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+//---------------------------------------------------------------------
+// Sequence lock
+//
+// For data written by one writer at a time and read by anyone: the
+// writer bumps seq to odd, updates, bumps it back to even; a reader
+// copies the data and retries if seq was odd or moved meanwhile.
+// Writers never wait for readers, and readers take no lock, so a reader
+// cannot hold up a worker. Concurrent writers must be serialized by
+// their caller.
+//
+//     uint32_t seq;
+//     do {
+//         seq = seqlock_read_begin(&rec->lock);
+//         copy = rec->data;
+//     } while (seqlock_read_retry(&rec->lock, seq));
+//---------------------------------------------------------------------
+typedef struct {
+    volatile uint32_t seq;
+} seqlock_t;
+
+// Spins on an odd sequence before yielding, for a writer preempted on
+// a host
+#define SEQLOCK_SPIN_LIMIT              100
+
+static inline void seqlock_write_begin(seqlock_t *lock)
+{
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write_end(seqlock_t *lock)
+{
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t seqlock_read_begin(const seqlock_t *lock)
+{
+    uint32_t seq;
+    int spins = 0;
+    while ((seq = __atomic_load_n(&lock->seq, __ATOMIC_ACQUIRE)) & 1) {
+        if (++spins == SEQLOCK_SPIN_LIMIT) {
+            spins = 0;
+            hal_delay_ms(0);
+        }
+    }
+    return seq;
+}
+
+// True if the data read since seqlock_read_begin() may be torn
+static inline bool seqlock_read_retry(const seqlock_t *lock, uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&lock->seq, __ATOMIC_RELAXED) != seq;
+}
@@ -0,0 +1,426 @@
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+#include "shardsup.h"
+#include "loglimit.h"
+
+static const char *TAG = "ShardSup";
+
+// Scans timed per table size in the benchmark
+#define BENCHMARK_SCANS                 1000
+// Feeds per task in each feed benchmark run
+#define BENCHMARK_FEEDS                 100000
+// Benchmark users per table in the feed runs
+#define BENCHMARK_FEED_USERS            4
+
+_Static_assert(SHARDSUP_MAX_USERS <= 32, "Miss masks are 32 bits");
+_Static_assert(SHARDSUP_MAX_SHARDS <= 32, "The check-in word is 32 bits");
+
+shard_table_t shardsup_shards[SHARDSUP_MAX_SHARDS];
+
+static shardsup_config_t s_config;
+static int s_shard_count;
+static bool s_initialized;
+static hal_twdt_user_t s_twdt_user;
+static shardsup_stats_t s_stats;
+
+// Bit per shard whose users were all healthy at its last scan
+static volatile uint32_t s_checkin __attribute__((aligned(SHARDSUP_ALIGN)));
+
+//---------------------------------------------------------------------
+// Heartbeat table
+//---------------------------------------------------------------------
+void shard_table_init(shard_table_t *table, int core)
+{
+    memset(table, 0, sizeof(*table));
+    table->core = core;
+    hal_spinlock_init(&table->lock);
+}
+
+esp_err_t shard_table_add(shard_table_t *table, const char *name, uint32_t timeout_us, int64_t now_us,
+                          int *out_index)
+{
+    if (table == NULL || name == NULL || out_index == NULL || strlen(name) >= SHARDSUP_NAME_LEN ||
+        timeout_us == 0 || timeout_us >= (1u << 31)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int index = -1;
+    hal_enter_critical(&table->lock);
+    for (int i = 0; i < SHARDSUP_MAX_USERS; i++) {
+        if (!table->users[i].used) {
+            shard_user_t *user = &table->users[i];
+            memset(user, 0, sizeof(*user));
+            strcpy(user->name, name);
+            user->timeout_us = timeout_us;
+            user->last_feed = (uint32_t)now_us;
+            user->used = true;
+            if (i >= table->count) {
+                table->count = i + 1;
+            }
+            index = i;
+            break;
+        }
+    }
+    hal_exit_critical(&table->lock);
+
+    if (index < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    *out_index = index;
+    return ESP_OK;
+}
+
+void shard_table_remove(shard_table_t *table, int index)
+{
+    hal_enter_critical(&table->lock);
+    table->users[index].used = false;
+    while (table->count > 0 && !table->users[table->count - 1].used) {
+        table->count--;
+    }
+    hal_exit_critical(&table->lock);
+}
+
+uint32_t HAL_IRAM_ATTR shard_table_scan_part(shard_table_t *table, int64_t now_us, int first, int max)
+{
+    uint32_t start = hal_cycles();
+    uint32_t now = (uint32_t)now_us;
+    uint32_t missed = 0;
+
+    int end = table->count;
+    if (max < end - first) {
+        end = first + max;
+    }
+    for (int i = first; i < end; i++) {
+        shard_user_t *user = &table->users[i];
+        if (!user->used) {
+            continue;
+        }
+        // Wraps with the 32-bit times as long as timeouts stay below 2^31
+        uint32_t elapsed = now - user->last_feed;
+        if (elapsed > user->timeout_us) {
+            if (!user->timed_out) {
+                user->timed_out = true;
+                user->misses++;
+                table->stats.misses++;
+                missed |= 1u << i;
+            }
+        } else if (user->timed_out) {
+            user->timed_out = false;
+        }
+    }
+
+    uint32_t cycles = hal_cycles() - start;
+    table->stats.scans++;
+    table->stats.scan_cycles_sum += cycles;
+    if (cycles > table->stats.scan_max_cycles) {
+        table->stats.scan_max_cycles = cycles;
+    }
+    return missed;
+}
+
+uint32_t shard_table_scan(shard_table_t *table, int64_t now_us)
+{
+    return shard_table_scan_part(table, now_us, 0, SHARDSUP_MAX_USERS);
+}
+
+uint32_t shard_table_unhealthy(const shard_table_t *table)
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < table->count; i++) {
+        if (table->users[i].used && table->users[i].timed_out) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+//---------------------------------------------------------------------
+// Per-core scan, then the check-in to the shared word
+//---------------------------------------------------------------------
+static void shard_task(void *arg)
+{
+    int shard = (int)(intptr_t)arg;
+    shard_table_t *table = &shardsup_shards[shard];
+    uint32_t all = (1u << s_shard_count) - 1;
+    hal_tick_t last_wake = hal_ticks();
+
+    while (1) {
+        hal_delay_until(&last_wake, s_config.scan_period_ms);
+
+        uint32_t missed = shard_table_scan(table, hal_time_us());
+        for (int i = 0; missed != 0; i++, missed >>= 1) {
+            if (!(missed & 1)) {
+                continue;
+            }
+            LOGLIMIT_W(TAG, "Core %d: %s missed its timeout", shard, table->users[i].name);
+            if (s_config.on_timeout != NULL) {
+                s_config.on_timeout(SHARDSUP_USER(shard, i), table->users[i].name, s_config.cb_arg);
+            }
+        }
+
+        if (shard_table_unhealthy(table) != 0) {
+            continue;
+        }
+        uint32_t set = __atomic_or_fetch(&s_checkin, 1u << shard, __ATOMIC_ACQ_REL);
+        __atomic_add_fetch(&s_stats.checkins, 1, __ATOMIC_RELAXED);
+        if (set == all) {
+            // A shard checking in between the OR and this store loses its
+            // bit and checks in again one scan period later
+            __atomic_store_n(&s_checkin, 0, __ATOMIC_RELEASE);
+            hal_twdt_reset_user(s_twdt_user);
+            __atomic_add_fetch(&s_stats.twdt_resets, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+esp_err_t shardsup_init(const shardsup_config_t *config)
+{
+    if (config == NULL || config->scan_period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_config = *config;
+    s_shard_count = hal_num_cores() < SHARDSUP_MAX_SHARDS ? hal_num_cores() : SHARDSUP_MAX_SHARDS;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_checkin = 0;
+    for (int i = 0; i < s_shard_count; i++) {
+        shard_table_init(&shardsup_shards[i], i);
+    }
+
+    esp_err_t err = hal_twdt_add_user("shards", &s_twdt_user);
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (int i = 0; i < s_shard_count; i++) {
+        char name[20];
+        snprintf(name, sizeof(name), "shardsup%d", i);
+        err = hal_task_create(shard_task, name, SHARDSUP_STACK_SIZE, (void *)(intptr_t)i,
+                              s_config.task_priority, i, NULL);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    s_initialized = true;
+
+    HAL_LOGI(TAG, "Sharded supervisor started on %d core%s (scan %lu ms)", s_shard_count,
+             s_shard_count > 1 ? "s" : "", (unsigned long)s_config.scan_period_ms);
+    return ESP_OK;
+}
+
+esp_err_t shardsup_add_user(const char *name, int core, uint32_t timeout_ms, shardsup_user_t *out_user)
+{
+    if (out_user == NULL || core < 0 || core >= SHARDSUP_MAX_SHARDS || timeout_ms >= (1u << 31) / 1000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized || core >= s_shard_count) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int index;
+    esp_err_t err = shard_table_add(&shardsup_shards[core], name, timeout_ms * 1000, hal_time_us(), &index);
+    if (err != ESP_OK) {
+        return err;
+    }
+    *out_user = SHARDSUP_USER(core, index);
+    return ESP_OK;
+}
+
+esp_err_t shardsup_remove_user(shardsup_user_t user)
+{
+    int shard = SHARDSUP_SHARD(user);
+    int index = SHARDSUP_INDEX(user);
+    if (shard < 0 || shard >= s_shard_count || index >= SHARDSUP_MAX_USERS ||
+        !shardsup_shards[shard].users[index].used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    shard_table_remove(&shardsup_shards[shard], index);
+    return ESP_OK;
+}
+
+void shardsup_get_stats(shardsup_stats_t *out)
+{
+    out->twdt_resets = __atomic_load_n(&s_stats.twdt_resets, __ATOMIC_RELAXED);
+    out->checkins = __atomic_load_n(&s_stats.checkins, __ATOMIC_RELAXED);
+}
+
+void shardsup_print_report(void)
+{
+    shardsup_stats_t stats;
+    shardsup_get_stats(&stats);
+    HAL_LOGI(TAG, "Sharded supervisor report (%d shards, %lu check-ins, %lu TWDT resets)",
+             s_shard_count, (unsigned long)stats.checkins, (unsigned long)stats.twdt_resets);
+
+    uint32_t per_us = hal_cycles_per_us();
+    for (int s = 0; s < s_shard_count; s++) {
+        const shard_table_t *table = &shardsup_shards[s];
+        const shard_stats_t *st = &table->stats;
+        int users = 0;
+        for (int i = 0; i < table->count; i++) {
+            users += table->users[i].used;
+        }
+        uint32_t avg = st->scans ? (uint32_t)(st->scan_cycles_sum / st->scans) : 0;
+        HAL_LOGI(TAG, "  core %d: %d users, %lu scans, avg %lu cycles (%.2f us), max %lu, %lu misses, %lu remote feeds",
+                 s, users, (unsigned long)st->scans, (unsigned long)avg, per_us ? (double)avg / per_us : 0.0,
+                 (unsigned long)st->scan_max_cycles, (unsigned long)st->misses,
+                 (unsigned long)st->remote_feeds);
+        for (int i = 0; i < table->count; i++) {
+            const shard_user_t *user = &table->users[i];
+            if (user->used) {
+                HAL_LOGI(TAG, "    %-16s timeout %lu ms, %lu feeds, %lu misses%s", user->name,
+                         (unsigned long)(user->timeout_us / 1000), (unsigned long)user->feeds,
+                         (unsigned long)user->misses, user->timed_out ? ", timed out" : "");
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------
+// Benchmark
+//
+// Feed runs put one task on each of the first two cores. In the local
+// run each feeds users of its own core's table; in the remote run each
+// feeds the other core's table; in the shared run both feed one table
+// behind one lock, the layout of a single-store supervisor, and every
+// time the lock moves from one core to the other is counted.
+//---------------------------------------------------------------------
+typedef enum {
+    FEED_LOCAL,
+    FEED_REMOTE,
+    FEED_SHARED,
+} feed_mode_t;
+
+typedef struct {
+    feed_mode_t mode;
+    int core;
+    int cores;
+    uint32_t cycles;                // Spent in feeds by this task
+} feed_bench_t;
+
+static shard_table_t s_bench_tables[SHARDSUP_MAX_SHARDS];
+static shard_table_t s_bench_shared;
+static hal_spinlock_t s_bench_lock = HAL_SPINLOCK_INIT;
+static volatile int s_bench_last_core;
+static volatile uint32_t s_bench_handoffs;
+static volatile int s_bench_running;
+static volatile int s_bench_ready;
+
+static void feed_bench_task(void *arg)
+{
+    feed_bench_t *bench = (feed_bench_t *)arg;
+    int core = bench->core;
+    shard_table_t *table = bench->mode == FEED_SHARED ? &s_bench_shared
+                         : bench->mode == FEED_REMOTE ? &s_bench_tables[(core + 1) % bench->cores]
+                         : &s_bench_tables[core];
+    // The shared table holds every task's users, each task its own
+    int base = bench->mode == FEED_SHARED ? core * BENCHMARK_FEED_USERS : 0;
+
+    // Start together so the runs overlap
+    __atomic_add_fetch(&s_bench_ready, 1, __ATOMIC_RELAXED);
+    while (__atomic_load_n(&s_bench_ready, __ATOMIC_RELAXED) < bench->cores) {
+    }
+
+    uint32_t cycles = 0;
+    for (int i = 0; i < BENCHMARK_FEEDS; i++) {
+        int index = base + i % BENCHMARK_FEED_USERS;
+        uint32_t start = hal_cycles();
+        if (bench->mode == FEED_SHARED) {
+            hal_enter_critical(&s_bench_lock);
+            if (s_bench_last_core != core) {
+                s_bench_last_core = core;
+                s_bench_handoffs++;
+            }
+            shard_table_feed(table, index, hal_time_us());
+            hal_exit_critical(&s_bench_lock);
+        } else {
+            shard_table_feed(table, index, hal_time_us());
+        }
+        cycles += hal_cycles() - start;
+    }
+    bench->cycles = cycles;
+
+    __atomic_sub_fetch(&s_bench_running, 1, __ATOMIC_RELEASE);
+    hal_task_delete(NULL);
+}
+
+// Returns the average cycles per feed; remote feeds and lock hand-offs
+// are added to the counters passed in
+static uint32_t feed_bench_run(feed_mode_t mode, int cores, uint32_t *out_remote, uint32_t *out_handoffs)
+{
+    static feed_bench_t bench[SHARDSUP_MAX_SHARDS];
+
+    shard_table_init(&s_bench_shared, -1);
+    for (int c = 0; c < cores; c++) {
+        shard_table_init(&s_bench_tables[c], c);
+    }
+    int64_t now = hal_time_us();
+    for (int c = 0; c < cores; c++) {
+        for (int u = 0; u < BENCHMARK_FEED_USERS; u++) {
+            int index;
+            shard_table_add(&s_bench_tables[c], "bench", 1000000, now, &index);
+            shard_table_add(&s_bench_shared, "bench", 1000000, now, &index);
+        }
+    }
+    s_bench_last_core = -1;
+    s_bench_handoffs = 0;
+    s_bench_ready = 0;
+    s_bench_running = cores;
+
+    for (int c = 0; c < cores; c++) {
+        bench[c] = (feed_bench_t) { .mode = mode, .core = c, .cores = cores };
+        hal_task_create(feed_bench_task, "shard_bench", SHARDSUP_STACK_SIZE, &bench[c], 2, c, NULL);
+    }
+    while (__atomic_load_n(&s_bench_running, __ATOMIC_ACQUIRE) > 0) {
+        hal_delay_ms(1);
+    }
+
+    uint64_t cycles = 0;
+    uint32_t remote = 0;
+    for (int c = 0; c < cores; c++) {
+        cycles += bench[c].cycles;
+        remote += s_bench_tables[c].stats.remote_feeds;
+    }
+    *out_remote = remote;
+    *out_handoffs = s_bench_handoffs;
+    return (uint32_t)(cycles / ((uint64_t)cores * BENCHMARK_FEEDS));
+}
+
+void shardsup_benchmark(void)
+{
+    static const int sizes[] = { 1, 4, 16, SHARDSUP_MAX_USERS };
+    shard_table_t *table = &s_bench_tables[0];
+
+    HAL_LOGI(TAG, "Scan cost per core as users are added to it:");
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        shard_table_init(table, -1);
+        int64_t now = hal_time_us();
+        for (int u = 0; u < sizes[s]; u++) {
+            int index;
+            shard_table_add(table, "bench", 1000000, now, &index);
+        }
+        for (int i = 0; i < BENCHMARK_SCANS; i++) {
+            shard_table_scan(table, now);
+        }
+        uint32_t avg = (uint32_t)(table->stats.scan_cycles_sum / table->stats.scans);
+        HAL_LOGI(TAG, "  %2d users: %lu cycles/scan, %lu cycles/user", sizes[s], (unsigned long)avg,
+                 (unsigned long)(avg / sizes[s]));
+    }
+
+    int cores = hal_num_cores() < SHARDSUP_MAX_SHARDS ? hal_num_cores() : SHARDSUP_MAX_SHARDS;
+    static const char *names[] = { "own core's table", "other core's table", "one locked table" };
+    HAL_LOGI(TAG, "Feed cost, %d core%s feeding %d users each:", cores, cores > 1 ? "s" : "",
+             BENCHMARK_FEED_USERS);
+    for (feed_mode_t mode = FEED_LOCAL; mode <= FEED_SHARED; mode++) {
+        if (mode == FEED_REMOTE && cores < 2) {
+            continue;
+        }
+        uint32_t remote;
+        uint32_t handoffs;
+        uint32_t cycles = feed_bench_run(mode, cores, &remote, &handoffs);
+        HAL_LOGI(TAG, "  %-18s %lu cycles/feed, %lu remote feeds, %lu lock hand-offs", names[mode],
+                 (unsigned long)cycles, (unsigned long)remote, (unsigned long)handoffs);
+    }
+}
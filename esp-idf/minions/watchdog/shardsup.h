@@ -0,0 +1,155 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+// Users per table, one bit each in a miss mask
+#define SHARDSUP_MAX_USERS              32
+// One table and one scanning task per core
+#define SHARDSUP_MAX_SHARDS             2
+#define SHARDSUP_NAME_LEN               16
+#define SHARDSUP_STACK_SIZE             2560
+// Keeps tables, and the heartbeats in them, on separate cache lines
+#define SHARDSUP_ALIGN                  64
+
+//---------------------------------------------------------------------
+// Heartbeat table
+//
+// One shard of the sharded supervisor, usable on its own: times are
+// passed in, so a table can be driven by a scanning task or by a
+// simulation with virtual time. A feed is a plain store of the low 32
+// bits of now into the user's slot, written only by the user; the scan
+// is the only writer of the detection state. Neither takes the lock,
+// which only guards adding and removing users.
+//
+// A table owned by a core (core >= 0) counts feeds made from any other
+// core as remote: each one moves a cache line, or on the ESP32 a bus
+// transaction, across cores. Timeouts must stay below 2^31 us (35 min).
+//---------------------------------------------------------------------
+typedef struct {
+    volatile uint32_t last_feed;    // Low 32 bits of the feed time in us
+    uint32_t feeds;
+    uint32_t timeout_us;
+    bool used;
+    bool timed_out;                 // Latched by the scan until a feed
+    uint32_t misses;
+    char name[SHARDSUP_NAME_LEN];
+} shard_user_t;
+
+typedef struct {
+    uint32_t scans;
+    uint32_t scan_max_cycles;
+    uint64_t scan_cycles_sum;
+    uint32_t misses;
+    volatile uint32_t remote_feeds; // Feeds from another core
+} shard_stats_t;
+
+typedef struct {
+    int core;                       // Owning core, -1 if not tracked
+    int count;                      // Slots in use up to here
+    hal_spinlock_t lock;
+    shard_stats_t stats;
+    shard_user_t users[SHARDSUP_MAX_USERS];
+} __attribute__((aligned(SHARDSUP_ALIGN))) shard_table_t;
+
+void shard_table_init(shard_table_t *table, int core);
+
+// Add a user whose first deadline runs from now_us
+esp_err_t shard_table_add(shard_table_t *table, const char *name, uint32_t timeout_us, int64_t now_us,
+                          int *out_index);
+
+void shard_table_remove(shard_table_t *table, int index);
+
+static inline void shard_table_feed(shard_table_t *table, int index, int64_t now_us)
+{
+    shard_user_t *user = &table->users[index];
+    user->last_feed = (uint32_t)now_us;
+    user->feeds++;
+    if (table->core >= 0 && table->core != hal_core_id()) {
+        __atomic_add_fetch(&table->stats.remote_feeds, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Check every user against its timeout at now_us. Returns the mask of
+// users that newly missed; a user fed again since is cleared.
+uint32_t shard_table_scan(shard_table_t *table, int64_t now_us);
+
+// shard_table_scan() over at most max slots from first, for callers that
+// bound the time of each scan and walk the table over several. Safe to
+// call from an interrupt.
+uint32_t shard_table_scan_part(shard_table_t *table, int64_t now_us, int first, int max);
+
+// Mask of users currently timed out
+uint32_t shard_table_unhealthy(const shard_table_t *table);
+
+//---------------------------------------------------------------------
+// Sharded supervisor
+//
+// One table per core, each scanned every scan_period_ms by a task pinned
+// to that core, so a feed and the scan of it stay on the feeding core.
+// Users are registered on the core their task runs on. The only shared
+// state is one word: a shard whose users are all healthy ORs its bit
+// into it after each scan, and the shard completing the set resets the
+// single TWDT user "shards" and clears the word. That is one atomic per
+// core per scan period crossing cores, whatever the number of users.
+//
+// A miss is reported through on_timeout from the shard's task; while any
+// user of a shard is timed out that shard stops checking in, and the
+// TWDT fires if the miss is not recovered within its own timeout.
+//---------------------------------------------------------------------
+
+// Handle of a user: shard in the high byte, table index in the low one
+typedef int shardsup_user_t;
+
+#define SHARDSUP_USER(shard, index)     (((shard) << 8) | (index))
+#define SHARDSUP_SHARD(user)            ((user) >> 8)
+#define SHARDSUP_INDEX(user)            ((user) & 0xff)
+
+// Called from the shard's task when a user misses its timeout
+typedef void (*shardsup_timeout_cb_t)(shardsup_user_t user, const char *name, void *arg);
+
+typedef struct {
+    uint32_t scan_period_ms;
+    uint32_t task_priority;
+    shardsup_timeout_cb_t on_timeout;
+    void *cb_arg;
+} shardsup_config_t;
+
+#define SHARDSUP_CONFIG_DEFAULT() {     \
+    .scan_period_ms = 20,               \
+    .task_priority = 6,                 \
+    .on_timeout = NULL,                 \
+    .cb_arg = NULL,                     \
+}
+
+typedef struct {
+    uint32_t twdt_resets;           // Times every shard had checked in
+    uint32_t checkins;              // Atomic ORs into the shared word
+} shardsup_stats_t;
+
+// Create one table and scanning task per core and the TWDT user
+esp_err_t shardsup_init(const shardsup_config_t *config);
+
+// Register a user on a core's table; feed it from that core
+esp_err_t shardsup_add_user(const char *name, int core, uint32_t timeout_ms, shardsup_user_t *out_user);
+
+esp_err_t shardsup_remove_user(shardsup_user_t user);
+
+// Tables of the running supervisor, for the inline shardsup_feed()
+extern shard_table_t shardsup_shards[SHARDSUP_MAX_SHARDS];
+
+static inline void shardsup_feed(shardsup_user_t user)
+{
+    shard_table_feed(&shardsup_shards[SHARDSUP_SHARD(user)], SHARDSUP_INDEX(user), hal_time_us());
+}
+
+void shardsup_get_stats(shardsup_stats_t *out);
+
+// Log users, scan cost and cross-core counters per shard
+void shardsup_print_report(void);
+
+// Scan cost as users are added to one core, and the cost of a feed with
+// both cores feeding into their own tables against both feeding into
+// one locked table, with the cross-core lock hand-offs of the latter
+void shardsup_benchmark(void);
@@ -0,0 +1,145 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "snapshot.h"
+
+static const char *TAG = "Snapshot";
+
+// Iterations averaged per benchmark point
+#define BENCHMARK_ROUNDS                20
+
+static snapshot_t s_snapshot;
+static bool s_valid = false;
+static SemaphoreHandle_t s_mutex;
+static StaticSemaphore_t s_mutex_storage;
+
+static const char *s_state_names[] = { "Running", "Ready", "Blocked", "Suspended", "Deleted", "Invalid" };
+
+//---------------------------------------------------------------------
+// Fill the snapshot buffer (call with s_mutex held)
+//---------------------------------------------------------------------
+static void capture_locked(uint32_t trigger_mask)
+{
+    int64_t start = esp_timer_get_time();
+
+    s_snapshot.count = uxTaskGetSystemState(s_snapshot.tasks, SNAPSHOT_MAX_TASKS, &s_snapshot.total_runtime);
+    s_snapshot.timestamp_us = start;
+    s_snapshot.trigger_mask = trigger_mask;
+    s_snapshot.capture_us = (uint32_t)(esp_timer_get_time() - start);
+    s_valid = true;
+}
+
+esp_err_t snapshot_init(void)
+{
+    if (s_mutex == NULL) {
+        s_mutex = xSemaphoreCreateMutexStatic(&s_mutex_storage);
+    }
+    return s_mutex ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t snapshot_capture(uint32_t trigger_mask)
+{
+    if (s_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Do not wait for a slow reader; the state would be stale by then
+    if (xSemaphoreTake(s_mutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (s_valid && now - s_snapshot.timestamp_us < SNAPSHOT_MIN_INTERVAL_MS * 1000) {
+        // Same incident, keep the earlier state and note the extra users
+        s_snapshot.trigger_mask |= trigger_mask;
+    } else {
+        capture_locked(trigger_mask);
+    }
+
+    xSemaphoreGive(s_mutex);
+    return ESP_OK;
+}
+
+void snapshot_print(void)
+{
+    if (s_mutex == NULL || xSemaphoreTake(s_mutex, portMAX_DELAY) != pdTRUE) {
+        return;
+    }
+    if (!s_valid) {
+        xSemaphoreGive(s_mutex);
+        return;
+    }
+
+    uint32_t total = s_snapshot.total_runtime / 100;
+    ESP_LOGI(TAG, "Snapshot at %lld ms for users 0x%02lx: %u tasks, captured in %lu us",
+             (long long)(s_snapshot.timestamp_us / 1000), (unsigned long)s_snapshot.trigger_mask,
+             (unsigned)s_snapshot.count, (unsigned long)s_snapshot.capture_us);
+
+    for (UBaseType_t i = 0; i < s_snapshot.count; i++) {
+        const TaskStatus_t *task = &s_snapshot.tasks[i];
+        int state = task->eCurrentState <= eInvalid ? task->eCurrentState : eInvalid;
+        uint32_t percent = total ? task->ulRunTimeCounter / total : 0;
+        ESP_LOGI(TAG, "  %-16s %-9s prio %2u/%-2u core %2d cpu %3lu%% stack free %5u",
+                 task->pcTaskName, s_state_names[state],
+                 (unsigned)task->uxCurrentPriority, (unsigned)task->uxBasePriority,
+                 task->xCoreID == tskNO_AFFINITY ? -1 : (int)task->xCoreID,
+                 (unsigned long)percent, (unsigned)task->usStackHighWaterMark);
+    }
+    xSemaphoreGive(s_mutex);
+}
+
+//---------------------------------------------------------------------
+// Dummy task for the benchmark, blocks until deleted
+//---------------------------------------------------------------------
+static void dummy_task(void *pvParameters)
+{
+    (void)pvParameters;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+void snapshot_benchmark(void)
+{
+    static const int targets[] = { 10, 50, 100 };
+    static TaskHandle_t dummies[100];
+    int created = 0;
+
+    if (s_mutex == NULL) {
+        return;
+    }
+
+    for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+        // Top the system up to the target number of tasks
+        while ((int)uxTaskGetNumberOfTasks() < targets[t] && created < 100) {
+            if (xTaskCreate(dummy_task, "snap_dummy", configMINIMAL_STACK_SIZE, NULL, 1, &dummies[created]) != pdPASS) {
+                ESP_LOGW(TAG, "Out of memory at %u tasks", (unsigned)uxTaskGetNumberOfTasks());
+                break;
+            }
+            created++;
+        }
+
+        uint64_t sum_us = 0;
+        uint32_t max_us = 0;
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        for (int i = 0; i < BENCHMARK_ROUNDS; i++) {
+            capture_locked(0);
+            sum_us += s_snapshot.capture_us;
+            if (s_snapshot.capture_us > max_us) {
+                max_us = s_snapshot.capture_us;
+            }
+        }
+        s_valid = false;
+        xSemaphoreGive(s_mutex);
+
+        ESP_LOGI(TAG, "Capture with %3u tasks: avg %lu us, max %lu us",
+                 (unsigned)uxTaskGetNumberOfTasks(),
+                 (unsigned long)(sum_us / BENCHMARK_ROUNDS), (unsigned long)max_us);
+    }
+
+    for (int i = 0; i < created; i++) {
+        vTaskDelete(dummies[i]);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+// Tasks a snapshot can hold; each entry costs sizeof(TaskStatus_t)
+#define SNAPSHOT_MAX_TASKS              128
+// Captures closer together than this are merged into the previous one
+#define SNAPSHOT_MIN_INTERVAL_MS        100
+
+//---------------------------------------------------------------------
+// Timeout-time system snapshot
+//
+// The scheduler state at the moment a timeout is noticed, captured with
+// uxTaskGetSystemState() into a static buffer so the capture never
+// allocates. Run-time counters are only filled in with
+// CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS enabled.
+//---------------------------------------------------------------------
+typedef struct {
+    int64_t timestamp_us;
+    uint32_t trigger_mask;          // Supervisor users that caused the capture
+    uint32_t total_runtime;
+    uint32_t capture_us;            // Cost of the capture itself
+    UBaseType_t count;
+    TaskStatus_t tasks[SNAPSHOT_MAX_TASKS];
+} snapshot_t;
+
+esp_err_t snapshot_init(void);
+
+// Capture the scheduler state now. Call from task context as early as
+// possible after a timeout is noticed.
+esp_err_t snapshot_capture(uint32_t trigger_mask);
+
+// Log the latest snapshot
+void snapshot_print(void);
+
+// Measure capture cost with 10, 50 and 100 tasks in the system by adding
+// idle dummy tasks. Needs roughly 100 * (configMINIMAL_STACK_SIZE + TCB)
+// of free heap; stops early and says so if task creation fails.
+void snapshot_benchmark(void);
@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+#include "startprof.h"
+
+static const char *TAG = "Startprof";
+
+typedef enum {
+    NODE_PHASE = 0,
+    NODE_USER,
+} node_kind_t;
+
+typedef struct {
+    char name[STARTPROF_NAME_LEN];
+    node_kind_t kind;
+    supervisor_user_id_t user;
+    uint32_t deps;
+    int core;
+    int64_t start_us;
+    int64_t end_us;                 // 0 while open, or user not fed yet
+} node_t;
+
+static node_t s_nodes[STARTPROF_MAX_NODES];
+static int s_count;
+static hal_spinlock_t s_lock = HAL_SPINLOCK_INIT;
+
+// Report scratch, kept off the caller's stack
+static int64_t s_dur_us[STARTPROF_MAX_NODES];
+static int64_t s_earliest_us[STARTPROF_MAX_NODES];    // Earliest finish
+static int64_t s_latest_us[STARTPROF_MAX_NODES];      // Latest finish
+
+static int add_node(const char *name, node_kind_t kind, uint32_t deps)
+{
+    int index = -1;
+    hal_enter_critical(&s_lock);
+    if (s_count < STARTPROF_MAX_NODES) {
+        index = s_count++;
+    }
+    hal_exit_critical(&s_lock);
+    if (index < 0) {
+        return -1;
+    }
+
+    node_t *node = &s_nodes[index];
+    memset(node, 0, sizeof(*node));
+    strncpy(node->name, name, STARTPROF_NAME_LEN - 1);
+    node->kind = kind;
+    node->user = -1;
+    // Only earlier nodes can be dependencies, which keeps the graph acyclic
+    node->deps = (deps | STARTPROF_DEP(STARTPROF_BOOT)) & (STARTPROF_DEP(index) - 1);
+    node->core = hal_core_id();
+    return index;
+}
+
+//---------------------------------------------------------------------
+// Earliest and latest finish of every node. Nodes are in dependency
+// order by construction, so one pass each way is enough.
+//---------------------------------------------------------------------
+static int64_t schedule(int count)
+{
+    int64_t makespan = 0;
+    for (int i = 0; i < count; i++) {
+        int64_t ready = 0;
+        for (int d = 0; d < i; d++) {
+            if ((s_nodes[i].deps & STARTPROF_DEP(d)) && s_earliest_us[d] > ready) {
+                ready = s_earliest_us[d];
+            }
+        }
+        s_earliest_us[i] = ready + s_dur_us[i];
+        if (s_earliest_us[i] > makespan) {
+            makespan = s_earliest_us[i];
+        }
+    }
+
+    for (int i = count - 1; i >= 0; i--) {
+        int64_t latest = makespan;
+        for (int s = i + 1; s < count; s++) {
+            int64_t start = s_latest_us[s] - s_dur_us[s];
+            if ((s_nodes[s].deps & STARTPROF_DEP(i)) && start < latest) {
+                latest = start;
+            }
+        }
+        s_latest_us[i] = latest;
+    }
+    return makespan;
+}
+
+//---------------------------------------------------------------------
+// Public API
+//---------------------------------------------------------------------
+void startprof_init(void)
+{
+    int64_t now = hal_time_us();
+
+    hal_enter_critical(&s_lock);
+    s_count = 0;
+    hal_exit_critical(&s_lock);
+
+    int boot = add_node("boot", NODE_PHASE, 0);
+    s_nodes[boot].start_us = 0;
+    s_nodes[boot].end_us = now;
+}
+
+startprof_phase_t startprof_begin(const char *name, uint32_t deps)
+{
+    if (name == NULL) {
+        return -1;
+    }
+    int index = add_node(name, NODE_PHASE, deps);
+    if (index >= 0) {
+        s_nodes[index].start_us = hal_time_us();
+    }
+    return index;
+}
+
+void startprof_end(startprof_phase_t phase)
+{
+    if (phase <= STARTPROF_BOOT || phase >= s_count || s_nodes[phase].kind != NODE_PHASE) {
+        return;
+    }
+    s_nodes[phase].end_us = hal_time_us();
+}
+
+esp_err_t startprof_add_user(supervisor_user_id_t id, uint32_t deps)
+{
+    supervisor_user_info_t info;
+    if (supervisor_get_info(id, &info) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char name[STARTPROF_NAME_LEN];
+    snprintf(name, sizeof(name), "feed:%s", info.name);
+    int index = add_node(name, NODE_USER, deps);
+    if (index < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_nodes[index].user = id;
+    return ESP_OK;
+}
+
+void startprof_report(void)
+{
+    int count = s_count;
+    int64_t healthy_us = 0;
+    uint32_t missing = 0;
+
+    // A user's node spans from its last dependency finishing to its
+    // first feed
+    for (int i = 0; i < count; i++) {
+        node_t *node = &s_nodes[i];
+        if (node->kind == NODE_USER) {
+            supervisor_user_info_t info;
+            node->start_us = 0;
+            for (int d = 0; d < i; d++) {
+                if ((node->deps & STARTPROF_DEP(d)) && s_nodes[d].end_us > node->start_us) {
+                    node->start_us = s_nodes[d].end_us;
+                }
+            }
+            node->end_us = 0;
+            if (supervisor_get_info(node->user, &info) == ESP_OK && info.first_feed_us != 0) {
+                node->end_us = info.first_feed_us;
+                if (info.first_feed_us > healthy_us) {
+                    healthy_us = info.first_feed_us;
+                }
+            } else {
+                missing |= STARTPROF_DEP(i);
+            }
+        }
+        s_dur_us[i] = node->end_us > node->start_us ? node->end_us - node->start_us : 0;
+    }
+
+    int64_t critical_us = schedule(count);
+
+    HAL_LOGI(TAG, "Startup: healthy after %.1f ms, critical path %.1f ms",
+             healthy_us / 1000.0, critical_us / 1000.0);
+    HAL_LOGI(TAG, "  %-23s %9s %9s %9s %4s", "phase", "start ms", "dur ms", "slack ms", "core");
+    for (int i = 0; i < count; i++) {
+        const node_t *node = &s_nodes[i];
+        int64_t slack = s_latest_us[i] - s_earliest_us[i];
+        if (missing & STARTPROF_DEP(i)) {
+            HAL_LOGW(TAG, "  %-23s %9.1f %9s", node->name, node->start_us / 1000.0, "no feed");
+            continue;
+        }
+        HAL_LOGI(TAG, "  %-23s %9.1f %9.1f %9.1f %4d%s", node->name, node->start_us / 1000.0,
+                 s_dur_us[i] / 1000.0, slack / 1000.0, node->core, slack == 0 ? "  *" : "");
+    }
+
+    // Walk back from the node finishing last through zero-slack
+    // dependencies ending latest
+    char path[STARTPROF_MAX_NODES * (STARTPROF_NAME_LEN + 3)];
+    int len = 0;
+    int current = -1;
+    for (int i = 0; i < count; i++) {
+        if (s_latest_us[i] == s_earliest_us[i] && s_earliest_us[i] == critical_us) {
+            current = i;
+        }
+    }
+    int chain[STARTPROF_MAX_NODES];
+    int depth = 0;
+    while (current >= 0 && depth < STARTPROF_MAX_NODES) {
+        chain[depth++] = current;
+        int next = -1;
+        for (int d = 0; d < current; d++) {
+            if ((s_nodes[current].deps & STARTPROF_DEP(d)) &&
+                s_earliest_us[d] == s_earliest_us[current] - s_dur_us[current]) {
+                next = d;
+            }
+        }
+        current = next;
+    }
+    for (int i = depth - 1; i >= 0; i--) {
+        len += snprintf(path + len, sizeof(path) - len, "%s%s", s_nodes[chain[i]].name, i ? " > " : "");
+    }
+    HAL_LOGI(TAG, "Critical path: %s", depth ? path : "-");
+
+    // Time spent in phases with slack; these can move to a task on the
+    // other core without delaying the first feeds
+    int64_t parallel_us = 0;
+    int parallel_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (s_latest_us[i] != s_earliest_us[i] && s_nodes[i].kind == NODE_PHASE) {
+            parallel_us += s_dur_us[i];
+            parallel_count++;
+        }
+    }
+    HAL_LOGI(TAG, "Off the critical path: %d phases, %.1f ms", parallel_count, parallel_us / 1000.0);
+}
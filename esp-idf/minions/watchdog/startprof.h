@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include "hal.h"
+#include "supervisor.h"
+
+// Phases and users together; one bit each in a dependency mask
+#define STARTPROF_MAX_NODES             32
+#define STARTPROF_NAME_LEN              24
+
+// Phase id 0 is everything before startprof_init(): ROM and second stage
+// bootloader, esp_timer start-up and the FreeRTOS start-up up to app_main
+#define STARTPROF_BOOT                  0
+
+// Dependency mask bit of a phase
+#define STARTPROF_DEP(phase)            (1u << (phase))
+
+typedef int startprof_phase_t;
+
+//---------------------------------------------------------------------
+// Startup profiler
+//
+// Times each init phase of app_main and each supervised user's first
+// feed, then works out which phases the time to healthy (the last user's
+// first feed) actually hinges on.
+//
+// Each phase names the phases it needs with a dependency mask; every
+// phase implicitly needs STARTPROF_BOOT. A user's first feed needs the
+// phases given to startprof_add_user(), usually the one that created its
+// task. From the measured durations the report computes for every node
+// its earliest finish if each phase started as soon as its dependencies
+// were done, and its slack, how long it could be delayed without moving
+// the end. Nodes with zero slack form the critical path; everything
+// else could run in parallel, e.g. in a task on the other core.
+//
+// Durations are wall time of the calling task, so a phase that creates a
+// higher priority task also contains that task's first run.
+//---------------------------------------------------------------------
+
+// Start profiling; closes the STARTPROF_BOOT phase. Call first in app_main.
+void startprof_init(void);
+
+// Open a phase. Returns its id, or -1 when the table is full.
+startprof_phase_t startprof_begin(const char *name, uint32_t deps);
+
+void startprof_end(startprof_phase_t phase);
+
+// Track the first feed of a user, which needs the phases in deps
+esp_err_t startprof_add_user(supervisor_user_id_t id, uint32_t deps);
+
+// Log the phases, the critical path and the phases with slack. First
+// feeds that have not happened yet are reported as missing.
+void startprof_report(void);
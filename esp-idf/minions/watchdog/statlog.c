@@ -0,0 +1,532 @@
+#include <stddef.h>
+#include <string.h>
+#include "hal.h"
+#include "partition_io.h"
+#include "statlog.h"
+
+static const char *TAG = "Statlog";
+
+#define SECTOR_MAGIC                    0x4c535457u     // "WTSL"
+#define RECORD_MAGIC                    0x5352u
+#define RECORD_ERASED                   0xFFFFu
+#define RECORD_CHECKPOINT               1
+#define RECORD_DELTA                    2
+// Entries in a checkpoint: current users plus restored ones not claimed yet
+#define MAX_ENTRIES                     (2 * SUPERVISOR_MAX_USERS)
+// Sectors of the partition used for the ring
+#define MAX_SECTORS                     64
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t erase_count;
+    uint32_t crc;                   // Of the fields above
+} sector_header_t;
+
+typedef struct {
+    uint16_t magic;
+    uint8_t kind;
+    uint8_t count;                  // statlog_entry_t that follow
+    uint32_t crc;                   // Of kind, count and the entries
+} record_header_t;
+
+_Static_assert(sizeof(sector_header_t) + sizeof(record_header_t) + MAX_ENTRIES * sizeof(statlog_entry_t)
+               <= PARTITION_IO_SECTOR_SIZE, "a checkpoint must fit in one sector");
+_Static_assert(sizeof(statlog_entry_t) % 4 == 0, "records must stay word aligned");
+
+typedef struct {
+    statlog_entry_t entry;
+    bool claimed;                   // Attached to a user by statlog_add_user()
+} restored_t;
+
+static partition_io_t s_part;
+static bool s_ready = false;
+static size_t s_sector_count;
+
+// Log position
+static bool s_have_sector = false;
+static bool s_need_rollover = false;
+static size_t s_active_sector;
+static uint32_t s_max_seq;
+static size_t s_write_offset;       // Absolute offset of the next record
+
+// Live stats, guarded by s_lock
+static statlog_entry_t s_entries[SUPERVISOR_MAX_USERS];
+static bool s_used[SUPERVISOR_MAX_USERS];
+static restored_t s_restored[MAX_ENTRIES];
+static int s_restored_count;
+static uint32_t s_dirty_mask;
+static uint32_t s_pending_events;
+static statlog_stats_t s_stats;
+static uint64_t s_note_cycles_sum;
+static hal_spinlock_t s_lock = HAL_SPINLOCK_INIT;
+
+// Flash side, guarded by s_io_mutex
+static hal_mutex_t s_io_mutex;
+static hal_task_t s_writer;
+static uint8_t s_record[sizeof(record_header_t) + MAX_ENTRIES * sizeof(statlog_entry_t)];
+
+//---------------------------------------------------------------------
+// Helpers
+//---------------------------------------------------------------------
+static uint32_t sector_crc(const sector_header_t *header)
+{
+    return hal_crc32_le(0, (const uint8_t *)header, offsetof(sector_header_t, crc));
+}
+
+static uint32_t record_crc(const record_header_t *header, const void *entries)
+{
+    uint32_t crc = hal_crc32_le(0, &header->kind, 2);
+    return hal_crc32_le(crc, (const uint8_t *)entries, header->count * sizeof(statlog_entry_t));
+}
+
+static size_t sector_start(size_t sector)
+{
+    return sector * PARTITION_IO_SECTOR_SIZE;
+}
+
+static uint32_t hist_bucket(uint32_t mttr_ms)
+{
+    uint32_t bucket = 0;
+    while (mttr_ms > 1 && bucket < STATLOG_HIST_BUCKETS - 1) {
+        mttr_ms >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+//---------------------------------------------------------------------
+// Restore: merge one persisted entry by name (at init, no lock needed)
+//---------------------------------------------------------------------
+static void restore_entry(const statlog_entry_t *entry)
+{
+    for (int i = 0; i < s_restored_count; i++) {
+        if (strncmp(s_restored[i].entry.name, entry->name, SUPERVISOR_NAME_LEN) == 0) {
+            s_restored[i].entry = *entry;
+            return;
+        }
+    }
+    if (s_restored_count < MAX_ENTRIES) {
+        s_restored[s_restored_count].entry = *entry;
+        s_restored[s_restored_count].entry.name[SUPERVISOR_NAME_LEN - 1] = '\0';
+        s_restored_count++;
+    }
+}
+
+//---------------------------------------------------------------------
+// Read and check the record at offset; returns its total size, 0 at the
+// end of the written part and -1 for a torn or corrupted record
+//---------------------------------------------------------------------
+static int read_record(size_t offset, size_t end, record_header_t *header, statlog_entry_t *entries)
+{
+    if (offset + sizeof(*header) > end ||
+        partition_io_read(&s_part, offset, header, sizeof(*header)) != ESP_OK) {
+        return -1;
+    }
+    if (header->magic == RECORD_ERASED && header->kind == 0xFF) {
+        return 0;
+    }
+    size_t size = sizeof(*header) + header->count * sizeof(statlog_entry_t);
+    if (header->magic != RECORD_MAGIC || header->count > MAX_ENTRIES || offset + size > end ||
+        partition_io_read(&s_part, offset + sizeof(*header), entries,
+                          header->count * sizeof(statlog_entry_t)) != ESP_OK ||
+        record_crc(header, entries) != header->crc) {
+        return -1;
+    }
+    return (int)size;
+}
+
+//---------------------------------------------------------------------
+// Replay one sector: its checkpoint, then every delta after it
+//---------------------------------------------------------------------
+static bool replay_sector(size_t sector)
+{
+    static statlog_entry_t entries[MAX_ENTRIES];
+    record_header_t header;
+    size_t offset = sector_start(sector) + sizeof(sector_header_t);
+    size_t end = sector_start(sector) + PARTITION_IO_SECTOR_SIZE;
+
+    int size = read_record(offset, end, &header, entries);
+    if (size <= 0 || header.kind != RECORD_CHECKPOINT) {
+        return false;
+    }
+    s_restored_count = 0;
+    for (;;) {
+        for (int i = 0; i < header.count; i++) {
+            restore_entry(&entries[i]);
+        }
+        offset += size;
+        size = read_record(offset, end, &header, entries);
+        if (size <= 0) {
+            break;
+        }
+    }
+
+    // Bytes after a torn record may be partly programmed; start afresh
+    s_need_rollover = size < 0;
+    s_write_offset = offset;
+    return true;
+}
+
+static void load_log(void)
+{
+    static sector_header_t headers[MAX_SECTORS];
+    bool valid[MAX_SECTORS] = { false };
+    size_t count = s_sector_count;
+
+    for (size_t i = 0; i < count; i++) {
+        if (partition_io_read(&s_part, sector_start(i), &headers[i], sizeof(headers[i])) == ESP_OK &&
+            headers[i].magic == SECTOR_MAGIC && headers[i].crc == sector_crc(&headers[i])) {
+            valid[i] = true;
+            if (headers[i].seq > s_max_seq) {
+                s_max_seq = headers[i].seq;
+            }
+            if (headers[i].erase_count > s_stats.max_erase_count) {
+                s_stats.max_erase_count = headers[i].erase_count;
+            }
+        }
+    }
+
+    // Newest first; a sector whose checkpoint was torn falls back to the
+    // one before it
+    for (;;) {
+        int best = -1;
+        for (size_t i = 0; i < count; i++) {
+            if (valid[i] && (best < 0 || headers[i].seq > headers[best].seq)) {
+                best = (int)i;
+            }
+        }
+        if (best < 0) {
+            return;
+        }
+        if (replay_sector(best)) {
+            s_have_sector = true;
+            s_active_sector = best;
+            if (headers[best].seq != s_max_seq) {
+                s_need_rollover = true;
+            }
+            HAL_LOGI(TAG, "Restored %d users from sector %d (seq %lu)", s_restored_count, best,
+                     (unsigned long)headers[best].seq);
+            return;
+        }
+        valid[best] = false;
+    }
+}
+
+//---------------------------------------------------------------------
+// Writing (call with s_io_mutex held)
+//---------------------------------------------------------------------
+static esp_err_t write_record(uint8_t kind, const statlog_entry_t *entries, int count)
+{
+    record_header_t *header = (record_header_t *)s_record;
+    header->magic = RECORD_MAGIC;
+    header->kind = kind;
+    header->count = (uint8_t)count;
+    memcpy(s_record + sizeof(*header), entries, count * sizeof(statlog_entry_t));
+    header->crc = record_crc(header, s_record + sizeof(*header));
+
+    size_t size = sizeof(*header) + count * sizeof(statlog_entry_t);
+    esp_err_t err = partition_io_write(&s_part, s_write_offset, s_record, size);
+    if (err == ESP_OK) {
+        s_write_offset += size;
+        s_stats.flash_bytes += size;
+        s_stats.records++;
+    }
+    return err;
+}
+
+//---------------------------------------------------------------------
+// Move to the next sector and write a checkpoint of every user there
+//---------------------------------------------------------------------
+static esp_err_t rollover(const statlog_entry_t *all, int count)
+{
+    size_t next = s_have_sector ? (s_active_sector + 1) % s_sector_count : 0;
+
+    // Carry the wear count of the sector being reused
+    sector_header_t old;
+    uint32_t erase_count = 0;
+    if (partition_io_read(&s_part, sector_start(next), &old, sizeof(old)) == ESP_OK &&
+        old.magic == SECTOR_MAGIC && old.crc == sector_crc(&old)) {
+        erase_count = old.erase_count;
+    }
+
+    esp_err_t err = partition_io_erase(&s_part, sector_start(next), PARTITION_IO_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_stats.erases++;
+
+    sector_header_t header = {
+        .magic = SECTOR_MAGIC,
+        .seq = ++s_max_seq,
+        .erase_count = erase_count + 1,
+    };
+    header.crc = sector_crc(&header);
+    err = partition_io_write(&s_part, sector_start(next), &header, sizeof(header));
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_stats.flash_bytes += sizeof(header);
+    if (header.erase_count > s_stats.max_erase_count) {
+        s_stats.max_erase_count = header.erase_count;
+    }
+
+    s_have_sector = true;
+    s_need_rollover = false;
+    s_active_sector = next;
+    s_write_offset = sector_start(next) + sizeof(header);
+
+    err = write_record(RECORD_CHECKPOINT, all, count);
+    if (err == ESP_OK) {
+        s_stats.checkpoints++;
+    }
+    return err;
+}
+
+static esp_err_t flush_locked(void)
+{
+    static statlog_entry_t dirty[SUPERVISOR_MAX_USERS];
+    static statlog_entry_t all[MAX_ENTRIES];
+    int dirty_count = 0;
+    int all_count = 0;
+
+    int64_t start = hal_time_us();
+
+    hal_enter_critical(&s_lock);
+    if (s_dirty_mask == 0) {
+        hal_exit_critical(&s_lock);
+        return ESP_OK;
+    }
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        if (s_used[i]) {
+            all[all_count++] = s_entries[i];
+            if (s_dirty_mask & (1u << i)) {
+                dirty[dirty_count++] = s_entries[i];
+            }
+        }
+    }
+    for (int i = 0; i < s_restored_count && all_count < MAX_ENTRIES; i++) {
+        if (!s_restored[i].claimed) {
+            all[all_count++] = s_restored[i].entry;
+        }
+    }
+    uint32_t dirty_mask = s_dirty_mask;
+    s_dirty_mask = 0;
+    s_pending_events = 0;
+    hal_exit_critical(&s_lock);
+
+    // A checkpoint already holds the changes, so a full sector just
+    // moves on without writing the delta
+    size_t delta_size = sizeof(record_header_t) + dirty_count * sizeof(statlog_entry_t);
+    size_t sector_end = sector_start(s_active_sector) + PARTITION_IO_SECTOR_SIZE;
+    esp_err_t err;
+    if (!s_have_sector || s_need_rollover || s_write_offset + delta_size > sector_end) {
+        err = rollover(all, all_count);
+    } else {
+        err = write_record(RECORD_DELTA, dirty, dirty_count);
+    }
+
+    if (err != ESP_OK) {
+        // Keep the changes for the next attempt
+        hal_enter_critical(&s_lock);
+        s_dirty_mask |= dirty_mask;
+        hal_exit_critical(&s_lock);
+        s_need_rollover = true;
+        HAL_LOGW(TAG, "Flush failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    partition_io_sync(&s_part);
+
+    uint32_t elapsed_us = (uint32_t)(hal_time_us() - start);
+    if (elapsed_us > s_stats.flush_max_us) {
+        s_stats.flush_max_us = elapsed_us;
+    }
+    return ESP_OK;
+}
+
+//---------------------------------------------------------------------
+// Writer Task - batches pending changes into the log
+//---------------------------------------------------------------------
+static void writer_task(void *pvParameters)
+{
+    (void)pvParameters;
+    while (1) {
+        hal_notify_take(STATLOG_FLUSH_MS * 1000);
+        hal_mutex_lock(&s_io_mutex);
+        flush_locked();
+        hal_mutex_unlock(&s_io_mutex);
+    }
+}
+
+//---------------------------------------------------------------------
+// Public API
+//---------------------------------------------------------------------
+esp_err_t statlog_init(void)
+{
+    if (s_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = partition_io_open(&s_part, STATLOG_PARTITION_LABEL, STATLOG_HOST_SIZE);
+    if (err != ESP_OK) {
+        HAL_LOGW(TAG, "No '%s' partition: %s", STATLOG_PARTITION_LABEL, esp_err_to_name(err));
+        return err;
+    }
+    s_sector_count = s_part.size / PARTITION_IO_SECTOR_SIZE;
+    if (s_sector_count > MAX_SECTORS) {
+        s_sector_count = MAX_SECTORS;
+    }
+    if (s_sector_count < 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    load_log();
+
+    hal_mutex_init(&s_io_mutex);
+    err = hal_task_create(writer_task, "statlog", 3072, NULL, 2, HAL_NO_AFFINITY, &s_writer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_ready = true;
+    return ESP_OK;
+}
+
+esp_err_t statlog_add_user(supervisor_user_id_t id)
+{
+    supervisor_user_info_t info;
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || supervisor_get_info(id, &info) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    hal_enter_critical(&s_lock);
+    statlog_entry_t *entry = &s_entries[id];
+    memset(entry, 0, sizeof(*entry));
+    memcpy(entry->name, info.name, SUPERVISOR_NAME_LEN - 1);
+    for (int i = 0; i < s_restored_count; i++) {
+        if (!s_restored[i].claimed && strncmp(s_restored[i].entry.name, entry->name, SUPERVISOR_NAME_LEN) == 0) {
+            *entry = s_restored[i].entry;
+            s_restored[i].claimed = true;
+            break;
+        }
+    }
+    s_used[id] = true;
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+//---------------------------------------------------------------------
+// Account an event; wakes the writer once enough have piled up
+// (call with s_lock held, returns true if the writer should run)
+//---------------------------------------------------------------------
+static bool note_event(supervisor_user_id_t id, uint32_t start_cycles)
+{
+    s_dirty_mask |= (1u << id);
+    s_stats.events++;
+    s_stats.logical_bytes += sizeof(statlog_entry_t);
+    s_pending_events++;
+
+    uint32_t cycles = hal_cycles() - start_cycles;
+    s_note_cycles_sum += cycles;
+    if (cycles > s_stats.note_max_cycles) {
+        s_stats.note_max_cycles = cycles;
+    }
+    return s_pending_events >= STATLOG_FLUSH_EVENTS;
+}
+
+void statlog_note_timeout(supervisor_user_id_t id)
+{
+    uint32_t start = hal_cycles();
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || !s_used[id]) {
+        return;
+    }
+    hal_enter_critical(&s_lock);
+    s_entries[id].timeouts++;
+    bool wake = note_event(id, start);
+    hal_exit_critical(&s_lock);
+
+    if (wake && s_writer != NULL) {
+        hal_notify_give(s_writer);
+    }
+}
+
+void statlog_note_recovered(supervisor_user_id_t id, uint32_t mttr_ms)
+{
+    uint32_t start = hal_cycles();
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || !s_used[id]) {
+        return;
+    }
+    hal_enter_critical(&s_lock);
+    statlog_entry_t *entry = &s_entries[id];
+    entry->recoveries++;
+    entry->mttr_sum_ms += mttr_ms;
+    if (mttr_ms > entry->mttr_max_ms) {
+        entry->mttr_max_ms = mttr_ms;
+    }
+    uint32_t bucket = hist_bucket(mttr_ms);
+    if (entry->mttr_hist[bucket] < UINT16_MAX) {
+        entry->mttr_hist[bucket]++;
+    }
+    bool wake = note_event(id, start);
+    hal_exit_critical(&s_lock);
+
+    if (wake && s_writer != NULL) {
+        hal_notify_give(s_writer);
+    }
+}
+
+esp_err_t statlog_flush(void)
+{
+    if (!s_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    hal_mutex_lock(&s_io_mutex);
+    esp_err_t err = flush_locked();
+    hal_mutex_unlock(&s_io_mutex);
+    return err;
+}
+
+esp_err_t statlog_get(supervisor_user_id_t id, statlog_entry_t *out)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || out == NULL || !s_used[id]) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    hal_enter_critical(&s_lock);
+    *out = s_entries[id];
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+void statlog_get_stats(statlog_stats_t *out)
+{
+    hal_enter_critical(&s_lock);
+    *out = s_stats;
+    out->note_avg_cycles = s_stats.events ? (uint32_t)(s_note_cycles_sum / s_stats.events) : 0;
+    hal_exit_critical(&s_lock);
+}
+
+void statlog_print_report(void)
+{
+    HAL_LOGI(TAG, "Persistent stats report");
+
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        statlog_entry_t entry;
+        if (statlog_get(i, &entry) != ESP_OK) {
+            continue;
+        }
+        uint32_t mttr_avg = entry.recoveries ? entry.mttr_sum_ms / entry.recoveries : 0;
+        HAL_LOGI(TAG, "  %-16s timeouts %lu, recoveries %lu, MTTR avg %lu ms max %lu ms",
+                 entry.name, (unsigned long)entry.timeouts, (unsigned long)entry.recoveries,
+                 (unsigned long)mttr_avg, (unsigned long)entry.mttr_max_ms);
+    }
+
+    statlog_stats_t stats;
+    statlog_get_stats(&stats);
+    // Write amplification against writing one entry per event in place
+    uint32_t wa_x100 = stats.logical_bytes ? (uint32_t)((uint64_t)stats.flash_bytes * 100 / stats.logical_bytes) : 0;
+    HAL_LOGI(TAG, "  %lu events, %lu records (%lu checkpoints), %lu flash bytes, write amplification %lu.%02lu",
+             (unsigned long)stats.events, (unsigned long)stats.records, (unsigned long)stats.checkpoints,
+             (unsigned long)stats.flash_bytes, (unsigned long)(wa_x100 / 100), (unsigned long)(wa_x100 % 100));
+    HAL_LOGI(TAG, "  %lu erases, max erase count %lu, event cost avg %lu max %lu cycles, flush max %lu us",
+             (unsigned long)stats.erases, (unsigned long)stats.max_erase_count,
+             (unsigned long)stats.note_avg_cycles, (unsigned long)stats.note_max_cycles,
+             (unsigned long)stats.flush_max_us);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include "hal.h"
+#include "supervisor.h"
+
+// Raw data partition holding the log, e.g. "wdstats, data, 0x41, , 16K";
+// the host build maps wdstats.bin instead
+#define STATLOG_PARTITION_LABEL         "wdstats"
+#define STATLOG_HOST_SIZE               (4 * 4096)
+// Dirty stats are written at most this often...
+#define STATLOG_FLUSH_MS                60000
+// ...or as soon as this many events are pending
+#define STATLOG_FLUSH_EVENTS            32
+// MTTR histogram buckets; bucket i counts [2^i, 2^(i+1)) ms, the last
+// one everything longer
+#define STATLOG_HIST_BUCKETS            12
+
+//---------------------------------------------------------------------
+// Persistent per-user watchdog statistics
+//
+// Events only update RAM under a spinlock; a background task batches the
+// users that changed into one record appended to a log in a raw flash
+// partition, so the recovery path never waits on flash and each byte
+// of flash is written once per batch rather than once per event.
+//
+// The partition is a ring of sectors. Each sector starts with a header
+// (sequence number, erase count) and a checkpoint record holding every
+// user; delta records with the changed users follow. When a sector fills
+// up, the next one is erased and begins with a fresh checkpoint, which
+// is the compaction: older sectors are never read again. At boot the
+// newest sector with a valid checkpoint is replayed.
+//
+// Users are matched by name, so ids may change between firmware builds.
+//---------------------------------------------------------------------
+typedef struct {
+    char name[SUPERVISOR_NAME_LEN];
+    uint32_t timeouts;
+    uint32_t recoveries;
+    uint32_t mttr_sum_ms;
+    uint32_t mttr_max_ms;
+    uint16_t mttr_hist[STATLOG_HIST_BUCKETS];
+} statlog_entry_t;
+
+typedef struct {
+    uint32_t events;                // Updates from the recovery path
+    uint32_t logical_bytes;         // One entry per event, as an in-place write would need
+    uint32_t flash_bytes;           // Bytes actually programmed
+    uint32_t records;               // Delta and checkpoint records written
+    uint32_t checkpoints;
+    uint32_t erases;
+    uint32_t max_erase_count;       // Highest erase count of any sector
+    uint32_t note_max_cycles;       // Cost of one event on the recovery path
+    uint32_t note_avg_cycles;
+    uint32_t flush_max_us;          // Cost of one batch, in the background task
+} statlog_stats_t;
+
+// Open the partition, replay the log and start the writer task
+esp_err_t statlog_init(void);
+
+// Attach a supervisor user to its persisted entry, creating it if new
+esp_err_t statlog_add_user(supervisor_user_id_t id);
+
+// Recovery path hooks; only touch RAM
+void statlog_note_timeout(supervisor_user_id_t id);
+void statlog_note_recovered(supervisor_user_id_t id, uint32_t mttr_ms);
+
+// Write pending changes now and wait for the write, e.g. before a reset
+esp_err_t statlog_flush(void);
+
+esp_err_t statlog_get(supervisor_user_id_t id, statlog_entry_t *out);
+void statlog_get_stats(statlog_stats_t *out);
+
+// Log lifetime totals per user and the write amplification
+void statlog_print_report(void);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include "supervisor.h"
+
+//---------------------------------------------------------------------
+// Single-store supervision
+//
+// For hot loops where supervisor_feed() (a lock, a timer read and the
+// model update) costs too much. The user id must be a compile-time
+// constant registered with supervisor_add_user_at(); a feed is then one
+// store to supervisor_fed_flags[id], with no call and no lock. The scan
+// task picks the flag up within scan_period_ms and does the rest, so
+// intervals and first feeds are recorded at scan granularity.
+//
+//     #define PUMP_USER 2
+//     supervisor_add_user_at("pump", PUMP_USER);
+//
+//     while (1) {
+//         SUPERVISED_SCOPE(PUMP_USER);    // Feeds when the iteration ends
+//         if (!read_sensor()) {
+//             continue;
+//         }
+//         ...
+//     }
+//
+// SUPERVISED_SCOPE() feeds on every exit from the enclosing block,
+// including break, continue and return, but not on a longjmp.
+//---------------------------------------------------------------------
+
+// Rejects ids that are not constant or out of range at compile time
+#define SUPERVISE_CHECK_ID(id)                                          \
+    _Static_assert((id) >= 0 && (id) < SUPERVISOR_MAX_USERS,            \
+                   "supervised user id out of range")
+
+#define SUPERVISE_FEED(id)                                              \
+    do {                                                                \
+        SUPERVISE_CHECK_ID(id);                                         \
+        supervisor_fed_flags[(id)] = 1;                                 \
+    } while (0)
+
+typedef struct {
+    supervisor_user_id_t id;
+} supervise_scope_t;
+
+static inline __attribute__((always_inline)) void supervise_scope_exit(const supervise_scope_t *scope)
+{
+    supervisor_fed_flags[scope->id] = 1;
+}
+
+#define SUPERVISE_CONCAT_(a, b)         a##b
+#define SUPERVISE_CONCAT(a, b)          SUPERVISE_CONCAT_(a, b)
+
+// Feed user id when the enclosing block is left
+#define SUPERVISED_SCOPE(id)                                            \
+    SUPERVISE_CHECK_ID(id);                                             \
+    __attribute__((cleanup(supervise_scope_exit), unused))              \
+    const supervise_scope_t SUPERVISE_CONCAT(supervise_scope_, __LINE__) = { (id) }
@@ -0,0 +1,556 @@
+#include <math.h>
+#include <string.h>
+#include "hal.h"
+#include "supervisor.h"
+#include "trace.h"
+#include "supstats.h"
+
+static const char *TAG = "Supervisor";
+
+typedef struct {
+    bool used;
+    char name[SUPERVISOR_NAME_LEN];
+    hal_twdt_user_t twdt_handle;
+    supervisor_task_desc_t task_desc;
+    hal_task_t task;
+
+    // Feed interval model
+    int64_t last_feed_us;
+    uint32_t samples;
+    float mean_ms;
+    float var_ms2;
+    uint32_t deadline_ms;
+
+    // Detection state
+    bool timed_out;                 // Latched until the next feed
+    bool rearmed;                   // Recovery action taken, waiting for a feed
+    int64_t detect_us;
+    uint32_t detections;
+    uint32_t premature;
+    uint64_t latency_sum_ms;
+
+    int64_t first_feed_us;
+} supervisor_user_t;
+
+// Modules that keep per-task state (e.g. lock monitoring)
+#define MAX_RESTART_HOOKS               4
+
+static supervisor_config_t s_config;
+static supervisor_user_t s_users[SUPERVISOR_MAX_USERS];
+static uint32_t s_pending_mask;
+static hal_spinlock_t s_lock = HAL_SPINLOCK_INIT;
+static bool s_initialized = false;
+static supervisor_restart_hook_t s_restart_hooks[MAX_RESTART_HOOKS];
+static void *s_restart_hook_args[MAX_RESTART_HOOKS];
+
+// Set by SUPERVISE_FEED(), taken by the scan
+volatile uint32_t supervisor_fed_flags[SUPERVISOR_MAX_USERS];
+
+//---------------------------------------------------------------------
+// Derive a user's deadline from its interval model (call under s_lock)
+//---------------------------------------------------------------------
+static uint32_t compute_deadline_ms(const supervisor_user_t *user)
+{
+    if (!s_config.adaptive || user->samples < s_config.warmup_samples) {
+        return s_config.fixed_timeout_ms;
+    }
+
+    float margin = s_config.k_sigma * sqrtf(user->var_ms2);
+    if (margin < (float)s_config.min_margin_ms) {
+        margin = (float)s_config.min_margin_ms;
+    }
+
+    float deadline = user->mean_ms + margin;
+    if (deadline < (float)s_config.min_timeout_ms) {
+        deadline = (float)s_config.min_timeout_ms;
+    }
+    if (deadline > (float)s_config.max_timeout_ms) {
+        deadline = (float)s_config.max_timeout_ms;
+    }
+    return (uint32_t)deadline;
+}
+
+//---------------------------------------------------------------------
+// Fold one feed interval into the EWMA mean and variance
+//---------------------------------------------------------------------
+static void update_model(supervisor_user_t *user, float interval_ms)
+{
+    if (user->samples == 0) {
+        user->mean_ms = interval_ms;
+        user->var_ms2 = 0.0f;
+    } else {
+        float alpha = s_config.ewma_alpha;
+        float diff = interval_ms - user->mean_ms;
+        user->mean_ms += alpha * diff;
+        user->var_ms2 = (1.0f - alpha) * (user->var_ms2 + alpha * diff * diff);
+    }
+    user->samples++;
+    user->deadline_ms = compute_deadline_ms(user);
+}
+
+//---------------------------------------------------------------------
+// Account a feed at now (call under s_lock). Returns true if it is the
+// first feed after a recovery action.
+//---------------------------------------------------------------------
+static bool record_feed(supervisor_user_t *user, int64_t now)
+{
+    bool recovered = false;
+    // A feed ending a miss is a recovery in the stats, whether or not a
+    // recovery action was taken
+    supstats_note_feed((supervisor_user_id_t)(user - s_users), now, user->last_feed_us,
+                       user->timed_out || user->rearmed ? user->detect_us : 0);
+    float interval_ms = (float)(now - user->last_feed_us) / 1000.0f;
+    if (user->rearmed) {
+        // First feed after a recovery action; the interval covers the
+        // recovery itself and is not a sample of normal behaviour
+        user->rearmed = false;
+        recovered = true;
+    } else if (!user->timed_out) {
+        update_model(user, interval_ms);
+    } else {
+        // A miss the fixed timeout would not have caught was a slow but
+        // healthy interval: count it and let the model learn from it.
+        // Longer gaps are real faults and stay out of the model.
+        if (interval_ms < (float)s_config.fixed_timeout_ms) {
+            user->premature++;
+            update_model(user, interval_ms);
+        }
+    }
+    user->timed_out = false;
+    user->last_feed_us = now;
+    if (user->first_feed_us == 0) {
+        user->first_feed_us = now;
+    }
+    return recovered;
+}
+
+//---------------------------------------------------------------------
+// Mark a user as timed out (call under s_lock). Returns true if this is
+// a new miss.
+//---------------------------------------------------------------------
+static bool latch_timeout(supervisor_user_t *user, int id, int64_t now_us)
+{
+    if (user->timed_out) {
+        return false;
+    }
+    user->timed_out = true;
+    user->detect_us = now_us;
+    user->detections++;
+    if (user->last_feed_us != 0) {
+        user->latency_sum_ms += (uint64_t)((now_us - user->last_feed_us) / 1000);
+    }
+    s_pending_mask |= (1u << id);
+    supstats_note_miss(id, now_us);
+    trace_record(TRACE_EVT_TIMEOUT, (uint32_t)id, 0);
+    return true;
+}
+
+//---------------------------------------------------------------------
+// Supervisor Task - checks every user against its deadline
+//---------------------------------------------------------------------
+static void supervisor_task(void *pvParameters)
+{
+    (void)pvParameters;
+    hal_tick_t last_wake = hal_ticks();
+
+    while (1) {
+        int64_t now = hal_time_us();
+        uint32_t missed = 0;
+        uint32_t fed = 0;
+        uint32_t recovered = 0;
+        int64_t detect_us[SUPERVISOR_MAX_USERS];
+
+        hal_enter_critical(&s_lock);
+        for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+            supervisor_user_t *user = &s_users[i];
+            if (!user->used || user->last_feed_us == 0) {
+                continue;
+            }
+            // Feeds through the single-store path count at scan time
+            if (__atomic_exchange_n(&supervisor_fed_flags[i], 0, __ATOMIC_ACQUIRE) != 0) {
+                detect_us[i] = user->detect_us;
+                if (record_feed(user, now)) {
+                    recovered |= (1u << i);
+                }
+                fed |= (1u << i);
+            }
+            int64_t elapsed_ms = (now - user->last_feed_us) / 1000;
+            if (elapsed_ms > user->deadline_ms && latch_timeout(user, i, now)) {
+                missed |= (1u << i);
+            }
+        }
+        hal_exit_critical(&s_lock);
+
+        for (int i = 0; fed != 0 && i < SUPERVISOR_MAX_USERS; i++) {
+            if (!(fed & (1u << i))) {
+                continue;
+            }
+            trace_record(TRACE_EVT_FEED, (uint32_t)i, 0);
+            hal_twdt_reset_user(s_users[i].twdt_handle);
+            if ((recovered & (1u << i)) && s_config.on_recovered != NULL) {
+                s_config.on_recovered(i, detect_us[i], s_config.cb_arg);
+            }
+        }
+
+        for (int i = 0; missed != 0 && i < SUPERVISOR_MAX_USERS; i++) {
+            if ((missed & (1u << i)) && s_config.on_timeout != NULL) {
+                s_config.on_timeout(i, s_config.cb_arg);
+            }
+        }
+
+        hal_delay_until(&last_wake, s_config.scan_period_ms);
+    }
+}
+
+//---------------------------------------------------------------------
+// Public API
+//---------------------------------------------------------------------
+esp_err_t supervisor_init(const supervisor_config_t *config)
+{
+    if (config == NULL || config->fixed_timeout_ms == 0 || config->scan_period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_config = *config;
+    if (s_config.max_timeout_ms == 0 || s_config.max_timeout_ms > s_config.fixed_timeout_ms) {
+        s_config.max_timeout_ms = s_config.fixed_timeout_ms;
+    }
+    memset(s_users, 0, sizeof(s_users));
+    s_pending_mask = 0;
+
+    esp_err_t err = hal_task_create(supervisor_task, "supervisor", SUPERVISOR_STACK_SIZE, NULL,
+                                    s_config.task_priority, HAL_NO_AFFINITY, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_initialized = true;
+
+    HAL_LOGI(TAG, "Supervisor started in %s mode (fixed timeout %lu ms, scan %lu ms)",
+             s_config.adaptive ? "adaptive" : "fixed",
+             (unsigned long)s_config.fixed_timeout_ms, (unsigned long)s_config.scan_period_ms);
+    return ESP_OK;
+}
+
+//---------------------------------------------------------------------
+// Register a user in slot want_id, or in the first free slot if -1
+//---------------------------------------------------------------------
+static esp_err_t add_user(const char *name, supervisor_user_id_t want_id, supervisor_user_id_t *out_id)
+{
+    if (name == NULL || out_id == NULL || strlen(name) >= SUPERVISOR_NAME_LEN ||
+        want_id < -1 || want_id >= SUPERVISOR_MAX_USERS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    hal_twdt_user_t handle;
+    esp_err_t err = hal_twdt_add_user(name, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    int id = -1;
+    hal_enter_critical(&s_lock);
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        if (!s_users[i].used && (want_id < 0 || i == want_id)) {
+            supervisor_user_t *user = &s_users[i];
+            memset(user, 0, sizeof(*user));
+            user->used = true;
+            strcpy(user->name, name);
+            user->twdt_handle = handle;
+            user->deadline_ms = s_config.fixed_timeout_ms;
+            user->last_feed_us = hal_time_us();
+            supervisor_fed_flags[i] = 0;
+            supstats_reset_user(i, name);
+            id = i;
+            break;
+        }
+    }
+    hal_exit_critical(&s_lock);
+
+    if (id < 0) {
+        hal_twdt_delete_user(handle);
+        return want_id < 0 ? ESP_ERR_NO_MEM : ESP_ERR_INVALID_STATE;
+    }
+    *out_id = id;
+    return ESP_OK;
+}
+
+esp_err_t supervisor_add_user(const char *name, supervisor_user_id_t *out_id)
+{
+    return add_user(name, -1, out_id);
+}
+
+esp_err_t supervisor_add_user_at(const char *name, supervisor_user_id_t id)
+{
+    if (id < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    supervisor_user_id_t out_id;
+    return add_user(name, id, &out_id);
+}
+
+esp_err_t supervisor_restore_model(supervisor_user_id_t id, uint32_t samples, float mean_ms, float sigma_ms)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || !s_users[id].used || mean_ms < 0.0f || sigma_ms < 0.0f) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    hal_enter_critical(&s_lock);
+    supervisor_user_t *user = &s_users[id];
+    user->samples = samples;
+    user->mean_ms = mean_ms;
+    user->var_ms2 = sigma_ms * sigma_ms;
+    user->deadline_ms = compute_deadline_ms(user);
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t supervisor_feed(supervisor_user_id_t id)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || !s_users[id].used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now = hal_time_us();
+    supervisor_user_t *user = &s_users[id];
+
+    hal_enter_critical(&s_lock);
+    int64_t detect_us = user->detect_us;
+    bool recovered = record_feed(user, now);
+    hal_exit_critical(&s_lock);
+    trace_record(TRACE_EVT_FEED, (uint32_t)id, 0);
+
+    if (recovered && s_config.on_recovered != NULL) {
+        s_config.on_recovered(id, detect_us, s_config.cb_arg);
+    }
+    return hal_twdt_reset_user(user->twdt_handle);
+}
+
+esp_err_t supervisor_start_task(supervisor_user_id_t id, const supervisor_task_desc_t *desc)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || !s_users[id].used || desc == NULL || desc->entry == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    supervisor_user_t *user = &s_users[id];
+    if (user->task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    user->task_desc = *desc;
+    hal_task_t task = NULL;
+    esp_err_t err = hal_task_create(desc->entry, desc->task_name, desc->stack_size, desc->arg,
+                                    desc->priority, desc->core_id, &task);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    hal_enter_critical(&s_lock);
+    user->task = task;
+    user->last_feed_us = hal_time_us();
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t supervisor_restart_task(supervisor_user_id_t id)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || !s_users[id].used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    supervisor_user_t *user = &s_users[id];
+    if (user->task == NULL || user->task_desc.entry == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    hal_enter_critical(&s_lock);
+    hal_task_t old = user->task;
+    user->task = NULL;
+    hal_exit_critical(&s_lock);
+    hal_task_delete(old);
+
+    for (int i = 0; i < MAX_RESTART_HOOKS && s_restart_hooks[i] != NULL; i++) {
+        s_restart_hooks[i](id, old, s_restart_hook_args[i]);
+    }
+
+    const supervisor_task_desc_t *desc = &user->task_desc;
+    hal_task_t task = NULL;
+    esp_err_t err = hal_task_create(desc->entry, desc->task_name, desc->stack_size, desc->arg,
+                                    desc->priority, desc->core_id, &task);
+    if (err != ESP_OK) {
+        HAL_LOGE(TAG, "Failed to recreate task %s", desc->task_name);
+        return err;
+    }
+
+    hal_enter_critical(&s_lock);
+    user->task = task;
+    hal_exit_critical(&s_lock);
+    return ESP_OK;
+}
+
+hal_task_t supervisor_get_task(supervisor_user_id_t id)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS) {
+        return NULL;
+    }
+    return s_users[id].task;
+}
+
+supervisor_user_id_t supervisor_find_user_by_task(hal_task_t task)
+{
+    if (task == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        if (s_users[i].used && s_users[i].task == task) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+esp_err_t supervisor_add_restart_hook(supervisor_restart_hook_t hook, void *arg)
+{
+    if (hook == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < MAX_RESTART_HOOKS; i++) {
+        if (s_restart_hooks[i] == NULL) {
+            s_restart_hook_args[i] = arg;
+            s_restart_hooks[i] = hook;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void supervisor_rearm(supervisor_user_id_t id)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || !s_users[id].used) {
+        return;
+    }
+    supervisor_user_t *user = &s_users[id];
+
+    hal_enter_critical(&s_lock);
+    user->timed_out = false;
+    user->rearmed = true;
+    user->last_feed_us = hal_time_us();
+    hal_exit_critical(&s_lock);
+
+    // Give the recovered user a full TWDT period as well
+    hal_twdt_reset_user(user->twdt_handle);
+}
+
+supervisor_user_id_t supervisor_find_user(const char *name)
+{
+    if (name == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        if (s_users[i].used && strcmp(s_users[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void supervisor_report_timeout(supervisor_user_id_t id)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS) {
+        return;
+    }
+    int64_t now = hal_time_us();
+    hal_enter_critical(&s_lock);
+    if (s_users[id].used) {
+        latch_timeout(&s_users[id], id, now);
+    }
+    hal_exit_critical(&s_lock);
+}
+
+uint32_t supervisor_take_timeouts(void)
+{
+    hal_enter_critical(&s_lock);
+    uint32_t mask = s_pending_mask;
+    s_pending_mask = 0;
+    hal_exit_critical(&s_lock);
+    return mask;
+}
+
+uint32_t supervisor_get_unhealthy_mask(void)
+{
+    uint32_t mask = 0;
+    hal_enter_critical(&s_lock);
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        if (s_users[i].used && (s_users[i].timed_out || s_users[i].rearmed)) {
+            mask |= (1u << i);
+        }
+    }
+    hal_exit_critical(&s_lock);
+    return mask;
+}
+
+uint32_t supervisor_get_timed_out_mask(void)
+{
+    uint32_t mask = 0;
+    hal_enter_critical(&s_lock);
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        if (s_users[i].used && s_users[i].timed_out) {
+            mask |= (1u << i);
+        }
+    }
+    hal_exit_critical(&s_lock);
+    return mask;
+}
+
+esp_err_t supervisor_get_info(supervisor_user_id_t id, supervisor_user_info_t *out)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || out == NULL || !s_users[id].used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    hal_enter_critical(&s_lock);
+    const supervisor_user_t *user = &s_users[id];
+    memcpy(out->name, user->name, sizeof(out->name));
+    out->samples = user->samples;
+    out->mean_ms = user->mean_ms;
+    float var = user->var_ms2;
+    out->deadline_ms = user->deadline_ms;
+    out->detections = user->detections;
+    out->premature = user->premature;
+    out->latency_sum_ms = user->latency_sum_ms;
+    out->last_detect_us = user->detect_us;
+    out->first_feed_us = user->first_feed_us;
+    hal_exit_critical(&s_lock);
+
+    out->sigma_ms = sqrtf(var);
+    return ESP_OK;
+}
+
+void supervisor_print_report(void)
+{
+    HAL_LOGI(TAG, "Detection report (%s mode, fixed timeout %lu ms)",
+             s_config.adaptive ? "adaptive" : "fixed", (unsigned long)s_config.fixed_timeout_ms);
+
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        supervisor_user_info_t info;
+        if (supervisor_get_info(i, &info) != ESP_OK) {
+            continue;
+        }
+
+        // The measured latency includes waiting for the next scan, half a
+        // period on average, and so would the fixed timeout's
+        uint32_t latency_ms = info.detections ? (uint32_t)(info.latency_sum_ms / info.detections) : 0;
+        uint32_t fixed_ms = s_config.fixed_timeout_ms + s_config.scan_period_ms / 2;
+        int32_t saved_ms = info.detections ? (int32_t)fixed_ms - (int32_t)latency_ms : 0;
+
+        HAL_LOGI(TAG, "  %-16s interval %.0f +/- %.0f ms, deadline %lu ms (%lu samples)",
+                 info.name, info.mean_ms, info.sigma_ms,
+                 (unsigned long)info.deadline_ms, (unsigned long)info.samples);
+        HAL_LOGI(TAG, "  %-16s detections %lu, avg latency %lu ms vs %lu ms fixed+scan (%ld ms earlier), "
+                 "premature %lu", "", (unsigned long)info.detections, (unsigned long)latency_ms,
+                 (unsigned long)fixed_ms, (long)saved_ms, (unsigned long)info.premature);
+    }
+}
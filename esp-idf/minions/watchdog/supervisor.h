@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+// Maximum number of users tracked by the supervisor (one bit each in a mask)
+#define SUPERVISOR_MAX_USERS            8
+#define SUPERVISOR_NAME_LEN             16
+// Stack of the supervisor task, which runs on_timeout and, for latched
+// feeds, on_recovered; the example app captures a snapshot and a
+// backtrace and logs from them
+#define SUPERVISOR_STACK_SIZE           4096
+
+// Identifier of a supervised user, an index into the supervisor table
+typedef int supervisor_user_id_t;
+
+// Called from the supervisor task when a user misses its deadline
+typedef void (*supervisor_timeout_cb_t)(supervisor_user_id_t id, void *arg);
+
+// Called from the feeding task on the first feed after supervisor_rearm()
+typedef void (*supervisor_recovered_cb_t)(supervisor_user_id_t id, int64_t detect_us, void *arg);
+
+// Called by supervisor_restart_task() after the old task was deleted
+typedef void (*supervisor_restart_hook_t)(supervisor_user_id_t id, hal_task_t old_task, void *arg);
+
+// Everything needed to (re)create a supervised task
+typedef struct {
+    hal_task_fn_t entry;
+    const char *task_name;
+    uint32_t stack_size;
+    uint32_t priority;
+    void *arg;
+    int core_id;                    // HAL_NO_AFFINITY for unpinned
+} supervisor_task_desc_t;
+
+//---------------------------------------------------------------------
+// Supervisor configuration
+//
+// In fixed mode every user gets fixed_timeout_ms. In adaptive mode each
+// user's deadline is learned from its own feed intervals:
+//
+//     deadline = clamp(mean + max(k_sigma * sigma, min_margin_ms),
+//                      min_timeout_ms, max_timeout_ms)
+//
+// where mean and sigma are an EWMA of the interval and its deviation.
+// Until warmup_samples intervals have been seen the fixed timeout is used.
+// The TWDT stays armed at its own timeout as the safety net.
+//
+// Feeds latched with SUPERVISE_FEED() or SUPERVISED_SCOPE() are only
+// timed when the scan picks them up, so the EWMA of such a user sees
+// intervals quantized to scan_period_ms (20 ms by default): a steady
+// 50 ms loop shows up as 40 and 60 ms intervals. The jitter widens
+// sigma and so the deadline; keep scan_period_ms well below the feed
+// intervals of latched users.
+//---------------------------------------------------------------------
+typedef struct {
+    uint32_t fixed_timeout_ms;
+    bool adaptive;
+    float ewma_alpha;               // Weight of the newest interval (0..1)
+    float k_sigma;                  // Deviations above the mean
+    uint32_t min_margin_ms;         // Lower bound on the slack above the mean
+    uint32_t min_timeout_ms;
+    uint32_t max_timeout_ms;        // Keep <= TWDT timeout
+    uint32_t warmup_samples;
+    uint32_t scan_period_ms;        // How often deadlines are checked
+    uint32_t task_priority;
+    supervisor_timeout_cb_t on_timeout;
+    supervisor_recovered_cb_t on_recovered;
+    void *cb_arg;
+} supervisor_config_t;
+
+#define SUPERVISOR_CONFIG_DEFAULT() {   \
+    .fixed_timeout_ms = 5000,           \
+    .adaptive = true,                   \
+    .ewma_alpha = 0.125f,               \
+    .k_sigma = 4.0f,                    \
+    .min_margin_ms = 250,               \
+    .min_timeout_ms = 200,              \
+    .max_timeout_ms = 5000,             \
+    .warmup_samples = 8,                \
+    .scan_period_ms = 20,               \
+    .task_priority = 6,                 \
+    .on_timeout = NULL,                 \
+    .on_recovered = NULL,               \
+    .cb_arg = NULL,                     \
+}
+
+// Per-user view used for reporting
+typedef struct {
+    char name[SUPERVISOR_NAME_LEN];
+    uint32_t samples;               // Intervals folded into the EWMA
+    float mean_ms;
+    float sigma_ms;
+    uint32_t deadline_ms;           // Deadline currently applied
+    uint32_t detections;            // Deadline misses reported
+    uint32_t premature;             // Misses where the user fed before the fixed timeout
+    uint64_t latency_sum_ms;        // Sum of last-feed-to-detection latencies
+    int64_t last_detect_us;         // Time of the most recent detection
+    int64_t first_feed_us;          // Time of the first feed since boot, 0 if none yet
+} supervisor_user_info_t;
+
+// Initialize the supervisor and start its scan task
+esp_err_t supervisor_init(const supervisor_config_t *config);
+
+// Register a user; also registers it with the TWDT under the same name
+esp_err_t supervisor_add_user(const char *name, supervisor_user_id_t *out_id);
+
+// Register a user under a fixed id, e.g. one known at compile time for
+// SUPERVISE_FEED(). Returns ESP_ERR_INVALID_STATE if the slot is taken.
+esp_err_t supervisor_add_user_at(const char *name, supervisor_user_id_t id);
+
+// Create the user's task from its descriptor. The descriptor is copied and
+// kept for supervisor_restart_task().
+esp_err_t supervisor_start_task(supervisor_user_id_t id, const supervisor_task_desc_t *desc);
+
+// Delete the user's task and create it again from its descriptor with a
+// fresh handle. The task must not hold locks it shares with other tasks
+// when it stalls, since deletion does not release them.
+esp_err_t supervisor_restart_task(supervisor_user_id_t id);
+
+// Current task handle of a user, NULL if it has no task
+hal_task_t supervisor_get_task(supervisor_user_id_t id);
+
+// User owning a task, -1 if the task is not supervised
+supervisor_user_id_t supervisor_find_user_by_task(hal_task_t task);
+
+// Let other modules drop state tied to a task the supervisor deletes
+esp_err_t supervisor_add_restart_hook(supervisor_restart_hook_t hook, void *arg);
+
+// Clear the user's timeout and restart its deadline after a recovery
+// action. The next feed is reported through on_recovered.
+void supervisor_rearm(supervisor_user_id_t id);
+
+// Seed a user's interval model, e.g. with one learned before a reset.
+// With enough samples the learned deadline applies right away instead of
+// the fixed timeout during warmup.
+esp_err_t supervisor_restore_model(supervisor_user_id_t id, uint32_t samples, float mean_ms, float sigma_ms);
+
+// Record a heartbeat and reset the user's TWDT entry
+esp_err_t supervisor_feed(supervisor_user_id_t id);
+
+// Per-user flags behind SUPERVISE_FEED() in supervise.h. The scan task
+// takes each set flag as a feed at scan time, with the interval
+// quantization described above, and resets the TWDT entry; on_recovered
+// then runs on the scan task.
+extern volatile uint32_t supervisor_fed_flags[SUPERVISOR_MAX_USERS];
+
+// Look up a user by name, returns -1 if unknown
+supervisor_user_id_t supervisor_find_user(const char *name);
+
+// Report a timeout seen by another detector (e.g. the TWDT). Ignored if the
+// user is already flagged for the current miss.
+void supervisor_report_timeout(supervisor_user_id_t id);
+
+// Return and clear the mask of users that timed out since the last call
+uint32_t supervisor_take_timeouts(void);
+
+// Mask of users currently timed out or re-armed but not yet fed again
+uint32_t supervisor_get_unhealthy_mask(void);
+
+// Mask of users currently timed out: missed a deadline and neither fed
+// nor re-armed since. Re-armed users are left out, so a user that was
+// only re-armed behind a failed dependency does not count as a failure.
+uint32_t supervisor_get_timed_out_mask(void);
+
+esp_err_t supervisor_get_info(supervisor_user_id_t id, supervisor_user_info_t *out);
+
+// Log per-user detection latency in adaptive mode against the fixed timeout
+void supervisor_print_report(void);
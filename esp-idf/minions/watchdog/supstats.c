@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+#include "supstats.h"
+
+static const char *TAG = "SupStats";
+
+// Frame bytes per STATS: log line
+#define LOG_LINE_BYTES                  48
+
+// CBOR major types
+#define CBOR_UINT                       0
+#define CBOR_TEXT                       3
+#define CBOR_ARRAY                      4
+#define CBOR_MAP                        5
+
+typedef struct {
+    seqlock_t lock;
+    bool used;
+    supstats_user_t data;
+} record_t;
+
+static record_t s_records[SUPERVISOR_MAX_USERS];
+static volatile uint32_t s_read_retries;
+
+static uint32_t hist_bucket(uint32_t ms)
+{
+    uint32_t bucket = 0;
+    while (ms > 1 && bucket < SUPSTATS_HIST_BUCKETS - 1) {
+        ms >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+//---------------------------------------------------------------------
+// Writers
+//---------------------------------------------------------------------
+void supstats_reset_user(supervisor_user_id_t id, const char *name)
+{
+    record_t *rec = &s_records[id];
+    seqlock_write_begin(&rec->lock);
+    memset(&rec->data, 0, sizeof(rec->data));
+    strncpy(rec->data.name, name, SUPERVISOR_NAME_LEN - 1);
+    rec->used = true;
+    seqlock_write_end(&rec->lock);
+}
+
+void supstats_note_feed(supervisor_user_id_t id, int64_t now_us, int64_t prev_feed_us, int64_t detect_us)
+{
+    record_t *rec = &s_records[id];
+    seqlock_write_begin(&rec->lock);
+    supstats_user_t *data = &rec->data;
+    data->feeds++;
+    // The gap a recovery ends is not an interval of normal running
+    if (prev_feed_us != 0 && detect_us == 0) {
+        data->interval_hist[hist_bucket((uint32_t)((now_us - prev_feed_us) / 1000))]++;
+    }
+    if (detect_us != 0) {
+        uint32_t recovery_ms = (uint32_t)((now_us - detect_us) / 1000);
+        data->recoveries++;
+        data->recovery_sum_ms += recovery_ms;
+        if (recovery_ms > data->recovery_max_ms) {
+            data->recovery_max_ms = recovery_ms;
+        }
+        data->recovery_hist[hist_bucket(recovery_ms)]++;
+    }
+    data->last_feed_us = now_us;
+    seqlock_write_end(&rec->lock);
+}
+
+void supstats_note_miss(supervisor_user_id_t id, int64_t now_us)
+{
+    record_t *rec = &s_records[id];
+    seqlock_write_begin(&rec->lock);
+    rec->data.misses++;
+    rec->data.last_miss_us = now_us;
+    seqlock_write_end(&rec->lock);
+}
+
+//---------------------------------------------------------------------
+// Readers
+//---------------------------------------------------------------------
+esp_err_t supstats_read(supervisor_user_id_t id, supstats_user_t *out)
+{
+    if (id < 0 || id >= SUPERVISOR_MAX_USERS || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const record_t *rec = &s_records[id];
+    bool used;
+    uint32_t seq = seqlock_read_begin(&rec->lock);
+    while (1) {
+        used = rec->used;
+        memcpy(out, &rec->data, sizeof(*out));
+        if (!seqlock_read_retry(&rec->lock, seq)) {
+            break;
+        }
+        __atomic_add_fetch(&s_read_retries, 1, __ATOMIC_RELAXED);
+        seq = seqlock_read_begin(&rec->lock);
+    }
+    return used ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+uint32_t supstats_snapshot(supstats_user_t out[SUPERVISOR_MAX_USERS])
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        if (supstats_read(i, &out[i]) == ESP_OK) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+uint32_t supstats_read_retries(void)
+{
+    return __atomic_load_n(&s_read_retries, __ATOMIC_RELAXED);
+}
+
+//---------------------------------------------------------------------
+// CBOR export
+//---------------------------------------------------------------------
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} cbor_writer_t;
+
+static void cbor_put(cbor_writer_t *w, const void *data, size_t len)
+{
+    if (w->len + len > w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+// Item head with the shortest encoding of value
+static void cbor_head(cbor_writer_t *w, uint8_t major, uint64_t value)
+{
+    uint8_t bytes[9];
+    size_t len;
+    if (value < 24) {
+        bytes[0] = (uint8_t)(major << 5 | value);
+        len = 1;
+    } else if (value <= UINT8_MAX) {
+        bytes[0] = (uint8_t)(major << 5 | 24);
+        len = 2;
+    } else if (value <= UINT16_MAX) {
+        bytes[0] = (uint8_t)(major << 5 | 25);
+        len = 3;
+    } else if (value <= UINT32_MAX) {
+        bytes[0] = (uint8_t)(major << 5 | 26);
+        len = 5;
+    } else {
+        bytes[0] = (uint8_t)(major << 5 | 27);
+        len = 9;
+    }
+    // Big-endian argument
+    for (size_t i = 1; i < len; i++) {
+        bytes[i] = (uint8_t)(value >> (8 * (len - 1 - i)));
+    }
+    cbor_put(w, bytes, len);
+}
+
+static void cbor_text(cbor_writer_t *w, const char *text)
+{
+    size_t len = strlen(text);
+    cbor_head(w, CBOR_TEXT, len);
+    cbor_put(w, text, len);
+}
+
+static void cbor_hist(cbor_writer_t *w, const uint32_t *hist)
+{
+    cbor_head(w, CBOR_ARRAY, SUPSTATS_HIST_BUCKETS);
+    for (int i = 0; i < SUPSTATS_HIST_BUCKETS; i++) {
+        cbor_head(w, CBOR_UINT, hist[i]);
+    }
+}
+
+esp_err_t supstats_export(uint8_t *buf, size_t size, size_t *out_len)
+{
+    if (buf == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    static supstats_user_t users[SUPERVISOR_MAX_USERS];
+    uint32_t mask = supstats_snapshot(users);
+    cbor_writer_t w = { .buf = buf, .size = size };
+
+    cbor_head(&w, CBOR_MAP, 3);
+    cbor_text(&w, "v");
+    cbor_head(&w, CBOR_UINT, 1);
+    cbor_text(&w, "t");
+    cbor_head(&w, CBOR_UINT, (uint64_t)hal_time_us());
+    cbor_text(&w, "users");
+    cbor_head(&w, CBOR_ARRAY, (uint64_t)__builtin_popcount(mask));
+
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        if (!(mask & (1u << i))) {
+            continue;
+        }
+        const supstats_user_t *u = &users[i];
+        cbor_head(&w, CBOR_ARRAY, 11);
+        cbor_head(&w, CBOR_UINT, (uint64_t)i);
+        cbor_text(&w, u->name);
+        cbor_head(&w, CBOR_UINT, u->feeds);
+        cbor_head(&w, CBOR_UINT, u->misses);
+        cbor_head(&w, CBOR_UINT, u->recoveries);
+        cbor_head(&w, CBOR_UINT, (uint64_t)u->last_feed_us);
+        cbor_head(&w, CBOR_UINT, (uint64_t)u->last_miss_us);
+        cbor_head(&w, CBOR_UINT, u->recovery_sum_ms);
+        cbor_head(&w, CBOR_UINT, u->recovery_max_ms);
+        cbor_hist(&w, u->interval_hist);
+        cbor_hist(&w, u->recovery_hist);
+    }
+
+    if (w.overflow) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_len = w.len;
+    return ESP_OK;
+}
+
+esp_err_t supstats_export_to_log(void)
+{
+    static uint8_t frame[SUPSTATS_EXPORT_MAX];
+    size_t len;
+    esp_err_t err = supstats_export(frame, sizeof(frame), &len);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    HAL_LOGI(TAG, "STATS:begin");
+    for (size_t off = 0; off < len; off += LOG_LINE_BYTES) {
+        char hex[LOG_LINE_BYTES * 2 + 1];
+        size_t n = len - off < LOG_LINE_BYTES ? len - off : LOG_LINE_BYTES;
+        for (size_t i = 0; i < n; i++) {
+            snprintf(&hex[i * 2], 3, "%02x", frame[off + i]);
+        }
+        hex[n * 2] = '\0';
+        HAL_LOGI(TAG, "STATS:%s", hex);
+    }
+    HAL_LOGI(TAG, "STATS:end");
+    return ESP_OK;
+}
+
+void supstats_print_report(void)
+{
+    static supstats_user_t users[SUPERVISOR_MAX_USERS];
+    uint32_t mask = supstats_snapshot(users);
+    int64_t now = hal_time_us();
+
+    HAL_LOGI(TAG, "Supervisor stats (%lu read retries)", (unsigned long)supstats_read_retries());
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        if (!(mask & (1u << i))) {
+            continue;
+        }
+        const supstats_user_t *u = &users[i];
+        HAL_LOGI(TAG, "  %-16s feeds %lu, misses %lu, recoveries %lu (avg %lu ms, max %lu ms), last fed %lld ms ago",
+                 u->name, (unsigned long)u->feeds, (unsigned long)u->misses, (unsigned long)u->recoveries,
+                 (unsigned long)(u->recoveries ? u->recovery_sum_ms / u->recoveries : 0),
+                 (unsigned long)u->recovery_max_ms,
+                 (long long)(u->last_feed_us ? (now - u->last_feed_us) / 1000 : -1));
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+#include "seqlock.h"
+#include "supervisor.h"
+
+// Histogram buckets; bucket i counts [2^i, 2^(i+1)) ms, the last one
+// everything longer
+#define SUPSTATS_HIST_BUCKETS           12
+// Largest frame supstats_export() writes, with every user registered
+#define SUPSTATS_EXPORT_MAX             (32 + SUPERVISOR_MAX_USERS * (48 + SUPERVISOR_NAME_LEN + \
+                                                                      2 * SUPSTATS_HIST_BUCKETS * 5))
+
+//---------------------------------------------------------------------
+// Supervisor statistics
+//
+// Per-user counters the supervisor updates as it goes: feeds, misses,
+// recoveries, last feed and miss times, and histograms of feed
+// intervals and of the time from detection to the first feed after it.
+// The supervisor writes a record only under its own lock, so the stats
+// add no lock of their own; each record sits behind a seqlock, and a
+// reader copies a consistent record without blocking the writer.
+//
+// supstats_export() writes every record as one CBOR frame:
+//
+//     {"v": 1, "t": <now us>, "users": [
+//         [id, name, feeds, misses, recoveries, last_feed_us,
+//          last_miss_us, recovery_sum_ms, recovery_max_ms,
+//          [interval_hist...], [recovery_hist...]], ...]}
+//
+// Times are hal_time_us() of the board, 0 for never.
+//---------------------------------------------------------------------
+typedef struct {
+    char name[SUPERVISOR_NAME_LEN];
+    uint32_t feeds;
+    uint32_t misses;
+    uint32_t recoveries;            // First feeds after a miss
+    int64_t last_feed_us;
+    int64_t last_miss_us;
+    uint32_t recovery_sum_ms;
+    uint32_t recovery_max_ms;
+    uint32_t interval_hist[SUPSTATS_HIST_BUCKETS];
+    uint32_t recovery_hist[SUPSTATS_HIST_BUCKETS];
+} supstats_user_t;
+
+// Writers, called by the supervisor with its lock held
+void supstats_reset_user(supervisor_user_id_t id, const char *name);
+void supstats_note_feed(supervisor_user_id_t id, int64_t now_us, int64_t prev_feed_us, int64_t detect_us);
+void supstats_note_miss(supervisor_user_id_t id, int64_t now_us);
+
+// Consistent copy of one user's record; ESP_ERR_NOT_FOUND if unused
+esp_err_t supstats_read(supervisor_user_id_t id, supstats_user_t *out);
+
+// Copy every used record into out, indexed by user id; returns the mask
+// of ids filled
+uint32_t supstats_snapshot(supstats_user_t out[SUPERVISOR_MAX_USERS]);
+
+// Encode a snapshot as CBOR into buf; ESP_ERR_INVALID_SIZE if it does
+// not fit (SUPSTATS_EXPORT_MAX always does)
+esp_err_t supstats_export(uint8_t *buf, size_t size, size_t *out_len);
+
+// Log the frame as "STATS:" hex lines between STATS:begin and STATS:end
+esp_err_t supstats_export_to_log(void);
+
+// Times a reader had to copy a record again
+uint32_t supstats_read_retries(void);
+
+void supstats_print_report(void);
@@ -0,0 +1,341 @@
+//---------------------------------------------------------------------
+// Fleet beacon load generator
+//
+// Plays a fleet of devices against tools/fleetcollector.c: each device
+// sends a beacon of beacon.c's layout every period, their send times
+// spread evenly over the period, from threads of their own with a
+// connected socket each and sendmmsg() batches. Halfway through, a
+// share of the devices goes silent (the collector should lose them) and
+// another share reboots (sequence and uptime back to 0).
+//
+// Build:  cc -O2 -pthread -o beaconsim tools/beaconsim.c
+// Usage:  beaconsim [-a addr] [-p port] [-n devices] [-P period_ms] [-d seconds]
+//                   [-j threads] [-u users] [-s silent_%] [-r reboot_%]
+//---------------------------------------------------------------------
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+// Layout shared with beacon.h
+#define BEACON_MAGIC                    0x43424457u
+#define BEACON_VERSION                  1
+#define BEACON_DEFAULT_PORT             47800
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t user_count;
+    uint16_t reserved;
+    uint32_t device_id;
+    uint32_t seq;
+    uint32_t uptime_s;
+    uint32_t period_ms;
+    uint32_t unhealthy_mask;
+    uint32_t misses;
+    uint32_t recoveries;
+} beacon_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t misses;
+    uint16_t recoveries;
+    uint32_t last_feed_age_ms;
+} beacon_user_t;
+
+#define BEACON_MAX_USERS                32
+#define BEACON_MAX_SIZE                 (sizeof(beacon_header_t) + \
+                                         BEACON_MAX_USERS * sizeof(beacon_user_t) + sizeof(uint32_t))
+
+#define BATCH                           256
+#define FIRST_DEVICE_ID                 0x10000000u
+
+typedef struct {
+    uint32_t seq;
+    uint32_t boot_ms;               // Simulated boot time, moved by a reboot
+    bool silent_later;
+    bool reboot_later;
+} device_t;
+
+typedef struct {
+    int index;
+    uint32_t first;                 // Device range of the thread
+    uint32_t count;
+    pthread_t thread;
+    volatile uint64_t sent;
+    volatile uint64_t errors;
+} worker_t;
+
+static struct sockaddr_in s_addr;
+static uint32_t s_period_ms = 1000;
+static int s_users = 8;
+static int s_duration_s = 30;
+static double s_silent = 0.01;
+static double s_reboot = 0.01;
+static device_t *s_devices;
+static int64_t s_start_ns;
+static volatile bool s_running = true;
+
+static uint32_t s_crc_table[256];
+
+static int64_t mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void crc_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+        s_crc_table[i] = crc;
+    }
+}
+
+static uint32_t crc32_le(const uint8_t *data, size_t len)
+{
+    uint32_t crc = UINT32_MAX;
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc >> 8) ^ s_crc_table[(crc ^ data[i]) & 0xff];
+    }
+    return ~crc;
+}
+
+static size_t build_beacon(uint8_t *buf, uint32_t id, device_t *dev, uint32_t now_ms)
+{
+    uint32_t seq = dev->seq++;
+    beacon_header_t header = {
+        .magic = BEACON_MAGIC,
+        .version = BEACON_VERSION,
+        .user_count = (uint8_t)s_users,
+        .device_id = id,
+        .seq = seq,
+        .uptime_s = (now_ms - dev->boot_ms) / 1000,
+        .period_ms = s_period_ms,
+        // A user in trouble now and then
+        .unhealthy_mask = (id * 2654435761u + seq) % 1000 == 0 ? 1 : 0,
+    };
+    size_t len = sizeof(header);
+    for (int i = 0; i < s_users; i++) {
+        beacon_user_t user = {
+            .misses = (uint16_t)(header.unhealthy_mask & 1u << i ? 1 : 0),
+            .recoveries = 0,
+            .last_feed_age_ms = (id + (uint32_t)i) % 100,
+        };
+        header.misses += user.misses;
+        memcpy(buf + len, &user, sizeof(user));
+        len += sizeof(user);
+    }
+    memcpy(buf, &header, sizeof(header));
+    uint32_t crc = crc32_le(buf, len);
+    memcpy(buf + len, &crc, sizeof(crc));
+    return len + sizeof(crc);
+}
+
+//---------------------------------------------------------------------
+// Sender thread. Device i of count sends at i * period / count into
+// every period; the thread sends whatever is due, then sleeps until the
+// next device is.
+//---------------------------------------------------------------------
+static void *worker_main(void *arg)
+{
+    worker_t *worker = arg;
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0 || connect(sock, (struct sockaddr *)&s_addr, sizeof(s_addr)) != 0) {
+        perror("beaconsim: socket");
+        return NULL;
+    }
+    int size = 4 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    static __thread uint8_t bufs[BATCH][BEACON_MAX_SIZE];
+    static __thread struct iovec iovs[BATCH];
+    static __thread struct mmsghdr msgs[BATCH];
+    for (int i = 0; i < BATCH; i++) {
+        iovs[i].iov_base = bufs[i];
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int64_t period_ns = (int64_t)s_period_ms * 1000000;
+    int64_t half_ns = (int64_t)s_duration_s * 500000000;
+    bool faults_done = false;
+    uint64_t round = 0;
+    uint32_t next = 0;
+
+    while (s_running) {
+        int64_t now = mono_ns() - s_start_ns;
+        if (!faults_done && now >= half_ns) {
+            for (uint32_t i = 0; i < worker->count; i++) {
+                device_t *dev = &s_devices[worker->first + i];
+                if (dev->reboot_later) {
+                    dev->seq = 0;
+                    dev->boot_ms = (uint32_t)(now / 1000000);
+                }
+            }
+            faults_done = true;
+        }
+
+        int batch = 0;
+        int64_t due = 0;
+        while (s_running) {
+            due = (int64_t)round * period_ns + (int64_t)next * period_ns / worker->count;
+            if (due > now) {
+                break;
+            }
+            uint32_t index = worker->first + next;
+            device_t *dev = &s_devices[index];
+            if (!(faults_done && dev->silent_later)) {
+                iovs[batch].iov_len = build_beacon(bufs[batch], FIRST_DEVICE_ID + index, dev,
+                                                   (uint32_t)(now / 1000000));
+                batch++;
+            }
+            if (++next == worker->count) {
+                next = 0;
+                round++;
+            }
+            if (batch == BATCH) {
+                break;
+            }
+        }
+
+        for (int sent = 0; sent < batch;) {
+            int n = sendmmsg(sock, msgs + sent, batch - sent, 0);
+            if (n < 0) {
+                // ENOBUFS or ECONNREFUSED: drop the rest of the batch
+                worker->errors += batch - sent;
+                break;
+            }
+            sent += n;
+            worker->sent += n;
+        }
+
+        if (batch < BATCH && due > now) {
+            int64_t wait = due - (mono_ns() - s_start_ns);
+            if (wait > 0) {
+                struct timespec ts = { .tv_sec = wait / 1000000000, .tv_nsec = wait % 1000000000 };
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+    close(sock);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    uint16_t port = BEACON_DEFAULT_PORT;
+    uint32_t devices = 10000;
+    int threads = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:n:P:d:j:u:s:r:")) != -1) {
+        switch (opt) {
+        case 'a':
+            host = optarg;
+            break;
+        case 'p':
+            port = (uint16_t)atoi(optarg);
+            break;
+        case 'n':
+            devices = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'P':
+            s_period_ms = (uint32_t)atoi(optarg);
+            break;
+        case 'd':
+            s_duration_s = atoi(optarg);
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'u':
+            s_users = atoi(optarg);
+            break;
+        case 's':
+            s_silent = atof(optarg) / 100;
+            break;
+        case 'r':
+            s_reboot = atof(optarg) / 100;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-a addr] [-p port] [-n devices] [-P period_ms] [-d seconds] "
+                    "[-j threads] [-u users] [-s silent_%%] [-r reboot_%%]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (devices == 0 || threads <= 0 || (uint32_t)threads > devices || s_period_ms == 0 || s_users < 0 ||
+        s_users > BEACON_MAX_USERS) {
+        fprintf(stderr, "beaconsim: bad arguments\n");
+        return 2;
+    }
+
+    s_addr.sin_family = AF_INET;
+    s_addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &s_addr.sin_addr) != 1) {
+        fprintf(stderr, "beaconsim: bad address %s\n", host);
+        return 2;
+    }
+    crc_init();
+
+    s_devices = calloc(devices, sizeof(device_t));
+    worker_t *workers = calloc(threads, sizeof(worker_t));
+    if (s_devices == NULL || workers == NULL) {
+        fprintf(stderr, "beaconsim: out of memory\n");
+        return 1;
+    }
+    srand(1);
+    uint32_t silent = 0, reboot = 0;
+    for (uint32_t i = 0; i < devices; i++) {
+        double r = (double)rand() / RAND_MAX;
+        s_devices[i].silent_later = r < s_silent;
+        s_devices[i].reboot_later = !s_devices[i].silent_later && r < s_silent + s_reboot;
+        silent += s_devices[i].silent_later;
+        reboot += s_devices[i].reboot_later;
+    }
+
+    printf("%u devices every %u ms to %s:%u from %d threads, %d users each; "
+           "at %d s %u go silent and %u reboot\n", devices, s_period_ms, host, (unsigned)port, threads,
+           s_users, s_duration_s / 2, silent, reboot);
+    fflush(stdout);
+
+    s_start_ns = mono_ns();
+    for (int i = 0; i < threads; i++) {
+        workers[i].index = i;
+        workers[i].first = (uint32_t)((uint64_t)devices * i / threads);
+        workers[i].count = (uint32_t)((uint64_t)devices * (i + 1) / threads) - workers[i].first;
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+
+    uint64_t last_sent = 0;
+    for (int s = 1; s <= s_duration_s; s++) {
+        sleep(1);
+        uint64_t sent = 0, errors = 0;
+        for (int i = 0; i < threads; i++) {
+            sent += workers[i].sent;
+            errors += workers[i].errors;
+        }
+        printf("%4ds %llu beacons/s (target %.0f), %llu sent, %llu send errors\n", s,
+               (unsigned long long)(sent - last_sent), (double)devices * 1000 / s_period_ms,
+               (unsigned long long)sent, (unsigned long long)errors);
+        fflush(stdout);
+        last_sent = sent;
+    }
+    s_running = false;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    return 0;
+}
@@ -0,0 +1,232 @@
+//---------------------------------------------------------------------
+// Decode a watchdog crash dump
+//
+// Checks the dump, prints its header and region list, decodes the
+// supervisor table and with -o writes every region decompressed to
+// <dir>/<index>_<name>.bin for further inspection.
+//
+// Read the partition off the device first:
+//   parttool.py read_partition --partition-name crashdump --output dump.bin
+// The host build leaves crashdump.bin in its working directory.
+//
+// Build:  cc -O2 -I. -o crashdump_decode tools/crashdump_decode.c lz.c
+// Usage:  crashdump_decode [-o dir] dump.bin
+//---------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "lz.h"
+
+// Layout shared with crashdump.h
+#define CRASHDUMP_MAGIC                 0x44434457u
+#define CRASHDUMP_VERSION               2
+#define CRASHDUMP_NAME_LEN              16
+#define CRASHDUMP_BLOCK_RAW             0x8000u
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t region_count;
+    int32_t user;
+    uint32_t uptime_ms;
+    uint32_t raw_size;
+    uint32_t stored_size;
+    uint32_t erase_us;
+    uint32_t write_us;
+    uint32_t crc;
+    uint32_t unreported;
+} crashdump_header_t;
+
+typedef struct {
+    char name[CRASHDUMP_NAME_LEN];
+    uint32_t type;
+    uint32_t addr;
+    uint32_t raw_size;
+    uint32_t stored_size;
+} crashdump_region_t;
+
+typedef struct {
+    uint16_t raw_len;
+    uint16_t stored_len;
+} crashdump_block_t;
+
+// supervisor_user_info_t; all fields are fixed width, same on the target
+typedef struct {
+    char name[16];
+    uint32_t samples;
+    float mean_ms;
+    float sigma_ms;
+    uint32_t deadline_ms;
+    uint32_t detections;
+    uint32_t premature;
+    uint64_t latency_sum_ms;
+    int64_t last_detect_us;
+    int64_t first_feed_us;
+} supervisor_user_info_t;
+
+static const char *s_type_names[] = { "table", "stack", "user" };
+
+//---------------------------------------------------------------------
+// Standard CRC-32, the same as esp_rom_crc32_le() chained from 0
+//---------------------------------------------------------------------
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+//---------------------------------------------------------------------
+// Decompress a region's blocks into out (raw_size bytes)
+//---------------------------------------------------------------------
+static int decode_region(const uint8_t *blocks, size_t stored_size, uint8_t *out, size_t raw_size)
+{
+    size_t in = 0;
+    size_t done = 0;
+    while (in < stored_size) {
+        crashdump_block_t block;
+        if (stored_size - in < sizeof(block)) {
+            return -1;
+        }
+        memcpy(&block, blocks + in, sizeof(block));
+        in += sizeof(block);
+
+        size_t stored = block.stored_len & ~CRASHDUMP_BLOCK_RAW;
+        if (stored > stored_size - in || block.raw_len > raw_size - done) {
+            return -1;
+        }
+        if (block.stored_len & CRASHDUMP_BLOCK_RAW) {
+            if (stored != block.raw_len) {
+                return -1;
+            }
+            memcpy(out + done, blocks + in, stored);
+        } else if (lz_decompress(blocks + in, stored, out + done, block.raw_len) != block.raw_len) {
+            return -1;
+        }
+        in += stored;
+        done += block.raw_len;
+    }
+    return done == raw_size ? 0 : -1;
+}
+
+static void print_supervisor(const uint8_t *data, size_t size)
+{
+    printf("  %-16s %8s %9s %9s %9s %6s %6s\n", "user", "samples", "mean ms", "sigma ms", "deadline", "misses", "early");
+    for (size_t pos = 0; pos + sizeof(supervisor_user_info_t) <= size; pos += sizeof(supervisor_user_info_t)) {
+        supervisor_user_info_t info;
+        memcpy(&info, data + pos, sizeof(info));
+        if (info.name[0] == '\0') {
+            continue;
+        }
+        info.name[sizeof(info.name) - 1] = '\0';
+        printf("  %-16s %8u %9.1f %9.1f %9u %6u %6u\n", info.name, (unsigned)info.samples, info.mean_ms,
+               info.sigma_ms, (unsigned)info.deadline_ms, (unsigned)info.detections, (unsigned)info.premature);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_dir = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:")) != -1) {
+        if (opt == 'o') {
+            out_dir = optarg;
+        } else {
+            fprintf(stderr, "usage: %s [-o dir] dump.bin\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-o dir] dump.bin\n", argv[0]);
+        return 2;
+    }
+
+    FILE *f = fopen(argv[optind], "rb");
+    if (f == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(file_size > 0 ? (size_t)file_size : 1);
+    if (data == NULL || fread(data, 1, (size_t)file_size, f) != (size_t)file_size) {
+        fprintf(stderr, "crashdump_decode: read failed\n");
+        return 1;
+    }
+    fclose(f);
+
+    crashdump_header_t header;
+    if ((size_t)file_size < sizeof(header)) {
+        fprintf(stderr, "crashdump_decode: file too small\n");
+        return 1;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != CRASHDUMP_MAGIC || header.version != CRASHDUMP_VERSION) {
+        fprintf(stderr, "crashdump_decode: no dump (erased or interrupted)\n");
+        return 1;
+    }
+    if (header.stored_size > (size_t)file_size - sizeof(header) ||
+        crc32(0, data + sizeof(header), header.stored_size) != header.crc) {
+        fprintf(stderr, "crashdump_decode: CRC mismatch, dump is corrupted\n");
+        return 1;
+    }
+
+    printf("Crash dump: user %d, uptime %u ms%s\n", (int)header.user, (unsigned)header.uptime_ms,
+           header.unreported == UINT32_MAX ? "" : ", reported on the device");
+    printf("  %u regions, %u -> %u bytes (%.1f%%), erase %.1f ms, compress+write %.1f ms\n",
+           header.region_count, (unsigned)header.raw_size, (unsigned)header.stored_size,
+           header.raw_size ? 100.0 * header.stored_size / header.raw_size : 0.0,
+           header.erase_us / 1000.0, header.write_us / 1000.0);
+
+    size_t pos = sizeof(header);
+    for (unsigned i = 0; i < header.region_count; i++) {
+        crashdump_region_t region;
+        if (pos + sizeof(region) > sizeof(header) + header.stored_size) {
+            fprintf(stderr, "crashdump_decode: region %u truncated\n", i);
+            return 1;
+        }
+        memcpy(&region, data + pos, sizeof(region));
+        pos += sizeof(region);
+        region.name[CRASHDUMP_NAME_LEN - 1] = '\0';
+        if (region.stored_size > sizeof(header) + header.stored_size - pos) {
+            fprintf(stderr, "crashdump_decode: region %u truncated\n", i);
+            return 1;
+        }
+
+        uint8_t *raw = malloc(region.raw_size ? region.raw_size : 1);
+        if (raw == NULL || decode_region(data + pos, region.stored_size, raw, region.raw_size) != 0) {
+            fprintf(stderr, "crashdump_decode: region %u (%s) does not decode\n", i, region.name);
+            return 1;
+        }
+        printf("[%2u] %-16s %-5s 0x%08x %6u -> %6u bytes\n", i, region.name,
+               region.type < 3 ? s_type_names[region.type] : "?", (unsigned)region.addr,
+               (unsigned)region.raw_size, (unsigned)region.stored_size);
+
+        if (strcmp(region.name, "supervisor") == 0) {
+            print_supervisor(raw, region.raw_size);
+        }
+        if (out_dir != NULL) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%02u_%s.bin", out_dir, i, region.name);
+            FILE *out = fopen(path, "wb");
+            if (out == NULL || fwrite(raw, 1, region.raw_size, out) != region.raw_size) {
+                perror(path);
+                return 1;
+            }
+            fclose(out);
+        }
+        free(raw);
+        pos += region.stored_size;
+    }
+
+    free(data);
+    return 0;
+}
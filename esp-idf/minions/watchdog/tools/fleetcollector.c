@@ -0,0 +1,590 @@
+//---------------------------------------------------------------------
+// Fleet heartbeat collector
+//
+// Receives the UDP beacons of beacon.c from a whole fleet and tracks
+// device liveness: a device is lost after TIMEOUT_PERIODS of its own
+// beacon periods without a beacon, and back when one arrives again.
+// Sized for a million devices on one thread:
+//   - epoll over the socket, a timerfd ticking the wheel and a signalfd
+//   - recvmmsg() drains up to BATCH datagrams per call
+//   - devices live in one array found through an open-addressed hash
+//     on the device id; nothing is allocated after start-up
+//   - each device has one timer in a four-level hierarchical timing
+//     wheel (64 slots a level, 10 ms ticks, 46 hours of range), so a
+//     beacon re-arms it in O(1) and a tick touches only what is due
+//
+// Sequence gaps count lost beacons; the sequence or uptime going back
+// is a reboot. tools/beaconsim.c generates the load of a fleet.
+//
+// Build:  cc -O2 -o fleetcollector tools/fleetcollector.c
+// Usage:  fleetcollector [-p port] [-n max_devices] [-i report_s] [-d seconds] [-v]
+//---------------------------------------------------------------------
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+// Layout shared with beacon.h
+#define BEACON_MAGIC                    0x43424457u
+#define BEACON_VERSION                  1
+#define BEACON_DEFAULT_PORT             47800
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t user_count;
+    uint16_t reserved;
+    uint32_t device_id;
+    uint32_t seq;
+    uint32_t uptime_s;
+    uint32_t period_ms;
+    uint32_t unhealthy_mask;
+    uint32_t misses;
+    uint32_t recoveries;
+} beacon_header_t;
+
+#define BEACON_USER_SIZE                8
+#define BEACON_MAX_USERS                32
+
+// Datagrams per recvmmsg() call, and calls per wakeup before the wheel
+// gets a turn
+#define BATCH                           256
+#define MAX_BATCHES                     64
+#define DATAGRAM_MAX                    512
+#define SOCKET_BUFFER                   (64 << 20)
+
+#define TICK_MS                         10
+#define WHEEL_LEVELS                    4
+#define WHEEL_BITS                      6
+#define WHEEL_SLOTS                     (1u << WHEEL_BITS)
+#define WHEEL_RANGE                     (1u << (WHEEL_LEVELS * WHEEL_BITS))
+// Beacon periods without a beacon before a device is lost
+#define TIMEOUT_PERIODS                 3
+
+#define NIL                             UINT32_MAX
+#define NO_SLOT                         UINT16_MAX
+
+typedef struct {
+    uint32_t id;
+    uint32_t next;                  // Wheel list links, device indices
+    uint32_t prev;
+    uint32_t expires;               // Tick
+    uint16_t slot;                  // Wheel list the device is on
+    bool online;
+    uint32_t seq;
+    uint32_t uptime_s;
+    uint32_t unhealthy_mask;
+    uint32_t misses;
+    uint32_t recoveries;
+    uint32_t lost_beacons;
+    uint32_t reboots;
+} device_t;
+
+typedef struct {
+    uint64_t datagrams;
+    uint64_t bytes;
+    uint64_t calls;                 // recvmmsg() calls that returned data
+    uint64_t bad;                   // Wrong size, magic, version or CRC
+    uint64_t table_full;
+    uint64_t new_devices;
+    uint64_t lost;                  // Devices that timed out
+    uint64_t back;                  // Lost devices heard from again
+    uint64_t reboots;
+    uint64_t lost_beacons;
+    uint64_t reordered;
+    uint64_t cascaded;              // Timers moved down a wheel level
+} counters_t;
+
+static device_t *s_devices;
+static uint32_t s_device_count;
+static uint32_t s_max_devices;
+static uint32_t *s_hash;            // Device index + 1, 0 when free
+static uint32_t s_hash_mask;
+
+static uint32_t s_wheel[WHEEL_LEVELS * WHEEL_SLOTS];
+static uint32_t s_tick;
+
+static counters_t s_counters;
+static uint32_t s_online;
+static uint32_t s_unhealthy;
+static bool s_verbose;
+
+static uint32_t s_crc_table[256];
+
+static int64_t mono_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void crc_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+        s_crc_table[i] = crc;
+    }
+}
+
+static uint32_t crc32_le(const uint8_t *data, size_t len)
+{
+    uint32_t crc = UINT32_MAX;
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc >> 8) ^ s_crc_table[(crc ^ data[i]) & 0xff];
+    }
+    return ~crc;
+}
+
+//---------------------------------------------------------------------
+// Device table
+//---------------------------------------------------------------------
+static uint32_t hash_id(uint32_t id)
+{
+    id ^= id >> 16;
+    id *= 0x7feb352du;
+    id ^= id >> 15;
+    id *= 0x846ca68bu;
+    id ^= id >> 16;
+    return id;
+}
+
+// Index of the device, added if new; NIL with the table full
+static uint32_t find_device(uint32_t id, bool *out_new)
+{
+    for (uint32_t h = hash_id(id) & s_hash_mask;; h = (h + 1) & s_hash_mask) {
+        uint32_t entry = s_hash[h];
+        if (entry == 0) {
+            if (s_device_count == s_max_devices) {
+                return NIL;
+            }
+            uint32_t index = s_device_count++;
+            s_hash[h] = index + 1;
+            device_t *dev = &s_devices[index];
+            memset(dev, 0, sizeof(*dev));
+            dev->id = id;
+            dev->slot = NO_SLOT;
+            *out_new = true;
+            return index;
+        }
+        if (s_devices[entry - 1].id == id) {
+            *out_new = false;
+            return entry - 1;
+        }
+    }
+}
+
+//---------------------------------------------------------------------
+// Timing wheel. Level L holds timers due within the current block of
+// 64^(L+1) ticks but not of 64^L; when the tick enters a new block of
+// level L, that level's slot for it is cascaded into the levels below.
+//---------------------------------------------------------------------
+static void wheel_unlink(uint32_t index)
+{
+    device_t *dev = &s_devices[index];
+    if (dev->slot == NO_SLOT) {
+        return;
+    }
+    if (dev->prev != NIL) {
+        s_devices[dev->prev].next = dev->next;
+    } else {
+        s_wheel[dev->slot] = dev->next;
+    }
+    if (dev->next != NIL) {
+        s_devices[dev->next].prev = dev->prev;
+    }
+    dev->slot = NO_SLOT;
+}
+
+static void wheel_insert(uint32_t index)
+{
+    device_t *dev = &s_devices[index];
+    if ((int32_t)(dev->expires - s_tick) <= 0) {
+        dev->expires = s_tick + 1;
+    }
+    uint32_t diff = dev->expires ^ s_tick;
+    if (diff >= WHEEL_RANGE) {
+        // Beyond the wheel: park at the end of the range, and expire
+        // early rather than never
+        dev->expires = s_tick | (WHEEL_RANGE - 1);
+        diff = dev->expires ^ s_tick;
+    }
+    int level = 0;
+    while (diff >= (1u << ((level + 1) * WHEEL_BITS))) {
+        level++;
+    }
+    uint16_t slot = (uint16_t)(level * WHEEL_SLOTS + ((dev->expires >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1)));
+
+    dev->slot = slot;
+    dev->prev = NIL;
+    dev->next = s_wheel[slot];
+    if (dev->next != NIL) {
+        s_devices[dev->next].prev = index;
+    }
+    s_wheel[slot] = index;
+}
+
+static void device_lost(uint32_t index)
+{
+    device_t *dev = &s_devices[index];
+    dev->online = false;
+    s_online--;
+    if (dev->unhealthy_mask != 0) {
+        s_unhealthy--;
+    }
+    s_counters.lost++;
+    if (s_verbose) {
+        printf("lost    %08x after seq %u\n", dev->id, dev->seq);
+    }
+}
+
+static void wheel_advance(uint32_t to)
+{
+    while (s_tick != to) {
+        s_tick++;
+        for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+            if ((s_tick & ((1u << (level * WHEEL_BITS)) - 1)) != 0) {
+                continue;
+            }
+            uint32_t slot = level * WHEEL_SLOTS + ((s_tick >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1));
+            uint32_t index = s_wheel[slot];
+            s_wheel[slot] = NIL;
+            while (index != NIL) {
+                uint32_t next = s_devices[index].next;
+                s_devices[index].slot = NO_SLOT;
+                wheel_insert(index);
+                s_counters.cascaded++;
+                index = next;
+            }
+        }
+
+        uint32_t slot = s_tick & (WHEEL_SLOTS - 1);
+        uint32_t index = s_wheel[slot];
+        s_wheel[slot] = NIL;
+        while (index != NIL) {
+            uint32_t next = s_devices[index].next;
+            s_devices[index].slot = NO_SLOT;
+            device_lost(index);
+            index = next;
+        }
+    }
+}
+
+//---------------------------------------------------------------------
+// Beacons
+//---------------------------------------------------------------------
+static void handle_beacon(const uint8_t *data, size_t len)
+{
+    beacon_header_t header;
+    if (len < sizeof(header) + sizeof(uint32_t)) {
+        s_counters.bad++;
+        return;
+    }
+    memcpy(&header, data, sizeof(header));
+    size_t body = sizeof(header) + (size_t)header.user_count * BEACON_USER_SIZE;
+    uint32_t crc;
+    if (header.magic != BEACON_MAGIC || header.version != BEACON_VERSION ||
+        header.user_count > BEACON_MAX_USERS || len != body + sizeof(crc)) {
+        s_counters.bad++;
+        return;
+    }
+    memcpy(&crc, data + body, sizeof(crc));
+    if (crc32_le(data, body) != crc) {
+        s_counters.bad++;
+        return;
+    }
+
+    bool is_new;
+    uint32_t index = find_device(header.device_id, &is_new);
+    if (index == NIL) {
+        s_counters.table_full++;
+        return;
+    }
+    device_t *dev = &s_devices[index];
+
+    if (is_new) {
+        s_counters.new_devices++;
+    } else if (header.uptime_s < dev->uptime_s || header.seq == 0) {
+        dev->reboots++;
+        s_counters.reboots++;
+        if (s_verbose) {
+            printf("reboot  %08x after %u s up\n", dev->id, dev->uptime_s);
+        }
+    } else if (header.seq > dev->seq) {
+        uint32_t gap = header.seq - dev->seq - 1;
+        dev->lost_beacons += gap;
+        s_counters.lost_beacons += gap;
+    } else {
+        // Late or duplicate; the newer state is already in
+        s_counters.reordered++;
+        return;
+    }
+
+    if (!dev->online) {
+        dev->online = true;
+        s_online++;
+        if (!is_new) {
+            s_counters.back++;
+            if (s_verbose) {
+                printf("back    %08x at seq %u\n", dev->id, header.seq);
+            }
+        }
+    } else if (dev->unhealthy_mask != 0) {
+        s_unhealthy--;
+    }
+    if (header.unhealthy_mask != 0) {
+        s_unhealthy++;
+        if (s_verbose && dev->unhealthy_mask == 0) {
+            printf("unwell  %08x users %08x\n", dev->id, header.unhealthy_mask);
+        }
+    }
+
+    dev->seq = header.seq;
+    dev->uptime_s = header.uptime_s;
+    dev->unhealthy_mask = header.unhealthy_mask;
+    dev->misses = header.misses;
+    dev->recoveries = header.recoveries;
+
+    uint32_t period_ms = header.period_ms ? header.period_ms : 1000;
+    wheel_unlink(index);
+    dev->expires = s_tick + (uint32_t)(((uint64_t)period_ms * TIMEOUT_PERIODS + TICK_MS - 1) / TICK_MS);
+    wheel_insert(index);
+}
+
+static struct mmsghdr s_msgs[BATCH];
+static struct iovec s_iovs[BATCH];
+static uint8_t s_bufs[BATCH][DATAGRAM_MAX];
+
+static void drain_socket(int sock)
+{
+    for (int n = 0; n < MAX_BATCHES; n++) {
+        for (int i = 0; i < BATCH; i++) {
+            s_msgs[i].msg_hdr.msg_iov = &s_iovs[i];
+            s_msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int count = recvmmsg(sock, s_msgs, BATCH, MSG_DONTWAIT, NULL);
+        if (count <= 0) {
+            return;
+        }
+        s_counters.calls++;
+        for (int i = 0; i < count; i++) {
+            s_counters.datagrams++;
+            s_counters.bytes += s_msgs[i].msg_len;
+            handle_beacon(s_bufs[i], s_msgs[i].msg_len);
+        }
+        if (count < BATCH) {
+            return;
+        }
+    }
+}
+
+//---------------------------------------------------------------------
+// Report
+//---------------------------------------------------------------------
+static int64_t cpu_us(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void report(double elapsed_s, const counters_t *last, int64_t cpu_delta_us, double interval_s)
+{
+    const counters_t *c = &s_counters;
+    uint64_t datagrams = c->datagrams - last->datagrams;
+    uint64_t calls = c->calls - last->calls;
+    printf("%7.1fs devices %u online %u lost %u unwell %u | %.0f beacons/s, %.1f per recvmmsg, "
+           "%.0f ns cpu/beacon, cpu %.0f%% | +%llu new, +%llu lost, +%llu back, +%llu reboots, "
+           "+%llu missed beacons, %llu bad\n",
+           elapsed_s, s_device_count, s_online, s_device_count - s_online, s_unhealthy,
+           datagrams / interval_s, calls ? (double)datagrams / calls : 0.0,
+           datagrams ? cpu_delta_us * 1000.0 / datagrams : 0.0, cpu_delta_us / (interval_s * 10000.0),
+           (unsigned long long)(c->new_devices - last->new_devices),
+           (unsigned long long)(c->lost - last->lost), (unsigned long long)(c->back - last->back),
+           (unsigned long long)(c->reboots - last->reboots),
+           (unsigned long long)(c->lost_beacons - last->lost_beacons), (unsigned long long)c->bad);
+    fflush(stdout);
+}
+
+static int open_socket(uint16_t port)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        perror("socket");
+        return -1;
+    }
+    int size = SOCKET_BUFFER;
+    // Past rmem_max only with CAP_NET_ADMIN; the plain one caps quietly
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0) {
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("bind");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t port = BEACON_DEFAULT_PORT;
+    uint32_t max_devices = 1 << 20;
+    int report_s = 5;
+    int duration_s = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:n:i:d:v")) != -1) {
+        switch (opt) {
+        case 'p':
+            port = (uint16_t)atoi(optarg);
+            break;
+        case 'n':
+            max_devices = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            report_s = atoi(optarg);
+            break;
+        case 'd':
+            duration_s = atoi(optarg);
+            break;
+        case 'v':
+            s_verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p port] [-n max_devices] [-i report_s] [-d seconds] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (max_devices == 0 || report_s <= 0) {
+        fprintf(stderr, "fleetcollector: bad -n or -i\n");
+        return 2;
+    }
+
+    // Hash at most half full
+    uint32_t hash_size = 1;
+    while (hash_size < max_devices * 2) {
+        hash_size <<= 1;
+    }
+    s_max_devices = max_devices;
+    s_hash_mask = hash_size - 1;
+    s_devices = calloc(max_devices, sizeof(device_t));
+    s_hash = calloc(hash_size, sizeof(uint32_t));
+    if (s_devices == NULL || s_hash == NULL) {
+        fprintf(stderr, "fleetcollector: out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < WHEEL_LEVELS * WHEEL_SLOTS; i++) {
+        s_wheel[i] = NIL;
+    }
+    for (int i = 0; i < BATCH; i++) {
+        s_iovs[i].iov_base = s_bufs[i];
+        s_iovs[i].iov_len = DATAGRAM_MAX;
+    }
+    crc_init();
+
+    int sock = open_socket(port);
+    if (sock < 0) {
+        return 1;
+    }
+
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    struct itimerspec spec = {
+        .it_interval = { .tv_nsec = TICK_MS * 1000000L },
+        .it_value = { .tv_nsec = TICK_MS * 1000000L },
+    };
+    timerfd_settime(timer, 0, &spec, NULL);
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    int sigfd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    int fds[] = { sock, timer, sigfd };
+    for (int i = 0; i < 3; i++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.fd = fds[i] };
+        epoll_ctl(ep, EPOLL_CTL_ADD, fds[i], &ev);
+    }
+
+    printf("Listening on udp/%u for up to %u devices (%u hash slots, %zu MB)\n", (unsigned)port, max_devices,
+           hash_size, ((size_t)max_devices * sizeof(device_t) + (size_t)hash_size * 4) >> 20);
+    fflush(stdout);
+
+    int64_t start_ms = mono_ms();
+    int64_t next_report_ms = start_ms + report_s * 1000;
+    int64_t last_report_ms = start_ms;
+    int64_t last_cpu_us = cpu_us();
+    counters_t last = s_counters;
+    bool running = true;
+
+    while (running) {
+        struct epoll_event events[3];
+        int count = epoll_wait(ep, events, 3, -1);
+        if (count < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == sock) {
+                drain_socket(sock);
+            } else if (fd == timer) {
+                uint64_t expirations;
+                if (read(timer, &expirations, sizeof(expirations)) < 0) {
+                    continue;
+                }
+            } else if (fd == sigfd) {
+                running = false;
+            }
+        }
+
+        // The wheel follows the clock, however late the timerfd was
+        int64_t now_ms = mono_ms();
+        wheel_advance((uint32_t)((now_ms - start_ms) / TICK_MS));
+
+        if (now_ms >= next_report_ms || !running) {
+            int64_t cpu = cpu_us();
+            double interval_s = (now_ms - last_report_ms) / 1000.0;
+            report((now_ms - start_ms) / 1000.0, &last, cpu - last_cpu_us, interval_s > 0 ? interval_s : 1);
+            last = s_counters;
+            last_cpu_us = cpu;
+            last_report_ms = now_ms;
+            next_report_ms += report_s * 1000;
+        }
+        if (duration_s > 0 && now_ms - start_ms >= (int64_t)duration_s * 1000) {
+            running = false;
+        }
+    }
+
+    const counters_t *c = &s_counters;
+    printf("Total: %llu beacons (%llu bytes), %u devices, %llu lost, %llu back, %llu reboots, "
+           "%llu missed beacons, %llu reordered, %llu bad, %llu table full, %llu timers cascaded\n",
+           (unsigned long long)c->datagrams, (unsigned long long)c->bytes, s_device_count,
+           (unsigned long long)c->lost, (unsigned long long)c->back, (unsigned long long)c->reboots,
+           (unsigned long long)c->lost_beacons, (unsigned long long)c->reordered, (unsigned long long)c->bad,
+           (unsigned long long)c->table_full, (unsigned long long)c->cascaded);
+    return 0;
+}
@@ -0,0 +1,671 @@
+//---------------------------------------------------------------------
+// Fleet simulator: thousands of virtual boards in one process
+//
+// Each board is the supervision side of the app in virtual time: a
+// heartbeat table (shard_table_t, as the sharded supervisor uses),
+// virtual tasks that feed it on their periods, a scan every
+// SCAN_PERIOD_MS and recovery as the app does it: the default breaker of
+// breaker.h gates each attempt and the default escalation ladder of
+// escalation.h (log, task restart, peripheral restart, system reset,
+// with its backoffs and healthy reset) picks the action, both through
+// the same per-user steps the boards run, plus a boot sequence after a
+// reset. Recovery actions take no CPU time in virtual time, so the
+// breaker's global budget never rejects an attempt here.
+// Faults are injected per board: tasks stall for a while, hang until
+// restarted, or hang for good until the board resets; boards also crash
+// outright.
+//
+// Boards are stepped in epochs of EPOCH_MS of virtual time. A pool of
+// threads takes chunks of CHUNK boards off a shared counter, and a
+// barrier closes each epoch. Without -a the simulation runs as fast as
+// it can and the figure of merit is board-seconds simulated per CPU
+// second, that is boards one core can keep up with in real time. With
+// -a it runs in real time and every board sends the UDP beacon of
+// beacon.h, to load-test tools/fleetcollector.c.
+//
+// Build:  make, from the watchdog directory (see Makefile)
+// Usage:  fleetsim [-n boards] [-j threads] [-t seconds] [-u users] [-f faults_per_hour]
+//                  [-c crashes_per_day] [-a collector_addr] [-p port]
+//---------------------------------------------------------------------
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "hal.h"
+#include "shardsup.h"
+#include "escalation.h"
+#include "breaker.h"
+#include "beacon.h"
+
+#define EPOCH_MS                        100
+#define CHUNK                           64
+#define SCAN_PERIOD_MS                  20
+#define BEACON_PERIOD_MS                1000
+// Time to restart a task or a peripheral, and to boot
+#define TASK_RESTART_MS                 20
+#define PERIPH_RESTART_MS               100
+#define BOOT_MS                         1500
+#define MAX_USERS                       SUPERVISOR_MAX_USERS
+#define SEND_BATCH                      64
+#define FIRST_DEVICE_ID                 0x20000000u
+
+#define NEVER                           INT64_MAX
+
+// Feed periods of the virtual tasks, in turn; timeouts are three
+// periods plus TIMEOUT_SLACK_MS
+static const uint32_t s_task_periods_ms[] = { 50, 100, 100, 200, 500, 1000, 20, 250 };
+#define TASK_PERIOD_COUNT               (sizeof(s_task_periods_ms) / sizeof(s_task_periods_ms[0]))
+#define TIMEOUT_SLACK_MS                100
+
+typedef enum {
+    FAULT_STALL = 0,                // Recovers by itself
+    FAULT_HANG,                     // Until the task is restarted
+    FAULT_STICKY,                   // Until the board resets
+    FAULT_KIND_COUNT,
+} fault_kind_t;
+
+// Share of each kind among injected faults, in percent
+static const int s_fault_share[FAULT_KIND_COUNT] = { 70, 25, 5 };
+
+typedef struct {
+    uint32_t period_us;
+    int64_t next_run_us;
+    int64_t stalled_until_us;       // NEVER while hung
+    bool sticky;
+    breaker_gate_t breaker;
+    escalation_state_t ladder;
+    int64_t detected_us;            // 0 when not timed out
+} vtask_t;
+
+typedef struct {
+    uint64_t board_us;              // Virtual time simulated, summed
+    uint64_t task_runs;
+    uint64_t faults[FAULT_KIND_COUNT];
+    uint64_t crashes;
+    uint64_t misses;
+    uint64_t detect_late_sum_us;    // Detection after the deadline
+    uint32_t detect_late_max_us;
+    uint64_t actions[ESCALATION_LEVEL_COUNT];
+    uint64_t overflows;
+    uint64_t deferred;
+    uint64_t suppressed;
+    uint64_t breaker_trips;
+    uint64_t recoveries;
+    uint64_t mttr_sum_us;
+    uint32_t mttr_max_us;
+    uint64_t boot_us;               // Time spent booting
+    uint64_t beacons;
+    uint64_t send_errors;
+} sim_stats_t;
+
+typedef struct {
+    shard_table_t table;
+    int64_t now_us;
+    int64_t next_scan_us;
+    int64_t next_beacon_us;
+    int64_t boot_us;                // Boot finished
+    uint32_t id;
+    uint32_t seq;
+    uint32_t rng;
+    uint32_t misses;
+    uint32_t recoveries;
+    vtask_t tasks[MAX_USERS];
+} board_t;
+
+typedef struct {
+    pthread_t thread;
+    int sock;
+    sim_stats_t stats;
+    int pending;
+    struct mmsghdr msgs[SEND_BATCH];
+    struct iovec iovs[SEND_BATCH];
+    uint8_t bufs[SEND_BATCH][BEACON_MAX_SIZE];
+} worker_t;
+
+static board_t *s_boards;
+static int s_board_count;
+static int s_users = 6;
+static escalation_policy_t s_policy = ESCALATION_POLICY_DEFAULT();
+static breaker_config_t s_breaker = BREAKER_CONFIG_DEFAULT();
+// Per task run and per scan
+static uint32_t s_fault_threshold[MAX_USERS];
+static uint32_t s_crash_threshold;
+static bool s_send;
+
+static pthread_barrier_t s_barrier;
+static volatile int s_next_chunk;
+static int64_t s_epoch_end_us;
+static volatile bool s_done;
+
+static uint32_t rng_next(board_t *board)
+{
+    uint32_t x = board->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    board->rng = x;
+    return x;
+}
+
+static uint32_t task_timeout_us(const vtask_t *task)
+{
+    return 3 * task->period_us + TIMEOUT_SLACK_MS * 1000;
+}
+
+//---------------------------------------------------------------------
+// Board lifecycle
+//---------------------------------------------------------------------
+static void board_boot(board_t *board, int64_t boot_us)
+{
+    board->boot_us = boot_us;
+    board->seq = 0;
+    shard_table_init(&board->table, -1);
+    for (int i = 0; i < s_users; i++) {
+        vtask_t *task = &board->tasks[i];
+        char name[SHARDSUP_NAME_LEN];
+        snprintf(name, sizeof(name), "task%d", i);
+        memset(task, 0, sizeof(*task));
+        task->period_us = s_task_periods_ms[i % TASK_PERIOD_COUNT] * 1000;
+        task->next_run_us = boot_us + rng_next(board) % task->period_us;
+        breaker_gate_init(&task->breaker, &s_breaker, boot_us);
+        escalation_state_reset(&task->ladder, &s_policy);
+        int index;
+        shard_table_add(&board->table, name, task_timeout_us(task), boot_us, &index);
+    }
+    board->next_scan_us = boot_us + SCAN_PERIOD_MS * 1000;
+    board->next_beacon_us = boot_us + rng_next(board) % (BEACON_PERIOD_MS * 1000);
+}
+
+static void board_reset(board_t *board, int64_t now_us, sim_stats_t *stats)
+{
+    stats->boot_us += BOOT_MS * 1000;
+    board_boot(board, now_us + BOOT_MS * 1000);
+}
+
+//---------------------------------------------------------------------
+// Recovery of a timed out task, after the app's recover_user(): the
+// breaker gates the attempt, then escalation_handle()'s ladder step
+// picks the action
+//---------------------------------------------------------------------
+static void escalate(board_t *board, int index, int64_t now_us, sim_stats_t *stats)
+{
+    vtask_t *task = &board->tasks[index];
+    shard_user_t *user = &board->table.users[index];
+
+    // Re-arm the deadline, so a task still stuck misses again
+    user->last_feed = (uint32_t)now_us;
+    user->timed_out = false;
+
+    bool tripped;
+    breaker_verdict_t verdict = breaker_gate_check(&task->breaker, &s_breaker, now_us, true, &tripped);
+    if (tripped) {
+        stats->breaker_trips++;
+    }
+    if (verdict != BREAKER_ALLOWED) {
+        stats->suppressed++;
+        return;
+    }
+
+    bool overflow;
+    int step = escalation_step(&task->ladder, &s_policy, now_us, &overflow);
+    if (step < 0) {
+        breaker_gate_refund(&task->breaker, &s_breaker);
+        stats->deferred++;
+        return;
+    }
+
+    escalation_level_t level = (escalation_level_t)step;
+    stats->actions[level]++;
+    if (overflow) {
+        stats->overflows++;
+    }
+    switch (level) {
+    case ESCALATION_LOG:
+        break;
+    case ESCALATION_TASK_RESTART:
+    case ESCALATION_PERIPH_RESTART:
+        if (!task->sticky) {
+            uint32_t restart_ms = level == ESCALATION_TASK_RESTART ? TASK_RESTART_MS : PERIPH_RESTART_MS;
+            task->stalled_until_us = now_us + restart_ms * 1000;
+            task->next_run_us = task->stalled_until_us;
+        }
+        break;
+    default:
+        board_reset(board, now_us, stats);
+        break;
+    }
+}
+
+//---------------------------------------------------------------------
+// Board events
+//---------------------------------------------------------------------
+static void run_task(board_t *board, int index, int64_t now_us, sim_stats_t *stats)
+{
+    vtask_t *task = &board->tasks[index];
+    if (now_us < task->stalled_until_us) {
+        task->next_run_us = task->stalled_until_us;
+        return;
+    }
+
+    stats->task_runs++;
+    shard_table_feed(&board->table, index, now_us);
+    if (task->detected_us != 0) {
+        uint32_t mttr = (uint32_t)(now_us - task->detected_us);
+        stats->recoveries++;
+        stats->mttr_sum_us += mttr;
+        if (mttr > stats->mttr_max_us) {
+            stats->mttr_max_us = mttr;
+        }
+        board->recoveries++;
+        task->detected_us = 0;
+        breaker_gate_recovered(&task->breaker);
+        escalation_state_recovered(&task->ladder, now_us);
+    }
+    task->next_run_us = now_us + task->period_us;
+
+    if (rng_next(board) < s_fault_threshold[index]) {
+        int roll = (int)(rng_next(board) % 100);
+        fault_kind_t kind = FAULT_STALL;
+        while (kind < FAULT_STICKY && roll >= s_fault_share[kind]) {
+            roll -= s_fault_share[kind];
+            kind++;
+        }
+        stats->faults[kind]++;
+        if (kind == FAULT_STALL) {
+            // Half to three times the timeout: some get caught, some not
+            uint32_t timeout = task_timeout_us(task);
+            task->stalled_until_us = now_us + timeout / 2 + rng_next(board) % (timeout * 5 / 2);
+            task->next_run_us = task->stalled_until_us;
+        } else {
+            task->stalled_until_us = NEVER;
+            task->sticky = kind == FAULT_STICKY;
+            task->next_run_us = NEVER;
+        }
+    }
+}
+
+static void scan(board_t *board, int64_t now_us, sim_stats_t *stats)
+{
+    board->next_scan_us = now_us + SCAN_PERIOD_MS * 1000;
+    if (s_crash_threshold != 0 && rng_next(board) < s_crash_threshold) {
+        stats->crashes++;
+        board_reset(board, now_us, stats);
+        return;
+    }
+
+    uint32_t missed = shard_table_scan(&board->table, now_us);
+    for (int i = 0; missed != 0; i++, missed >>= 1) {
+        if (!(missed & 1)) {
+            continue;
+        }
+        const shard_user_t *user = &board->table.users[i];
+        uint32_t late = (uint32_t)now_us - user->last_feed - user->timeout_us;
+        stats->misses++;
+        stats->detect_late_sum_us += late;
+        if (late > stats->detect_late_max_us) {
+            stats->detect_late_max_us = late;
+        }
+        board->misses++;
+        if (board->tasks[i].detected_us == 0) {
+            board->tasks[i].detected_us = now_us;
+        }
+        escalate(board, i, now_us, stats);
+        if (board->boot_us > now_us) {
+            // Reset by the ladder
+            return;
+        }
+    }
+}
+
+static void flush_beacons(worker_t *worker)
+{
+    for (int sent = 0; sent < worker->pending;) {
+        int n = sendmmsg(worker->sock, worker->msgs + sent, worker->pending - sent, 0);
+        if (n < 0) {
+            worker->stats.send_errors += worker->pending - sent;
+            break;
+        }
+        sent += n;
+    }
+    worker->pending = 0;
+}
+
+static void send_beacon(board_t *board, int64_t now_us, worker_t *worker)
+{
+    board->next_beacon_us = now_us + BEACON_PERIOD_MS * 1000;
+    worker->stats.beacons++;
+    if (!s_send) {
+        return;
+    }
+
+    // The ladder re-arms the table, so timed out means not yet recovered
+    uint32_t unhealthy = 0;
+    for (int i = 0; i < s_users; i++) {
+        if (board->tasks[i].detected_us != 0) {
+            unhealthy |= 1u << i;
+        }
+    }
+
+    uint8_t *buf = worker->bufs[worker->pending];
+    beacon_header_t header = {
+        .magic = BEACON_MAGIC,
+        .version = BEACON_VERSION,
+        .user_count = (uint8_t)s_users,
+        .device_id = board->id,
+        .seq = board->seq++,
+        .uptime_s = (uint32_t)((now_us - board->boot_us) / 1000000),
+        .period_ms = BEACON_PERIOD_MS,
+        .unhealthy_mask = unhealthy,
+        .misses = board->misses,
+        .recoveries = board->recoveries,
+    };
+    size_t len = sizeof(header);
+    for (int i = 0; i < s_users; i++) {
+        const shard_user_t *user = &board->table.users[i];
+        beacon_user_t entry = {
+            .misses = (uint16_t)(user->misses > UINT16_MAX ? UINT16_MAX : user->misses),
+            .recoveries = 0,
+            .last_feed_age_ms = ((uint32_t)now_us - user->last_feed) / 1000,
+        };
+        memcpy(buf + len, &entry, sizeof(entry));
+        len += sizeof(entry);
+    }
+    memcpy(buf, &header, sizeof(header));
+    uint32_t crc = hal_crc32_le(0, buf, len);
+    memcpy(buf + len, &crc, sizeof(crc));
+
+    worker->iovs[worker->pending].iov_len = len + sizeof(crc);
+    if (++worker->pending == SEND_BATCH) {
+        flush_beacons(worker);
+    }
+}
+
+// Run one board's events up to end_us, earliest first
+static void step_board(board_t *board, int64_t end_us, worker_t *worker)
+{
+    sim_stats_t *stats = &worker->stats;
+    stats->board_us += end_us - board->now_us;
+
+    while (1) {
+        int64_t next = board->next_scan_us;
+        int task = -1;
+        for (int i = 0; i < s_users; i++) {
+            if (board->tasks[i].next_run_us < next) {
+                next = board->tasks[i].next_run_us;
+                task = i;
+            }
+        }
+        bool beacon = board->next_beacon_us < next;
+        if (beacon) {
+            next = board->next_beacon_us;
+        }
+        if (next >= end_us) {
+            break;
+        }
+        board->now_us = next;
+        if (beacon) {
+            send_beacon(board, next, worker);
+        } else if (task >= 0) {
+            run_task(board, task, next, stats);
+        } else {
+            scan(board, next, stats);
+        }
+    }
+    board->now_us = end_us;
+}
+
+//---------------------------------------------------------------------
+// Thread pool
+//---------------------------------------------------------------------
+static void *worker_main(void *arg)
+{
+    worker_t *worker = arg;
+    int chunks = (s_board_count + CHUNK - 1) / CHUNK;
+    while (1) {
+        pthread_barrier_wait(&s_barrier);
+        if (s_done) {
+            break;
+        }
+        int chunk;
+        while ((chunk = __atomic_fetch_add(&s_next_chunk, 1, __ATOMIC_RELAXED)) < chunks) {
+            int end = (chunk + 1) * CHUNK < s_board_count ? (chunk + 1) * CHUNK : s_board_count;
+            for (int i = chunk * CHUNK; i < end; i++) {
+                step_board(&s_boards[i], s_epoch_end_us, worker);
+            }
+        }
+        flush_beacons(worker);
+        pthread_barrier_wait(&s_barrier);
+    }
+    return NULL;
+}
+
+static int64_t mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t cpu_us(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void sum_stats(const worker_t *workers, int count, sim_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    for (int w = 0; w < count; w++) {
+        const sim_stats_t *s = &workers[w].stats;
+        out->board_us += s->board_us;
+        out->task_runs += s->task_runs;
+        for (int k = 0; k < FAULT_KIND_COUNT; k++) {
+            out->faults[k] += s->faults[k];
+        }
+        out->crashes += s->crashes;
+        out->misses += s->misses;
+        out->detect_late_sum_us += s->detect_late_sum_us;
+        if (s->detect_late_max_us > out->detect_late_max_us) {
+            out->detect_late_max_us = s->detect_late_max_us;
+        }
+        for (int l = 0; l < ESCALATION_LEVEL_COUNT; l++) {
+            out->actions[l] += s->actions[l];
+        }
+        out->overflows += s->overflows;
+        out->deferred += s->deferred;
+        out->suppressed += s->suppressed;
+        out->breaker_trips += s->breaker_trips;
+        out->recoveries += s->recoveries;
+        out->mttr_sum_us += s->mttr_sum_us;
+        if (s->mttr_max_us > out->mttr_max_us) {
+            out->mttr_max_us = s->mttr_max_us;
+        }
+        out->boot_us += s->boot_us;
+        out->beacons += s->beacons;
+        out->send_errors += s->send_errors;
+    }
+}
+
+static void print_summary(const sim_stats_t *s, double wall_s, double cpu_s, int threads)
+{
+    double board_s = s->board_us / 1e6;
+    printf("Simulated %.0f board-seconds in %.2f s (%.2f s CPU, %d threads): %.0f boards per core in real time, "
+           "%.0f task runs/s per core\n", board_s, wall_s, cpu_s, threads, cpu_s > 0 ? board_s / cpu_s : 0.0,
+           cpu_s > 0 ? s->task_runs / cpu_s : 0.0);
+    printf("  faults: %llu stalls, %llu hangs, %llu sticky hangs, %llu crashes\n",
+           (unsigned long long)s->faults[FAULT_STALL], (unsigned long long)s->faults[FAULT_HANG],
+           (unsigned long long)s->faults[FAULT_STICKY], (unsigned long long)s->crashes);
+    printf("  %llu misses caught avg %.1f ms, max %.1f ms after the deadline\n", (unsigned long long)s->misses,
+           s->misses ? s->detect_late_sum_us / 1000.0 / s->misses : 0.0, s->detect_late_max_us / 1000.0);
+    printf("  actions:");
+    for (int l = 0; l < ESCALATION_LEVEL_COUNT; l++) {
+        printf(" %llu %s,", (unsigned long long)s->actions[l], escalation_level_name((escalation_level_t)l));
+    }
+    printf(" %llu past the limit, %llu deferred\n", (unsigned long long)s->overflows,
+           (unsigned long long)s->deferred);
+    printf("  %llu attempts suppressed by breakers, %llu breaker trips\n", (unsigned long long)s->suppressed,
+           (unsigned long long)s->breaker_trips);
+    printf("  %llu recoveries, MTTR avg %.1f ms, max %.1f ms; %.3f%% of board time booting\n",
+           (unsigned long long)s->recoveries, s->recoveries ? s->mttr_sum_us / 1000.0 / s->recoveries : 0.0,
+           s->mttr_max_us / 1000.0, board_s > 0 ? s->boot_us / 1e4 / board_s : 0.0);
+    if (s_send) {
+        printf("  %llu beacons sent, %llu send errors\n", (unsigned long long)s->beacons,
+               (unsigned long long)s->send_errors);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int threads = hal_num_cores();
+    int seconds = 60;
+    double faults_per_hour = 60;
+    double crashes_per_day = 1;
+    const char *collector = NULL;
+    uint16_t port = BEACON_DEFAULT_PORT;
+    s_board_count = 10000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:j:t:u:f:c:a:p:")) != -1) {
+        switch (opt) {
+        case 'n':
+            s_board_count = atoi(optarg);
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'u':
+            s_users = atoi(optarg);
+            break;
+        case 'f':
+            faults_per_hour = atof(optarg);
+            break;
+        case 'c':
+            crashes_per_day = atof(optarg);
+            break;
+        case 'a':
+            collector = optarg;
+            break;
+        case 'p':
+            port = (uint16_t)atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n boards] [-j threads] [-t seconds] [-u users] [-f faults_per_hour] "
+                    "[-c crashes_per_day] [-a collector_addr] [-p port]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (s_board_count <= 0 || threads <= 0 || seconds <= 0 || s_users <= 0 || s_users > MAX_USERS) {
+        fprintf(stderr, "fleetsim: bad arguments (at most %d users)\n", MAX_USERS);
+        return 2;
+    }
+
+    // Faults spread evenly over the users' runs
+    for (int i = 0; i < MAX_USERS; i++) {
+        double runs_per_hour = 3600.0 * 1000 / s_task_periods_ms[i % TASK_PERIOD_COUNT];
+        double p = faults_per_hour / s_users / runs_per_hour;
+        s_fault_threshold[i] = (uint32_t)(p >= 1 ? UINT32_MAX : p * UINT32_MAX);
+    }
+    double p_crash = crashes_per_day / (86400.0 * 1000 / SCAN_PERIOD_MS);
+    s_crash_threshold = (uint32_t)(p_crash >= 1 ? UINT32_MAX : p_crash * UINT32_MAX);
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    if (collector != NULL) {
+        if (inet_pton(AF_INET, collector, &addr.sin_addr) != 1) {
+            fprintf(stderr, "fleetsim: bad address %s\n", collector);
+            return 2;
+        }
+        s_send = true;
+    }
+
+    s_boards = aligned_alloc(SHARDSUP_ALIGN, sizeof(board_t) * (size_t)s_board_count);
+    worker_t *workers = calloc(threads, sizeof(worker_t));
+    if (s_boards == NULL || workers == NULL) {
+        fprintf(stderr, "fleetsim: out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < s_board_count; i++) {
+        board_t *board = &s_boards[i];
+        memset(board, 0, sizeof(*board));
+        board->id = FIRST_DEVICE_ID + (uint32_t)i;
+        board->rng = board->id * 2654435761u | 1;
+        board_boot(board, 0);
+    }
+
+    printf("%d boards, %d users each, %d threads, %d s%s; %.0f faults per board-hour, %.1f crashes per board-day; "
+           "%zu bytes per board\n", s_board_count, s_users, threads, seconds,
+           s_send ? " in real time with beacons" : " as fast as possible", faults_per_hour, crashes_per_day,
+           sizeof(board_t));
+    fflush(stdout);
+
+    pthread_barrier_init(&s_barrier, NULL, threads + 1);
+    for (int i = 0; i < threads; i++) {
+        worker_t *worker = &workers[i];
+        worker->sock = -1;
+        if (s_send) {
+            worker->sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+            if (worker->sock < 0 || connect(worker->sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+                perror("fleetsim: socket");
+                return 1;
+            }
+        }
+        for (int b = 0; b < SEND_BATCH; b++) {
+            worker->iovs[b].iov_base = worker->bufs[b];
+            worker->msgs[b].msg_hdr.msg_iov = &worker->iovs[b];
+            worker->msgs[b].msg_hdr.msg_iovlen = 1;
+        }
+        pthread_create(&worker->thread, NULL, worker_main, worker);
+    }
+
+    int64_t start_us = mono_us();
+    int64_t start_cpu = cpu_us();
+    int64_t next_report_us = start_us + 1000000;
+    int epochs = seconds * 1000 / EPOCH_MS;
+    for (int e = 1; e <= epochs; e++) {
+        s_epoch_end_us = (int64_t)e * EPOCH_MS * 1000;
+        s_next_chunk = 0;
+        pthread_barrier_wait(&s_barrier);
+        pthread_barrier_wait(&s_barrier);
+
+        int64_t now = mono_us();
+        if (s_send && start_us + s_epoch_end_us > now) {
+            usleep((useconds_t)(start_us + s_epoch_end_us - now));
+            now = mono_us();
+        }
+        if (now >= next_report_us) {
+            sim_stats_t stats;
+            sum_stats(workers, threads, &stats);
+            double cpu_s = (cpu_us() - start_cpu) / 1e6;
+            printf("%6.1fs virtual, %.1fs wall: %.0f boards per core, %llu misses, %llu recoveries, %llu resets\n",
+                   s_epoch_end_us / 1e6, (now - start_us) / 1e6, cpu_s > 0 ? stats.board_us / 1e6 / cpu_s : 0.0,
+                   (unsigned long long)stats.misses, (unsigned long long)stats.recoveries,
+                   (unsigned long long)(stats.actions[ESCALATION_SYSTEM_RESET] + stats.crashes));
+            fflush(stdout);
+            next_report_us += 1000000;
+        }
+    }
+    s_done = true;
+    pthread_barrier_wait(&s_barrier);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        if (workers[i].sock >= 0) {
+            close(workers[i].sock);
+        }
+    }
+
+    sim_stats_t stats;
+    sum_stats(workers, threads, &stats);
+    print_summary(&stats, (mono_us() - start_us) / 1e6, (cpu_us() - start_cpu) / 1e6, threads);
+    return 0;
+}
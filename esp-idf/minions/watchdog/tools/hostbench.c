@@ -0,0 +1,226 @@
+//---------------------------------------------------------------------
+// Run the supervision stack natively on Linux
+//
+// Builds the supervisor, escalation ladder, job runner, worker pool,
+// sharded supervisor and fast detection against hal_linux.c, plays a
+// short fault scenario (one user stalls, has its thread unwound and is
+// restarted by the ladder, a 1 kHz control loop stalls and is caught by
+// fast detection, a user of the sharded supervisor stalls so its core
+// withholds its check-in and the TWDT fires) and runs the module
+// benchmarks, so the logic can be profiled with perf and checked with
+// the sanitizers.
+//
+// Build:  make, from the watchdog directory (see Makefile)
+// Usage:  build-host/hostbench [seconds]
+//         perf stat -e cycles,instructions,cache-misses build-host/hostbench
+//---------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include "hal.h"
+#include "supervisor.h"
+#include "supervise.h"
+#include "supstats.h"
+#include "escalation.h"
+#include "jobrunner.h"
+#include "workpool.h"
+#include "shardsup.h"
+#include "fastdet.h"
+#include "loglimit.h"
+#include "trace.h"
+#include "backtrace.h"
+
+static const char *TAG = "hostbench";
+
+#define TWDT_TIMEOUT_MS                 3000
+#define FEED_PERIOD_MS                  50
+// The steady user feeds through the latched single-store path
+#define STEADY_USER_ID                  0
+// The flaky user stalls once, this long after start
+#define STALL_AFTER_MS                  1000
+// The control loop runs every millisecond and stalls once for a while.
+// Its timeout leaves room for the jitter of sleeps on a host without
+// real-time scheduling; on the board 1-2 ms is the target.
+#define LOOP_TIMEOUT_US                 5000
+#define LOOP_STALL_AFTER_MS             500
+#define LOOP_STALL_MS                   20
+// One sharded supervisor user per core, fed from that core. The last
+// core's user stalls for longer than the TWDT timeout: its shard stops
+// checking in, the "shards" TWDT user is no longer reset and fires.
+#define SHARD_TIMEOUT_MS                200
+#define SHARD_STALL_AFTER_MS            500
+#define SHARD_STALL_MS                  4000
+// From the stall to its shard's scan seeing the user timed out
+#define SHARD_DETECT_MS                 (SHARD_TIMEOUT_MS + 50)
+
+static supervisor_user_id_t s_flaky_id;
+static hal_task_t s_recovery_task;
+static volatile bool s_stalled;
+static fastdet_user_t s_loop_user;
+static shardsup_user_t s_shard_users[SHARDSUP_MAX_SHARDS];
+static int s_shard_count;
+
+static void steady_task(void *arg)
+{
+    (void)arg;
+    while (1) {
+        SUPERVISED_SCOPE(STEADY_USER_ID);
+        hal_delay_ms(FEED_PERIOD_MS);
+    }
+}
+
+static void flaky_task(void *arg)
+{
+    (void)arg;
+    int64_t start_us = hal_time_us();
+    while (1) {
+        if (!s_stalled && hal_time_us() - start_us > STALL_AFTER_MS * 1000) {
+            s_stalled = true;
+            HAL_LOGW(TAG, "flaky: stalling");
+            // Stuck polling, e.g. a driver waiting on a bit that never
+            // sets; the busy-wait is where a restart can stop it
+            while (1) {
+                hal_delay_us(1000);
+            }
+        }
+        supervisor_feed(s_flaky_id);
+        hal_delay_ms(FEED_PERIOD_MS);
+    }
+}
+
+static void control_loop_task(void *arg)
+{
+    (void)arg;
+    int64_t start_us = hal_time_us();
+    bool stalled = false;
+    while (1) {
+        fastdet_feed(s_loop_user);
+        if (!stalled && hal_time_us() - start_us > LOOP_STALL_AFTER_MS * 1000) {
+            stalled = true;
+            HAL_LOGW(TAG, "control loop: stalling for %d ms", LOOP_STALL_MS);
+            hal_delay_ms(LOOP_STALL_MS);
+        }
+        hal_delay_ms(1);
+    }
+}
+
+static void shard_feeder_task(void *arg)
+{
+    int core = (int)(intptr_t)arg;
+    int64_t start_us = hal_time_us();
+    bool stalled = core != s_shard_count - 1;
+    while (1) {
+        if (!stalled && hal_time_us() - start_us > SHARD_STALL_AFTER_MS * 1000) {
+            stalled = true;
+            HAL_LOGW(TAG, "core %d feeder: stalling for %d ms", core, SHARD_STALL_MS);
+            shardsup_stats_t before;
+            shardsup_stats_t after;
+            hal_delay_ms(SHARD_DETECT_MS);
+            shardsup_get_stats(&before);
+            hal_delay_ms(SHARD_STALL_MS - SHARD_DETECT_MS);
+            shardsup_get_stats(&after);
+            HAL_LOGI(TAG, "core %d feeder: resuming; %lu check-ins and %lu TWDT resets while it was timed out",
+                     core, (unsigned long)(after.checkins - before.checkins),
+                     (unsigned long)(after.twdt_resets - before.twdt_resets));
+        }
+        shardsup_feed(s_shard_users[core]);
+        hal_delay_ms(FEED_PERIOD_MS);
+    }
+}
+
+static void on_timeout(supervisor_user_id_t id, void *arg)
+{
+    (void)id;
+    (void)arg;
+    hal_notify_give(s_recovery_task);
+}
+
+static void recovery_task(void *arg)
+{
+    (void)arg;
+    while (1) {
+        hal_notify_take(100 * 1000);
+        loglimit_flush();
+        uint32_t mask = supervisor_take_timeouts();
+        for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+            if (mask & (1u << i)) {
+                if (backtrace_capture_user(i) == ESP_OK) {
+                    backtrace_print(i);
+                }
+                escalation_handle(i);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 5;
+
+    ESP_ERROR_CHECK(hal_twdt_init(TWDT_TIMEOUT_MS, false));
+    ESP_ERROR_CHECK(trace_init());
+    ESP_ERROR_CHECK(backtrace_init());
+    trace_start();
+    ESP_ERROR_CHECK(hal_task_create(recovery_task, "recovery", 4096, NULL, 5, HAL_NO_AFFINITY,
+                                    &s_recovery_task));
+
+    supervisor_config_t config = SUPERVISOR_CONFIG_DEFAULT();
+    config.fixed_timeout_ms = TWDT_TIMEOUT_MS - 500;
+    config.on_timeout = on_timeout;
+    config.on_recovered = escalation_on_recovered;
+    ESP_ERROR_CHECK(supervisor_init(&config));
+
+    ESP_ERROR_CHECK(supervisor_add_user_at("steady", STEADY_USER_ID));
+    ESP_ERROR_CHECK(supervisor_add_user("flaky", &s_flaky_id));
+
+    // Skip straight to a task restart and never reset the host
+    escalation_policy_t policy = ESCALATION_POLICY_DEFAULT();
+    policy.max_attempts[ESCALATION_LOG] = 0;
+    policy.max_attempts[ESCALATION_PERIPH_RESTART] = 0;
+    policy.max_attempts[ESCALATION_SYSTEM_RESET] = 0;
+    policy.backoff_ms[ESCALATION_TASK_RESTART] = 0;
+    ESP_ERROR_CHECK(escalation_set_policy(s_flaky_id, &policy));
+
+    supervisor_task_desc_t steady = {
+        .entry = steady_task, .task_name = "steady", .stack_size = 4096, .priority = 4,
+        .arg = NULL, .core_id = HAL_NO_AFFINITY,
+    };
+    supervisor_task_desc_t flaky = {
+        .entry = flaky_task, .task_name = "flaky", .stack_size = 4096, .priority = 4,
+        .arg = NULL, .core_id = HAL_NO_AFFINITY,
+    };
+    ESP_ERROR_CHECK(supervisor_start_task(STEADY_USER_ID, &steady));
+    ESP_ERROR_CHECK(supervisor_start_task(s_flaky_id, &flaky));
+
+    fastdet_config_t fast = FASTDET_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(fastdet_init(&fast));
+    ESP_ERROR_CHECK(fastdet_add_user("control_loop", LOOP_TIMEOUT_US, &s_loop_user));
+    ESP_ERROR_CHECK(hal_task_create(control_loop_task, "control_loop", 4096, NULL, 6, HAL_NO_AFFINITY, NULL));
+
+    shardsup_config_t shards = SHARDSUP_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(shardsup_init(&shards));
+    s_shard_count = hal_num_cores() < SHARDSUP_MAX_SHARDS ? hal_num_cores() : SHARDSUP_MAX_SHARDS;
+    for (int core = 0; core < s_shard_count; core++) {
+        char name[24];
+        snprintf(name, sizeof(name), "core%d_feeder", core);
+        ESP_ERROR_CHECK(shardsup_add_user(name, core, SHARD_TIMEOUT_MS, &s_shard_users[core]));
+        ESP_ERROR_CHECK(hal_task_create(shard_feeder_task, name, 4096, (void *)(intptr_t)core, 4, core, NULL));
+    }
+
+    hal_delay_ms((uint32_t)seconds * 1000);
+    trace_stop();
+
+    supervisor_print_report();
+    supstats_print_report();
+    supstats_export_to_log();
+    escalation_print_report();
+    fastdet_stop();
+    fastdet_print_report();
+    shardsup_print_report();
+    loglimit_print_report();
+
+    trace_benchmark();
+    jobrunner_benchmark();
+    workpool_benchmark();
+    shardsup_benchmark();
+    return 0;
+}
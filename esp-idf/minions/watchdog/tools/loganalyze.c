@@ -0,0 +1,772 @@
+//---------------------------------------------------------------------
+// Offline supervision log analyzer
+//
+// Turns supervisor logs into SLO figures per user: faults, detection
+// latency, MTTR, downtime and availability, and the distribution of
+// times between faults. Reads two kinds of input, told apart by their
+// first bytes:
+//
+//   Monitor logs ("I (1234) TAG: message" lines, colours allowed). A
+//   fault of a user is detected at its "<name> failed, taking specific
+//   recovery action" line from recover_user() and restored at the next
+//   "Recovery complete". It started at the earliest "Not resetting
+//   watchdog" line since the last detection, if the log has one.
+//   "Custom TWDT handler was invoked" lines count TWDT firings, and
+//   loglimit summaries of suppressed detections are counted without a
+//   user. Timestamps going back mark a reboot, which also ends every
+//   outstanding fault.
+//
+//   Trace dumps (trace.h layout, one or more back to back). A fault
+//   starts at the user's last feed, is detected at its timeout event
+//   and restored at its next feed.
+//
+// Files are taken as one device's history, in the order given. They
+// are mapped with mmap() and cut into chunks, logs at line ends and
+// dumps at dump boundaries, which a pool of threads parses into short
+// event lists. One pass over the events in order then stitches the
+// timeline across reboots and computes the figures, so the run time is
+// that of the parallel scan of the bytes.
+//
+// Detection latency runs from the start of a fault to its detection,
+// less the -d deadline: given the user's timeout, it is how long after
+// the deadline a stall was caught.
+//
+// Build:  cc -O2 -pthread -o loganalyze tools/loganalyze.c
+// Usage:  loganalyze [-j threads] [-d deadline_ms] [-v] file...
+//---------------------------------------------------------------------
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Layout shared with trace.h
+#define TRACE_MAGIC                     0x52544457u
+#define TRACE_NAME_LEN                  16
+
+enum {
+    TRACE_EVT_FEED = 6,
+    TRACE_EVT_TIMEOUT,
+    TRACE_EVT_RECOVERY_BEGIN,
+    TRACE_EVT_RECOVERY_END,
+};
+
+typedef struct {
+    uint32_t timestamp_us;
+    uint8_t type;
+    uint8_t core;
+    uint16_t arg16;
+    uint32_t arg;
+} trace_record_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t task_count;
+    uint32_t record_count;
+    uint32_t dropped;
+} trace_header_t;
+
+typedef struct {
+    uint32_t handle;
+    char name[TRACE_NAME_LEN];
+} trace_task_name_t;
+
+// Log chunks per thread, and their smallest size
+#define CHUNKS_PER_THREAD               8
+#define MIN_CHUNK                       (1 << 20)
+#define MAX_USERS                       64
+#define NAME_LEN                        32
+// Log2 buckets of the time between faults, from under 1 s
+#define GAP_BUCKETS                     16
+
+static const char DETECT_SUFFIX[] = " failed, taking specific recovery action...";
+
+typedef enum {
+    EV_MARK = 0,                    // Time only, for the span and reboots
+    EV_REBOOT,                      // arg: timestamp of the line before, ms
+    EV_ONSET,
+    EV_TWDT,                        // arg: count
+    EV_SUPPRESSED,                  // arg: count
+    EV_DETECT,
+    EV_RESTORED,                    // Log: every user that is down
+    EV_FEED,
+    EV_ACTION,
+} event_type_t;
+
+typedef struct {
+    int64_t t_us;                   // Log: since boot; dump: from base_raw
+    const char *name;               // Log users, into the mapping
+    uint32_t arg;                   // Dump users, or as per the type
+    uint32_t order;                 // Keeps sorting stable
+    uint16_t name_len;
+    uint8_t type;
+} event_t;
+
+typedef struct {
+    bool dump;
+    const uint8_t *start;
+    const uint8_t *end;
+    uint32_t base_raw;              // Dump: raw time of t_us 0
+    uint64_t lines;
+    uint64_t dropped;
+    event_t *events;
+    size_t count;
+    size_t cap;
+} chunk_t;
+
+typedef struct {
+    double *v;
+    size_t n;
+    size_t cap;
+} samples_t;
+
+typedef struct {
+    char name[NAME_LEN];
+    bool down;
+    int64_t fault_start;
+    int64_t detected;
+    int64_t last_feed;              // -1 before the first
+    int64_t last_detect;            // -1 before the first
+    uint32_t faults;
+    uint32_t redetections;          // While already down, e.g. escalations
+    uint32_t actions;
+    int64_t down_us;
+    samples_t latency_ms;
+    samples_t mttr_ms;
+    samples_t gap_s;
+} user_t;
+
+static chunk_t *s_chunks;
+static int s_chunk_count;
+static int s_chunk_cap;
+static volatile int s_next_chunk;
+
+static user_t s_users[MAX_USERS];
+static int s_user_count;
+static int64_t s_deadline_us;
+static bool s_verbose;
+
+// Timeline, built by the merge
+static int64_t s_offset;            // Added to log timestamps
+static int64_t s_last_raw = -1;
+static int64_t s_first = -1;
+static int64_t s_now;
+static uint32_t s_last_raw32;
+static int64_t s_onset = -1;
+static int64_t s_last_fault = -1;
+static uint64_t s_reboots;
+static uint64_t s_twdt;
+static uint64_t s_suppressed;
+static uint64_t s_dropped;
+static uint64_t s_lines;
+static uint64_t s_events;
+static samples_t s_gaps;
+static uint64_t s_gap_hist[GAP_BUCKETS];
+
+static void *grow(void *p, size_t *cap, size_t size)
+{
+    *cap = *cap ? *cap * 2 : 256;
+    p = realloc(p, *cap * size);
+    if (p == NULL) {
+        fprintf(stderr, "loganalyze: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void push_event(chunk_t *chunk, int64_t t_us, event_type_t type, uint32_t arg, const char *name,
+                       size_t name_len)
+{
+    if (chunk->count == chunk->cap) {
+        chunk->events = grow(chunk->events, &chunk->cap, sizeof(event_t));
+    }
+    event_t *ev = &chunk->events[chunk->count];
+    ev->t_us = t_us;
+    ev->name = name;
+    ev->arg = arg;
+    ev->order = (uint32_t)chunk->count++;
+    ev->name_len = (uint16_t)(name_len < NAME_LEN ? name_len : NAME_LEN - 1);
+    ev->type = (uint8_t)type;
+}
+
+static void push_sample(samples_t *s, double value)
+{
+    if (s->n == s->cap) {
+        s->v = grow(s->v, &s->cap, sizeof(double));
+    }
+    s->v[s->n++] = value;
+}
+
+static bool starts_with(const char *p, const char *end, const char *prefix, size_t len)
+{
+    return (size_t)(end - p) >= len && memcmp(p, prefix, len) == 0;
+}
+
+#define STARTS_WITH(p, end, lit)        starts_with(p, end, lit, sizeof(lit) - 1)
+
+//---------------------------------------------------------------------
+// Log chunks
+//---------------------------------------------------------------------
+static void parse_line(chunk_t *chunk, const char *p, const char *end, int64_t *prev_ms)
+{
+    // Colour codes of idf.py monitor around the line
+    if (p < end && *p == 0x1b) {
+        const char *m = memchr(p, 'm', end - p);
+        if (m == NULL) {
+            return;
+        }
+        p = m + 1;
+    }
+    if (end > p && end[-1] == '\r') {
+        end--;
+    }
+    if (end - p >= 4 && memcmp(end - 4, "\x1b[0m", 4) == 0) {
+        end -= 4;
+    }
+    if (end - p < 6 || p[1] != ' ' || p[2] != '(' || strchr("EWIDV", p[0]) == NULL) {
+        return;
+    }
+    char level = p[0];
+    p += 3;
+    int64_t ms = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        ms = ms * 10 + (*p++ - '0');
+    }
+    if (end - p < 2 || p[0] != ')' || p[1] != ' ') {
+        return;
+    }
+    const char *msg = memchr(p, ':', end - p);
+    if (msg == NULL || end - msg < 2) {
+        return;
+    }
+    msg += 2;
+
+    int64_t t_us = ms * 1000;
+    if (*prev_ms < 0) {
+        push_event(chunk, t_us, EV_MARK, 0, NULL, 0);
+    } else if (ms < *prev_ms) {
+        push_event(chunk, t_us, EV_REBOOT, (uint32_t)*prev_ms, NULL, 0);
+    }
+    *prev_ms = ms;
+
+    switch (*msg) {
+    case 'C':
+        if (STARTS_WITH(msg, end, "Custom TWDT handler was invoked")) {
+            push_event(chunk, t_us, EV_TWDT, 1, NULL, 0);
+        }
+        return;
+    case 'R':
+        if (STARTS_WITH(msg, end, "Recovery complete")) {
+            push_event(chunk, t_us, EV_RESTORED, 0, NULL, 0);
+        }
+        return;
+    case 'N':
+        if (STARTS_WITH(msg, end, "Not resetting watchdog")) {
+            push_event(chunk, t_us, EV_ONSET, 0, NULL, 0);
+        }
+        return;
+    case 'L':
+        // loglimit summary, naming the format string
+        if (STARTS_WITH(msg, end, "Last message repeated ")) {
+            const char *q = msg + sizeof("Last message repeated ") - 1;
+            uint32_t count = (uint32_t)strtoul(q, NULL, 10);
+            if (memmem(q, end - q, DETECT_SUFFIX, sizeof(DETECT_SUFFIX) - 1) != NULL) {
+                push_event(chunk, t_us, EV_SUPPRESSED, count, NULL, 0);
+            } else if (memmem(q, end - q, "Custom TWDT handler was invoked", 31) != NULL) {
+                push_event(chunk, t_us, EV_TWDT, count, NULL, 0);
+            }
+        }
+        return;
+    default:
+        break;
+    }
+
+    size_t suffix = sizeof(DETECT_SUFFIX) - 1;
+    if (level == 'I' && (size_t)(end - msg) > suffix && memcmp(end - suffix, DETECT_SUFFIX, suffix) == 0) {
+        push_event(chunk, t_us, EV_DETECT, 0, msg, (size_t)(end - msg) - suffix);
+    }
+}
+
+static void parse_log(chunk_t *chunk)
+{
+    const char *p = (const char *)chunk->start;
+    const char *end = (const char *)chunk->end;
+    int64_t prev_ms = -1;
+    while (p < end) {
+        const char *eol = memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            eol = end;
+        }
+        chunk->lines++;
+        parse_line(chunk, p, eol, &prev_ms);
+        p = eol + 1;
+    }
+    if (prev_ms >= 0) {
+        push_event(chunk, prev_ms * 1000, EV_MARK, 0, NULL, 0);
+    }
+}
+
+//---------------------------------------------------------------------
+// Dump chunks, one dump each
+//---------------------------------------------------------------------
+static int compare_events(const void *a, const void *b)
+{
+    const event_t *x = a;
+    const event_t *y = b;
+    if (x->t_us != y->t_us) {
+        return x->t_us < y->t_us ? -1 : 1;
+    }
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+static void parse_dump(chunk_t *chunk)
+{
+    trace_header_t header;
+    memcpy(&header, chunk->start, sizeof(header));
+    chunk->dropped = header.dropped;
+    const uint8_t *p = chunk->start + sizeof(header) + (size_t)header.task_count * sizeof(trace_task_name_t);
+    if (header.record_count == 0) {
+        return;
+    }
+
+    // Records are per core, each core in order: times are taken relative
+    // to the first record, which is within 35 minutes of all others
+    trace_record_t rec;
+    memcpy(&rec, p, sizeof(rec));
+    chunk->base_raw = rec.timestamp_us;
+    int64_t first = 0;
+    int64_t last = 0;
+    for (uint32_t i = 0; i < header.record_count; i++, p += header.record_size) {
+        memcpy(&rec, p, sizeof(rec));
+        int64_t t = (int32_t)(rec.timestamp_us - chunk->base_raw);
+        first = t < first ? t : first;
+        last = t > last ? t : last;
+        switch (rec.type) {
+        case TRACE_EVT_FEED:
+            push_event(chunk, t, EV_FEED, rec.arg, NULL, 0);
+            break;
+        case TRACE_EVT_TIMEOUT:
+            push_event(chunk, t, EV_DETECT, rec.arg, NULL, 0);
+            break;
+        case TRACE_EVT_RECOVERY_BEGIN:
+            push_event(chunk, t, EV_ACTION, rec.arg, NULL, 0);
+            break;
+        default:
+            break;
+        }
+    }
+    push_event(chunk, first, EV_MARK, 0, NULL, 0);
+    push_event(chunk, last, EV_MARK, 0, NULL, 0);
+    qsort(chunk->events, chunk->count, sizeof(event_t), compare_events);
+}
+
+static void *worker_main(void *arg)
+{
+    (void)arg;
+    int chunk;
+    while ((chunk = __atomic_fetch_add(&s_next_chunk, 1, __ATOMIC_RELAXED)) < s_chunk_count) {
+        if (s_chunks[chunk].dump) {
+            parse_dump(&s_chunks[chunk]);
+        } else {
+            parse_log(&s_chunks[chunk]);
+        }
+    }
+    return NULL;
+}
+
+static chunk_t *add_chunk(bool dump, const uint8_t *start, const uint8_t *end)
+{
+    if (s_chunk_count == s_chunk_cap) {
+        size_t cap = (size_t)s_chunk_cap;
+        s_chunks = grow(s_chunks, &cap, sizeof(chunk_t));
+        s_chunk_cap = (int)cap;
+    }
+    chunk_t *chunk = &s_chunks[s_chunk_count++];
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->dump = dump;
+    chunk->start = start;
+    chunk->end = end;
+    return chunk;
+}
+
+static void split_log(const uint8_t *data, size_t size, int threads)
+{
+    size_t chunk_size = size / ((size_t)threads * CHUNKS_PER_THREAD);
+    if (chunk_size < MIN_CHUNK) {
+        chunk_size = MIN_CHUNK;
+    }
+    const uint8_t *end = data + size;
+    const uint8_t *p = data;
+    while (p < end) {
+        const uint8_t *next = end;
+        if ((size_t)(end - p) > chunk_size) {
+            next = memchr(p + chunk_size, '\n', end - p - chunk_size);
+            next = next ? next + 1 : end;
+        }
+        add_chunk(false, p, next);
+        p = next;
+    }
+}
+
+static void split_dumps(const char *path, const uint8_t *data, size_t size)
+{
+    size_t off = 0;
+    while (off + sizeof(trace_header_t) <= size) {
+        trace_header_t header;
+        memcpy(&header, data + off, sizeof(header));
+        size_t len = sizeof(header) + (size_t)header.task_count * sizeof(trace_task_name_t) +
+                     (size_t)header.record_count * header.record_size;
+        if (header.magic != TRACE_MAGIC || header.record_size < sizeof(trace_record_t) || off + len > size) {
+            fprintf(stderr, "loganalyze: %s: no complete dump at offset %zu, skipping the rest\n", path, off);
+            return;
+        }
+        add_chunk(true, data + off, data + off + len);
+        off += len;
+    }
+}
+
+//---------------------------------------------------------------------
+// Merge: one pass over all events, in file order
+//---------------------------------------------------------------------
+static user_t *user_named(const char *name, size_t len)
+{
+    for (int i = 0; i < s_user_count; i++) {
+        if (strlen(s_users[i].name) == len && memcmp(s_users[i].name, name, len) == 0) {
+            return &s_users[i];
+        }
+    }
+    if (s_user_count == MAX_USERS) {
+        return NULL;
+    }
+    user_t *user = &s_users[s_user_count++];
+    memcpy(user->name, name, len);
+    user->last_feed = -1;
+    user->last_detect = -1;
+    return user;
+}
+
+static user_t *user_id(uint32_t id)
+{
+    char name[NAME_LEN];
+    int len = snprintf(name, sizeof(name), "user %u", (unsigned)id);
+    return user_named(name, (size_t)len);
+}
+
+static void restore(user_t *user, int64_t t)
+{
+    push_sample(&user->mttr_ms, (t - user->detected) / 1000.0);
+    user->down_us += t - user->fault_start;
+    user->down = false;
+    if (s_verbose) {
+        printf("%12.3f s  %-16s restored after %.1f ms\n", t / 1e6, user->name, (t - user->detected) / 1000.0);
+    }
+}
+
+static void detect(user_t *user, int64_t t, int64_t start)
+{
+    if (user->down) {
+        user->redetections++;
+        return;
+    }
+    user->faults++;
+    user->down = true;
+    user->detected = t;
+    user->fault_start = t;
+    if (start >= 0 && start <= t) {
+        user->fault_start = start;
+        push_sample(&user->latency_ms, (t - start - s_deadline_us) / 1000.0);
+    }
+    if (s_verbose) {
+        printf("%12.3f s  %-16s detected", t / 1e6, user->name);
+        if (start >= 0 && start <= t) {
+            printf(" %.1f ms after the fault started", (t - start) / 1000.0);
+        }
+        printf("\n");
+    }
+
+    if (user->last_detect >= 0) {
+        push_sample(&user->gap_s, (t - user->last_detect) / 1e6);
+    }
+    user->last_detect = t;
+    if (s_last_fault >= 0) {
+        double gap = (t - s_last_fault) / 1e6;
+        push_sample(&s_gaps, gap);
+        int bucket = 0;
+        while (bucket < GAP_BUCKETS - 1 && gap >= (double)(1u << bucket)) {
+            bucket++;
+        }
+        s_gap_hist[bucket]++;
+    }
+    s_last_fault = t;
+}
+
+static void reboot(void)
+{
+    s_reboots++;
+    s_onset = -1;
+    for (int i = 0; i < s_user_count; i++) {
+        if (s_users[i].down) {
+            restore(&s_users[i], s_now);
+        }
+        s_users[i].last_feed = -1;
+    }
+    if (s_verbose) {
+        printf("%12.3f s  reboot\n", s_now / 1e6);
+    }
+}
+
+static void handle(const event_t *ev, int64_t t, bool dump)
+{
+    if (s_first < 0) {
+        s_first = t;
+        s_now = t;
+    }
+    if (t > s_now) {
+        s_now = t;
+    }
+    s_events++;
+
+    user_t *user = NULL;
+    switch (ev->type) {
+    case EV_ONSET:
+        if (s_onset < 0) {
+            s_onset = t;
+        }
+        break;
+    case EV_TWDT:
+        s_twdt += ev->arg;
+        break;
+    case EV_SUPPRESSED:
+        s_suppressed += ev->arg;
+        break;
+    case EV_DETECT:
+        user = dump ? user_id(ev->arg) : user_named(ev->name, ev->name_len);
+        if (user != NULL) {
+            detect(user, t, dump ? user->last_feed : s_onset);
+        }
+        if (!dump) {
+            s_onset = -1;
+        }
+        break;
+    case EV_RESTORED:
+        for (int i = 0; i < s_user_count; i++) {
+            if (s_users[i].down) {
+                restore(&s_users[i], t);
+            }
+        }
+        break;
+    case EV_FEED:
+        user = user_id(ev->arg);
+        if (user != NULL) {
+            if (user->down) {
+                restore(user, t);
+            }
+            user->last_feed = t;
+        }
+        break;
+    case EV_ACTION:
+        user = user_id(ev->arg);
+        if (user != NULL) {
+            user->actions++;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void merge_chunk(const chunk_t *chunk)
+{
+    s_lines += chunk->lines;
+    s_dropped += chunk->dropped;
+
+    if (chunk->dump) {
+        if (chunk->count == 0) {
+            return;
+        }
+        // Carry on from the previous dump through the 32-bit wrap
+        int64_t base = s_first < 0 ? chunk->base_raw : s_now + (int32_t)(chunk->base_raw - s_last_raw32);
+        for (size_t i = 0; i < chunk->count; i++) {
+            handle(&chunk->events[i], base + chunk->events[i].t_us, true);
+        }
+        s_last_raw32 = chunk->base_raw + (uint32_t)(s_now - base);
+        return;
+    }
+
+    for (size_t i = 0; i < chunk->count; i++) {
+        const event_t *ev = &chunk->events[i];
+        if (ev->type == EV_REBOOT || (s_last_raw >= 0 && ev->t_us < s_last_raw)) {
+            if (ev->type == EV_REBOOT && s_offset + (int64_t)ev->arg * 1000 > s_now) {
+                s_now = s_offset + (int64_t)ev->arg * 1000;
+            }
+            reboot();
+            // The reboot takes no time on the stitched timeline
+            s_offset = s_now - ev->t_us;
+        }
+        s_last_raw = ev->t_us;
+        handle(ev, s_offset + ev->t_us, false);
+    }
+}
+
+//---------------------------------------------------------------------
+// Report
+//---------------------------------------------------------------------
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_dist(const char *label, samples_t *s, const char *unit)
+{
+    if (s->n == 0) {
+        printf("    %-18s none\n", label);
+        return;
+    }
+    qsort(s->v, s->n, sizeof(double), compare_doubles);
+    double sum = 0;
+    for (size_t i = 0; i < s->n; i++) {
+        sum += s->v[i];
+    }
+    printf("    %-18s n %zu: avg %.1f, p50 %.1f, p90 %.1f, p99 %.1f, max %.1f %s\n", label, s->n, sum / s->n,
+           s->v[(s->n - 1) / 2], s->v[(size_t)((s->n - 1) * 0.9)], s->v[(size_t)((s->n - 1) * 0.99)],
+           s->v[s->n - 1], unit);
+}
+
+static void print_report(double span_s)
+{
+    printf("Timeline %.1f s, %llu reboots, %llu TWDT firings, %llu detections suppressed by loglimit, "
+           "%llu trace records dropped\n", span_s, (unsigned long long)s_reboots, (unsigned long long)s_twdt,
+           (unsigned long long)s_suppressed, (unsigned long long)s_dropped);
+
+    for (int i = 0; i < s_user_count; i++) {
+        user_t *user = &s_users[i];
+        if (user->down) {
+            user->down_us += s_now - user->fault_start;
+        }
+        double avail = span_s > 0 ? 100.0 * (1 - user->down_us / 1e6 / span_s) : 100.0;
+        printf("  %-16s %u faults, %u more detections while down, %u recovery actions%s; "
+               "availability %.4f%% (%.1f s down)\n", user->name, user->faults, user->redetections, user->actions,
+               user->down ? ", still down at the end" : "", avail, user->down_us / 1e6);
+        print_dist("detection latency", &user->latency_ms, "ms");
+        print_dist("MTTR", &user->mttr_ms, "ms");
+        print_dist("between faults", &user->gap_s, "s");
+    }
+
+    printf("  Between faults of any user\n");
+    print_dist("all", &s_gaps, "s");
+    if (s_gaps.n != 0) {
+        const char *sep = "    ";
+        for (int b = 0; b < GAP_BUCKETS; b++) {
+            if (s_gap_hist[b] == 0) {
+                continue;
+            }
+            if (b == 0) {
+                printf("%s<1 s: %llu", sep, (unsigned long long)s_gap_hist[b]);
+            } else if (b == GAP_BUCKETS - 1) {
+                printf("%s>=%u s: %llu", sep, 1u << (b - 1), (unsigned long long)s_gap_hist[b]);
+            } else {
+                printf("%s%u-%u s: %llu", sep, 1u << (b - 1), 1u << b, (unsigned long long)s_gap_hist[b]);
+            }
+            sep = ", ";
+        }
+        printf("\n");
+    }
+}
+
+static double mono_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while ((opt = getopt(argc, argv, "j:d:v")) != -1) {
+        switch (opt) {
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'd':
+            s_deadline_us = (int64_t)atof(optarg) * 1000;
+            break;
+        case 'v':
+            s_verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-j threads] [-d deadline_ms] [-v] file...\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind == argc || threads <= 0) {
+        fprintf(stderr, "usage: %s [-j threads] [-d deadline_ms] [-v] file...\n", argv[0]);
+        return 2;
+    }
+
+    double start = mono_s();
+    size_t total = 0;
+    for (int i = optind; i < argc; i++) {
+        int fd = open(argv[i], O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            perror(argv[i]);
+            return 1;
+        }
+        if (st.st_size == 0) {
+            close(fd);
+            continue;
+        }
+        const uint8_t *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            perror(argv[i]);
+            return 1;
+        }
+        madvise((void *)data, (size_t)st.st_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+        total += (size_t)st.st_size;
+
+        uint32_t magic = 0;
+        if (st.st_size >= 4) {
+            memcpy(&magic, data, sizeof(magic));
+        }
+        if (magic == TRACE_MAGIC) {
+            split_dumps(argv[i], data, (size_t)st.st_size);
+        } else {
+            split_log(data, (size_t)st.st_size, threads);
+        }
+    }
+
+    pthread_t *pool = calloc(threads, sizeof(pthread_t));
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&pool[i], NULL, worker_main, NULL);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(pool[i], NULL);
+    }
+    double parsed = mono_s();
+
+    for (int i = 0; i < s_chunk_count; i++) {
+        merge_chunk(&s_chunks[i]);
+        free(s_chunks[i].events);
+    }
+    double done = mono_s();
+
+    printf("Read %.1f MB in %.3f s (%.2f GB/s, %d threads, %d chunks; merge %.3f s): %llu lines, %llu events\n",
+           total / 1e6, done - start, total / 1e9 / (done - start), threads, s_chunk_count, done - parsed,
+           (unsigned long long)s_lines, (unsigned long long)s_events);
+    print_report(s_first < 0 ? 0 : (s_now - s_first) / 1e6);
+    return 0;
+}
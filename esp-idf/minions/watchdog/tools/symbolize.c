@@ -0,0 +1,132 @@
+//---------------------------------------------------------------------
+// Offline symboliser for "Backtrace: PC:SP ..." log lines
+//
+// Copies a monitor log to stdout and, after every Backtrace line, prints
+// one resolved frame per line using addr2line from the target toolchain.
+//
+// Build:  cc -O2 -o symbolize tools/symbolize.c
+// Usage:  symbolize -e build/app.elf [-t xtensa-esp32-elf-] [log]
+//         Host build: symbolize -e ./watchdog -t "" watchdog.log
+//---------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_PREFIX                  "xtensa-esp32-elf-"
+#define MAX_FRAMES                      64
+#define LINE_LEN                        4096
+
+static const char *s_elf;
+static const char *s_prefix = DEFAULT_PREFIX;
+
+//---------------------------------------------------------------------
+// Resolve a list of addresses with a single addr2line run
+//---------------------------------------------------------------------
+static void symbolize_frames(const unsigned long *pcs, int count)
+{
+    char cmd[LINE_LEN];
+    int len = snprintf(cmd, sizeof(cmd), "%saddr2line -pfiaC -e '%s'", s_prefix, s_elf);
+    for (int i = 0; i < count && len < (int)sizeof(cmd); i++) {
+        // The return address points after the call; step back into it
+        unsigned long pc = (i > 0 && pcs[i] > 0) ? pcs[i] - 1 : pcs[i];
+        len += snprintf(cmd + len, sizeof(cmd) - len, " 0x%lx", pc);
+    }
+    if (len >= (int)sizeof(cmd)) {
+        fprintf(stderr, "symbolize: backtrace too long\n");
+        return;
+    }
+
+    FILE *pipe = popen(cmd, "r");
+    if (pipe == NULL) {
+        perror("symbolize: popen");
+        return;
+    }
+    char line[LINE_LEN];
+    while (fgets(line, sizeof(line), pipe) != NULL) {
+        printf("    %s", line);
+    }
+    pclose(pipe);
+}
+
+//---------------------------------------------------------------------
+// Pull the PCs out of the text following "Backtrace:"
+//---------------------------------------------------------------------
+static int parse_frames(const char *text, unsigned long *pcs)
+{
+    int count = 0;
+    while (count < MAX_FRAMES) {
+        char *end;
+        unsigned long pc = strtoul(text, &end, 16);
+        if (end == text) {
+            break;
+        }
+        pcs[count++] = pc;
+        // Skip ":SP"
+        text = end;
+        if (*text == ':') {
+            strtoul(text + 1, &end, 16);
+            text = end;
+        }
+    }
+    return count;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s -e <elf> [-t <toolchain prefix>] [log]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "e:t:")) != -1) {
+        switch (opt) {
+        case 'e':
+            s_elf = optarg;
+            break;
+        case 't':
+            s_prefix = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (s_elf == NULL || argc - optind > 1) {
+        usage(argv[0]);
+    }
+
+    FILE *in = stdin;
+    if (optind < argc) {
+        in = fopen(argv[optind], "r");
+        if (in == NULL) {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+
+    char line[LINE_LEN];
+    while (fgets(line, sizeof(line), in) != NULL) {
+        fputs(line, stdout);
+        // The log tag may itself be "Backtrace:", so use the last match
+        const char *tag = NULL;
+        for (const char *p = line; (p = strstr(p, "Backtrace:")) != NULL; p++) {
+            tag = p;
+        }
+        if (tag == NULL) {
+            continue;
+        }
+        unsigned long pcs[MAX_FRAMES];
+        int count = parse_frames(tag + strlen("Backtrace:"), pcs);
+        if (count > 0) {
+            fflush(stdout);
+            symbolize_frames(pcs, count);
+        }
+    }
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    return 0;
+}
@@ -0,0 +1,428 @@
+//---------------------------------------------------------------------
+// Convert a trace recorder dump to Chrome trace JSON
+//
+// Reads either a raw dump (trace.h layout) or a monitor log containing
+// the "TRACE:" hex lines written by trace_dump_to_log(); the last
+// complete dump in a log wins. The JSON opens in chrome://tracing and in
+// ui.perfetto.dev.
+//
+// Build:  cc -O2 -o trace2json tools/trace2json.c
+// Usage:  trace2json [dump.bin | monitor.log] > trace.json
+//---------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+// Layout shared with the recorder
+#define TRACE_MAGIC                     0x52544457u
+#define TRACE_NAME_LEN                  16
+#define TRACE_MAX_CORES                 2
+
+enum {
+    TRACE_EVT_TASK_SWITCH_IN = 1,
+    TRACE_EVT_TASK_CREATE,
+    TRACE_EVT_TASK_DELETE,
+    TRACE_EVT_ISR_ENTER,
+    TRACE_EVT_ISR_EXIT,
+    TRACE_EVT_FEED,
+    TRACE_EVT_TIMEOUT,
+    TRACE_EVT_RECOVERY_BEGIN,
+    TRACE_EVT_RECOVERY_END,
+};
+
+typedef struct {
+    uint32_t timestamp_us;
+    uint8_t type;
+    uint8_t core;
+    uint16_t arg16;
+    uint32_t arg;
+} trace_record_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t task_count;
+    uint32_t record_count;
+    uint32_t dropped;
+} trace_header_t;
+
+typedef struct {
+    uint32_t handle;
+    char name[TRACE_NAME_LEN];
+} trace_task_name_t;
+
+// Nested interrupts tracked per core
+#define MAX_ISR_NESTING                 8
+#define MAX_USERS                       32
+
+typedef struct {
+    trace_record_t rec;
+    uint64_t time_us;               // Unwrapped timestamp
+    uint32_t index;                 // Position in the dump, keeps sorting stable
+} event_t;
+
+static const char *s_level_names[] = { "log", "task-restart", "periph-restart", "system-reset" };
+
+static trace_task_name_t *s_names;
+static uint32_t s_name_count;
+static int s_first_event = 1;
+
+//---------------------------------------------------------------------
+// Input
+//---------------------------------------------------------------------
+static uint8_t *read_all(FILE *in, size_t *out_len)
+{
+    size_t cap = 1 << 16;
+    size_t len = 0;
+    uint8_t *buf = malloc(cap);
+    size_t n;
+    while (buf != NULL && (n = fread(buf + len, 1, cap - len, in)) > 0) {
+        len += n;
+        if (len == cap) {
+            cap *= 2;
+            buf = realloc(buf, cap);
+        }
+    }
+    *out_len = len;
+    return buf;
+}
+
+static int hex_value(int c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c = tolower(c);
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+//---------------------------------------------------------------------
+// Extract the last complete dump from a log of "TRACE:" hex lines
+//---------------------------------------------------------------------
+static uint8_t *decode_log(const uint8_t *text, size_t text_len, size_t *out_len)
+{
+    uint8_t *dump = malloc(text_len / 2 + 1);
+    uint8_t *current = malloc(text_len / 2 + 1);
+    size_t dump_len = 0;
+    size_t len = 0;
+    int complete = 0;
+
+    const char *p = (const char *)text;
+    const char *end = p + text_len;
+    while (p < end) {
+        const char *eol = memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            eol = end;
+        }
+        const char *tag = NULL;
+        for (const char *s = p; s + 6 <= eol; s++) {
+            if (memcmp(s, "TRACE:", 6) == 0) {
+                tag = s + 6;
+                break;
+            }
+        }
+        if (tag != NULL) {
+            if (eol - tag >= 5 && memcmp(tag, "begin", 5) == 0) {
+                len = 0;
+            } else if (eol - tag >= 3 && memcmp(tag, "end", 3) == 0) {
+                memcpy(dump, current, len);
+                dump_len = len;
+                complete = 1;
+            } else {
+                while (tag + 1 < eol && hex_value(tag[0]) >= 0 && hex_value(tag[1]) >= 0) {
+                    current[len++] = (uint8_t)(hex_value(tag[0]) << 4 | hex_value(tag[1]));
+                    tag += 2;
+                }
+            }
+        }
+        p = eol + 1;
+    }
+
+    free(current);
+    if (!complete) {
+        free(dump);
+        return NULL;
+    }
+    *out_len = dump_len;
+    return dump;
+}
+
+//---------------------------------------------------------------------
+// Output
+//---------------------------------------------------------------------
+static const char *task_name(uint32_t handle)
+{
+    static char fallback[32];
+    for (uint32_t i = 0; i < s_name_count; i++) {
+        if (s_names[i].handle == handle) {
+            return s_names[i].name;
+        }
+    }
+    snprintf(fallback, sizeof(fallback), "task 0x%08x", (unsigned)handle);
+    return fallback;
+}
+
+static void emit(const char *fmt_prefix)
+{
+    printf("%s\n    %s", s_first_event ? "" : ",", fmt_prefix);
+    s_first_event = 0;
+}
+
+static void emit_span(int pid, int tid, const char *name, const char *cat, uint64_t start, uint64_t end)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%llu,\"dur\":%llu}",
+             name, cat, pid, tid, (unsigned long long)start, (unsigned long long)(end - start));
+    emit(buf);
+}
+
+static void emit_instant(int pid, int tid, const char *name, const char *cat, uint64_t ts)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"ts\":%llu}",
+             name, cat, pid, tid, (unsigned long long)ts);
+    emit(buf);
+}
+
+static void emit_name(const char *kind, int pid, int tid, const char *name)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+             kind, pid, tid, name);
+    emit(buf);
+}
+
+static int compare_events(const void *a, const void *b)
+{
+    const event_t *x = a;
+    const event_t *y = b;
+    if (x->time_us != y->time_us) {
+        return x->time_us < y->time_us ? -1 : 1;
+    }
+    return x->index < y->index ? -1 : 1;
+}
+
+//---------------------------------------------------------------------
+// Unwrap the 32-bit timestamps. Each core's records are in order, so a
+// step backwards is a wrap; the cores are then aligned to core 0.
+//---------------------------------------------------------------------
+static void unwrap(event_t *events, uint32_t count)
+{
+    uint64_t epoch[TRACE_MAX_CORES] = { 0 };
+    uint32_t last[TRACE_MAX_CORES] = { 0 };
+    int64_t first[TRACE_MAX_CORES];
+    int seen[TRACE_MAX_CORES] = { 0 };
+
+    for (uint32_t i = 0; i < count; i++) {
+        int core = events[i].rec.core % TRACE_MAX_CORES;
+        uint32_t ts = events[i].rec.timestamp_us;
+        if (seen[core] && ts < last[core]) {
+            epoch[core] += 1ull << 32;
+        }
+        last[core] = ts;
+        events[i].time_us = epoch[core] + ts;
+        if (!seen[core]) {
+            first[core] = (int64_t)events[i].time_us;
+            seen[core] = 1;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        int core = events[i].rec.core % TRACE_MAX_CORES;
+        if (core == 0 || !seen[0]) {
+            continue;
+        }
+        int64_t diff = first[core] - first[0];
+        if (diff > (1ll << 31)) {
+            events[i].time_us -= 1ull << 32;
+        } else if (diff < -(1ll << 31)) {
+            events[i].time_us += 1ull << 32;
+        }
+    }
+}
+
+static void convert(const event_t *events, uint32_t count)
+{
+    uint32_t current_task[TRACE_MAX_CORES] = { 0 };
+    uint64_t task_since[TRACE_MAX_CORES] = { 0 };
+    int has_task[TRACE_MAX_CORES] = { 0 };
+    uint64_t isr_since[TRACE_MAX_CORES][MAX_ISR_NESTING];
+    uint16_t isr_irq[TRACE_MAX_CORES][MAX_ISR_NESTING];
+    int isr_depth[TRACE_MAX_CORES] = { 0 };
+    uint64_t recovery_since[MAX_USERS] = { 0 };
+    uint32_t users_seen = 0;
+    uint64_t base = count > 0 ? events[0].time_us : 0;
+    uint64_t last = base;
+    char name[64];
+
+    printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (int core = 0; core < TRACE_MAX_CORES; core++) {
+        snprintf(name, sizeof(name), "CPU %d", core);
+        emit_name("thread_name", 0, core, name);
+    }
+    emit_name("process_name", 0, 0, "Scheduler");
+    emit_name("process_name", 1, 0, "Supervisor");
+
+    for (uint32_t i = 0; i < count; i++) {
+        const trace_record_t *rec = &events[i].rec;
+        int core = rec->core % TRACE_MAX_CORES;
+        uint64_t ts = events[i].time_us - base;
+        uint32_t user = rec->arg % MAX_USERS;
+        last = events[i].time_us;
+
+        switch (rec->type) {
+        case TRACE_EVT_TASK_SWITCH_IN:
+            if (has_task[core]) {
+                emit_span(0, core, task_name(current_task[core]), "task", task_since[core], ts);
+            }
+            current_task[core] = rec->arg;
+            task_since[core] = ts;
+            has_task[core] = 1;
+            break;
+        case TRACE_EVT_TASK_CREATE:
+            snprintf(name, sizeof(name), "create %s", task_name(rec->arg));
+            emit_instant(0, core, name, "task", ts);
+            break;
+        case TRACE_EVT_TASK_DELETE:
+            snprintf(name, sizeof(name), "delete %s", task_name(rec->arg));
+            emit_instant(0, core, name, "task", ts);
+            break;
+        case TRACE_EVT_ISR_ENTER:
+            if (isr_depth[core] < MAX_ISR_NESTING) {
+                isr_since[core][isr_depth[core]] = ts;
+                isr_irq[core][isr_depth[core]] = rec->arg16;
+            }
+            isr_depth[core]++;
+            break;
+        case TRACE_EVT_ISR_EXIT:
+            // An exit without an enter was recorded before the window
+            if (isr_depth[core] > 0) {
+                isr_depth[core]--;
+                if (isr_depth[core] < MAX_ISR_NESTING) {
+                    snprintf(name, sizeof(name), "ISR %u", isr_irq[core][isr_depth[core]]);
+                    emit_span(0, core, name, "isr", isr_since[core][isr_depth[core]], ts);
+                }
+            }
+            break;
+        case TRACE_EVT_FEED:
+            users_seen |= 1u << user;
+            emit_instant(1, user, "feed", "supervisor", ts);
+            break;
+        case TRACE_EVT_TIMEOUT:
+            users_seen |= 1u << user;
+            emit_instant(1, user, "timeout", "supervisor", ts);
+            break;
+        case TRACE_EVT_RECOVERY_BEGIN:
+            users_seen |= 1u << user;
+            recovery_since[user] = ts + 1;
+            break;
+        case TRACE_EVT_RECOVERY_END:
+            if (recovery_since[user] != 0) {
+                snprintf(name, sizeof(name), "recovery %s",
+                         rec->arg16 < 4 ? s_level_names[rec->arg16] : "?");
+                emit_span(1, user, name, "supervisor", recovery_since[user] - 1, ts);
+                recovery_since[user] = 0;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Close the spans still open at the end of the window
+    for (int core = 0; core < TRACE_MAX_CORES; core++) {
+        if (has_task[core]) {
+            emit_span(0, core, task_name(current_task[core]), "task", task_since[core], last - base);
+        }
+    }
+    for (uint32_t user = 0; user < MAX_USERS; user++) {
+        if (users_seen & (1u << user)) {
+            snprintf(name, sizeof(name), "user %u", (unsigned)user);
+            emit_name("thread_name", 1, (int)user, name);
+        }
+    }
+    printf("\n]}\n");
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [dump.bin | monitor.log]\n", argv[0]);
+        return 2;
+    }
+    if (argc == 2) {
+        in = fopen(argv[1], "rb");
+        if (in == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    size_t len;
+    uint8_t *data = read_all(in, &len);
+    if (data == NULL) {
+        fprintf(stderr, "trace2json: out of memory\n");
+        return 1;
+    }
+
+    uint32_t magic = 0;
+    if (len >= sizeof(magic)) {
+        memcpy(&magic, data, sizeof(magic));
+    }
+    if (magic != TRACE_MAGIC) {
+        uint8_t *dump = decode_log(data, len, &len);
+        free(data);
+        if (dump == NULL) {
+            fprintf(stderr, "trace2json: no complete TRACE dump in input\n");
+            return 1;
+        }
+        data = dump;
+    }
+
+    trace_header_t header;
+    if (len < sizeof(header)) {
+        fprintf(stderr, "trace2json: truncated header\n");
+        return 1;
+    }
+    memcpy(&header, data, sizeof(header));
+    size_t need = sizeof(header) + (size_t)header.task_count * sizeof(trace_task_name_t) +
+                  (size_t)header.record_count * sizeof(trace_record_t);
+    if (header.magic != TRACE_MAGIC || header.record_size != sizeof(trace_record_t) || len < need) {
+        fprintf(stderr, "trace2json: bad or truncated dump\n");
+        return 1;
+    }
+
+    s_names = (trace_task_name_t *)(data + sizeof(header));
+    s_name_count = header.task_count;
+    for (uint32_t i = 0; i < s_name_count; i++) {
+        s_names[i].name[TRACE_NAME_LEN - 1] = '\0';
+        // Keep the JSON strings well formed
+        for (char *c = s_names[i].name; *c != '\0'; c++) {
+            if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20) {
+                *c = '_';
+            }
+        }
+    }
+
+    const uint8_t *records = data + sizeof(header) + header.task_count * sizeof(trace_task_name_t);
+    event_t *events = calloc(header.record_count ? header.record_count : 1, sizeof(event_t));
+    for (uint32_t i = 0; i < header.record_count; i++) {
+        memcpy(&events[i].rec, records + i * sizeof(trace_record_t), sizeof(trace_record_t));
+        events[i].index = i;
+    }
+    unwrap(events, header.record_count);
+    qsort(events, header.record_count, sizeof(event_t), compare_events);
+    convert(events, header.record_count);
+
+    fprintf(stderr, "trace2json: %u records, %u tasks, %u dropped\n",
+            (unsigned)header.record_count, (unsigned)header.task_count, (unsigned)header.dropped);
+    free(events);
+    free(data);
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+#include "trace.h"
+
+static const char *TAG = "Trace";
+
+// Bytes per "TRACE:" hex line
+#define LOG_LINE_BYTES                  32
+// trace_record() calls timed by the benchmark
+#define BENCHMARK_EVENTS                1000
+
+_Static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "TRACE_RING_SIZE must be a power of two");
+
+static trace_record_t s_rings[TRACE_MAX_CORES][TRACE_RING_SIZE];
+static volatile uint32_t s_heads[TRACE_MAX_CORES];  // Records ever written per core
+static volatile bool s_running = false;
+
+static hal_task_info_t s_tasks[TRACE_MAX_TASKS];
+
+//---------------------------------------------------------------------
+// Recording
+//---------------------------------------------------------------------
+void HAL_IRAM_ATTR trace_record(trace_event_t type, uint32_t arg, uint16_t arg16)
+{
+    if (!s_running) {
+        return;
+    }
+
+    // Keeping this core to ourselves is enough: nobody else writes its
+    // ring. Linux hosts with more CPUs share rings under the one lock.
+    hal_irq_state_t state = hal_core_lock();
+    int core = hal_core_id() % TRACE_MAX_CORES;
+    uint32_t head = s_heads[core];
+    trace_record_t *rec = &s_rings[core][head & (TRACE_RING_SIZE - 1)];
+    rec->timestamp_us = (uint32_t)hal_time_us();
+    rec->type = (uint8_t)type;
+    rec->core = (uint8_t)core;
+    rec->arg16 = arg16;
+    rec->arg = arg;
+    s_heads[core] = head + 1;
+    hal_core_unlock(state);
+}
+
+#ifdef ESP_PLATFORM
+void HAL_IRAM_ATTR trace_task_switched_in(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandleForCore(hal_core_id());
+    trace_record(TRACE_EVT_TASK_SWITCH_IN, (uint32_t)(uintptr_t)task, 0);
+}
+#endif
+
+void HAL_IRAM_ATTR trace_task_created(void *task)
+{
+    trace_record(TRACE_EVT_TASK_CREATE, (uint32_t)(uintptr_t)task, 0);
+}
+
+void HAL_IRAM_ATTR trace_task_deleted(void *task)
+{
+    trace_record(TRACE_EVT_TASK_DELETE, (uint32_t)(uintptr_t)task, 0);
+}
+
+void HAL_IRAM_ATTR trace_isr_enter(int irq)
+{
+    trace_record(TRACE_EVT_ISR_ENTER, 0, (uint16_t)irq);
+}
+
+void HAL_IRAM_ATTR trace_isr_exit(void)
+{
+    trace_record(TRACE_EVT_ISR_EXIT, 0, 0);
+}
+
+//---------------------------------------------------------------------
+// Control
+//---------------------------------------------------------------------
+esp_err_t trace_init(void)
+{
+#if defined(ESP_PLATFORM) && !defined(TRACE_HOOKS_INCLUDED)
+    HAL_LOGW(TAG, "trace_hooks.h is not force-included, no context switch or ISR events (see trace_hooks.h)");
+#endif
+    s_running = false;
+    for (int core = 0; core < TRACE_MAX_CORES; core++) {
+        s_heads[core] = 0;
+    }
+    return ESP_OK;
+}
+
+void trace_start(void)
+{
+    s_running = true;
+}
+
+void trace_stop(void)
+{
+    s_running = false;
+    // Let a record already in progress on the other core complete
+    hal_delay_us(5);
+}
+
+//---------------------------------------------------------------------
+// Dump
+//---------------------------------------------------------------------
+esp_err_t trace_dump(trace_write_fn_t write, void *arg)
+{
+    if (write == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t task_count = (uint32_t)hal_task_list(s_tasks, TRACE_MAX_TASKS);
+
+    trace_header_t header = {
+        .magic = TRACE_MAGIC,
+        .version = TRACE_VERSION,
+        .record_size = sizeof(trace_record_t),
+        .task_count = task_count,
+    };
+    for (int core = 0; core < TRACE_MAX_CORES; core++) {
+        uint32_t head = s_heads[core];
+        uint32_t count = head < TRACE_RING_SIZE ? head : TRACE_RING_SIZE;
+        header.record_count += count;
+        header.dropped += head - count;
+    }
+
+    esp_err_t err = write(&header, sizeof(header), arg);
+
+    for (uint32_t i = 0; err == ESP_OK && i < task_count; i++) {
+        trace_task_name_t entry = { .handle = (uint32_t)(uintptr_t)s_tasks[i].handle };
+        strncpy(entry.name, s_tasks[i].name, TRACE_NAME_LEN - 1);
+        err = write(&entry, sizeof(entry), arg);
+    }
+
+    // Oldest first; a wrapped ring is written in two pieces
+    for (int core = 0; err == ESP_OK && core < TRACE_MAX_CORES; core++) {
+        uint32_t head = s_heads[core];
+        uint32_t count = head < TRACE_RING_SIZE ? head : TRACE_RING_SIZE;
+        uint32_t start = (head - count) & (TRACE_RING_SIZE - 1);
+        uint32_t first = count < TRACE_RING_SIZE - start ? count : TRACE_RING_SIZE - start;
+        if (first > 0) {
+            err = write(&s_rings[core][start], first * sizeof(trace_record_t), arg);
+        }
+        if (err == ESP_OK && count > first) {
+            err = write(&s_rings[core][0], (count - first) * sizeof(trace_record_t), arg);
+        }
+    }
+    return err;
+}
+
+typedef struct {
+    uint8_t bytes[LOG_LINE_BYTES];
+    size_t len;
+} log_line_t;
+
+static void flush_log_line(log_line_t *line)
+{
+    char hex[LOG_LINE_BYTES * 2 + 1];
+    for (size_t i = 0; i < line->len; i++) {
+        snprintf(&hex[i * 2], 3, "%02x", line->bytes[i]);
+    }
+    hex[line->len * 2] = '\0';
+    HAL_LOGI(TAG, "TRACE:%s", hex);
+    line->len = 0;
+}
+
+static esp_err_t write_log(const void *data, size_t len, void *arg)
+{
+    log_line_t *line = (log_line_t *)arg;
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        line->bytes[line->len++] = bytes[i];
+        if (line->len == LOG_LINE_BYTES) {
+            flush_log_line(line);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t trace_dump_to_log(void)
+{
+    static log_line_t line;
+    line.len = 0;
+
+    HAL_LOGI(TAG, "TRACE:begin");
+    esp_err_t err = trace_dump(write_log, &line);
+    if (line.len > 0) {
+        flush_log_line(&line);
+    }
+    HAL_LOGI(TAG, "TRACE:end");
+    return err;
+}
+
+//---------------------------------------------------------------------
+// Overhead measurement
+//---------------------------------------------------------------------
+void trace_benchmark(void)
+{
+    bool was_running = s_running;
+    s_running = true;
+
+    uint32_t start = hal_cycles();
+    for (int i = 0; i < BENCHMARK_EVENTS; i++) {
+        trace_record(TRACE_EVT_FEED, (uint32_t)i, 0);
+    }
+    uint32_t cycles = (hal_cycles() - start) / BENCHMARK_EVENTS;
+
+    // Discard the benchmark records
+    s_running = false;
+    trace_init();
+    s_running = was_running;
+
+    uint32_t mhz = hal_cycles_per_us();
+    HAL_LOGI(TAG, "trace_record(): %lu cycles/event (%lu ns at %lu MHz)",
+             (unsigned long)cycles, (unsigned long)(mhz ? cycles * 1000 / mhz : 0), (unsigned long)mhz);
+}
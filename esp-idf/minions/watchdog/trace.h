@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hal.h"
+
+// Records per core ring; each record is 12 bytes
+#define TRACE_RING_SIZE                 1024
+#define TRACE_MAX_CORES                 2
+// Task names stored in a dump, for the converter's track names
+#define TRACE_MAX_TASKS                 32
+#define TRACE_NAME_LEN                  16
+
+#define TRACE_MAGIC                     0x52544457u     // "WDTR"
+#define TRACE_VERSION                   1
+
+typedef enum {
+    TRACE_EVT_TASK_SWITCH_IN = 1,   // arg: task handle
+    TRACE_EVT_TASK_CREATE,          // arg: task handle
+    TRACE_EVT_TASK_DELETE,          // arg: task handle
+    TRACE_EVT_ISR_ENTER,            // arg16: interrupt number
+    TRACE_EVT_ISR_EXIT,
+    TRACE_EVT_FEED,                 // arg: supervisor user
+    TRACE_EVT_TIMEOUT,              // arg: supervisor user
+    TRACE_EVT_RECOVERY_BEGIN,       // arg: supervisor user, arg16: escalation level
+    TRACE_EVT_RECOVERY_END,         // arg: supervisor user, arg16: escalation level
+} trace_event_t;
+
+//---------------------------------------------------------------------
+// Binary scheduling trace
+//
+// Every core appends to its own ring with interrupts masked on that core
+// only, so recording never takes a lock shared between cores. The rings
+// overwrite their oldest records; stop the recorder before dumping to
+// keep the window leading up to an incident.
+//
+// Context switches and ISRs come from the FreeRTOS trace macros in
+// trace_hooks.h; feeds, timeouts and recoveries from probes in the
+// supervisor and escalation modules. tools/trace2json.c converts a dump
+// to Chrome trace JSON, which chrome://tracing and ui.perfetto.dev open.
+//
+// Dump layout, little endian:
+//   trace_header_t
+//   trace_task_name_t  x task_count
+//   trace_record_t     x record_count, each core's records in order
+//---------------------------------------------------------------------
+typedef struct {
+    uint32_t timestamp_us;          // Low 32 bits of esp_timer_get_time()
+    uint8_t type;                   // trace_event_t
+    uint8_t core;
+    uint16_t arg16;
+    uint32_t arg;
+} trace_record_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t task_count;
+    uint32_t record_count;
+    uint32_t dropped;               // Records overwritten before the dump
+} trace_header_t;
+
+typedef struct {
+    uint32_t handle;
+    char name[TRACE_NAME_LEN];
+} trace_task_name_t;
+
+// Sink for trace_dump(); returns ESP_OK to continue
+typedef esp_err_t (*trace_write_fn_t)(const void *data, size_t len, void *arg);
+
+esp_err_t trace_init(void);
+
+void trace_start(void);
+void trace_stop(void);
+
+// Append a record on the calling core. Safe from tasks and ISRs and from
+// inside critical sections; does nothing while the recorder is stopped.
+void trace_record(trace_event_t type, uint32_t arg, uint16_t arg16);
+
+// Stream the stopped recorder's contents through a sink
+esp_err_t trace_dump(trace_write_fn_t write, void *arg);
+
+// Log the dump as hex lines prefixed "TRACE:" for tools/trace2json.c
+esp_err_t trace_dump_to_log(void);
+
+// Measure the cost of trace_record() and log cycles per event
+void trace_benchmark(void);
+
+// Entry points for the FreeRTOS trace macros in trace_hooks.h
+void trace_task_switched_in(void);
+void trace_task_created(void *task);
+void trace_task_deleted(void *task);
+void trace_isr_enter(int irq);
+void trace_isr_exit(void);
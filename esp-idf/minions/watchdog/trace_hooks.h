@@ -0,0 +1,39 @@
+#pragma once
+
+//---------------------------------------------------------------------
+// FreeRTOS trace macros feeding the trace recorder
+//
+// FreeRTOS only picks these up if they are defined before its own
+// headers while the freertos component itself is compiled, so a
+// component-level option is not enough. This is a manual step in the
+// project's top-level CMakeLists.txt, between including project.cmake
+// and project(), with these sources as the main component:
+//
+//   include($ENV{IDF_PATH}/tools/cmake/project.cmake)
+//   idf_build_set_property(COMPILE_OPTIONS
+//       "-include" "${CMAKE_CURRENT_LIST_DIR}/main/trace_hooks.h" APPEND)
+//   project(watchdog)
+//
+// Without it the recorder still logs the supervisor probes, only the
+// context switch and ISR tracks stay empty; trace_init() warns about
+// that. The hooks run in the scheduler with interrupts masked and must
+// stay in IRAM.
+//---------------------------------------------------------------------
+#define TRACE_HOOKS_INCLUDED            1
+
+#ifndef __ASSEMBLER__
+
+void trace_task_switched_in(void);
+void trace_task_created(void *task);
+void trace_task_deleted(void *task);
+void trace_isr_enter(int irq);
+void trace_isr_exit(void);
+
+#define traceTASK_SWITCHED_IN()             trace_task_switched_in()
+#define traceTASK_CREATE(pxNewTCB)          trace_task_created((void *)(pxNewTCB))
+#define traceTASK_DELETE(pxTCB)             trace_task_deleted((void *)(pxTCB))
+#define traceISR_ENTER(n)                   trace_isr_enter(n)
+#define traceISR_EXIT()                     trace_isr_exit()
+#define traceISR_EXIT_TO_SCHEDULER()        trace_isr_exit()
+
+#endif
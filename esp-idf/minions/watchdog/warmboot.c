@@ -0,0 +1,238 @@
+#include <stddef.h>
+#include <string.h>
+#include "hal.h"
+#include "warmboot.h"
+
+static const char *TAG = "Warmboot";
+
+// How often warmboot_report_ttff() looks at the first feeds
+#define TTFF_POLL_MS                    5
+
+typedef struct {
+    char name[SUPERVISOR_NAME_LEN];
+    uint32_t samples;
+    float mean_ms;
+    float sigma_ms;
+} warmboot_model_t;
+
+typedef struct {
+    uint32_t magic;
+    warmboot_stats_t stats;
+    uint32_t model_count;
+    warmboot_model_t models[SUPERVISOR_MAX_USERS];
+    uint32_t crc;                   // CRC-32 of everything above
+} warmboot_state_t;
+
+// Left alone by software, panic and watchdog resets
+HAL_NOINIT_ATTR static warmboot_state_t s_state;
+
+static bool s_warm = false;
+static int s_reason;
+static hal_spinlock_t s_lock = HAL_SPINLOCK_INIT;
+
+static uint32_t state_crc(void)
+{
+    return hal_crc32_le(0, (const uint8_t *)&s_state, offsetof(warmboot_state_t, crc));
+}
+
+static bool state_valid(void)
+{
+    return s_state.magic == WARMBOOT_MAGIC && s_state.model_count <= SUPERVISOR_MAX_USERS &&
+           s_state.crc == state_crc();
+}
+
+#ifdef ESP_PLATFORM
+#include "esp_system.h"
+
+static int reset_reason(void)
+{
+    return esp_reset_reason();
+}
+
+static bool reason_is_warm(int reason)
+{
+    switch (reason) {
+    case ESP_RST_SW:
+    case ESP_RST_PANIC:
+    case ESP_RST_INT_WDT:
+    case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+#else // Host build
+
+// HAL_NOINIT_ATTR is plain .bss in a process, so nothing survives and
+// every start is a cold boot
+static int reset_reason(void)
+{
+    return 0;
+}
+
+static bool reason_is_warm(int reason)
+{
+    (void)reason;
+    return false;
+}
+
+#endif // ESP_PLATFORM
+
+//---------------------------------------------------------------------
+// Public API
+//---------------------------------------------------------------------
+bool warmboot_begin(void)
+{
+    s_reason = reset_reason();
+    bool valid = state_valid();
+    s_warm = valid && reason_is_warm(s_reason);
+
+    hal_enter_critical(&s_lock);
+    if (!valid) {
+        // Power-on contents; nothing to keep
+        memset(&s_state, 0, sizeof(s_state));
+        s_state.magic = WARMBOOT_MAGIC;
+    }
+    if (!s_warm) {
+        // The timing history is still worth keeping if RTC memory
+        // survived, the models are not
+        s_state.model_count = 0;
+        memset(s_state.models, 0, sizeof(s_state.models));
+    } else {
+        s_state.stats.warm_boots++;
+    }
+    s_state.stats.boot_count++;
+    s_state.crc = state_crc();
+    hal_exit_critical(&s_lock);
+
+    if (s_warm) {
+        HAL_LOGW(TAG, "Warm boot %lu (reset reason %d), %lu saved models",
+                 (unsigned long)s_state.stats.boot_count, (int)s_reason, (unsigned long)s_state.model_count);
+    } else {
+        HAL_LOGI(TAG, "Cold boot (reset reason %d)", (int)s_reason);
+    }
+    return s_warm;
+}
+
+bool warmboot_is_warm(void)
+{
+    return s_warm;
+}
+
+void warmboot_save(void)
+{
+    // Read the models first; supervisor_get_info() takes its own lock
+    warmboot_model_t models[SUPERVISOR_MAX_USERS];
+    uint32_t count = 0;
+    for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+        supervisor_user_info_t info;
+        if (supervisor_get_info(i, &info) != ESP_OK) {
+            continue;
+        }
+        memcpy(models[count].name, info.name, SUPERVISOR_NAME_LEN);
+        models[count].samples = info.samples;
+        models[count].mean_ms = info.mean_ms;
+        models[count].sigma_ms = info.sigma_ms;
+        count++;
+    }
+
+    // A reset in the middle of this leaves a bad CRC, i.e. a cold boot
+    hal_enter_critical(&s_lock);
+    s_state.model_count = count;
+    memcpy(s_state.models, models, count * sizeof(models[0]));
+    s_state.crc = state_crc();
+    hal_exit_critical(&s_lock);
+}
+
+int warmboot_restore_users(void)
+{
+    if (!s_warm) {
+        return 0;
+    }
+
+    int restored = 0;
+    for (uint32_t i = 0; i < s_state.model_count; i++) {
+        const warmboot_model_t *model = &s_state.models[i];
+        supervisor_user_id_t id = supervisor_find_user(model->name);
+        if (id < 0 || supervisor_restore_model(id, model->samples, model->mean_ms, model->sigma_ms) != ESP_OK) {
+            continue;
+        }
+
+        supervisor_user_info_t info;
+        supervisor_get_info(id, &info);
+        HAL_LOGI(TAG, "  %-16s restored %.0f +/- %.0f ms (%lu samples), deadline %lu ms",
+                 model->name, model->mean_ms, model->sigma_ms,
+                 (unsigned long)model->samples, (unsigned long)info.deadline_ms);
+        restored++;
+    }
+    return restored;
+}
+
+esp_err_t warmboot_report_ttff(uint32_t mask, uint32_t timeout_ms)
+{
+    if (mask == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t ttff_us = 0;
+    uint32_t missing = 0;
+    int64_t give_up = hal_time_us() + (int64_t)timeout_ms * 1000;
+    while (1) {
+        missing = 0;
+        ttff_us = 0;
+        for (int i = 0; i < SUPERVISOR_MAX_USERS; i++) {
+            supervisor_user_info_t info;
+            if (!(mask & (1u << i)) || supervisor_get_info(i, &info) != ESP_OK) {
+                continue;
+            }
+            if (info.first_feed_us == 0) {
+                missing |= (1u << i);
+            } else if (info.first_feed_us > ttff_us) {
+                ttff_us = info.first_feed_us;
+            }
+        }
+        if (missing == 0 || hal_time_us() >= give_up) {
+            break;
+        }
+        hal_delay_ms(TTFF_POLL_MS);
+    }
+
+    if (missing != 0) {
+        HAL_LOGW(TAG, "No first feed from users 0x%02lx within %lu ms", (unsigned long)missing,
+                 (unsigned long)timeout_ms);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    hal_enter_critical(&s_lock);
+    if (s_warm) {
+        s_state.stats.last_warm_ttff_us = (uint32_t)ttff_us;
+    } else {
+        s_state.stats.last_cold_ttff_us = (uint32_t)ttff_us;
+    }
+    s_state.crc = state_crc();
+    warmboot_stats_t stats = s_state.stats;
+    hal_exit_critical(&s_lock);
+
+    uint32_t other_us = s_warm ? stats.last_cold_ttff_us : stats.last_warm_ttff_us;
+    if (other_us == 0) {
+        HAL_LOGI(TAG, "TTFF %lu us (%s boot), no %s boot measured yet", (unsigned long)ttff_us,
+                 s_warm ? "warm" : "cold", s_warm ? "cold" : "warm");
+    } else {
+        HAL_LOGI(TAG, "TTFF %lu us (%s boot) vs %lu us last %s boot (%+ld us)", (unsigned long)ttff_us,
+                 s_warm ? "warm" : "cold", (unsigned long)other_us, s_warm ? "cold" : "warm",
+                 (long)((int64_t)ttff_us - other_us));
+    }
+    return ESP_OK;
+}
+
+void warmboot_get_stats(warmboot_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    hal_enter_critical(&s_lock);
+    *out = s_state.stats;
+    hal_exit_critical(&s_lock);
+}
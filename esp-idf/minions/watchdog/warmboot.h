@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+#include "supervisor.h"
+
+#define WARMBOOT_MAGIC                  0x544d5257u     // "WRMT"
+
+//---------------------------------------------------------------------
+// Warm boot after a watchdog reset
+//
+// The supervisor models (samples, mean and deviation of every user's
+// feed interval) are copied into RTC memory that survives a software,
+// panic or watchdog reset. A boot with one of those reset reasons and an
+// intact copy is warm: the application restores the models right after
+// registering its users, so their learned deadlines are armed from the
+// first feed on instead of after warmup, and it can skip work that only
+// matters on a cold start.
+//
+// Time to first feed (TTFF) is the time since boot until every user
+// given to warmboot_report_ttff() has fed once. The last cold and the
+// last warm TTFF are kept in the same RTC block so each boot is logged
+// against the other kind.
+//---------------------------------------------------------------------
+typedef struct {
+    uint32_t boot_count;            // Boots since power-on
+    uint32_t warm_boots;
+    uint32_t last_cold_ttff_us;     // 0 until measured
+    uint32_t last_warm_ttff_us;
+} warmboot_stats_t;
+
+// Check the reset reason and the preserved state. Returns true on a warm
+// boot; on a cold one the preserved models are dropped.
+bool warmboot_begin(void);
+
+bool warmboot_is_warm(void);
+
+// Copy the current supervisor models into RTC memory. Call after each
+// recovery round and right before a controlled reset.
+void warmboot_save(void);
+
+// Seed registered users with the models saved before the reset, matched
+// by name. Returns the number of users restored.
+int warmboot_restore_users(void);
+
+// Wait up to timeout_ms for every user in mask to feed once, then log the
+// TTFF of this boot against the last boot of the other kind
+esp_err_t warmboot_report_ttff(uint32_t mask, uint32_t timeout_ms);
+
+void warmboot_get_stats(warmboot_stats_t *out);
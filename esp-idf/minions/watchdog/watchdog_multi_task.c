@@ -6,7 +6,30 @@
 #include "esp_system.h"
 #include "esp_log.h"
 #include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "esp_mac.h"
+#include "esp_rom_crc.h"
 #include "driver/gpio.h"
+#include "supervisor.h"
+#include "supervise.h"
+#include "escalation.h"
+#include "checkpoint.h"
+#include "breaker.h"
+#include "depgraph.h"
+#include "lockmon.h"
+#include "snapshot.h"
+#include "backtrace.h"
+#include "trace.h"
+#include "crashdump.h"
+#include "statlog.h"
+#include "warmboot.h"
+#include "startprof.h"
+#include "jobrunner.h"
+#include "workpool.h"
+#include "shardsup.h"
+#include "loglimit.h"
+#include "supstats.h"
+#include "beacon.h"
 
 static const char *TAG = "TWDT_Example";
 
@@ -17,13 +40,53 @@ static const char *TAG = "TWDT_Example";
 #define STATUS_LED                  GPIO_NUM_2
 #define STATUS_LED_2                 GPIO_NUM_15
 
+// Set to 1 to measure snapshot cost with 10, 50 and 100 tasks at startup
+#define RUN_SNAPSHOT_BENCHMARK      0
+// Set to 1 to measure the trace recorder's cost per event at startup
+#define RUN_TRACE_BENCHMARK         0
+// Set to 1 to log the scheduling trace leading up to each recovery as
+// TRACE: lines for tools/trace2json.c. The whole ring is ~70 KB of log,
+// seconds of UART time with the recovery task blocked and the trace
+// stopped, so only enable it while chasing a specific stall.
+#define DUMP_TRACE_ON_RECOVERY      0
+// Set to 1 to measure the job runner's cost per step at startup
+#define RUN_JOBRUNNER_BENCHMARK     0
+// Set to 1 to measure worker pool scaling from 1 to all cores at startup
+#define RUN_WORKPOOL_BENCHMARK      0
+// Set to 1 to measure per-core scan and feed cost of the sharded
+// supervisor against one shared table at startup
+#define RUN_SHARDSUP_BENCHMARK      0
+
+// Set to 1 to send fleet heartbeat beacons to tools/fleetcollector.c;
+// needs the network brought up before app_main gets here
+#define ENABLE_FLEET_BEACON         0
+#define FLEET_COLLECTOR_IP          "192.168.1.10"
+
+// Small periodic jobs sharing one supervised runner task instead of a
+// task each; job i runs every JOB_PERIOD_MS + i ms
+#define JOB_COUNT                   100
+#define JOB_PERIOD_MS               100
+
+// Every POOL_BURST_MS a job splits a checksum of POOL_CHUNKS chunks over
+// the worker pool and gives the burst POOL_BURST_MS / 2 to finish
+#define POOL_BURST_MS               1000
+#define POOL_CHUNKS                 8
+#define POOL_CHUNK_SIZE             1024
+
+// Fixed supervisor ids of the test users, so their tasks can feed with
+// SUPERVISE_FEED()
+#define TEST_USER_ID                0
+#define TEST_2_USER_ID              1
+
+// Shortest time between two rounds of module reports
+#define REPORT_INTERVAL_MS          10000
+
 // Event group bits
 #define RECOVERY_ACTIVE_BIT         BIT0
 
 // Global variables
 static EventGroupHandle_t event_group;
-static esp_task_wdt_user_handle_t twdt_user_handle;
-static esp_task_wdt_user_handle_t twdt_user_2_handle;
+static lockmon_mutex_t shared_resource;
 static volatile bool g_watchdog_timeout_occurred = false;
 
 // Define a buffer to store the task/user names
@@ -31,12 +94,35 @@ static volatile bool g_watchdog_timeout_occurred = false;
 static char failed_task_name[MAX_TASK_NAME_LEN];
 static bool capturing_task_name = false;
 static bool task_name_captured = false;
+static uint32_t twdt_reported_mask;
+
+// State of one periodic job; stackless jobs keep nothing in locals
+typedef struct {
+    uint32_t period_ms;
+    uint32_t count;
+} periodic_job_t;
+static periodic_job_t periodic_jobs[JOB_COUNT];
+
+// One checksum burst on the worker pool; work items stay valid until run
+typedef struct {
+    uint8_t data[POOL_CHUNKS][POOL_CHUNK_SIZE];
+    uint32_t crc[POOL_CHUNKS];
+    workpool_work_t work[POOL_CHUNKS];
+    volatile uint32_t done_mask;    // Chunks checksummed in this burst
+    int64_t start_us;
+    uint32_t bursts;
+    uint32_t late;                  // Not finished in time, e.g. a worker was stuck
+} pool_burst_t;
+static pool_burst_t pool_burst;
 
 // Forward declarations
 static void init_gpio(void);
 static void test_task(void *pvParameters);
 static void recovery_task(void *pvParameters);
 static void init_watchdog(void);
+static void init_supervisor(void);
+static void init_escalation(void);
+static void init_breaker(void);
 
 //---------------------------------------------------------------------
 // Custom TWDT User Handler - MUST be minimal and ISR-safe
@@ -60,6 +146,7 @@ void esp_task_wdt_isr_user_handler(void)
 // Custom Message Handler to capture task names
 //--------------------------------------------------------------------
 static void twdt_msg_handler(void *opaque, const char *msg) {
+    (void)opaque;
     // Check if we're starting a new task entry
     if (strstr(msg, " -") != NULL) {
         capturing_task_name = true;
@@ -74,6 +161,11 @@ static void twdt_msg_handler(void *opaque, const char *msg) {
             strncpy(failed_task_name, msg, MAX_TASK_NAME_LEN - 1);
             failed_task_name[MAX_TASK_NAME_LEN - 1] = '\0'; // Ensure null termination
             task_name_captured = true;
+            supervisor_user_id_t id = supervisor_find_user(failed_task_name);
+            if (id >= 0) {
+                supervisor_report_timeout(id);
+                twdt_reported_mask |= (1u << id);
+            }
         }
     }
     
@@ -116,16 +208,240 @@ static void init_watchdog(void)
     ESP_LOGI(TAG, "TWDT initialized with timeout: %d ms", WATCHDOG_TIMEOUT_MS);
 }
 
+//---------------------------------------------------------------------
+// Supervisor timeout callback - runs in the supervisor task
+//---------------------------------------------------------------------
+static void on_supervisor_timeout(supervisor_user_id_t id, void *arg)
+{
+    (void)arg;
+    // Capture the scheduler state before anything else runs
+    snapshot_capture(1u << id);
+    backtrace_capture_user(id);
+    xEventGroupSetBits(event_group, RECOVERY_ACTIVE_BIT);
+}
+
+//---------------------------------------------------------------------
+// Supervisor recovered callback - first feed after a recovery action
+//---------------------------------------------------------------------
+static void on_supervisor_recovered(supervisor_user_id_t id, int64_t detect_us, void *arg)
+{
+    breaker_on_recovered(id);
+    escalation_on_recovered(id, detect_us, arg);
+    statlog_note_recovered(id, (uint32_t)((esp_timer_get_time() - detect_us) / 1000));
+}
+
+//---------------------------------------------------------------------
+// Initialize the supervisor with adaptive per-user deadlines. The TWDT
+// keeps its fixed timeout as the safety net.
+//---------------------------------------------------------------------
+static void init_supervisor(void)
+{
+    supervisor_config_t config = SUPERVISOR_CONFIG_DEFAULT();
+    config.fixed_timeout_ms = WATCHDOG_TIMEOUT_MS;
+    config.max_timeout_ms = WATCHDOG_TIMEOUT_MS;
+    config.adaptive = true;
+    config.on_timeout = on_supervisor_timeout;
+    config.on_recovered = on_supervisor_recovered;
+
+    ESP_ERROR_CHECK(supervisor_init(&config));
+}
+
+//---------------------------------------------------------------------
+// Deadlock callback - flag the users in the cycle right away instead of
+// waiting for their deadlines
+//---------------------------------------------------------------------
+static void on_deadlock(const lockmon_deadlock_t *report, void *arg)
+{
+    (void)arg;
+    uint32_t mask = 0;
+    for (int i = 0; i < report->length; i++) {
+        if (report->users[i] >= 0) {
+            supervisor_report_timeout(report->users[i]);
+            mask |= (1u << report->users[i]);
+        }
+    }
+    snapshot_capture(mask);
+    backtrace_capture_mask(mask);
+    xEventGroupSetBits(event_group, RECOVERY_ACTIVE_BIT);
+}
+
+//---------------------------------------------------------------------
+// Peripheral restart hook - reset the LED pin a task drives
+//---------------------------------------------------------------------
+static esp_err_t restart_led(supervisor_user_id_t id, void *arg)
+{
+    (void)id;
+    gpio_num_t led = (gpio_num_t)(intptr_t)arg;
+
+    esp_err_t err = gpio_reset_pin(led);
+    if (err == ESP_OK) {
+        err = gpio_set_direction(led, GPIO_MODE_OUTPUT);
+    }
+    if (err == ESP_OK) {
+        err = gpio_set_level(led, 0);
+    }
+    return err;
+}
+
+//---------------------------------------------------------------------
+// Reset hook - keep the state that led to the reset for the next boot
+//---------------------------------------------------------------------
+static void on_system_reset(supervisor_user_id_t id, void *arg)
+{
+    (void)arg;
+    warmboot_save();
+    statlog_flush();
+    crashdump_write(id);
+}
+
+//---------------------------------------------------------------------
+// Escalation policy: log, restart the task twice, restart its LED, then
+// reset the system with a crash dump
+//---------------------------------------------------------------------
+static void init_escalation(void)
+{
+    escalation_set_reset_hook(on_system_reset, NULL);
+
+    escalation_policy_t policy = ESCALATION_POLICY_DEFAULT();
+    policy.periph_restart = restart_led;
+
+    policy.periph_arg = (void *)(intptr_t)STATUS_LED;
+    ESP_ERROR_CHECK(escalation_set_policy(TEST_USER_ID, &policy));
+
+    policy.periph_arg = (void *)(intptr_t)STATUS_LED_2;
+    ESP_ERROR_CHECK(escalation_set_policy(TEST_2_USER_ID, &policy));
+}
+
+//---------------------------------------------------------------------
+// Limit recovery attempts: per-user breakers with the default token
+// bucket, and at most 10% of each second spent in recovery actions
+//---------------------------------------------------------------------
+static void init_breaker(void)
+{
+    breaker_budget_t budget = BREAKER_BUDGET_DEFAULT();
+    ESP_ERROR_CHECK(breaker_init(&budget));
+}
+
+//---------------------------------------------------------------------
+// Periodic job - counts its runs and feeds its own deadline
+//---------------------------------------------------------------------
+static job_status_t periodic_job(job_t *job, void *arg)
+{
+    periodic_job_t *state = (periodic_job_t *)arg;
+
+    JOB_BEGIN(job);
+    while (1) {
+        state->count++;
+        JOB_FEED(job);
+        JOB_EVERY(job, state->period_ms);
+    }
+    JOB_END(job);
+}
+
+//---------------------------------------------------------------------
+// Job timeout callback - runs in the job's runner; start it over
+//---------------------------------------------------------------------
+static void on_job_timeout(job_t *job, void *arg)
+{
+    (void)arg;
+    jobrunner_restart_job(job);
+}
+
+//---------------------------------------------------------------------
+// Run the periodic jobs on one runner task, each with a deadline of
+// twice its period
+//---------------------------------------------------------------------
+static void init_jobs(void)
+{
+    ESP_ERROR_CHECK(jobrunner_start(0, "jobs", tskNO_AFFINITY, 4, on_job_timeout, NULL));
+    for (int i = 0; i < JOB_COUNT; i++) {
+        periodic_jobs[i].period_ms = JOB_PERIOD_MS + i;
+        ESP_ERROR_CHECK(jobrunner_add_job(0, "periodic", periodic_job, &periodic_jobs[i],
+                                          2 * periodic_jobs[i].period_ms, NULL));
+    }
+}
+
+//---------------------------------------------------------------------
+// Pool work - checksum one chunk of the burst on whichever core is free
+//---------------------------------------------------------------------
+static void checksum_chunk(void *arg)
+{
+    int chunk = (int)(intptr_t)arg;
+    pool_burst.crc[chunk] = esp_rom_crc32_le(0, pool_burst.data[chunk], POOL_CHUNK_SIZE);
+    __atomic_or_fetch(&pool_burst.done_mask, 1u << chunk, __ATOMIC_RELEASE);
+}
+
+//---------------------------------------------------------------------
+// Burst job - hands a burst to the pool and waits for it before the
+// next one. A chunk that finishes after its burst gave up may mark the
+// same chunk of the next burst done early.
+//---------------------------------------------------------------------
+static job_status_t pool_burst_job(job_t *job, void *arg)
+{
+    pool_burst_t *burst = (pool_burst_t *)arg;
+    const uint32_t all = (1u << POOL_CHUNKS) - 1;
+
+    JOB_BEGIN(job);
+    while (1) {
+        __atomic_store_n(&burst->done_mask, 0, __ATOMIC_RELAXED);
+        burst->start_us = job->now_us;
+        for (int i = 0; i < POOL_CHUNKS; i++) {
+            burst->data[i][0] = (uint8_t)burst->bursts;
+            burst->work[i] = (workpool_work_t) {
+                .fn = checksum_chunk,
+                .arg = (void *)(intptr_t)i,
+                .name = "checksum_chunk",
+            };
+            if (workpool_submit(&burst->work[i]) != ESP_OK) {
+                checksum_chunk((void *)(intptr_t)i);
+            }
+        }
+        JOB_WAIT_UNTIL(job, __atomic_load_n(&burst->done_mask, __ATOMIC_ACQUIRE) == all ||
+                            job->now_us - burst->start_us > POOL_BURST_MS / 2 * 1000);
+        if (__atomic_load_n(&burst->done_mask, __ATOMIC_ACQUIRE) == all) {
+            burst->bursts++;
+        } else {
+            burst->late++;
+            ESP_LOGW(TAG, "Checksum burst %lu not done after %d ms", (unsigned long)burst->bursts,
+                     POOL_BURST_MS / 2);
+        }
+        JOB_FEED(job);
+        JOB_SLEEP(job, POOL_BURST_MS);
+    }
+    JOB_END(job);
+}
+
+//---------------------------------------------------------------------
+// The test tasks stop feeding for counter 4..10 and 20..30. A task
+// restarted during one of those stalls resumes right after it; resuming
+// inside it would only miss again and climb the ladder to a reset.
+//---------------------------------------------------------------------
+static int skip_stall(int counter)
+{
+    if (counter >= 4 && counter <= 10) {
+        return 10;
+    }
+    if (counter >= 20 && counter <= 30) {
+        return 30;
+    }
+    return counter;
+}
+
 //---------------------------------------------------------------------
 // Test Task - Will trigger the watchdog
 //---------------------------------------------------------------------
 static void test_task(void *pvParameters)
 {
-    // Register this task with TWDT
-    ESP_ERROR_CHECK(esp_task_wdt_add_user("test_user", &twdt_user_handle));
-    ESP_LOGI(TAG, "Test task registered with TWDT");
+    (void)pvParameters;
+    ESP_LOGI(TAG, "Test task started");
     
     int counter = 0;
+
+    // Resume from the last checkpoint if the supervisor restarted us
+    if (checkpoint_restore(TEST_USER_ID, &counter, sizeof(counter), NULL) == ESP_OK) {
+        counter = skip_stall(counter);
+        ESP_LOGI(TAG, "Test task resumed from checkpoint, counter = %d", counter);
+    }
     
     while (1) {
         counter++;
@@ -134,14 +450,14 @@ static void test_task(void *pvParameters)
         // Reset watchdog for the first 3 iterations
         if (counter <= 3) {
             ESP_LOGI(TAG, "Resetting watchdog timer (%d/3)", counter);
-            ESP_ERROR_CHECK(esp_task_wdt_reset_user(twdt_user_handle));
+            SUPERVISE_FEED(TEST_USER_ID);
         } else if (counter == 4) {
             // On the 4th iteration, don't reset and warn about it
             ESP_LOGW(TAG, "Not resetting watchdog - will trigger timeout in %d ms", WATCHDOG_TIMEOUT_MS);
         } else if (counter > 10 && counter < 20) {
             // After recovery, start resetting again
             ESP_LOGI(TAG, "Resuming normal operation, resetting watchdog");
-            ESP_ERROR_CHECK(esp_task_wdt_reset_user(twdt_user_handle));
+            SUPERVISE_FEED(TEST_USER_ID);
         } else if (counter > 20 && counter < 30) {
             // After recovery not reset again for testing
             ESP_LOGI(TAG, "Not resetting watchdog - will trigger timeout in %d ms", WATCHDOG_TIMEOUT_MS);
@@ -149,11 +465,17 @@ static void test_task(void *pvParameters)
             // After recovery, start resetting again
             counter = 0;
             ESP_LOGI(TAG, "Resuming normal operation, resetting watchdog");
-            ESP_ERROR_CHECK(esp_task_wdt_reset_user(twdt_user_handle));
+            SUPERVISE_FEED(TEST_USER_ID);
         }
         
-        // Blink LED to show task is running
+        // Commit progress so a restart resumes from here
+        ESP_ERROR_CHECK(checkpoint_save(TEST_USER_ID, &counter, sizeof(counter)));
+
+        // Blink LED to show task is running, under the resource shared
+        // with test_2_task
+        ESP_ERROR_CHECK(lockmon_lock(&shared_resource, portMAX_DELAY));
         gpio_set_level(STATUS_LED, counter % 2);
+        lockmon_unlock(&shared_resource);
         
         // Delay for 1 second
         vTaskDelay(pdMS_TO_TICKS(1000));
@@ -165,11 +487,16 @@ static void test_task(void *pvParameters)
 //---------------------------------------------------------------------
 static void test_2_task(void *pvParameters)
 {
-    // Register this task with TWDT
-    ESP_ERROR_CHECK(esp_task_wdt_add_user("test_2_user", &twdt_user_2_handle));
-    ESP_LOGI(TAG, "Test task registered with TWDT");
+    (void)pvParameters;
+    ESP_LOGI(TAG, "Test task 2 started");
     
     int counter = 0;
+
+    // Resume from the last checkpoint if the supervisor restarted us
+    if (checkpoint_restore(TEST_2_USER_ID, &counter, sizeof(counter), NULL) == ESP_OK) {
+        counter = skip_stall(counter);
+        ESP_LOGI(TAG, "Test task 2 resumed from checkpoint, counter = %d", counter);
+    }
     
     while (1) {
         counter++;
@@ -178,14 +505,14 @@ static void test_2_task(void *pvParameters)
         // Reset watchdog for the first 3 iterations
         if (counter <= 3) {
             ESP_LOGI(TAG, "Resetting watchdog timer (%d/3)", counter);
-            ESP_ERROR_CHECK(esp_task_wdt_reset_user(twdt_user_2_handle));
+            SUPERVISE_FEED(TEST_2_USER_ID);
         } else if (counter == 4) {
             // On the 4th iteration, don't reset and warn about it
             ESP_LOGW(TAG, "Not resetting watchdog - will trigger timeout in %d ms", WATCHDOG_TIMEOUT_MS);
         } else if (counter > 10 && counter < 20) {
             // After recovery, start resetting again
             ESP_LOGI(TAG, "Resuming normal operation, resetting watchdog");
-            ESP_ERROR_CHECK(esp_task_wdt_reset_user(twdt_user_2_handle));
+            SUPERVISE_FEED(TEST_2_USER_ID);
         } else if (counter > 20 && counter < 30) {
             // After recovery not reset again for testing
             ESP_LOGI(TAG, "Not resetting watchdog - will trigger timeout in %d ms", WATCHDOG_TIMEOUT_MS);
@@ -193,53 +520,111 @@ static void test_2_task(void *pvParameters)
             // After recovery, start resetting again
             counter = 0;
             ESP_LOGI(TAG, "Resuming normal operation, resetting watchdog");
-            ESP_ERROR_CHECK(esp_task_wdt_reset_user(twdt_user_2_handle));
+            SUPERVISE_FEED(TEST_2_USER_ID);
         }
         
-        // Blink LED to show task is running
+        // Commit progress so a restart resumes from here
+        ESP_ERROR_CHECK(checkpoint_save(TEST_2_USER_ID, &counter, sizeof(counter)));
+
+        // Blink LED to show task is running, under the resource shared
+        // with test_task
+        ESP_ERROR_CHECK(lockmon_lock(&shared_resource, portMAX_DELAY));
         gpio_set_level(STATUS_LED_2, counter % 2);
+        lockmon_unlock(&shared_resource);
         
         // Delay for 1 second
         vTaskDelay(pdMS_TO_TICKS(1500));
     }
 }
 
+//---------------------------------------------------------------------
+// Blink an LED rapidly to indicate recovery
+//---------------------------------------------------------------------
+static void blink_recovery(gpio_num_t led)
+{
+    for (int i = 0; i < 10; i++) {
+        gpio_set_level(led, 1);
+        vTaskDelay(pdMS_TO_TICKS(100));
+        gpio_set_level(led, 0);
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+}
+
+//---------------------------------------------------------------------
+// Recover one user through its breaker and escalation ladder
+//---------------------------------------------------------------------
+static void recover_user(supervisor_user_id_t id)
+{
+    supervisor_user_info_t info;
+    ESP_ERROR_CHECK(supervisor_get_info(id, &info));
+    const char *name = info.name;
+    gpio_num_t led = (id == TEST_USER_ID) ? STATUS_LED : STATUS_LED_2;
+
+    if (!breaker_allow(id)) {
+        // Keep the deadline running so the breaker sees the next miss
+        ESP_LOGD(TAG, "%s recovery suppressed", name);
+        supervisor_rearm(id);
+        return;
+    }
+
+    // Not rate limited: at most once per user and round, and the line
+    // tools/loganalyze.c takes as the detection time
+    ESP_LOGI(TAG, "%s failed, taking specific recovery action...", name);
+    int64_t start = esp_timer_get_time();
+    int level = escalation_handle(id);
+    if (level < 0) {
+        // Deferred by the ladder's backoff, not a failed recovery
+        breaker_refund(id);
+        return;
+    }
+    breaker_record(id, esp_timer_get_time() - start);
+
+    if (level == ESCALATION_LOG) {
+        blink_recovery(led);
+    }
+}
+
+//---------------------------------------------------------------------
+// Log the state of every module after one or more recovery rounds
+//---------------------------------------------------------------------
+static void print_reports(uint32_t rounds)
+{
+    ESP_LOGI(TAG, "Reports after %lu recovery round(s)", (unsigned long)rounds);
+    supervisor_print_report();
+    escalation_print_report();
+    breaker_print_report();
+    depgraph_print_report();
+    lockmon_print_report();
+    snapshot_print();
+    statlog_print_report();
+    jobrunner_print_report();
+    workpool_print_report();
+    ESP_LOGI(TAG, "Checksum bursts on the pool: %lu done, %lu late", (unsigned long)pool_burst.bursts,
+             (unsigned long)pool_burst.late);
+    loglimit_print_report();
+    supstats_print_report();
+    supstats_export_to_log();
+}
+
 //---------------------------------------------------------------------
 // Recovery Task - Handles watchdog timeout recovery
 //---------------------------------------------------------------------
 static void recovery_task(void *pvParameters)
 {
+    (void)pvParameters;
+    uint32_t report_rounds = 0;
+    int64_t next_report_us = 0;
+
     while (1) {
-        // Wait for recovery bit to be set
+        // Wait for recovery bit to be set, waking at least once
+        // per log limiter window so its summaries go out even when the
+        // window ends quietly
         EventBits_t bits = xEventGroupWaitBits(
             event_group,
             RECOVERY_ACTIVE_BIT,
             pdTRUE,  // Clear on exit
             pdFALSE, // Don't wait for all bits
-            portMAX_DELAY);
-            
-        ESP_LOGI(TAG, "----------------A---------------------");
-        // Reset the capture flag
-        capturing_task_name = false;
-        task_name_captured = false;
-        failed_task_name[0] = '\0';
-
-        // Get more detailed information about which tasks/users triggered the watchdog
-        int failing_cpus = 0;
-        esp_err_t err = esp_task_wdt_print_triggered_tasks(twdt_msg_handler, NULL, &failing_cpus);
-        
-        // if (task_name_captured) {
-        //     ESP_LOGI(TAG, "Failed task/user name: %s", failed_task_name);
-            
-        //     // Now you can take specific actions based on which task failed
-        //     if (strcmp(failed_task_name, "test_2_user") == 0) {
-        //         ESP_LOGI(TAG, "test_2_user failed, taking specific recovery action...");
-        //         // Recovery action specific to test_2_user
-        //     }
-        //     // Add more conditions for other tasks as needed
-        // }
-
-        ESP_LOGI(TAG, "----------------B---------------------");
+            pdMS_TO_TICKS(LOGLIMIT_WINDOW_MS));
 
         if (bits & RECOVERY_ACTIVE_BIT) {
             // Check our global flag
@@ -247,41 +632,91 @@ static void recovery_task(void *pvParameters)
                 // Reset the flag
                 g_watchdog_timeout_occurred = false;
 
+                // Capture the scheduler state while it still shows the stall
+                snapshot_capture(0);
+
+                // Reset the capture flag
+                capturing_task_name = false;
+                task_name_captured = false;
+                failed_task_name[0] = '\0';
+                twdt_reported_mask = 0;
+
+                // Report which users triggered the TWDT to the supervisor
+                int failing_cpus = 0;
+                esp_task_wdt_print_triggered_tasks(twdt_msg_handler, NULL, &failing_cpus);
+
+                // Record where the reported users are stuck
+                backtrace_capture_mask(twdt_reported_mask);
+
                 // Now it's safe to log
-                ESP_LOGE(TAG, "Custom TWDT handler was invoked! Task failed to reset the watchdog in time.");
-                ESP_LOGE(TAG, "Performing recovery actions...");
-
-                if (task_name_captured) {
-                    if (strcmp(failed_task_name, "test_user") == 0) {
-                        ESP_LOGI(TAG, "test_user failed, taking specific recovery action...");
-                        // Recovery action specific to test_2_user
-                        
-                        // Perform recovery actions - blink LED rapidly to indicate recovery
-                        for (int i = 0; i < 10; i++) {
-                            gpio_set_level(STATUS_LED, 1);
-                            vTaskDelay(pdMS_TO_TICKS(100));
-                            gpio_set_level(STATUS_LED, 0);
-                            vTaskDelay(pdMS_TO_TICKS(100));
-                        }
-                    }
-                    if (strcmp(failed_task_name, "test_2_user") == 0) {
-                        ESP_LOGI(TAG, "test_2_user failed, taking specific recovery action...");
-                        // Recovery action specific to test_2_user
-                        
-                        // Perform recovery actions - blink LED rapidly to indicate recovery
-                        for (int i = 0; i < 10; i++) {
-                            gpio_set_level(STATUS_LED_2, 1);
-                            vTaskDelay(pdMS_TO_TICKS(100));
-                            gpio_set_level(STATUS_LED_2, 0);
-                            vTaskDelay(pdMS_TO_TICKS(100));
-                        }
+                LOGLIMIT_E(TAG, "Custom TWDT handler was invoked! Task failed to reset the watchdog in time.");
+            }
+
+            // Users flagged by either the supervisor deadlines or the TWDT
+            uint32_t failed = supervisor_take_timeouts();
+            if (failed != 0) {
+                LOGLIMIT_E(TAG, "Performing recovery actions...");
+
+                // Recover root causes only; users stuck behind a failed
+                // dependency are expected to resume once it recovers
+                depgraph_result_t analysis;
+                depgraph_analyze(failed, supervisor_get_timed_out_mask(), &analysis);
+
+                for (int i = 0; i < analysis.count; i++) {
+                    supervisor_user_id_t id = analysis.order[i];
+
+                    // Counted in RAM; the stats log writes it out later
+                    statlog_note_timeout(id);
+
+                    // Where the user was stuck when the timeout was noticed
+                    backtrace_print(id);
+
+                    // Point out stalls caused by a lower-priority lock owner
+                    lockmon_explain_timeout(id, (int64_t)WATCHDOG_TIMEOUT_MS * 1000);
+
+                    // A stalled job runner or pool worker is stuck in
+                    // one of its jobs
+                    jobrunner_explain_timeout(id);
+                    workpool_explain_timeout(id);
+
+                    if (analysis.suppressed_mask & (1u << id)) {
+                        LOGLIMIT_W(TAG, "User %d is waiting on a failed dependency, not recovering it", id);
+                        supervisor_rearm(id);
+                        continue;
                     }
+                    recover_user(id);
                 }
-                
+
                 ESP_LOGI(TAG, "Recovery complete");
+                report_rounds++;
+
+                // Learned deadlines for a warm boot should the next
+                // round end in a reset
+                warmboot_save();
+
+#if DUMP_TRACE_ON_RECOVERY
+                // Freeze the window around the incident, then start afresh
+                trace_stop();
+                trace_dump_to_log();
+                trace_init();
+                trace_start();
+#endif
             }
         }
-        
+
+        // The reports are most of the log a fault storm produces; print
+        // them at most once per REPORT_INTERVAL_MS, covering every round
+        // since the last one
+        int64_t now = esp_timer_get_time();
+        if (report_rounds != 0 && now >= next_report_us) {
+            print_reports(report_rounds);
+            report_rounds = 0;
+            next_report_us = now + (int64_t)REPORT_INTERVAL_MS * 1000;
+        }
+
+        // Summaries of repeated lines whose window ended quietly
+        loglimit_flush();
+
         // Short delay before checking again
         vTaskDelay(pdMS_TO_TICKS(100));
     }
@@ -292,24 +727,199 @@ static void recovery_task(void *pvParameters)
 //---------------------------------------------------------------------
 void app_main(void)
 {
+    // Time every init phase from here on, against what it depends on
+    startprof_init();
+
     ESP_LOGI(TAG, "Starting Task Watchdog Example");
+
+    // After a watchdog or software reset the learned deadlines and the
+    // task checkpoints survive in RTC memory; a cold boot starts afresh
+    startprof_phase_t p_warmboot = startprof_begin("warmboot", 0);
+    bool warm = warmboot_begin();
+    if (!warm) {
+        checkpoint_clear_all();
+    }
+    startprof_end(p_warmboot);
     
     // Initialize GPIO for status LED
+    startprof_phase_t p_gpio = startprof_begin("gpio", 0);
     init_gpio();
+    startprof_end(p_gpio);
     
     // Create event group
+    startprof_phase_t p_events = startprof_begin("event_group", 0);
     event_group = xEventGroupCreate();
+    startprof_end(p_events);
     
+    // Preallocated buffer for timeout-time snapshots and per-user slots
+    // for timeout-time backtraces
+    startprof_phase_t p_diag = startprof_begin("snapshot+backtrace", 0);
+    ESP_ERROR_CHECK(snapshot_init());
+    ESP_ERROR_CHECK(backtrace_init());
+    startprof_end(p_diag);
+
+#if RUN_SNAPSHOT_BENCHMARK
+    if (!warm) {
+        snapshot_benchmark();
+    }
+#endif
+
+    // Only opens the partition; the dump is read once the tasks run
+    startprof_phase_t p_crashdump = startprof_begin("crashdump_open", 0);
+    bool have_crashdump = crashdump_init() == ESP_OK;
+    startprof_end(p_crashdump);
+
+    // Scheduling trace: context switches, feeds, timeouts and recoveries
+    startprof_phase_t p_trace = startprof_begin("trace", 0);
+    ESP_ERROR_CHECK(trace_init());
+#if RUN_TRACE_BENCHMARK
+    if (!warm) {
+        trace_benchmark();
+    }
+#endif
+#if RUN_JOBRUNNER_BENCHMARK
+    if (!warm) {
+        jobrunner_benchmark();
+    }
+#endif
+#if RUN_WORKPOOL_BENCHMARK
+    if (!warm) {
+        workpool_benchmark();
+    }
+#endif
+#if RUN_SHARDSUP_BENCHMARK
+    if (!warm) {
+        shardsup_benchmark();
+    }
+#endif
+    trace_start();
+    startprof_end(p_trace);
+
     // Initialize the Task Watchdog Timer
+    startprof_phase_t p_twdt = startprof_begin("twdt", 0);
     init_watchdog();
+    startprof_end(p_twdt);
+
+    // Start the supervisor on top of the TWDT
+    startprof_phase_t p_supervisor = startprof_begin("supervisor", STARTPROF_DEP(p_twdt));
+    init_supervisor();
+    startprof_end(p_supervisor);
     
     // Create the recovery task
+    startprof_phase_t p_recovery = startprof_begin("recovery_task", STARTPROF_DEP(p_events) |
+                                                   STARTPROF_DEP(p_supervisor) | STARTPROF_DEP(p_diag));
     xTaskCreate(recovery_task, "recovery_task", 4096, NULL, 5, NULL);
+    startprof_end(p_recovery);
     
-    // Create the test task that will trigger the watchdog
-    xTaskCreate(test_task, "test_task", 2048, NULL, 4, NULL);
+    // Register the supervised users; the supervisor owns their tasks so it
+    // can recreate them during escalation
+    startprof_phase_t p_users = startprof_begin("add_users", STARTPROF_DEP(p_supervisor));
+    ESP_ERROR_CHECK(supervisor_add_user_at("test_user", TEST_USER_ID));
+    ESP_ERROR_CHECK(supervisor_add_user_at("test_2_user", TEST_2_USER_ID));
+    startprof_end(p_users);
+
+    startprof_phase_t p_escalation = startprof_begin("escalation+breaker", STARTPROF_DEP(p_users));
+    init_escalation();
+    init_breaker();
+    startprof_end(p_escalation);
+
+    // Arm the deadlines learned before the reset instead of warming up
+    // on the fixed timeout again
+    startprof_phase_t p_restore = startprof_begin("restore_models", STARTPROF_DEP(p_users) |
+                                                  STARTPROF_DEP(p_warmboot));
+    if (warm) {
+        warmboot_restore_users();
+    }
+    startprof_end(p_restore);
+
+    // No depgraph_add() edges: the two test tasks take shared_resource
+    // only briefly and stall on their own, so each of their timeouts is
+    // a root cause. Declare an edge when a task blocks on something
+    // another one holds or produces.
+
+    // Report deadlocks between supervised tasks as soon as they form
+    startprof_phase_t p_lockmon = startprof_begin("lockmon", STARTPROF_DEP(p_users));
+    ESP_ERROR_CHECK(lockmon_init(on_deadlock, NULL));
+    ESP_ERROR_CHECK(lockmon_mutex_init(&shared_resource, "shared_resource"));
+    startprof_end(p_lockmon);
+
+    // What the test tasks touch before their first feed
+    uint32_t task_deps = STARTPROF_DEP(p_users) | STARTPROF_DEP(p_gpio) | STARTPROF_DEP(p_lockmon) |
+                         STARTPROF_DEP(p_restore);
+
+    // Create the test tasks that will trigger the watchdog
+    supervisor_task_desc_t test_desc = {
+        .entry = test_task,
+        .task_name = "test_task",
+        .stack_size = 2048,
+        .priority = 4,
+        .arg = NULL,
+        .core_id = tskNO_AFFINITY,
+    };
+    startprof_phase_t p_task = startprof_begin("start:test_task", task_deps);
+    ESP_ERROR_CHECK(supervisor_start_task(TEST_USER_ID, &test_desc));
+    startprof_end(p_task);
+    startprof_add_user(TEST_USER_ID, STARTPROF_DEP(p_task));
 
-    xTaskCreate(test_2_task, "test_2_task", 2048, NULL, 4, NULL);
+    supervisor_task_desc_t test_2_desc = {
+        .entry = test_2_task,
+        .task_name = "test_2_task",
+        .stack_size = 2048,
+        .priority = 4,
+        .arg = NULL,
+        .core_id = tskNO_AFFINITY,
+    };
+    startprof_phase_t p_task_2 = startprof_begin("start:test_2_task", task_deps);
+    ESP_ERROR_CHECK(supervisor_start_task(TEST_2_USER_ID, &test_2_desc));
+    startprof_end(p_task_2);
+    startprof_add_user(TEST_2_USER_ID, STARTPROF_DEP(p_task_2));
+
+    // Flash-bound diagnostics run behind the supervised tasks so they do
+    // not delay the first feeds
+
+    // Report a dump left by a watchdog reset; it is marked reported so
+    // only the first boot after the reset logs it
+    startprof_phase_t p_check = startprof_begin("crashdump_check", STARTPROF_DEP(p_crashdump));
+    if (have_crashdump) {
+        crashdump_check();
+    }
+    startprof_end(p_check);
+
+    // Lifetime stats kept across reboots; runs without the partition
+    startprof_phase_t p_statlog = startprof_begin("statlog", STARTPROF_DEP(p_users));
+    if (statlog_init() == ESP_OK) {
+        statlog_add_user(TEST_USER_ID);
+        statlog_add_user(TEST_2_USER_ID);
+    }
+    startprof_end(p_statlog);
+
+    // Many small supervised activities on one task
+    startprof_phase_t p_jobs = startprof_begin("jobs", STARTPROF_DEP(p_supervisor));
+    init_jobs();
+    startprof_end(p_jobs);
+
+    // Supervised workers, one per core, for bursts of work that should
+    // spread over both cores
+    startprof_phase_t p_pool = startprof_begin("workpool", STARTPROF_DEP(p_supervisor) | STARTPROF_DEP(p_jobs));
+    ESP_ERROR_CHECK(workpool_init(3));
+    ESP_ERROR_CHECK(jobrunner_add_job(0, "pool_burst", pool_burst_job, &pool_burst, 2 * POOL_BURST_MS, NULL));
+    startprof_end(p_pool);
+
+#if ENABLE_FLEET_BEACON
+    // Device-level liveness for the fleet collector, keyed by the MAC
+    uint8_t mac[6];
+    ESP_ERROR_CHECK(esp_efuse_mac_get_default(mac));
+    beacon_config_t beacon = BEACON_CONFIG_DEFAULT();
+    beacon.collector_ip = FLEET_COLLECTOR_IP;
+    beacon.device_id = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5];
+    ESP_ERROR_CHECK(beacon_init(&beacon));
+#endif
     
     ESP_LOGI(TAG, "All tasks created, system running");
+
+    // Time to first feed of this boot against the last one of the other kind
+    warmboot_report_ttff((1u << TEST_USER_ID) | (1u << TEST_2_USER_ID), WATCHDOG_TIMEOUT_MS);
+
+    // Where the time to healthy went and what could run in parallel
+    startprof_report();
 }
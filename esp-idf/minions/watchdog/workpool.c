@@ -0,0 +1,530 @@
+#include <string.h>
+#include <stdio.h>
+#include "hal.h"
+#include "workpool.h"
+#include "loglimit.h"
+
+static const char *TAG = "Workpool";
+
+// Failed searches for work before a worker sleeps
+#define IDLE_SPINS                      64
+// Benchmark shape: bursts each spawning FANOUT pieces of SPIN iterations
+#define BENCHMARK_BURSTS                16
+#define BENCHMARK_FANOUT                32
+#define BENCHMARK_SPIN                  2000
+
+_Static_assert((WORKPOOL_DEQUE_SIZE & (WORKPOOL_DEQUE_SIZE - 1)) == 0, "WORKPOOL_DEQUE_SIZE must be a power of two");
+_Static_assert((WORKPOOL_INJECT_SIZE & (WORKPOOL_INJECT_SIZE - 1)) == 0, "WORKPOOL_INJECT_SIZE must be a power of two");
+
+typedef struct {
+    volatile int32_t top;           // Next to steal
+    volatile int32_t bottom;        // Next free slot, owner only
+    workpool_work_t *volatile buf[WORKPOOL_DEQUE_SIZE];
+} deque_t;
+
+typedef struct {
+    volatile uint32_t seq;
+    workpool_work_t *work;
+} inject_cell_t;
+
+typedef struct pool pool_t;
+
+typedef struct {
+    pool_t *pool;
+    int index;
+    deque_t deque;
+    supervisor_user_id_t user;      // -1 when unsupervised
+    hal_task_t task;
+    volatile bool sleeping;
+
+    // Attribution of a stuck worker
+    workpool_work_t *volatile current;
+    volatile int64_t current_start_us;
+
+    int64_t last_feed_us;
+    uint32_t rng;
+    workpool_worker_stats_t stats;
+} worker_t;
+
+struct pool {
+    worker_t workers[WORKPOOL_MAX_WORKERS];
+    int count;
+    volatile bool stop;
+    volatile int running;           // Benchmark workers not yet exited
+
+    inject_cell_t inject[WORKPOOL_INJECT_SIZE];
+    volatile uint32_t inject_head;  // Next to take
+    volatile uint32_t inject_tail;  // Next to fill
+};
+
+static pool_t s_pool;
+static char s_names[WORKPOOL_MAX_WORKERS][SUPERVISOR_NAME_LEN];
+
+// Worker running on this task or thread, NULL outside the pool
+static __thread worker_t *s_self;
+
+//---------------------------------------------------------------------
+// Chase-Lev deque; push and take by the owner, steal by anyone
+//---------------------------------------------------------------------
+static bool deque_push(deque_t *d, workpool_work_t *work)
+{
+    int32_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+    int32_t t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    if (b - t >= WORKPOOL_DEQUE_SIZE) {
+        return false;
+    }
+    __atomic_store_n(&d->buf[b & (WORKPOOL_DEQUE_SIZE - 1)], work, __ATOMIC_RELAXED);
+    // Publishes the slot to thieves, who read bottom with acquire
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static workpool_work_t *deque_take(deque_t *d)
+{
+    int32_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int32_t t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        // Empty
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    workpool_work_t *work = __atomic_load_n(&d->buf[b & (WORKPOOL_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+    if (t == b) {
+        // Last one: race the thieves for it
+        if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            work = NULL;
+        }
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return work;
+}
+
+static workpool_work_t *deque_steal(deque_t *d)
+{
+    int32_t t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int32_t b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) {
+        return NULL;
+    }
+    workpool_work_t *work = __atomic_load_n(&d->buf[t & (WORKPOOL_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        // Lost to the owner or another thief
+        return NULL;
+    }
+    return work;
+}
+
+//---------------------------------------------------------------------
+// Bounded multi-producer multi-consumer submission queue: each cell's
+// sequence number says whose turn it is
+//---------------------------------------------------------------------
+static void inject_init(pool_t *pool)
+{
+    for (uint32_t i = 0; i < WORKPOOL_INJECT_SIZE; i++) {
+        pool->inject[i].seq = i;
+        pool->inject[i].work = NULL;
+    }
+    pool->inject_head = 0;
+    pool->inject_tail = 0;
+}
+
+static bool inject_push(pool_t *pool, workpool_work_t *work)
+{
+    uint32_t pos = __atomic_load_n(&pool->inject_tail, __ATOMIC_RELAXED);
+    inject_cell_t *cell;
+    while (1) {
+        cell = &pool->inject[pos & (WORKPOOL_INJECT_SIZE - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&pool->inject_tail, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = __atomic_load_n(&pool->inject_tail, __ATOMIC_RELAXED);
+        }
+    }
+    cell->work = work;
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static workpool_work_t *inject_pop(pool_t *pool)
+{
+    uint32_t pos = __atomic_load_n(&pool->inject_head, __ATOMIC_RELAXED);
+    inject_cell_t *cell;
+    while (1) {
+        cell = &pool->inject[pos & (WORKPOOL_INJECT_SIZE - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&pool->inject_head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&pool->inject_head, __ATOMIC_RELAXED);
+        }
+    }
+    workpool_work_t *work = cell->work;
+    __atomic_store_n(&cell->seq, pos + WORKPOOL_INJECT_SIZE, __ATOMIC_RELEASE);
+    return work;
+}
+
+//---------------------------------------------------------------------
+// Sleeping and waking idle workers
+//---------------------------------------------------------------------
+static void worker_idle(worker_t *w)
+{
+    w->sleeping = true;
+    hal_notify_take(HAL_TICK_US);
+    w->sleeping = false;
+}
+
+static void wake_idle(pool_t *pool, const worker_t *except)
+{
+    for (int i = 0; i < pool->count; i++) {
+        worker_t *w = &pool->workers[i];
+        if (w != except && w->sleeping && w->task != NULL) {
+            hal_notify_give(w->task);
+        }
+    }
+}
+
+//---------------------------------------------------------------------
+// Find work: own deque first, then the submission queue, then steal
+// from the others starting at a random victim
+//---------------------------------------------------------------------
+static workpool_work_t *find_work(worker_t *w)
+{
+    pool_t *pool = w->pool;
+    workpool_work_t *work = deque_take(&w->deque);
+    if (work != NULL) {
+        return work;
+    }
+
+    work = inject_pop(pool);
+    if (work != NULL) {
+        w->stats.injected++;
+        return work;
+    }
+
+    if (pool->count > 1) {
+        w->rng ^= w->rng << 13;
+        w->rng ^= w->rng >> 17;
+        w->rng ^= w->rng << 5;
+        int start = (int)(w->rng % (uint32_t)pool->count);
+        for (int i = 0; i < pool->count; i++) {
+            worker_t *victim = &pool->workers[(start + i) % pool->count];
+            if (victim == w) {
+                continue;
+            }
+            work = deque_steal(&victim->deque);
+            if (work != NULL) {
+                w->stats.stolen++;
+                return work;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void run_work(worker_t *w, workpool_work_t *work)
+{
+    w->current_start_us = hal_time_us();
+    w->current = work;
+    work->fn(work->arg);
+    w->current = NULL;
+    w->stats.executed++;
+}
+
+static void maybe_feed(worker_t *w)
+{
+    if (w->user < 0) {
+        return;
+    }
+    int64_t now = hal_time_us();
+    if (now - w->last_feed_us >= WORKPOOL_FEED_MS * 1000) {
+        w->last_feed_us = now;
+        supervisor_feed(w->user);
+    }
+}
+
+static void worker_loop(worker_t *w)
+{
+    s_self = w;
+    w->rng = 0x9e3779b9u * (uint32_t)(w->index + 1);
+    int idle = 0;
+
+    while (!__atomic_load_n(&w->pool->stop, __ATOMIC_RELAXED)) {
+        workpool_work_t *work = find_work(w);
+        if (work != NULL) {
+            run_work(w, work);
+            idle = 0;
+        } else if (++idle >= IDLE_SPINS) {
+            worker_idle(w);
+            idle = 0;
+        }
+        maybe_feed(w);
+    }
+}
+
+//---------------------------------------------------------------------
+// Worker Task - one per core in the supervised pool
+//---------------------------------------------------------------------
+static void worker_task(void *pvParameters)
+{
+    worker_t *w = (worker_t *)pvParameters;
+
+    // A restarted worker cannot resume the work its predecessor was
+    // deleted in; it is dropped and the deque carries on
+    if (w->current != NULL) {
+        LOGLIMIT_W(TAG, "Worker %d dropped %s after a restart", w->index, w->current->name);
+        w->current = NULL;
+        w->stats.abandoned++;
+    }
+    w->task = hal_task_current();
+    worker_loop(w);
+
+    __atomic_sub_fetch(&w->pool->running, 1, __ATOMIC_RELEASE);
+    hal_task_delete(NULL);
+}
+
+//---------------------------------------------------------------------
+// Public API
+//---------------------------------------------------------------------
+esp_err_t workpool_init(uint32_t priority)
+{
+    pool_t *pool = &s_pool;
+    if (pool->count != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    inject_init(pool);
+
+    int count = hal_num_cores() < WORKPOOL_MAX_WORKERS ? hal_num_cores() : WORKPOOL_MAX_WORKERS;
+    for (int i = 0; i < count; i++) {
+        worker_t *w = &pool->workers[i];
+        w->pool = pool;
+        w->index = i;
+        snprintf(s_names[i], SUPERVISOR_NAME_LEN, "pool%d", i);
+        esp_err_t err = supervisor_add_user(s_names[i], &w->user);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    pool->count = count;
+
+    for (int i = 0; i < count; i++) {
+        worker_t *w = &pool->workers[i];
+        supervisor_task_desc_t desc = {
+            .entry = worker_task,
+            .task_name = s_names[i],
+            .stack_size = WORKPOOL_STACK_SIZE,
+            .priority = priority,
+            .arg = w,
+            .core_id = i,
+        };
+        esp_err_t err = supervisor_start_task(w->user, &desc);
+        if (err != ESP_OK) {
+            return err;
+        }
+        w->task = supervisor_get_task(w->user);
+    }
+    HAL_LOGI(TAG, "Started %d supervised workers", count);
+    return ESP_OK;
+}
+
+static esp_err_t submit(pool_t *pool, workpool_work_t *work)
+{
+    worker_t *self = s_self;
+    if (self != NULL && self->pool == pool) {
+        if (!deque_push(&self->deque, work)) {
+            self->stats.inline_runs++;
+            work->fn(work->arg);
+            return ESP_OK;
+        }
+        wake_idle(pool, self);
+        return ESP_OK;
+    }
+    if (!inject_push(pool, work)) {
+        return ESP_ERR_NO_MEM;
+    }
+    wake_idle(pool, NULL);
+    return ESP_OK;
+}
+
+esp_err_t workpool_submit(workpool_work_t *work)
+{
+    if (work == NULL || work->fn == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_pool.count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return submit(&s_pool, work);
+}
+
+bool workpool_explain_timeout(supervisor_user_id_t id)
+{
+    for (int i = 0; i < s_pool.count; i++) {
+        worker_t *w = &s_pool.workers[i];
+        if (w->user != id) {
+            continue;
+        }
+        workpool_work_t *work = w->current;
+        int64_t start_us = w->current_start_us;
+        if (work == NULL) {
+            return false;
+        }
+        LOGLIMIT_W(TAG, "Worker %d is stuck in %s for %lld ms", i, work->name ? work->name : "?",
+                   (long long)((hal_time_us() - start_us) / 1000));
+        return true;
+    }
+    return false;
+}
+
+esp_err_t workpool_get_stats(int worker, workpool_worker_stats_t *out)
+{
+    if (worker < 0 || worker >= s_pool.count || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out = s_pool.workers[worker].stats;
+    return ESP_OK;
+}
+
+void workpool_print_report(void)
+{
+    for (int i = 0; i < s_pool.count; i++) {
+        const workpool_worker_stats_t *stats = &s_pool.workers[i].stats;
+        HAL_LOGI(TAG, "  worker %d: %lu executed, %lu stolen, %lu submitted, %lu inline, %lu dropped",
+                 i, (unsigned long)stats->executed, (unsigned long)stats->stolen,
+                 (unsigned long)stats->injected, (unsigned long)stats->inline_runs,
+                 (unsigned long)stats->abandoned);
+    }
+}
+
+//---------------------------------------------------------------------
+// Benchmark
+//---------------------------------------------------------------------
+typedef struct {
+    pool_t *pool;
+    workpool_work_t children[BENCHMARK_FANOUT];
+} bench_burst_t;
+
+static pool_t s_bench_pool;
+static bench_burst_t s_bursts[BENCHMARK_BURSTS];
+static workpool_work_t s_burst_roots[BENCHMARK_BURSTS];
+static volatile uint32_t s_bench_done;
+static volatile int64_t s_bench_end_us;     // Set by the last leaf to finish
+static volatile uint32_t s_bench_sink;
+
+static void bench_leaf(void *arg)
+{
+    uint32_t x = (uint32_t)(uintptr_t)arg | 1;
+    for (int i = 0; i < BENCHMARK_SPIN; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+    }
+    __atomic_store_n(&s_bench_sink, x, __ATOMIC_RELAXED);
+    if (__atomic_add_fetch(&s_bench_done, 1, __ATOMIC_ACQ_REL) == BENCHMARK_BURSTS * BENCHMARK_FANOUT) {
+        __atomic_store_n(&s_bench_end_us, hal_time_us(), __ATOMIC_RELEASE);
+    }
+}
+
+// Root of a burst: spawns its children onto the running worker's deque
+static void bench_root(void *arg)
+{
+    bench_burst_t *burst = (bench_burst_t *)arg;
+    for (int i = 0; i < BENCHMARK_FANOUT; i++) {
+        burst->children[i] = (workpool_work_t) {
+            .fn = bench_leaf,
+            .arg = (void *)(uintptr_t)(i + 1),
+            .name = "bench_leaf",
+        };
+        submit(burst->pool, &burst->children[i]);
+    }
+}
+
+static void bench_task(void *pvParameters)
+{
+    worker_t *w = (worker_t *)pvParameters;
+    w->task = hal_task_current();
+    worker_loop(w);
+    __atomic_sub_fetch(&w->pool->running, 1, __ATOMIC_RELEASE);
+    hal_task_delete(NULL);
+}
+
+//---------------------------------------------------------------------
+// Run all bursts on count workers, returns leaves per second
+//---------------------------------------------------------------------
+static uint32_t bench_run(int count, uint32_t *out_steals)
+{
+    pool_t *pool = &s_bench_pool;
+    memset(pool, 0, sizeof(*pool));
+    inject_init(pool);
+    pool->count = count;
+    pool->running = count;
+    s_bench_done = 0;
+    s_bench_end_us = 0;
+
+    for (int i = 0; i < count; i++) {
+        worker_t *w = &pool->workers[i];
+        w->pool = pool;
+        w->index = i;
+        w->user = -1;
+        hal_task_create(bench_task, "pool_bench", WORKPOOL_STACK_SIZE, w, 2, i, NULL);
+    }
+
+    int64_t start = hal_time_us();
+    for (int i = 0; i < BENCHMARK_BURSTS; i++) {
+        s_bursts[i].pool = pool;
+        s_burst_roots[i] = (workpool_work_t) { .fn = bench_root, .arg = &s_bursts[i], .name = "bench_root" };
+        while (submit(pool, &s_burst_roots[i]) != ESP_OK) {
+            hal_delay_ms(1);
+        }
+    }
+    // The poll sleeps a whole tick on the target, longer than the run
+    // itself; the last leaf takes the end time instead
+    int64_t end;
+    while ((end = __atomic_load_n(&s_bench_end_us, __ATOMIC_ACQUIRE)) == 0) {
+        hal_delay_ms(1);
+    }
+    int64_t elapsed_us = end - start;
+
+    __atomic_store_n(&pool->stop, true, __ATOMIC_RELAXED);
+    wake_idle(pool, NULL);
+    while (__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE) > 0) {
+        hal_delay_ms(1);
+    }
+
+    uint32_t steals = 0;
+    for (int i = 0; i < count; i++) {
+        steals += pool->workers[i].stats.stolen;
+    }
+    *out_steals = steals;
+    return elapsed_us > 0 ? (uint32_t)((uint64_t)BENCHMARK_BURSTS * BENCHMARK_FANOUT * 1000000 / elapsed_us) : 0;
+}
+
+void workpool_benchmark(void)
+{
+    int max_workers = hal_num_cores() < WORKPOOL_MAX_WORKERS ? hal_num_cores() : WORKPOOL_MAX_WORKERS;
+
+    uint32_t base = 0;
+    for (int count = 1; count <= max_workers; count++) {
+        uint32_t steals;
+        uint32_t rate = bench_run(count, &steals);
+        if (count == 1) {
+            base = rate;
+        }
+        HAL_LOGI(TAG, "%d worker%s: %lu items/s, speedup %.2f, %lu steals", count, count > 1 ? "s" : " ",
+                 (unsigned long)rate, base ? (double)rate / base : 0.0, (unsigned long)steals);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+#include "supervisor.h"
+
+// Workers of one pool; the supervised pool uses one per core
+#define WORKPOOL_MAX_WORKERS            8
+// Per-worker deque, power of two. Work spawned into a full deque runs
+// inline.
+#define WORKPOOL_DEQUE_SIZE             256
+// Work submitted from outside the pool, power of two
+#define WORKPOOL_INJECT_SIZE            128
+// Supervised workers feed at most this often while busy
+#define WORKPOOL_FEED_MS                10
+#define WORKPOOL_STACK_SIZE             3072
+
+typedef void (*workpool_fn_t)(void *arg);
+
+// One piece of run-to-completion work. Owned by the submitter and must
+// stay valid until fn has started.
+typedef struct {
+    workpool_fn_t fn;
+    void *arg;
+    const char *name;               // Reported when a worker is stuck in it
+} workpool_work_t;
+
+//---------------------------------------------------------------------
+// Work-stealing worker pool
+//
+// Each worker owns a Chase-Lev deque: it pushes and takes work at the
+// bottom, idle workers steal from the top, so a burst spawned on one
+// core spreads over the others without a shared lock. Work submitted
+// from outside the pool goes through a bounded multi-producer queue that
+// every worker drains. Both use only atomics, so the same code runs on
+// FreeRTOS tasks on the target and on threads through hal_linux.c.
+//
+// In the supervised pool every worker is a supervisor user pinned to
+// its core ("pool0", "pool1", ...). A worker records the work it is
+// running, so a timeout of the worker can be attributed to that work
+// with workpool_explain_timeout(). A worker restarted by the escalation
+// ladder drops the work it was stuck in and carries on with its deque.
+//---------------------------------------------------------------------
+typedef struct {
+    uint32_t executed;
+    uint32_t stolen;                // Taken from another worker's deque
+    uint32_t injected;              // Taken from the submission queue
+    uint32_t inline_runs;           // Spawned into a full deque
+    uint32_t abandoned;             // Dropped by a restart
+} workpool_worker_stats_t;
+
+// Start one supervised worker per core at the given priority
+esp_err_t workpool_init(uint32_t priority);
+
+// Queue work. From inside a worker it goes onto that worker's deque,
+// otherwise onto the submission queue. Returns ESP_ERR_NO_MEM if the
+// submission queue is full.
+esp_err_t workpool_submit(workpool_work_t *work);
+
+// If the user is a worker stuck inside a piece of work, log the work.
+// Returns true if so.
+bool workpool_explain_timeout(supervisor_user_id_t id);
+
+esp_err_t workpool_get_stats(int worker, workpool_worker_stats_t *out);
+
+void workpool_print_report(void);
+
+// Throughput of fork-style bursts with 1 to all cores (tasks pinned to
+// each core) or 1 to WORKPOOL_MAX_WORKERS threads on the host, on an
+// unsupervised pool of its own
+void workpool_benchmark(void);